@@ -0,0 +1,227 @@
+/*******************************************************************************
+ * File Name: color.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code to convert isl29125 counts to CIE XYZ, 
+ *  lux, xy chromaticity and correlated color temperature.
+ *  Only integer math is used, the Cortex-M has no floating point unit and 
+ *  a conversion has to keep up with the sensor.  It takes 9 multiplies for
+ *  the matrix and 3 divides for the chromaticity and color temperature.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "color.h"
+
+/***************************************
+*      Conversion constants
+***************************************/  
+
+// Lux of one count of the 375 lux range at 16 bits is 375 / 65535 = 5.7217 mlux,
+// split into a whole part and a fraction of 1024
+#define MILLILUX_PER_COUNT          5
+#define MILLILUX_FRACTION           739
+#define MILLILUX_FRACTION_SHIFT     10
+
+// McCamy's approximation, CCT = -449 n^3 + 3525 n^2 - 6823.3 n + 5520.33
+// with n = (x - 0.3320) / (y - 0.1858).  Coefficients are scaled by 10
+#define MCCAMY_XE                   10879   // 0.3320 in Q15
+#define MCCAMY_YE                   6088    // 0.1858 in Q15
+#define MCCAMY_N_SHIFT              12
+#define MCCAMY_N_LIMIT              (2L << MCCAMY_N_SHIFT)
+#define MCCAMY_A3                   (-4490L)
+#define MCCAMY_A2                   35250L
+#define MCCAMY_A1                   (-68233L)
+#define MCCAMY_A0                   55203L
+#define MCCAMY_SCALE                10
+
+/******************************************************************************
+* Default calibration
+*******************************************************************************
+*
+* Linear sRGB to XYZ matrix, treating the red, green and blue channels as
+* sRGB primaries.  It is only a placeholder, each sensor and light diffuser
+* should be calibrated against a reference meter and its own matrix passed in.
+*
+*******************************************************************************/
+
+const COLOR_CALIBRATION color_default_calibration = {{
+    {27027, 23436, 11829},
+    {13933, 46871,  4732},
+    { 1265,  7812, 62292}
+}};
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static int32 matrix_row(const int32* row, const ISL29125_RGB* rgb);
+
+static uint32 scale_counts(int32 counts, const ISL29125_RGB* rgb);
+
+
+/******************************************************************************
+* Function Name: color_convert
+*******************************************************************************
+*
+* Summary:
+*  Convert a sample to XYZ with the calibration matrix, then calculate 
+*  the lux, xy chromaticity and color temperature.  The matrix is applied 
+*  to the raw counts and the results are then normalized with the range
+*  and resolution the sample was measured at.
+*
+* Parameters:
+*  const COLOR_CALIBRATION* calibration: matrix to use, 
+*                                        or &color_default_calibration
+*  const ISL29125_RGB* rgb: sample to convert
+*  COLOR_RESULT* result: structure to put the results in
+*
+*******************************************************************************/
+
+void color_convert(const COLOR_CALIBRATION* calibration, const ISL29125_RGB* rgb, 
+                   COLOR_RESULT* result) {
+    uint32 X;
+    uint32 Y;
+    uint32 sum;
+    
+    result->X = scale_counts(matrix_row(calibration->matrix[0], rgb), rgb);
+    result->Y = scale_counts(matrix_row(calibration->matrix[1], rgb), rgb);
+    result->Z = scale_counts(matrix_row(calibration->matrix[2], rgb), rgb);
+    
+    Y = result->Y;
+    result->millilux = Y * MILLILUX_PER_COUNT + 
+                       ((Y * MILLILUX_FRACTION) >> MILLILUX_FRACTION_SHIFT);
+    
+    X = result->X;
+    sum = X + Y + result->Z;
+    if (sum == 0) {
+        result->x = 0;
+        result->y = 0;
+        result->cct = COLOR_CCT_INVALID;
+        return;
+    }
+    // keep the shifted numerators in 31 bits
+    while (sum > 0xFFFF) {
+        X >>= 1;
+        Y >>= 1;
+        sum >>= 1;
+    }
+    result->x = (X << COLOR_XY_SHIFT) / sum;
+    result->y = (Y << COLOR_XY_SHIFT) / sum;
+    result->cct = color_cct(result->x, result->y);
+}
+
+/******************************************************************************
+* Function Name: color_cct
+*******************************************************************************
+*
+* Summary:
+*  Calculate the correlated color temperature from the chromaticity with
+*  McCamy's cubic approximation.  It is good to a few kelvin between about
+*  2000 K and 12000 K, further from the planckian locus it is only a guide.
+*
+* Parameters:
+*  uint16 x: chromaticity x, Q15
+*  uint16 y: chromaticity y, Q15
+*
+* Return:
+*  uint16: color temperature in kelvin, or COLOR_CCT_INVALID
+*
+*******************************************************************************/
+
+uint16 color_cct(uint16 x, uint16 y) {
+    int32 n;
+    int32 n2;
+    int32 n3;
+    int32 cct;
+    
+    if (y <= MCCAMY_YE) {
+        return COLOR_CCT_INVALID;
+    }
+    n = ((int32) x - MCCAMY_XE) * (1L << MCCAMY_N_SHIFT) / ((int32) y - MCCAMY_YE);
+    if ((n > MCCAMY_N_LIMIT) || (n < -MCCAMY_N_LIMIT)) {
+        return COLOR_CCT_INVALID;
+    }
+    n2 = (n * n) >> MCCAMY_N_SHIFT;
+    n3 = (n2 * n) / (1L << MCCAMY_N_SHIFT);
+    
+    cct = MCCAMY_A3 * n3 + MCCAMY_A2 * n2 + MCCAMY_A1 * n + 
+          (MCCAMY_A0 << MCCAMY_N_SHIFT);
+    if (cct <= 0) {
+        return COLOR_CCT_INVALID;
+    }
+    cct = (cct + (MCCAMY_SCALE << (MCCAMY_N_SHIFT - 1))) / (MCCAMY_SCALE << MCCAMY_N_SHIFT);
+    if (cct > 0xFFFF) {
+        return COLOR_CCT_INVALID;
+    }
+    return cct;
+}
+
+/*****************************************************************************
+* Function Name: matrix_row
+******************************************************************************
+*
+* Summary:
+*  Multiply the counts by one row of the Q16 matrix.  Each coefficient is 
+*  split into its whole and fraction parts so the products stay in 32 bits.
+*
+* Parameters:
+*  const int32* row: 3 coefficients for the red, green and blue counts
+*  const ISL29125_RGB* rgb: counts
+*
+* Return:
+*  int32: sum of the products, in counts
+*
+*******************************************************************************/
+
+static int32 matrix_row(const int32* row, const ISL29125_RGB* rgb) {
+    uint16 counts[3];
+    int32 sum = 0;
+    uint8 i;
+    
+    counts[0] = rgb->red;
+    counts[1] = rgb->green;
+    counts[2] = rgb->blue;
+    for (i = 0; i < 3; i++) {
+        // the whole part floors, so the fraction part is always positive
+        sum += (int32) counts[i] * (row[i] >> COLOR_MATRIX_SHIFT);
+        sum += ((uint32) counts[i] * (row[i] & (COLOR_MATRIX_ONE - 1))) >> COLOR_MATRIX_SHIFT;
+    }
+    return sum;
+}
+
+/*****************************************************************************
+* Function Name: scale_counts
+******************************************************************************
+*
+* Summary:
+*  Scale counts to the 375 lux range at 16 bits, negative values from 
+*  the matrix are clipped to 0
+*
+* Parameters:
+*  int32 counts: counts at the range and resolution of the sample
+*  const ISL29125_RGB* rgb: sample the counts were calculated from
+*
+* Return:
+*  uint32: normalized counts
+*
+*******************************************************************************/
+
+static uint32 scale_counts(int32 counts, const ISL29125_RGB* rgb) {
+    if (counts <= 0) {
+        return 0;
+    }
+    return isl29125_normalize(counts, rgb->intensity_range, rgb->adc_resolution);
+}
+
+/* [] END OF FILE */
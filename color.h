@@ -0,0 +1,74 @@
+/*******************************************************************************
+ * File Name: color.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the fixed point conversion of isl29125 counts to 
+ *  CIE XYZ, lux, xy chromaticity and correlated color temperature.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_COLOR_H)
+#define _COLOR_H
+    
+#include "platform.h"
+#include "isl29125.h"
+    
+/***************************************
+*      Conversion constants
+***************************************/ 
+
+// Fraction bits of the calibration matrix coefficients
+#define COLOR_MATRIX_SHIFT          16
+#define COLOR_MATRIX_ONE            (1L << COLOR_MATRIX_SHIFT)
+    
+// Fraction bits of the x and y chromaticity coordinates
+#define COLOR_XY_SHIFT              15
+    
+// Returned as the color temperature when it can not be calculated
+#define COLOR_CCT_INVALID           0
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+// Maps the red, green and blue counts to X, Y and Z, in Q16
+// X = m[0][0]*red + m[0][1]*green + m[0][2]*blue, and so on for Y and Z
+typedef struct {
+    int32       matrix[3][3];
+} COLOR_CALIBRATION;
+
+typedef struct {
+    // Tristimulus values in counts of the 375 lux range at 16 bits
+    int32       X;
+    int32       Y;
+    int32       Z;
+    uint32      millilux;
+    uint16      x;          // chromaticity, Q15
+    uint16      y;
+    uint16      cct;        // kelvin, or COLOR_CCT_INVALID
+} COLOR_RESULT;
+
+extern const COLOR_CALIBRATION color_default_calibration;
+    
+/***************************************
+*        Function Prototypes
+***************************************/     
+
+void color_convert(const COLOR_CALIBRATION* calibration, const ISL29125_RGB* rgb, 
+                   COLOR_RESULT* result);
+uint16 color_cct(uint16 x, uint16 y);
+
+#endif
+
+/* [] END OF FILE */
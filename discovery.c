@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * File Name: discovery.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the startup discovery of the
+ *  sensors.  Every address a supported device can have is probed on every
+ *  bus with an address only transfer, and the addresses that answer have
+ *  their ID register read to check the part.  The probes of all the buses
+ *  are queued before any is waited on, so independent buses are probed at
+ *  the same time.  An address with no device costs one address byte.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "discovery.h"
+
+// An address a supported device can have, and where its ID is read from
+typedef struct {
+    uint8       type;
+    uint8       address;
+    uint8       id_register;    // with the command bits of the device
+} CANDIDATE;
+
+static const CANDIDATE candidates[] = {
+    {DISCOVERY_ISL29125,    ISL29125_I2C_ADDRESS,   ISL29125_DEVICE_ID_REG},
+    {DISCOVERY_TSL2561,     I2C_ADDRESS_GROUND,     TSL2561_COMMAND_BIT | TSL2561_REG_ID},
+    {DISCOVERY_TSL2561,     I2C_ADDRESS_FLOAT,      TSL2561_COMMAND_BIT | TSL2561_REG_ID},
+    {DISCOVERY_TSL2561,     I2C_ADDRESS_VDD,        TSL2561_COMMAND_BIT | TSL2561_REG_ID}
+};
+
+#define NUM_CANDIDATES              (sizeof(candidates) / sizeof(candidates[0]))
+#define MAX_PROBES                  (DISCOVERY_MAX_BUSES * NUM_CANDIDATES)
+
+// One candidate address on one bus
+typedef struct {
+    SENSOR_TRANSACTION  transaction;
+    SENSOR_BUS*         bus;
+    const CANDIDATE*    candidate;
+    uint8               id;
+} PROBE;
+
+static PROBE probes[MAX_PROBES];
+
+/***************************************
+*      Static Function Prototypes
+***************************************/
+
+static void run_probes(uint8 num_probes, SENSOR_BUS* const* buses, uint8 num_buses);
+static bool identify(const CANDIDATE* candidate, uint8 id);
+
+/******************************************************************************
+* Function Name: discovery_scan
+*******************************************************************************
+*
+* Summary:
+*  Find the supported devices on the buses.  All the candidate addresses
+*  are probed on all the buses at once, then the ID registers of the
+*  addresses that answered are read at once.  A device whose ID is right
+*  is added to the table, ready for the init of its driver with the bus
+*  and address in its entry.  Needs the timebase to be running, for the
+*  bus timeouts.
+*
+* Parameters:
+*  DISCOVERY_TABLE* table: table to fill
+*  SENSOR_BUS* const* buses: buses to scan, up to DISCOVERY_MAX_BUSES
+*  uint8 num_buses: number of buses
+*
+* Return:
+*  uint8: number of devices found
+*
+*******************************************************************************/
+
+uint8 discovery_scan(DISCOVERY_TABLE* table, SENSOR_BUS* const* buses, uint8 num_buses) {
+    DISCOVERY_DEVICE* device;
+    PROBE* probe;
+    uint8 num_probes = 0;
+    uint8 num_found = 0;
+    uint8 i;
+    uint8 j;
+
+    if (num_buses > DISCOVERY_MAX_BUSES) {
+        num_buses = DISCOVERY_MAX_BUSES;
+    }
+    for (i = 0; i < num_buses; i++) {
+        for (j = 0; j < NUM_CANDIDATES; j++) {
+            probe = &probes[num_probes++];
+            probe->bus = buses[i];
+            probe->candidate = &candidates[j];
+            sensor_probe_init(&probe->transaction, candidates[j].address);
+        }
+    }
+    table->probes = num_probes;
+    run_probes(num_probes, buses, num_buses);
+
+    // turn the answered probes into reads of the ID register
+    for (i = 0; i < num_probes; i++) {
+        probe = &probes[i];
+        if (probe->transaction.status == SENSOR_OK) {
+            probe->transaction.type = SENSOR_XFER_READ;
+            probe->transaction._register = probe->candidate->id_register;
+            probe->transaction.buffer = &probe->id;
+            probe->transaction.num_bytes = 1;
+        }
+    }
+    run_probes(num_probes, buses, num_buses);
+
+    for (i = 0; i < num_probes; i++) {
+        probe = &probes[i];
+        if ((probe->transaction.type != SENSOR_XFER_READ) ||
+                (probe->transaction.status != SENSOR_OK) ||
+                !identify(probe->candidate, probe->id) ||
+                (num_found >= DISCOVERY_MAX_DEVICES)) {
+            continue;
+        }
+        device = &table->devices[num_found++];
+        device->type = probe->candidate->type;
+        device->bus = probe->bus;
+        device->address = probe->candidate->address;
+        device->id = probe->id;
+    }
+    table->num_devices = num_found;
+    return num_found;
+}
+
+/******************************************************************************
+* Function Name: discovery_find
+*******************************************************************************
+*
+* Summary:
+*  Get a device of one type from the table
+*
+* Parameters:
+*  DISCOVERY_TABLE* table: table filled by discovery_scan
+*  uint8 type: DISCOVERY_ISL29125 or DISCOVERY_TSL2561
+*  uint8 index: 0 for the first device of the type, 1 for the next...
+*
+* Return:
+*  DISCOVERY_DEVICE*: the device, or 0 if there are not that many
+*
+*******************************************************************************/
+
+DISCOVERY_DEVICE* discovery_find(DISCOVERY_TABLE* table, uint8 type, uint8 index) {
+    uint8 i;
+    for (i = 0; i < table->num_devices; i++) {
+        if (table->devices[i].type != type) {
+            continue;
+        }
+        if (index == 0) {
+            return &table->devices[i];
+        }
+        index--;
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: run_probes
+*******************************************************************************
+*
+* Summary:
+*  Queue the transactions of the probes and service all the buses until
+*  every one has finished.  Probes whose last transaction failed, e.g. a
+*  probe that was not answered, are done already and are skipped.  A full
+*  queue is serviced until it has room, the other buses are already 
+*  working on theirs.
+*
+*******************************************************************************/
+
+static void run_probes(uint8 num_probes, SENSOR_BUS* const* buses, uint8 num_buses) {
+    PROBE* probe;
+    bool busy = true;
+    uint8 i;
+
+    for (i = 0; i < num_probes; i++) {
+        probe = &probes[i];
+        if (probe->transaction.status != SENSOR_OK) {
+            continue;
+        }
+        while (!sensor_bus_submit(probe->bus, &probe->transaction)) {
+            sensor_bus_service(probe->bus);
+        }
+    }
+    while (busy) {
+        busy = false;
+        for (i = 0; i < num_buses; i++) {
+            sensor_bus_service(buses[i]);
+        }
+        for (i = 0; i < num_probes; i++) {
+            if (probes[i].transaction.state != SENSOR_XFER_DONE) {
+                busy = true;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: identify
+*******************************************************************************
+*
+* Return:
+*  bool: true if the ID byte is the one of the candidate's part
+*
+*******************************************************************************/
+
+static bool identify(const CANDIDATE* candidate, uint8 id) {
+    uint8 part;
+
+    if (candidate->type == DISCOVERY_ISL29125) {
+        return (id == ISL29125_DEVICE_ID);
+    }
+    part = id & TSL2561_ID_PARTNO_MASK;
+    return ((part == TSL2561_ID_PARTNO_T) || (part == TSL2561_ID_PARTNO_CS));
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,74 @@
+/*******************************************************************************
+ * File Name: discovery.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the startup discovery of the sensors, that finds
+ *  which of the supported devices answer on each bus and builds the table
+ *  of devices the application samples.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_DISCOVERY_H)
+#define _DISCOVERY_H
+
+#include "platform.h"
+#include "stdbool.h"
+#include "sensor.h"
+#include "isl29125.h"
+#include "tsl2561.h"
+
+/***************************************
+*      Discovery constants
+***************************************/
+
+#define DISCOVERY_MAX_BUSES         4
+#define DISCOVERY_MAX_DEVICES       8
+
+// Device types
+#define DISCOVERY_NONE              0
+#define DISCOVERY_ISL29125          1
+#define DISCOVERY_TSL2561           2
+
+/***************************************
+*      Structures
+***************************************/
+
+// A device found on a bus, with the driver structure it is used through
+typedef struct {
+    uint8       type;       // DISCOVERY_ISL29125 or DISCOVERY_TSL2561
+    SENSOR_BUS* bus;
+    uint8       address;
+    uint8       id;         // byte read from its ID register
+    union {
+        ISL29125    isl29125;
+        TSL2561     tsl2561;
+    } driver;
+} DISCOVERY_DEVICE;
+
+typedef struct {
+    DISCOVERY_DEVICE    devices[DISCOVERY_MAX_DEVICES];
+    uint8               num_devices;
+    uint8               probes;     // addresses probed by the last scan
+} DISCOVERY_TABLE;
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 discovery_scan(DISCOVERY_TABLE* table, SENSOR_BUS* const* buses, uint8 num_buses);
+DISCOVERY_DEVICE* discovery_find(DISCOVERY_TABLE* table, uint8 type, uint8 index);
+
+#endif
+
+/* [] END OF FILE */
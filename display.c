@@ -0,0 +1,233 @@
+/*******************************************************************************
+ * File Name: display.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the character LCD frame buffer.
+ *  The text of a screen is put together in the frame buffer and 
+ *  display_update sends only the characters that differ from what the
+ *  LCD shows, so there is no LCD_ClearDisplay and no flicker.  Numbers
+ *  are formatted here instead of with sprintf, which keeps newlib's 
+ *  printf code out of the flash.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "display.h"
+
+// Most decimal digits of a uint32
+#define MAX_DIGITS                  10
+
+static char frame[DISPLAY_ROWS][DISPLAY_COLUMNS];   // text to show
+static char shown[DISPLAY_ROWS][DISPLAY_COLUMNS];   // text on the LCD
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static uint8 put_chars(uint8 row, uint8 column, const char* text, uint8 length);
+
+
+/******************************************************************************
+* Function Name: display_start
+*******************************************************************************
+*
+* Summary:
+*  Clear the LCD and the frame buffer.  The LCD has to be started with 
+*  LCD_Start first.  This is the only time the LCD is cleared.
+*
+*******************************************************************************/
+
+void display_start(void) {
+    uint8 row;
+    uint8 column;
+    
+    LCD_ClearDisplay();
+    for (row = 0; row < DISPLAY_ROWS; row++) {
+        for (column = 0; column < DISPLAY_COLUMNS; column++) {
+            frame[row][column] = ' ';
+            shown[row][column] = ' ';
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: display_clear
+*******************************************************************************
+*
+* Summary:
+*  Blank the frame buffer to draw a new screen, the LCD is not changed 
+*  until display_update.
+*
+*******************************************************************************/
+
+void display_clear(void) {
+    uint8 row;
+    uint8 column;
+    
+    for (row = 0; row < DISPLAY_ROWS; row++) {
+        for (column = 0; column < DISPLAY_COLUMNS; column++) {
+            frame[row][column] = ' ';
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: display_print
+*******************************************************************************
+*
+* Summary:
+*  Put text in the frame buffer, anything past the end of the row is cut
+*
+* Parameters:
+*  uint8 row: row to put the text in
+*  uint8 column: column of the first character
+*  const char* text: zero terminated text
+*
+* Return:
+*  uint8: column after the text, to continue the row from
+*
+*******************************************************************************/
+
+uint8 display_print(uint8 row, uint8 column, const char* text) {
+    uint8 length = 0;
+    
+    while (text[length] != 0) {
+        length++;
+    }
+    return put_chars(row, column, text, length);
+}
+
+/******************************************************************************
+* Function Name: display_print_uint
+*******************************************************************************
+*
+* Summary:
+*  Put a number in the frame buffer in decimal
+*
+* Parameters:
+*  uint8 row: row to put the number in
+*  uint8 column: column of the first digit
+*  uint32 value: number to show
+*
+* Return:
+*  uint8: column after the number
+*
+*******************************************************************************/
+
+uint8 display_print_uint(uint8 row, uint8 column, uint32 value) {
+    char digits[MAX_DIGITS];
+    uint8 first = MAX_DIGITS;
+    
+    // fill from the last digit
+    do {
+        first--;
+        digits[first] = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0);
+    return put_chars(row, column, &digits[first], MAX_DIGITS - first);
+}
+
+/******************************************************************************
+* Function Name: display_print_hex
+*******************************************************************************
+*
+* Summary:
+*  Put a number in the frame buffer in hexadecimal with a fixed number of 
+*  digits, without a 0x
+*
+* Parameters:
+*  uint8 row: row to put the number in
+*  uint8 column: column of the first digit
+*  uint32 value: number to show
+*  uint8 digits: number of digits to show, 1 to 8
+*
+* Return:
+*  uint8: column after the number
+*
+*******************************************************************************/
+
+uint8 display_print_hex(uint8 row, uint8 column, uint32 value, uint8 digits) {
+    char text[8];
+    uint8 i;
+    
+    if (digits > 8) {
+        digits = 8;
+    }
+    for (i = digits; i > 0; i--) {
+        text[i - 1] = hex_digits[value & 0x0F];
+        value >>= 4;
+    }
+    return put_chars(row, column, text, digits);
+}
+
+/******************************************************************************
+* Function Name: display_update
+*******************************************************************************
+*
+* Summary:
+*  Send the characters of the frame buffer that the LCD does not show yet.
+*  The cursor moves on by itself after each character, so it is only 
+*  positioned at the start of each run of changed characters.
+*
+*******************************************************************************/
+
+void display_update(void) {
+    uint8 row;
+    uint8 column;
+    bool in_place;    // cursor is at column
+    
+    for (row = 0; row < DISPLAY_ROWS; row++) {
+        in_place = false;
+        for (column = 0; column < DISPLAY_COLUMNS; column++) {
+            if (frame[row][column] == shown[row][column]) {
+                in_place = false;
+                continue;
+            }
+            if (!in_place) {
+                LCD_Position(row, column);
+                in_place = true;
+            }
+            LCD_PutChar(frame[row][column]);
+            shown[row][column] = frame[row][column];
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: put_chars
+*******************************************************************************
+*
+* Summary:
+*  Copy characters into a row of the frame buffer, cutting at the end
+*
+* Return:
+*  uint8: column after the characters
+*
+*******************************************************************************/
+
+static uint8 put_chars(uint8 row, uint8 column, const char* text, uint8 length) {
+    uint8 i;
+    
+    if (row >= DISPLAY_ROWS) {
+        return column;
+    }
+    for (i = 0; (i < length) && (column < DISPLAY_COLUMNS); i++) {
+        frame[row][column] = text[i];
+        column++;
+    }
+    return column;
+}
+
+/* [] END OF FILE */
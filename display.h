@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * File Name: display.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the frame buffer of the character LCD, that only
+ *  sends the characters that changed.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_DISPLAY_H)
+#define _DISPLAY_H
+    
+#include "platform.h"
+#include "stdbool.h"
+    
+/***************************************
+*      Display constants
+***************************************/ 
+
+#define DISPLAY_ROWS                2
+#define DISPLAY_COLUMNS             16
+    
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void display_start(void);
+void display_clear(void);
+uint8 display_print(uint8 row, uint8 column, const char* text);
+uint8 display_print_uint(uint8 row, uint8 column, uint32 value);
+uint8 display_print_hex(uint8 row, uint8 column, uint32 value, uint8 digits);
+void display_update(void);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,363 @@
+/*******************************************************************************
+ * File Name: filter.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the streaming filters.  Only
+ *  integer math is used.  The boxcar and IIR filters cost the same for 
+ *  every sample whatever the window, the median keeps its window sorted 
+ *  so it needs a binary search and a short shift of the sorted array 
+ *  per sample instead of sorting the window.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "filter.h"
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static FILTER_STAGE* add_stage(FILTER* filter, uint8 type, uint8 size);
+static uint32 boxcar_update(FILTER_STAGE* stage, uint32 value);
+static uint32 median_update(FILTER_STAGE* stage, uint32 value);
+static uint32 iir_update(FILTER_STAGE* stage, uint32 value);
+static uint8 sorted_position(FILTER_STAGE* stage, uint32 value);
+
+
+/******************************************************************************
+* Function Name: filter_init
+*******************************************************************************
+*
+* Summary:
+*  Make an empty filter chain, that passes values through unchanged.
+*  Add the stages in the order they should be applied.
+*
+* Parameters:
+*  FILTER* filter: filter chain to set up
+*
+*******************************************************************************/
+
+void filter_init(FILTER* filter) {
+    filter->num_stages = 0;
+}
+
+/******************************************************************************
+* Function Name: filter_reset
+*******************************************************************************
+*
+* Summary:
+*  Forget the past values of every stage, keeping the stages.  Use after
+*  a gap in the data, the filters then start again from the next value.
+*
+* Parameters:
+*  FILTER* filter: filter chain to reset
+*
+*******************************************************************************/
+
+void filter_reset(FILTER* filter) {
+    uint8 i;
+    
+    for (i = 0; i < filter->num_stages; i++) {
+        filter->stages[i].count = 0;
+        filter->stages[i].oldest = 0;
+        filter->stages[i].state = 0;
+    }
+}
+
+/******************************************************************************
+* Function Name: filter_add_boxcar
+*******************************************************************************
+*
+* Summary:
+*  Add a moving average of the last window values to the chain.  Until
+*  the window is full the average is of the values so far.  The sum of 
+*  window values has to fit in 32 bits.
+*
+* Parameters:
+*  FILTER* filter: filter chain to add to
+*  uint8 window: number of values to average, 1 to FILTER_MAX_WINDOW
+*
+* Return:
+*  bool: true if the stage was added, false if the chain is full or
+*        the window is too large
+*
+*******************************************************************************/
+
+bool filter_add_boxcar(FILTER* filter, uint8 window) {
+    if ((window == 0) || (window > FILTER_MAX_WINDOW)) {
+        return false;
+    }
+    return (0 != add_stage(filter, FILTER_BOXCAR, window));
+}
+
+/******************************************************************************
+* Function Name: filter_add_median
+*******************************************************************************
+*
+* Summary:
+*  Add a running median of the last window values to the chain, to remove
+*  single sample spikes.  An odd window is best, with an even window the
+*  upper of the 2 middle values is used.
+*
+* Parameters:
+*  FILTER* filter: filter chain to add to
+*  uint8 window: number of values to take the median of, 1 to FILTER_MAX_WINDOW
+*
+* Return:
+*  bool: true if the stage was added, false if the chain is full or
+*        the window is too large
+*
+*******************************************************************************/
+
+bool filter_add_median(FILTER* filter, uint8 window) {
+    if ((window == 0) || (window > FILTER_MAX_WINDOW)) {
+        return false;
+    }
+    return (0 != add_stage(filter, FILTER_MEDIAN, window));
+}
+
+/******************************************************************************
+* Function Name: filter_add_iir
+*******************************************************************************
+*
+* Summary:
+*  Add a first order low pass filter to the chain, 
+*  output += (value - output) / 2^shift.  The time constant is about 
+*  2^shift samples.  It starts at the first value, and values have to be
+*  below 2^(31 - FILTER_IIR_FRACTION).
+*
+* Parameters:
+*  FILTER* filter: filter chain to add to
+*  uint8 shift: 1 to FILTER_IIR_MAX_SHIFT
+*
+* Return:
+*  bool: true if the stage was added, false if the chain is full or
+*        the shift is too large
+*
+*******************************************************************************/
+
+bool filter_add_iir(FILTER* filter, uint8 shift) {
+    if ((shift == 0) || (shift > FILTER_IIR_MAX_SHIFT)) {
+        return false;
+    }
+    return (0 != add_stage(filter, FILTER_IIR, shift));
+}
+
+/******************************************************************************
+* Function Name: filter_update
+*******************************************************************************
+*
+* Summary:
+*  Put a new value through every stage of the chain
+*
+* Parameters:
+*  FILTER* filter: filter chain to use
+*  uint32 value: new value of the channel
+*
+* Return:
+*  uint32: filtered value
+*
+*******************************************************************************/
+
+uint32 filter_update(FILTER* filter, uint32 value) {
+    FILTER_STAGE* stage;
+    uint8 i;
+    
+    for (i = 0; i < filter->num_stages; i++) {
+        stage = &filter->stages[i];
+        switch (stage->type) {
+            case FILTER_BOXCAR:
+                value = boxcar_update(stage, value);
+                break;
+            case FILTER_MEDIAN:
+                value = median_update(stage, value);
+                break;
+            case FILTER_IIR:
+                value = iir_update(stage, value);
+                break;
+            default:
+                break;
+        }
+    }
+    return value;
+}
+
+/******************************************************************************
+* Function Name: filter_update_channels
+*******************************************************************************
+*
+* Summary:
+*  Filter each channel of a sample with its own chain, e.g. red, green and
+*  blue of the isl29125 or the 2 channels of the tsl2561
+*
+* Parameters:
+*  FILTER* filters: one filter chain per channel
+*  uint32* values: new value of each channel, replaced by the filtered values
+*  uint8 num_channels: number of channels
+*
+*******************************************************************************/
+
+void filter_update_channels(FILTER* filters, uint32* values, uint8 num_channels) {
+    uint8 i;
+    
+    for (i = 0; i < num_channels; i++) {
+        values[i] = filter_update(&filters[i], values[i]);
+    }
+}
+
+/******************************************************************************
+* Function Name: add_stage
+*******************************************************************************
+*
+* Return:
+*  FILTER_STAGE*: the new stage at the end of the chain, or 0 if it is full
+*
+*******************************************************************************/
+
+static FILTER_STAGE* add_stage(FILTER* filter, uint8 type, uint8 size) {
+    FILTER_STAGE* stage;
+    
+    if (filter->num_stages >= FILTER_MAX_STAGES) {
+        return 0;
+    }
+    stage = &filter->stages[filter->num_stages];
+    stage->type = type;
+    stage->size = size;
+    stage->count = 0;
+    stage->oldest = 0;
+    stage->state = 0;
+    filter->num_stages++;
+    return stage;
+}
+
+/******************************************************************************
+* Function Name: boxcar_update
+*******************************************************************************
+*
+* Summary:
+*  Keep a running sum, adding the new value and taking out the one that 
+*  leaves the window
+*
+*******************************************************************************/
+
+static uint32 boxcar_update(FILTER_STAGE* stage, uint32 value) {
+    if (stage->count < stage->size) {
+        stage->count++;
+    }
+    else {
+        stage->state -= stage->window[stage->oldest];
+    }
+    stage->window[stage->oldest] = value;
+    stage->state += value;
+    stage->oldest++;
+    if (stage->oldest >= stage->size) {
+        stage->oldest = 0;
+    }
+    return (stage->state + (stage->count >> 1)) / stage->count;
+}
+
+/******************************************************************************
+* Function Name: median_update
+*******************************************************************************
+*
+* Summary:
+*  Take the value leaving the window out of the sorted copy and put the
+*  new value in at its place, then the median is the middle of the copy
+*
+*******************************************************************************/
+
+static uint32 median_update(FILTER_STAGE* stage, uint32 value) {
+    uint8 position;
+    uint8 i;
+    
+    if (stage->count < stage->size) {
+        stage->count++;
+    }
+    else {
+        position = sorted_position(stage, stage->window[stage->oldest]);
+        for (i = position; i < stage->count - 1; i++) {
+            stage->sorted[i] = stage->sorted[i + 1];
+        }
+    }
+    stage->window[stage->oldest] = value;
+    stage->oldest++;
+    if (stage->oldest >= stage->size) {
+        stage->oldest = 0;
+    }
+    
+    // the sorted copy has count - 1 values now
+    stage->count--;
+    position = sorted_position(stage, value);
+    for (i = stage->count; i > position; i--) {
+        stage->sorted[i] = stage->sorted[i - 1];
+    }
+    stage->sorted[position] = value;
+    stage->count++;
+    return stage->sorted[stage->count >> 1];
+}
+
+/******************************************************************************
+* Function Name: sorted_position
+*******************************************************************************
+*
+* Summary:
+*  Binary search of the first count sorted values
+*
+* Return:
+*  uint8: index of the first value not below value
+*
+*******************************************************************************/
+
+static uint8 sorted_position(FILTER_STAGE* stage, uint32 value) {
+    uint8 low = 0;
+    uint8 high = stage->count;
+    uint8 middle;
+    
+    while (low < high) {
+        middle = (low + high) >> 1;
+        if (stage->sorted[middle] < value) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/******************************************************************************
+* Function Name: iir_update
+*******************************************************************************
+*
+* Summary:
+*  First order low pass filter, the state keeps FILTER_IIR_FRACTION bits
+*  below the value so small steps are not lost to rounding
+*
+*******************************************************************************/
+
+static uint32 iir_update(FILTER_STAGE* stage, uint32 value) {
+    int32 difference;
+    
+    value <<= FILTER_IIR_FRACTION;
+    if (stage->count == 0) {
+        stage->count = 1;
+        stage->state = value;
+    }
+    else {
+        difference = (int32) (value - stage->state);
+        stage->state += difference >> stage->size;
+    }
+    return (stage->state + (1 << (FILTER_IIR_FRACTION - 1))) >> FILTER_IIR_FRACTION;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * File Name: filter.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the streaming integer filters (boxcar, running median
+ *  and first order IIR) that can be chained on each channel of the sensors.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_FILTER_H)
+#define _FILTER_H
+    
+#include "platform.h"
+#include "stdbool.h"
+    
+/***************************************
+*      Filter constants
+***************************************/ 
+
+// Largest boxcar or median window, each stage keeps 2 arrays of this size
+#if !defined(FILTER_MAX_WINDOW)
+#define FILTER_MAX_WINDOW           9
+#endif
+    
+// Number of stages a channel can chain
+#if !defined(FILTER_MAX_STAGES)
+#define FILTER_MAX_STAGES           3
+#endif
+    
+// Fraction bits kept in the state of the IIR filter
+#define FILTER_IIR_FRACTION         8
+// Largest IIR shift, the value and fraction have to fit in 31 bits
+#define FILTER_IIR_MAX_SHIFT        8
+    
+// Stage types
+#define FILTER_NONE                 0
+#define FILTER_BOXCAR               1
+#define FILTER_MEDIAN               2
+#define FILTER_IIR                  3
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+typedef struct {
+    uint8       type;
+    uint8       size;       // window size, or shift of the IIR filter
+    uint8       count;      // values in the window, up to size
+    uint8       oldest;     // index in window of the next value to leave
+    uint32      state;      // running sum of the boxcar or IIR output with fraction bits
+    uint32      window[FILTER_MAX_WINDOW];  // values in the order they came in
+    uint32      sorted[FILTER_MAX_WINDOW];  // same values sorted, for the median
+} FILTER_STAGE;
+
+// Chain of stages for one channel, each stage filters the output of the last
+typedef struct {
+    FILTER_STAGE    stages[FILTER_MAX_STAGES];
+    uint8           num_stages;
+} FILTER;
+  
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void filter_init(FILTER* filter);
+void filter_reset(FILTER* filter);
+bool filter_add_boxcar(FILTER* filter, uint8 window);
+bool filter_add_median(FILTER* filter, uint8 window);
+bool filter_add_iir(FILTER* filter, uint8 shift);
+uint32 filter_update(FILTER* filter, uint32 value);
+void filter_update_channels(FILTER* filters, uint32* values, uint8 num_channels);
+
+#endif
+
+/* [] END OF FILE */
@@ -17,29 +17,84 @@
  * ========================================
  */
 #include "isl29125.h"
+#include "timebase.h"
+#include "sensor_stats.h"
+#include "nv_store.h"
 
-/***************************************
-*      I2C communication buffers
-***************************************/  
+// Settings after isl29125_init, rgb mode at the high lux setting with the 
+// ir adjustment set to high
+#define INIT_CONFIG1    (ISL29125_CONFIG1_RGB_MODE | ISL29125_CONFIG1_10KLUX | \
+                         ISL29125_CONFIG1_ADC_16BIT | ISL29125_CONFIG1_NO_SYNC)
+#define INIT_CONFIG2    (ISL29125_CONFIG2_IR_ADJUST_HIGH | ISL29125_CONFIG2_IR_OFFSET_OFF)
+#define INIT_CONFIG3    (ISL29125_CONFIG3_NO_INT | ISL29125_CONFIG3_INT_1_TIME | \
+                         ISL29125_CONFIG3_DISABLE_INT_ON_CONVERSION)
+
+// Configuration through status registers, read to check a reset
+#define RESET_CHECK_LENGTH          (ISL29125_STATUS_REG - ISL29125_CONFIG_REG_1 + 1)
+
+// Jobs moved forward by isl29125_poll
+#define JOB_NONE                    0
+#define JOB_INIT                    1
+#define JOB_RESET                   2
+#define JOB_CONFIG                  3
+#define JOB_SAMPLE                  4
 
-uint8 static read_buffer[8];
-uint8 static write_buffer[2];
+// Steps of the jobs, each one I2C transaction
+#define STEP_READ_ID                0
+#define STEP_RESET                  1
+#define STEP_CHECK_RESET            2
+#define STEP_FLUSH                  3
+#define STEP_VERIFY                 4
+#define STEP_SAMPLE                 5
+#define STEP_FINISHED               6
+
+// Offset of a register in the burst read of the sample block
+#define SAMPLE_OFFSET(_register)    ((_register) - ISL29125_SAMPLE_BLOCK_FIRST)
+
+static const REGMAP_REGISTER isl29125_registers[] = REGMAP_REGISTER_TABLE(ISL29125_REGISTERS);
+
+const REGMAP isl29125_regmap = {
+    isl29125_registers,
+    sizeof(isl29125_registers) / sizeof(isl29125_registers[0]),
+    0
+};
 
 /***************************************
 *      Static Function Prototypes
 ***************************************/  
 
-static inline bool isl29125_reset(void);
-static inline bool isl29125_config(uint8 config1, uint8 config2, uint8 config3);
+static void isl29125_setup(ISL29125* device, SENSOR_BUS* bus, uint8 address);
+static void isl29125_settings(ISL29125* device, uint8 config1, uint8 config2, uint8 config3);
+static void shadow_settings(ISL29125* device);
+static void isl29125_set_mode(ISL29125* device, uint8 mode);
+static bool shadow_flush(ISL29125* device);
+
+static void job_begin(ISL29125* device, uint8 job, uint8 step);
+static bool job_submit(ISL29125* device);
+static void job_next(ISL29125* device, uint8 status);
+static bool job_wait(ISL29125* device);
+static bool job_run(ISL29125* device, uint8 job, uint8 step);
 
-static uint8 config_register1(void);
-static uint8 config_register2(void);
-static uint8 config_register3(void);
+static void decode_rgb(ISL29125* device, uint8* buffer, ISL29125_RGB* rgb);
+static void sample_read_done(SENSOR_TRANSACTION* transaction);
+static bool auto_range_step(ISL29125* device, ISL29125_RGB* rgb, uint8* range, 
+                            uint8* resolution);
+static bool range_write(ISL29125* device, uint8 range, uint8 resolution);
+static inline bool range_queued(ISL29125* device);
+static void range_done(SENSOR_TRANSACTION* transaction);
+static void put_sample(ISL29125* device, ISL29125_RGB* rgb);
+static void threshold_event(ISL29125* device, ISL29125_RGB* rgb);
+static void threshold_done(SENSOR_TRANSACTION* transaction);
+static void fill_threshold_buffer(uint8* buffer, uint16 low, uint16 high);
+static uint16 color_level(ISL29125_RGB* rgb, uint8 color);
 
-static inline void isl29125_write8(uint8 _register, uint8 data);
+static uint8 isl29125_write(ISL29125* device, uint8* buffer, uint8 num_bytes);
+static uint8 isl29125_read(ISL29125* device, uint8* buffer, uint8 _register, uint8 num_bytes);
+static void transfer_done(ISL29125* device, uint8 status);
+static void queued_done(SENSOR_TRANSACTION* transaction);
 
-static inline uint8 isl29125_read8(uint8 _register);
-static inline uint16 isl29125_read16(uint8 _register);
+static inline uint8 isl29125_read8(ISL29125* device, uint8 _register);
+static inline uint16 isl29125_read16(ISL29125* device, uint8 _register);
 
 
 /******************************************************************************
@@ -51,36 +106,330 @@ static inline uint16 isl29125_read16(uint8 _register);
 *  First check that the device returns the correct ID.  Reset the device
 *  and then configure it to read in the rgb mode, at the high lux setting
 *  and with the ir adjustment set to high.  
-*  Save to the isl29125 structure all the operational settings
+*  Save to the isl29125 structure all the operational settings.
+*  Waits for the bus, isl29125_init_begin does the same without waiting.
+*
+* Parameters:
+*  ISL29125* device: structure to save the settings of this isl29125 in
+*  SENSOR_BUS* bus: bus the isl29125 is on, or 0 for the default bus
+*  uint8 address: I2C address of the isl29125, normally ISL29125_I2C_ADDRESS
+*
+*******************************************************************************/
+
+void isl29125_init(ISL29125* device, SENSOR_BUS* bus, uint8 address) {
+    SENSOR_STATS_BEGIN(SENSOR_API_ISL29125_INIT);
+    isl29125_init_begin(device, bus, address);
+    job_wait(device);
+    SENSOR_STATS_END(SENSOR_API_ISL29125_INIT);
+}
+
+/******************************************************************************
+* Function Name: isl29125_init_begin
+*******************************************************************************
+*
+* Summary:
+*  Start the same initialization as isl29125_init as a job, moved forward
+*  by isl29125_poll.  The ID read, reset, reset check and configuration
+*  each take one call of isl29125_poll that finds the bus done, so 
+*  several devices can be initialized together with other work.
+*
+* Parameters:
+*  ISL29125* device: structure to save the settings of this isl29125 in
+*  SENSOR_BUS* bus: bus the isl29125 is on, or 0 for the default bus
+*  uint8 address: I2C address of the isl29125, normally ISL29125_I2C_ADDRESS
+*
+*******************************************************************************/
+
+void isl29125_init_begin(ISL29125* device, SENSOR_BUS* bus, uint8 address) {
+    isl29125_setup(device, bus, address);
+    job_begin(device, JOB_INIT, STEP_READ_ID);
+}
+
+/******************************************************************************
+* Function Name: isl29125_reset_begin
+*******************************************************************************
+*
+* Summary:
+*  Start a job that resets the isl29125 and checks in one burst read that 
+*  the configuration and status registers went back to 0
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
+* Return:
+*  bool: true if started, false if the device already has a job
+*
+*******************************************************************************/
+
+bool isl29125_reset_begin(ISL29125* device) {
+    if (device->job != JOB_NONE) {
+        return false;
+    }
+    job_begin(device, JOB_RESET, STEP_RESET);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: isl29125_config_begin
+*******************************************************************************
+*
+* Summary:
+*  Start a job that configures the isl29125.  The values go in the 
+*  shadow registers, the registers that changed are written in one 
+*  transaction and then the settings of the structure follow them.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8 config1: value to put in configuration register 1
+*  uint8 config2: value to put in configuration register 2
+*  uint8 config3: value to put in configuration register 3
+*
+* Return:
+*  bool: true if started, false if the device already has a job
+*
+*******************************************************************************/
+
+bool isl29125_config_begin(ISL29125* device, uint8 config1, uint8 config2, uint8 config3) {
+    uint8 interrupt_state;
+    
+    if (device->job != JOB_NONE) {
+        return false;
+    }
+    interrupt_state = CyEnterCriticalSection();
+    regmap_shadow_write(&device->config, ISL29125_CONFIG_REG_1, config1);
+    regmap_shadow_write(&device->config, ISL29125_CONFIG_REG_2, config2);
+    regmap_shadow_write(&device->config, ISL29125_CONFIG_REG_3, config3);
+    CyExitCriticalSection(interrupt_state);
+    job_begin(device, JOB_CONFIG, STEP_FLUSH);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: isl29125_sample_begin
+*******************************************************************************
+*
+* Summary:
+*  Start a job that reads the status and the 3 colors in one transaction,
+*  the same as isl29125_read_rgb.  The device has to be already running.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  ISL29125_RGB* rgb: where to put the colors, kept until the job is done
+*
+* Return:
+*  bool: true if started, false if the device already has a job
+*
+*******************************************************************************/
+
+bool isl29125_sample_begin(ISL29125* device, ISL29125_RGB* rgb) {
+    if (device->job != JOB_NONE) {
+        return false;
+    }
+    device->job_rgb = rgb;
+    job_begin(device, JOB_SAMPLE, STEP_SAMPLE);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: isl29125_poll
+*******************************************************************************
+*
+* Summary:
+*  Move the job of the isl29125 forward without waiting on the bus.  Call
+*  it from a loop, with the polls of the other devices, until it returns
+*  SENSOR_JOB_DONE.  Then job_ok tells if the job worked: the device is
+*  initialized, reset or configured, or the sample was read.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
 *
-* Global Parameters:
-*  ISL29125 isl29125: structure to save settings of the isl29125
+* Return:
+*  uint8: SENSOR_JOB_BUSY while the job runs, SENSOR_JOB_DONE once when 
+*         it finishes, SENSOR_JOB_IDLE after that or with no job
 *
 *******************************************************************************/
 
-void isl29125_init(void) {
-    uint8 data;
+uint8 isl29125_poll(ISL29125* device) {
+    SENSOR_TRANSACTION* transaction = &device->job_transaction;
+    uint8 interrupt_state;
+    bool submitted;
     
-    data = isl29125_read8(ISL29125_DEVICE_ID_REG);
-    if (data != ISL29125_DEVICE_ID) {
-        isl29125.working = false;
+    if (device->job == JOB_NONE) {
+        return SENSOR_JOB_IDLE;
     }
-    if (!isl29125_reset()) {
-        isl29125.working = false;
+    sensor_bus_service(device->bus);
+    for (;;) {
+        if (device->job_step == STEP_FINISHED) {
+            if ((device->job == JOB_INIT) && !device->job_ok) {
+                device->working = false;
+            }
+            device->job = JOB_NONE;
+            return SENSOR_JOB_DONE;
+        }
+        // the steps use the config shadow, that the auto range changes from 
+        // the sample read callback
+        if (transaction->state == SENSOR_XFER_IDLE) {
+            interrupt_state = CyEnterCriticalSection();
+            submitted = job_submit(device);
+            CyExitCriticalSection(interrupt_state);
+            if (!submitted) {
+                return SENSOR_JOB_BUSY;  // the queue is full or a range write is in it
+            }
+            continue;
+        }
+        if (transaction->state != SENSOR_XFER_DONE) {
+            return SENSOR_JOB_BUSY;
+        }
+        transaction->state = SENSOR_XFER_IDLE;
+        interrupt_state = CyEnterCriticalSection();
+        transfer_done(device, transaction->status);
+        job_next(device, transaction->status);
+        CyExitCriticalSection(interrupt_state);
+    }
+}
+
+/******************************************************************************
+* Function Name: isl29125_warm_init
+*******************************************************************************
+*
+* Summary:
+*  Initialize a isl29125 that may have kept its configuration over an MCU 
+*  restart.  The ID and configuration registers are checked in one burst
+*  read against the configuration saved in the nonvolatile slot.  If they
+*  match the device is used as it is, so the only I2C transaction is that
+*  read.  Otherwise it gets a cold isl29125_init and that configuration
+*  is saved.  Call nv_store_start first.
+*
+* Parameters:
+*  ISL29125* device: structure to save the settings of this isl29125 in
+*  SENSOR_BUS* bus: bus the isl29125 is on, or 0 for the default bus
+*  uint8 address: I2C address of the isl29125, normally ISL29125_I2C_ADDRESS
+*  uint8 slot: nonvolatile slot of this isl29125, e.g. NV_SLOT_ISL29125
+*
+* Return:
+*  bool: true if the device kept its configuration, false after a cold init
+*
+*******************************************************************************/
+
+bool isl29125_warm_init(ISL29125* device, SENSOR_BUS* bus, uint8 address, uint8 slot) {
+    uint8 saved[ISL29125_WARM_RECORD_SIZE];
+    uint8* config = &saved[1];
+    uint8* registers = device->read_buffer;
+    uint8 i;
+    
+    isl29125_setup(device, bus, address);
+    if (nv_store_read(slot, saved, ISL29125_WARM_RECORD_SIZE) && (saved[0] == address) &&
+            (SENSOR_OK == isl29125_read(device, registers, ISL29125_DEVICE_ID_REG, 
+                                        1 + ISL29125_CONFIG_BLOCK_LENGTH)) &&
+            (registers[0] == ISL29125_DEVICE_ID)) {
+        for (i = 0; i < ISL29125_CONFIG_BLOCK_LENGTH; i++) {
+            if (registers[1 + i] != config[i]) {
+                break;
+            }
+        }
+        if (i == ISL29125_CONFIG_BLOCK_LENGTH) {
+            isl29125_settings(device, config[0], config[1], config[2]);
+            regmap_shadow_init(&device->config, ISL29125_CONFIG_BLOCK_FIRST, 
+                               ISL29125_CONFIG_BLOCK_LENGTH, ISL29125_CONFIG_DEFAULT);
+            for (i = 0; i < ISL29125_CONFIG_BLOCK_LENGTH; i++) {
+                regmap_shadow_sync(&device->config, ISL29125_CONFIG_BLOCK_FIRST + i, config[i]);
+            }
+            return true;
+        }
     }
+    isl29125_init(device, bus, address);
+    isl29125_save_config(device, slot);
+    return false;
+}
+
+/******************************************************************************
+* Function Name: isl29125_save_config
+*******************************************************************************
+*
+* Summary:
+*  Save the configuration the isl29125 holds, for isl29125_warm_init after
+*  the next restart.  Call again after changing settings that should be
+*  kept, the EEPROM row is only written when the record changes.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8 slot: nonvolatile slot of this isl29125
+*
+* Return:
+*  bool: true if saved, false if the device is not working or not configured
+*
+*******************************************************************************/
+
+bool isl29125_save_config(ISL29125* device, uint8 slot) {
+    uint8 record[ISL29125_WARM_RECORD_SIZE];
+    uint8 i;
     
-    if (!isl29125_config(ISL29125_CONFIG1_RGB_MODE | ISL29125_CONFIG1_10KLUX, 
-        ISL29125_CONFIG2_IR_ADJUST_HIGH, ISL29125_CONFIG3_NO_INT)) {
-        isl29125.working = false;
+    if (!device->working || (device->config.dirty != 0x00)) {
+        return false;
     }
-    isl29125.color_mode = ISL29125_CONFIG1_RGB_MODE;
-    isl29125.intensity_range = ISL29125_CONFIG1_10KLUX;
-    isl29125.adc_resolution = ISL29125_CONFIG1_ADC_16BIT;
-    isl29125.isr_setting = ISL29125_CONFIG1_NO_SYNC;
-    isl29125.ir_offset = ISL29125_CONFIG2_IR_OFFSET_OFF;
-    isl29125.ir_setting = ISL29125_CONFIG2_IR_ADJUST_HIGH;
-    isl29125.interrupt_color = ISL29125_CONFIG3_NO_INT;
-    isl29125.working = true;
+    record[0] = device->address;
+    for (i = 0; i < ISL29125_CONFIG_BLOCK_LENGTH; i++) {
+        record[1 + i] = regmap_shadow_read(&device->config, ISL29125_CONFIG_BLOCK_FIRST + i);
+    }
+    return nv_store_write(slot, record, ISL29125_WARM_RECORD_SIZE);
+}
+
+/******************************************************************************
+* Function Name: isl29125_setup
+*******************************************************************************
+*
+* Summary:
+*  Set up the bus, address and state of the isl29125 structure, before 
+*  talking to the device
+*
+*******************************************************************************/
+
+static void isl29125_setup(ISL29125* device, SENSOR_BUS* bus, uint8 address) {
+    device->bus = bus ? bus : sensor_get_bus();
+    device->address = address;
+    device->working = true;
+    device->backoff.failures = 0;
+    device->auto_range = false;
+    device->range_discard = 0;
+    device->job = JOB_NONE;
+}
+
+/******************************************************************************
+* Function Name: isl29125_settings
+*******************************************************************************
+*
+* Summary:
+*  Fill the settings of the isl29125 structure from the values of the 
+*  configuration registers
+*
+*******************************************************************************/
+
+static void isl29125_settings(ISL29125* device, uint8 config1, uint8 config2, uint8 config3) {
+    device->color_mode = config1 & ISL29125_MODE_MASK;
+    device->intensity_range = config1 & ISL29125_RANGE_MASK;
+    device->adc_resolution = config1 & ISL29125_RESOLUTION_MASK;
+    device->isr_setting = config1 & ISL29125_SYNC_MASK;
+    device->ir_offset = config2 & ISL29125_IR_OFFSET_MASK;
+    device->ir_setting = config2 & ISL29125_IR_ADJUST_MASK;
+    device->interrupt_color = config3 & ISL29125_INT_COLOR_MASK;
+    device->conversion_interrupt = config3 & ISL29125_INT_ON_CONVERSION_MASK;
+    device->interrupt_persist = config3 & ISL29125_INT_PERSIST_MASK;
+}
+
+/******************************************************************************
+* Function Name: shadow_settings
+*******************************************************************************
+*
+* Summary:
+*  Fill the settings of the isl29125 structure from the shadow registers,
+*  once they are written to the device
+*
+*******************************************************************************/
+
+static void shadow_settings(ISL29125* device) {
+    isl29125_settings(device, regmap_shadow_read(&device->config, ISL29125_CONFIG_REG_1),
+                      regmap_shadow_read(&device->config, ISL29125_CONFIG_REG_2),
+                      regmap_shadow_read(&device->config, ISL29125_CONFIG_REG_3));
 }
 
 /******************************************************************************
@@ -90,15 +439,13 @@ void isl29125_init(void) {
 * Summary:
 *  Start the isl29125 in rgb mode
 *
-* Global Parameters:
-*  ISL29125 isl29125: structure to save settings of the isl29125
+* Parameters:
+*  ISL29125* device: isl29125 to use
 *
 *******************************************************************************/
 
-void isl29125_start(void) {
-    isl29125.color_mode = ISL29125_CONFIG1_RGB_MODE;
-    isl29125.config_reg1 |= ISL29125_CONFIG1_RGB_MODE;
-    isl29125_write8(ISL29125_CONFIG_REG_1, isl29125.config_reg1);
+void isl29125_start(ISL29125* device) {
+    isl29125_set_mode(device, ISL29125_CONFIG1_RGB_MODE);
 }
 
 /******************************************************************************
@@ -108,15 +455,13 @@ void isl29125_start(void) {
 * Summary:
 *  Put the isl29125 into the standby mode
 *
-* Global Parameters:
-*  ISL29125 isl29125: structure to save settings of the isl29125
+* Parameters:
+*  ISL29125* device: isl29125 to use
 *
 *******************************************************************************/
 
-void isl29125_sleep(void) {
-    isl29125.color_mode = ISL29125_CONFIG1_STANDBY;
-    isl29125.config_reg1 |= ISL29125_CONFIG1_STANDBY;
-    isl29125_write8(ISL29125_CONFIG_REG_1, isl29125.config_reg1);
+void isl29125_sleep(ISL29125* device) {
+    isl29125_set_mode(device, ISL29125_CONFIG1_STANDBY);
 }
 
 /******************************************************************************
@@ -126,85 +471,283 @@ void isl29125_sleep(void) {
 * Summary:
 *  Power down the isl29125
 *
-* Global Parameters:
-*  ISL29125 isl29125: structure to save settings of the isl29125
+* Parameters:
+*  ISL29125* device: isl29125 to use
 *
 *******************************************************************************/
 
-void isl29125_stop(void) {
-    isl29125.color_mode = ISL29125_CONFIG1_POWERDOWN;
-    isl29125.config_reg1 |= ISL29125_CONFIG1_POWERDOWN;
-    isl29125_write8(ISL29125_CONFIG_REG_1, isl29125.config_reg1);
+void isl29125_stop(ISL29125* device) {
+    isl29125_set_mode(device, ISL29125_CONFIG1_POWERDOWN);
 }
 
 /******************************************************************************
-* Function Name: isl29125_init
+* Function Name: isl29125_set_mode
 *******************************************************************************
 *
 * Summary:
-*  Reset the isl29125 rgb sensor.  Send the reset code and then read the 
-*  configuration registers to confirm the are set to 0
+*  Change the color mode of the isl29125, keeping the other settings of
+*  the first configuration register.  Takes at most one I2C transaction,
+*  none if the device is already in the mode.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8 mode: one of the ISL29125_CONFIG1_*_MODE, STANDBY or POWERDOWN settings
+*
+*******************************************************************************/
+
+static void isl29125_set_mode(ISL29125* device, uint8 mode) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    REGMAP_SHADOW_FIELD(&device->config, ISL29125_MODE, mode);
+    CyExitCriticalSection(interrupt_state);
+    shadow_flush(device);
+}
+
+/******************************************************************************
+* Function Name: shadow_flush
+*******************************************************************************
+*
+* Summary:
+*  Write the dirty configuration registers to the device and wait for it.
+*  The range from the first to the last dirty register is sent in one 
+*  auto-increment write, so this costs at most one I2C transaction.  If 
+*  ISL29125_VERIFY_CONFIG is defined the range is read back and checked.
+*  If the write fails, or the device has a job and nothing is written, 
+*  the registers stay dirty for the next flush.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
 *
 * Return:
-*  bool: true if the device was reset, or false if not
+*  bool: true if the device was properly configured, or false if not
 *
 *******************************************************************************/
 
-static bool isl29125_reset(void) {
-    uint8 data = 0x00;
-    
-    // Reset the registers
-    isl29125_write8(ISL29125_DEVICE_ID_REG, ISL29125_DEVICE_RESET_CODE);
+static bool shadow_flush(ISL29125* device) {
+    return job_run(device, JOB_CONFIG, STEP_FLUSH);
+}
+
+/******************************************************************************
+* Function Name: job_begin
+*******************************************************************************
+*
+* Summary:
+*  Set the job of the isl29125, its first transaction is queued by the 
+*  next isl29125_poll
+*
+*******************************************************************************/
+
+static void job_begin(ISL29125* device, uint8 job, uint8 step) {
+    device->job = job;
+    device->job_step = step;
+    device->job_ok = true;
+    device->job_transaction.state = SENSOR_XFER_IDLE;
+}
+
+/******************************************************************************
+* Function Name: job_submit
+*******************************************************************************
+*
+* Summary:
+*  Queue the transaction of the step the job is at.  A device that is 
+*  backing off gets the step finished with SENSOR_ERR_BACKOFF instead, 
+*  and a flush with nothing dirty finishes the job.  Called with 
+*  interrupts disabled, so a range write of the sample read callback can
+*  not come between filling the flush and queueing it.
+*
+* Return:
+*  bool: false if the queue of the bus is full, or a flush waits for a 
+*        range write still queued
+*
+*******************************************************************************/
+
+static bool job_submit(ISL29125* device) {
+    SENSOR_TRANSACTION* transaction = &device->job_transaction;
+    uint8 num_bytes;
     
-    // Check reset
-    data = isl29125_read8(ISL29125_CONFIG_REG_1);
-    data |= isl29125_read8(ISL29125_CONFIG_REG_2);
-    data |= isl29125_read8(ISL29125_CONFIG_REG_3);
-    data |= isl29125_read8(ISL29125_STATUS_REG);
-    if (data == 0x00) {
+    if (!sensor_backoff_ready(&device->backoff)) {
+        transaction->status = SENSOR_ERR_BACKOFF;
+        transaction->state = SENSOR_XFER_DONE;
         return true;
     }
-    return false;
+    transaction->type = SENSOR_XFER_READ;
+    transaction->address = device->address;
+    transaction->buffer = device->read_buffer;
+    transaction->callback = 0;
+    switch (device->job_step) {
+        case STEP_READ_ID:
+            transaction->_register = ISL29125_DEVICE_ID_REG;
+            transaction->num_bytes = 1;
+            break;
+        case STEP_RESET:
+            device->write_buffer[0] = ISL29125_DEVICE_ID_REG;
+            device->write_buffer[1] = ISL29125_DEVICE_RESET_CODE;
+            transaction->type = SENSOR_XFER_WRITE;
+            transaction->buffer = device->write_buffer;
+            transaction->num_bytes = 2;
+            break;
+        case STEP_CHECK_RESET:
+            // the thresholds in between are not checked
+            transaction->_register = ISL29125_CONFIG_REG_1;
+            transaction->num_bytes = RESET_CHECK_LENGTH;
+            break;
+        case STEP_FLUSH:
+            // a range write still queued goes out first, so the two do not cross
+            if (range_queued(device)) {
+                return false;
+            }
+            num_bytes = regmap_shadow_flush_buffer(&device->config, device->write_buffer);
+            if (num_bytes == 0) {
+                device->job_step = STEP_FINISHED;
+                return true;
+            }
+            transaction->type = SENSOR_XFER_WRITE;
+            transaction->buffer = device->write_buffer;
+            transaction->num_bytes = num_bytes;
+            break;
+        case STEP_VERIFY:
+            // the registers of the flush, num_bytes still has its length
+            transaction->_register = device->write_buffer[0];
+            transaction->num_bytes = transaction->num_bytes - 1;
+            break;
+        default:
+            // STEP_SAMPLE
+            transaction->_register = ISL29125_STATUS_REG;
+            transaction->num_bytes = ISL29125_RGB_READ_LENGTH;
+            break;
+    }
+    transaction->_register |= isl29125_regmap.command;
+    if (!sensor_bus_submit(device->bus, transaction)) {
+        if (device->job_step == STEP_FLUSH) {
+            // the flush recorded the registers as written, fill it again next time
+            regmap_shadow_invalidate(&device->config);
+        }
+        return false;
+    }
+    return true;
 }
 
 /******************************************************************************
-* Function Name: isl29125_config
+* Function Name: job_next
 *******************************************************************************
 *
 * Summary:
-*  Configure the isl29125 rgb sensor.  Write to the 3 configuration registers
-*  and then confirm they are set properly
+*  Use the result of the transaction of the step the job was at and go to
+*  the next step
 *
 * Parameters:
-*  uint8 config1: value to put in congiuration register 1
-*  uint8 config2: value to put in congiuration register 2
-*  uint8 config3: value to put in congiuration register 3
+*  ISL29125* device: isl29125 to use
+*  uint8 status: SENSOR_OK or the SENSOR_ERR_* code of the transaction
+*
+*******************************************************************************/
+
+static void job_next(ISL29125* device, uint8 status) {
+    uint8* registers = device->read_buffer;
+    
+    switch (device->job_step) {
+        case STEP_READ_ID:
+            if ((status != SENSOR_OK) || (registers[0] != ISL29125_DEVICE_ID)) {
+                device->job_ok = false;
+            }
+            device->job_step = STEP_RESET;
+            break;
+        case STEP_RESET:
+            device->job_step = STEP_CHECK_RESET;
+            break;
+        case STEP_CHECK_RESET:
+            // the device now holds the default configuration
+            regmap_shadow_init(&device->config, ISL29125_CONFIG_BLOCK_FIRST, 
+                               ISL29125_CONFIG_BLOCK_LENGTH, ISL29125_CONFIG_DEFAULT);
+            shadow_settings(device);
+            if ((status != SENSOR_OK) || (registers[0] | registers[1] | registers[2] | 
+                                          registers[RESET_CHECK_LENGTH - 1])) {
+                // unknown state, rewrite every register on the next flush
+                regmap_shadow_invalidate(&device->config);
+                device->job_ok = false;
+            }
+            device->job_step = STEP_FINISHED;
+            if (device->job == JOB_INIT) {
+                regmap_shadow_write(&device->config, ISL29125_CONFIG_REG_1, INIT_CONFIG1);
+                regmap_shadow_write(&device->config, ISL29125_CONFIG_REG_2, INIT_CONFIG2);
+                regmap_shadow_write(&device->config, ISL29125_CONFIG_REG_3, INIT_CONFIG3);
+                device->job_step = STEP_FLUSH;
+            }
+            break;
+        case STEP_FLUSH:
+            device->job_step = STEP_FINISHED;
+            if (status != SENSOR_OK) {
+                // what the device holds is not known, write them all next time
+                regmap_shadow_invalidate(&device->config);
+                device->job_ok = false;
+            }
+            else {
+                // samples from now on are measured with the settings written
+                shadow_settings(device);
+#if defined(ISL29125_VERIFY_CONFIG)
+                device->job_step = STEP_VERIFY;
+#endif
+            }
+            break;
+        case STEP_VERIFY:
+            if (status == SENSOR_OK) {
+                regmap_shadow_verify(&device->config, device->write_buffer[0], registers, 
+                                     device->job_transaction.num_bytes);
+            }
+            device->job_ok = (status == SENSOR_OK) && (device->config.dirty == 0x00);
+            device->job_step = STEP_FINISHED;
+            break;
+        default:
+            // STEP_SAMPLE
+            if (status == SENSOR_OK) {
+                decode_rgb(device, registers, device->job_rgb);
+            }
+            device->job_ok = (status == SENSOR_OK);
+            device->job_step = STEP_FINISHED;
+            break;
+    }
+}
+
+/******************************************************************************
+* Function Name: job_wait
+*******************************************************************************
+*
+* Summary:
+*  Poll the job of the isl29125 until it is done, for the blocking 
+*  functions of the driver
 *
 * Return:
-*  bool: true if the device was properly configured, or false if not
+*  bool: job_ok of the job
 *
 *******************************************************************************/
 
-static bool isl29125_config(uint8 config1, uint8 config2, uint8 config3) {
-    uint8 data;  
-    // set up the registers
-    isl29125_write8(ISL29125_CONFIG_REG_1, config1);
-    isl29125_write8(ISL29125_CONFIG_REG_2, config2);
-    isl29125_write8(ISL29125_CONFIG_REG_3, config3);
-    // confirm the registers are correct
-    data = isl29125_read8(ISL29125_CONFIG_REG_1);
-    if (data != config1) {
-        return false;
-    }
-    data = isl29125_read8(ISL29125_CONFIG_REG_2);
-    if (data != config2) {
-        return false;
+static bool job_wait(ISL29125* device) {
+    while (isl29125_poll(device) == SENSOR_JOB_BUSY) {
+        device->bus->stats.wait_polls++;
+        SENSOR_STATS_SPIN();
     }
-    data = isl29125_read8(ISL29125_CONFIG_REG_3);
-    if (data != config3) {
+    return device->job_ok;
+}
+
+/******************************************************************************
+* Function Name: job_run
+*******************************************************************************
+*
+* Summary:
+*  Run a job and wait for it, for the blocking functions of the driver.
+*  Nothing is done if the device already has a job started by a *_begin
+*  function: waiting for it here would take the SENSOR_JOB_DONE its owner
+*  polls for, and change job_ok before the owner reads it.
+*
+* Return:
+*  bool: job_ok of the job, or false if the device already has a job
+*
+*******************************************************************************/
+
+static bool job_run(ISL29125* device, uint8 job, uint8 step) {
+    if (device->job != JOB_NONE) {
         return false;
     }
-    return true;
+    job_begin(device, job, step);
+    return job_wait(device);
 }
 
 /******************************************************************************
@@ -214,13 +757,20 @@ static bool isl29125_config(uint8 config1, uint8 config2, uint8 config3) {
 * Summary:
 *  Read the ID code of the isl29125 rgb sensor, should be 0x74
 *
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
 * Return:
-*  uint8: byte read from the device's ID register
+*  uint8: byte read from the device's ID register, 0 if the read failed or the 
+*         device has a job
 *
 *******************************************************************************/
 
-uint8 isl29125_read_id(void) {
-    return isl29125_read8(ISL29125_DEVICE_ID_REG); 
+uint8 isl29125_read_id(ISL29125* device) {
+    SENSOR_STATS_BEGIN(SENSOR_API_ISL29125_READ_ID);
+    uint8 id = isl29125_read8(device, ISL29125_DEVICE_ID_REG); 
+    SENSOR_STATS_END(SENSOR_API_ISL29125_READ_ID);
+    return id;
 }
 
 /******************************************************************************
@@ -231,13 +781,19 @@ uint8 isl29125_read_id(void) {
 *  Read the red value of the isl29125 rgb sensor.  The device has to be already 
 *  running. 
 *
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
 * Return:
-*  uint16: value of the red registers.
+*  uint16: value of the red registers, 0 if the read failed or the device has a job
 *
 *******************************************************************************/
 
-uint16 isl29125_read_red(void) {
-    return isl29125_read16(ISL29125_RED_REG_L);
+uint16 isl29125_read_red(ISL29125* device) {
+    SENSOR_STATS_BEGIN(SENSOR_API_ISL29125_READ_RED);
+    uint16 red = isl29125_read16(device, ISL29125_RED_REG);
+    SENSOR_STATS_END(SENSOR_API_ISL29125_READ_RED);
+    return red;
 }
 
 /******************************************************************************
@@ -248,13 +804,19 @@ uint16 isl29125_read_red(void) {
 *  Read the green value of the isl29125 rgb sensor.  The device has to be already 
 *  running. 
 *
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
 * Return:
-*  uint16: value of the green registers.
+*  uint16: value of the green registers, 0 if the read failed or the device has a job
 *
 *******************************************************************************/
 
-uint16 isl29125_read_green(void) {
-    return isl29125_read16(ISL29125_GREEN_REG_L);
+uint16 isl29125_read_green(ISL29125* device) {
+    SENSOR_STATS_BEGIN(SENSOR_API_ISL29125_READ_GREEN);
+    uint16 green = isl29125_read16(device, ISL29125_GREEN_REG);
+    SENSOR_STATS_END(SENSOR_API_ISL29125_READ_GREEN);
+    return green;
 }
 
 /******************************************************************************
@@ -265,123 +827,1120 @@ uint16 isl29125_read_green(void) {
 *  Read the blue value of the isl29125 rgb sensor.  The device has to be already 
 *  running. 
 *
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
 * Return:
-*  uint16: value of the blue registers.
+*  uint16: value of the blue registers, 0 if the read failed or the device has a job
 *
 *******************************************************************************/
 
-uint16 isl29125_read_blue(void) {
-    return isl29125_read16(ISL29125_BLUE_REG_L);
+uint16 isl29125_read_blue(ISL29125* device) {
+    SENSOR_STATS_BEGIN(SENSOR_API_ISL29125_READ_BLUE);
+    uint16 blue = isl29125_read16(device, ISL29125_BLUE_REG);
+    SENSOR_STATS_END(SENSOR_API_ISL29125_READ_BLUE);
+    return blue;
 }
 
 /******************************************************************************
-* Function Name: isl29125_config_register1
+* Function Name: isl29125_read_rgb
 *******************************************************************************
 *
 * Summary:
-*  Take the isl29125 setting and make the byte the first
-*   configuration register should be set to.
+*  Read the status register and the green, red and blue values of the
+*  isl29125 rgb sensor in one I2C transaction, so all 3 colors come from
+*  the same conversion.  The device has to be already running, and not 
+*  have a job of the *_begin functions.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  ISL29125_RGB* rgb: structure to put the color values and status flags in
 *
 * Return:
-*  uint8: value to set the isl29125's first configuration register to
+*  uint8: SENSOR_OK, or the SENSOR_ERR_* code of the read and rgb is not changed,
+*         SENSOR_ERR_BUSY if the device has a job
 *
 *******************************************************************************/
 
-static uint8 config_register1(void){
-    return (isl29125.color_mode | isl29125.intensity_range | 
-            isl29125.adc_resolution | isl29125.isr_setting);
+uint8 isl29125_read_rgb(ISL29125* device, ISL29125_RGB* rgb) {
+    uint8 status = SENSOR_ERR_BUSY;
+    
+    SENSOR_STATS_BEGIN(SENSOR_API_ISL29125_READ_RGB);
+    if (device->job == JOB_NONE) {
+        device->job_rgb = rgb;
+        job_run(device, JOB_SAMPLE, STEP_SAMPLE);
+        status = device->job_transaction.status;
+    }
+    SENSOR_STATS_END(SENSOR_API_ISL29125_READ_RGB);
+    return status;
 }
 
 /******************************************************************************
-* Function Name: isl29125_config_register2
+* Function Name: isl29125_submit_rgb_read
 *******************************************************************************
 *
 * Summary:
-*  Take the isl29125 setting and make the byte the second
-*   configuration register should be set to.
+*  Queue the same read as isl29125_read_rgb without waiting for it, so 
+*  transfers with other devices can go on the bus around it.  When the
+*  transaction is done, get the colors with isl29125_finish_rgb_read.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  SENSOR_TRANSACTION* transaction: transaction to use, not in a queue
+*  uint8* buffer: ISL29125_RGB_READ_LENGTH bytes for the registers, kept 
+*                 until the transaction is done
 *
 * Return:
-*  uint8: value to set the isl29125's second configuration register to
+*  bool: true if queued, false if the device is backing off or the queue is full
 *
 *******************************************************************************/
 
-static uint8 config_register2(void){
-    return (isl29125.ir_setting | isl29125.ir_offset);
+bool isl29125_submit_rgb_read(ISL29125* device, SENSOR_TRANSACTION* transaction, 
+                              uint8* buffer) {
+    if (!sensor_backoff_ready(&device->backoff)) {
+        return false;
+    }
+    transaction->type = SENSOR_XFER_READ;
+    transaction->address = device->address;
+    transaction->_register = ISL29125_STATUS_REG;
+    transaction->buffer = buffer;
+    transaction->num_bytes = ISL29125_RGB_READ_LENGTH;
+    transaction->callback = queued_done;
+    transaction->context = device;
+    return sensor_bus_submit(device->bus, transaction);
 }
 
 /******************************************************************************
-* Function Name: isl29125_config_register3
+* Function Name: isl29125_finish_rgb_read
 *******************************************************************************
 *
 * Summary:
-*  Take the isl29125 setting and make the byte the third
-*   configuration register should be set to.
+*  Get the colors of a read queued by isl29125_submit_rgb_read that is done
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  SENSOR_TRANSACTION* transaction: the finished transaction
+*  ISL29125_RGB* rgb: structure to put the color values and status flags in
 *
 * Return:
-*  uint8: value to set the isl29125's third configuration register to
+*  uint8: SENSOR_OK, or the SENSOR_ERR_* code of the read and rgb is not changed
 *
 *******************************************************************************/
 
-static uint8 config_register3(void){
-    return (isl29125.interrupt_color);
+uint8 isl29125_finish_rgb_read(ISL29125* device, SENSOR_TRANSACTION* transaction, 
+                               ISL29125_RGB* rgb) {
+    if (transaction->status == SENSOR_OK) {
+        decode_rgb(device, transaction->buffer, rgb);
+    }
+    return transaction->status;
 }
 
-/*****************************************************************************
-* Function Name: isl29125_write8
+/******************************************************************************
+* Function Name: isl29125_set_range
 *******************************************************************************
 *
 * Summary:
-*  Write a byte of data to the specified register.  Uses the sensors.c library
+*  Set the light intensity range of the isl29125
 *
 * Parameters:
-*  uint8 _register: register of isl29125 to write to
-*  uint8 data: value to put into the _register of the isl29125
+*  ISL29125* device: isl29125 to use
+*  uint8 range: ISL29125_CONFIG1_375LUX or ISL29125_CONFIG1_10KLUX
 *
 *******************************************************************************/
 
-static void isl29125_write8(uint8 _register, uint8 data) {
-    write_buffer[0] = _register;
-    write_buffer[1] = data;
-    sensor_write8(ISL29125_I2C_ADDRESS, write_buffer);
+void isl29125_set_range(ISL29125* device, uint8 range) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    REGMAP_SHADOW_FIELD(&device->config, ISL29125_RANGE, range);
+    CyExitCriticalSection(interrupt_state);
+    shadow_flush(device);
 }
 
-/*****************************************************************************
-* Function Name: isl29A125_read8
+/******************************************************************************
+* Function Name: set_adc_resolution
 *******************************************************************************
 *
 * Summary:
-*  Read a byte of data from the specified register.  Uses the sensors.c library
+*  Set the ADC resolution of the isl29125.  A 16 bit conversion takes about 
+*  100 ms and a 12 bit conversion about 6 ms.
 *
 * Parameters:
-*  uint8 _register: register of isl29125 to read from
-*  uint8 data: value to put into the _register of the isl29125
+*  ISL29125* device: isl29125 to use
+*  uint8 resolution: ISL29125_CONFIG1_ADC_16BIT or ISL29125_CONFIG1_ADC_12BIT
+*
+*******************************************************************************/
+
+void set_adc_resolution(ISL29125* device, uint8 resolution) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    REGMAP_SHADOW_FIELD(&device->config, ISL29125_RESOLUTION, resolution);
+    CyExitCriticalSection(interrupt_state);
+    shadow_flush(device);
+}
+
+/******************************************************************************
+* Function Name: get_adc_resolution
+*******************************************************************************
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
 *
 * Return:
-*  uint8: value of the register.
+*  uint8: ISL29125_CONFIG1_ADC_16BIT or ISL29125_CONFIG1_ADC_12BIT
 *
 *******************************************************************************/
 
-static uint8 isl29125_read8(uint8 _register) {
-    return sensor_read8(ISL29125_I2C_ADDRESS, read_buffer, _register);
+uint8 get_adc_resolution(ISL29125* device) {
+    return device->adc_resolution;
 }
 
-/*****************************************************************************
-* Function Name: isl29125_read16
+/******************************************************************************
+* Function Name: isl29125_set_auto_range
 *******************************************************************************
 *
 * Summary:
-*  Read 2 bytes of data starting from the specified register. Uses the sensors.c library
+*  Have the range and ADC resolution follow the light level.  The range is
+*  changed to 10k lux when the brightest color gets near full scale and 
+*  back to 375 lux when it would fit in 375 lux with room to spare.  The 
+*  resolution is the fast 12 bits when that still gives the brightest
+*  color at least precision counts, else 16 bits.  Both switches have 
+*  hysteresis so the settings do not toggle on a steady light.
+*  Samples read after an isl29125 interrupt are checked automatically, the 
+*  one converting while the settings change is dropped.  When polling with 
+*  isl29125_read_rgb pass each sample to isl29125_auto_range instead.
 *
 * Parameters:
-*  uint8 _register: register of isl29125 to read from
+*  ISL29125* device: isl29125 to use
+*  bool enable: true to turn auto ranging on
+*  uint16 precision: counts wanted from the brightest color, 0 always
+*                    picks 12 bits and above 2047 always picks 16 bits
 *
-* Return:
-*  uint16: value of the registers.
+*******************************************************************************/
+
+void isl29125_set_auto_range(ISL29125* device, bool enable, uint16 precision) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    device->range_precision = precision;
+    device->range_discard = 0;
+    device->auto_range = enable;
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: isl29125_auto_range
+*******************************************************************************
+*
+* Summary:
+*  Auto range step for samples read with isl29125_read_rgb, call once per
+*  conversion.  Changes the settings if the sample calls for it and tells 
+*  if the sample should be dropped because it was converting while the 
+*  settings changed.  The sample itself is measured with the settings in it.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  ISL29125_RGB* rgb: sample just read
+*
+* Return:
+*  bool: true if the sample is good, false if it should be dropped
+*
+*******************************************************************************/
+
+bool isl29125_auto_range(ISL29125* device, ISL29125_RGB* rgb) {
+    uint8 interrupt_state;
+    uint8 range;
+    uint8 resolution;
+    bool changed;
+    
+    if (device->range_discard) {
+        device->range_discard--;
+        return false;
+    }
+    // the settings only change with a flush, wait for a sample with no job
+    if (device->job != JOB_NONE) {
+        return true;
+    }
+    interrupt_state = CyEnterCriticalSection();
+    range = device->intensity_range;
+    resolution = device->adc_resolution;
+    changed = device->auto_range && auto_range_step(device, rgb, &range, &resolution);
+    if (changed) {
+        REGMAP_SHADOW_FIELD(&device->config, ISL29125_RANGE, range);
+        REGMAP_SHADOW_FIELD(&device->config, ISL29125_RESOLUTION, resolution);
+        device->range_discard = 1;
+    }
+    CyExitCriticalSection(interrupt_state);
+    if (changed) {
+        shadow_flush(device);
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: isl29125_conversion_time_ms
+*******************************************************************************
+*
+* Summary:
+*  Time from starting the isl29125 in its color mode until every color of
+*  the mode has been converted once.  The colors are converted one after 
+*  the other, so the rgb mode takes 3 conversion times.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
+* Return:
+*  uint16: milliseconds to wait
+*
+*******************************************************************************/
+
+uint16 isl29125_conversion_time_ms(ISL29125* device) {
+    uint16 color_time = ISL29125_CONVERSION_16BIT_MS;
+    
+    if (device->adc_resolution == ISL29125_CONFIG1_ADC_12BIT) {
+        color_time = ISL29125_CONVERSION_12BIT_MS;
+    }
+    switch (device->color_mode) {
+        case ISL29125_CONFIG1_RGB_MODE:
+            return 3 * color_time;
+        case ISL29125_CONFIG1_RG_MODE:
+        case ISL29125_CONFIG1_GB_MODE:
+            return 2 * color_time;
+        default:
+            return color_time;
+    }
+}
+
+/******************************************************************************
+* Function Name: isl29125_normalize
+*******************************************************************************
+*
+* Summary:
+*  Scale counts to what they would be in the 375 lux range at 16 bits, so
+*  counts measured with different settings can be compared.  The 10k lux 
+*  range at 16 bits goes up to 1747600.
+*
+* Parameters:
+*  uint32 counts: counts measured with the settings
+*  uint8 intensity_range: ISL29125_CONFIG1_375LUX or ISL29125_CONFIG1_10KLUX
+*  uint8 adc_resolution: ISL29125_CONFIG1_ADC_16BIT or ISL29125_CONFIG1_ADC_12BIT
+*
+* Return:
+*  uint32: normalized counts
+*
+*******************************************************************************/
+
+uint32 isl29125_normalize(uint32 counts, uint8 intensity_range, uint8 adc_resolution) {
+    if (adc_resolution == ISL29125_CONFIG1_ADC_12BIT) {
+        counts <<= 4;
+    }
+    if (intensity_range == ISL29125_CONFIG1_10KLUX) {
+        counts = (counts * ISL29125_RANGE_RATIO_NUM) / ISL29125_RANGE_RATIO_DEN;
+    }
+    return counts;
+}
+
+/******************************************************************************
+* Function Name: isl29125_normalize_rgb
+*******************************************************************************
+*
+* Summary:
+*  Normalize the 3 colors of a sample with the settings it was measured at
+*
+* Parameters:
+*  const ISL29125_RGB* rgb: sample to normalize
+*  ISL29125_NORMALIZED_RGB* normalized: structure to put the normalized colors in
+*
+*******************************************************************************/
+
+void isl29125_normalize_rgb(const ISL29125_RGB* rgb, ISL29125_NORMALIZED_RGB* normalized) {
+    normalized->red = isl29125_normalize(rgb->red, rgb->intensity_range, 
+                                         rgb->adc_resolution);
+    normalized->green = isl29125_normalize(rgb->green, rgb->intensity_range, 
+                                           rgb->adc_resolution);
+    normalized->blue = isl29125_normalize(rgb->blue, rgb->intensity_range, 
+                                          rgb->adc_resolution);
+}
+
+/******************************************************************************
+* Function Name: auto_range_step
+*******************************************************************************
+*
+* Summary:
+*  Pick the range and resolution for the next samples from the brightest 
+*  color of this one.  Only one setting is changed at a time, the range
+*  first.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  ISL29125_RGB* rgb: sample to check
+*  uint8* range: range of the device, changed to the one to use next
+*  uint8* resolution: resolution of the device, changed to the one to use next
+*
+* Return:
+*  bool: true if the range or resolution was changed
+*
+*******************************************************************************/
+
+static bool auto_range_step(ISL29125* device, ISL29125_RGB* rgb, uint8* range, 
+                            uint8* resolution) {
+    uint16 level = rgb->red;
+    uint16 full_scale = ISL29125_FULL_SCALE_16BIT;
+    uint32 precision = device->range_precision;
+    
+    if (rgb->green > level) {
+        level = rgb->green;
+    }
+    if (rgb->blue > level) {
+        level = rgb->blue;
+    }
+    if (*resolution == ISL29125_CONFIG1_ADC_12BIT) {
+        full_scale = ISL29125_FULL_SCALE_12BIT;
+    }
+    
+    // go up at 7/8 of full scale, come back below 5/8 of the 375 lux full scale
+    if (*range == ISL29125_CONFIG1_375LUX) {
+        if (level >= full_scale - (full_scale >> 3)) {
+            *range = ISL29125_CONFIG1_10KLUX;
+            return true;
+        }
+    }
+    else if (level < (((uint32) full_scale * ISL29125_RANGE_RATIO_DEN * 5) / 
+                      (ISL29125_RANGE_RATIO_NUM * 8))) {
+        *range = ISL29125_CONFIG1_375LUX;
+        return true;
+    }
+    
+    // 12 bits keeps 1/16 of the counts, drop to it with a factor of 2 to spare
+    if (*resolution == ISL29125_CONFIG1_ADC_16BIT) {
+        if ((level >> 4) >= (precision << 1)) {
+            *resolution = ISL29125_CONFIG1_ADC_12BIT;
+            return true;
+        }
+    }
+    else if (level < precision) {
+        *resolution = ISL29125_CONFIG1_ADC_16BIT;
+        return true;
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function Name: range_write
+*******************************************************************************
+*
+* Summary:
+*  Queue a write of the first configuration register with a new range 
+*  and resolution.  Called from the I2C transaction queue with interrupts
+*  disabled, so it can not wait for the bus like shadow_flush.  The shadow
+*  and the settings only take the new values in range_done, once the 
+*  device has them.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8 range: ISL29125_CONFIG1_375LUX or ISL29125_CONFIG1_10KLUX
+*  uint8 resolution: ISL29125_CONFIG1_ADC_16BIT or ISL29125_CONFIG1_ADC_12BIT
+*
+* Return:
+*  bool: true if queued, false if the queue is full and nothing changes
+*
+*******************************************************************************/
+
+static bool range_write(ISL29125* device, uint8 range, uint8 resolution) {
+    uint8 config1 = regmap_shadow_read(&device->config, ISL29125_CONFIG_REG_1);
+    
+    config1 &= ~(ISL29125_RANGE_MASK | ISL29125_RESOLUTION_MASK);
+    device->range_buffer[0] = ISL29125_CONFIG_REG_1;
+    device->range_buffer[1] = config1 | range | resolution;
+    device->range_transaction.type = SENSOR_XFER_WRITE;
+    device->range_transaction.address = device->address;
+    device->range_transaction.buffer = device->range_buffer;
+    device->range_transaction.num_bytes = 2;
+    device->range_transaction.callback = range_done;
+    device->range_transaction.context = device;
+    return sensor_bus_submit(device->bus, &device->range_transaction);
+}
+
+/******************************************************************************
+* Function Name: range_queued
+*******************************************************************************
+*
+* Return:
+*  bool: true if a range write is in the queue or on the bus
+*
+*******************************************************************************/
+
+static inline bool range_queued(ISL29125* device) {
+    return (device->range_transaction.state != SENSOR_XFER_IDLE) && 
+           (device->range_transaction.state != SENSOR_XFER_DONE);
+}
+
+/******************************************************************************
+* Function Name: range_done
+*******************************************************************************
+*
+* Summary:
+*  Callback of the range write.  If it went through, the shadow and the 
+*  settings take the new range and resolution, else the old ones are kept
+*  and the failed transfer leaves the register dirty for the next flush.
+*  A change of the register made by the main loop since the write was 
+*  queued stays dirty too.
+*
+*******************************************************************************/
+
+static void range_done(SENSOR_TRANSACTION* transaction) {
+    ISL29125* device = (ISL29125*) transaction->context;
+    uint8 config1 = device->range_buffer[1];
+    
+    transfer_done(device, transaction->status);
+    if (transaction->status != SENSOR_OK) {
+        return;
+    }
+    REGMAP_SHADOW_FIELD(&device->config, ISL29125_RANGE, config1 & ISL29125_RANGE_MASK);
+    REGMAP_SHADOW_FIELD(&device->config, ISL29125_RESOLUTION, 
+                        config1 & ISL29125_RESOLUTION_MASK);
+    if (regmap_shadow_read(&device->config, ISL29125_CONFIG_REG_1) == config1) {
+        regmap_shadow_sync(&device->config, ISL29125_CONFIG_REG_1, config1);
+    }
+    device->intensity_range = config1 & ISL29125_RANGE_MASK;
+    device->adc_resolution = config1 & ISL29125_RESOLUTION_MASK;
+}
+
+/******************************************************************************
+* Function Name: isl29125_set_conversion_interrupt
+*******************************************************************************
+*
+* Summary:
+*  Choose if the INT pin of the isl29125 goes low every time a conversion
+*  finishes.  Connect the pin to an interrupt that calls 
+*  isl29125_interrupt to get each sample as soon as it is ready, at the
+*  conversion rate of the sensor (about 100 ms at 16 bits, 6 ms at 12 bits).
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  bool enable: true to have the INT pin signal each finished conversion
+*
+* Return:
+*  uint8: SENSOR_OK or the SENSOR_ERR_* code of the status read that releases
+*         the INT pin, SENSOR_ERR_BUSY and nothing is changed if the device
+*         has a job
+*
+*******************************************************************************/
+
+uint8 isl29125_set_conversion_interrupt(ISL29125* device, bool enable) {
+    uint8 setting = ISL29125_CONFIG3_DISABLE_INT_ON_CONVERSION;
+    uint8 interrupt_state;
+    
+    if (device->job != JOB_NONE) {
+        return SENSOR_ERR_BUSY;
+    }
+    if (enable) {
+        setting = ISL29125_CONFIG3_ENABLE_INT_ON_CONVERSION;
+    }
+    interrupt_state = CyEnterCriticalSection();
+    REGMAP_SHADOW_FIELD(&device->config, ISL29125_INT_ON_CONVERSION, setting);
+    CyExitCriticalSection(interrupt_state);
+    shadow_flush(device);
+    // read the status register to release the INT pin
+    return isl29125_read(device, device->read_buffer, ISL29125_STATUS_REG, 1);
+}
+
+/******************************************************************************
+* Function Name: isl29125_interrupt
+*******************************************************************************
+*
+* Summary:
+*  Call from the interrupt of the pin connected to the isl29125 INT pin.
+*  Queues a read of the status and color registers without waiting for
+*  the bus, reading the status register also releases the INT pin.
+*  When the read finishes the sample is available with isl29125_get_sample.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
+*******************************************************************************/
+
+void isl29125_interrupt(ISL29125* device) {
+    if (!sensor_backoff_ready(&device->backoff)) {
+        return;  // the INT pin stays low until a later read of the status
+    }
+    if ((device->sample_transaction.state != SENSOR_XFER_IDLE) && 
+            (device->sample_transaction.state != SENSOR_XFER_DONE)) {
+        return;  // the last interrupt is still being read
+    }
+    device->sample_transaction.type = SENSOR_XFER_READ;
+    device->sample_transaction.address = device->address;
+    device->sample_transaction._register = ISL29125_STATUS_REG;
+    device->sample_transaction.buffer = device->interrupt_buffer;
+    device->sample_transaction.num_bytes = ISL29125_RGB_READ_LENGTH;
+    device->sample_transaction.callback = sample_read_done;
+    device->sample_transaction.context = device;
+    sensor_bus_submit(device->bus, &device->sample_transaction);
+}
+
+/******************************************************************************
+* Function Name: isl29125_get_sample
+*******************************************************************************
+*
+* Summary:
+*  Get the sample read after the last isl29125 interrupt, if there is a 
+*  new one.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  ISL29125_RGB* rgb: structure to put the color values and status flags in
+*
+* Return:
+*  bool: true if a new sample was put in rgb, false if there is no new sample
+*
+*******************************************************************************/
+
+bool isl29125_get_sample(ISL29125* device, ISL29125_RGB* rgb) {
+    uint8 interrupt_state;
+    
+    if (!device->sample_ready) {
+        return false;
+    }
+    interrupt_state = CyEnterCriticalSection();
+    *rgb = device->sample;
+    device->sample_ready = false;
+    CyExitCriticalSection(interrupt_state);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: set_upper_threshold
+*******************************************************************************
+*
+* Summary:
+*  Set the upper threshold of the isl29125 interrupt window
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint16 level: the interrupt color going above this level triggers an interrupt
+*
+* Return:
+*  uint8: SENSOR_OK or the SENSOR_ERR_* code of the write, SENSOR_ERR_BUSY and
+*         nothing is changed if the device has a job
+*
+*******************************************************************************/
+
+uint8 set_upper_threshold(ISL29125* device, uint16 level) {
+    uint8 status;
+    
+    if (device->job != JOB_NONE) {
+        return SENSOR_ERR_BUSY;
+    }
+    device->write_buffer[0] = ISL29125_THRESHOLD_HIGH_REG;
+    device->write_buffer[1] = level & 0xFF;
+    device->write_buffer[2] = level >> 8;
+    status = isl29125_write(device, device->write_buffer, 3);
+    if (status == SENSOR_OK) {
+        device->threshold_high = level;
+    }
+    return status;
+}
+
+/******************************************************************************
+* Function Name: set_lower_threshold
+*******************************************************************************
+*
+* Summary:
+*  Set the lower threshold of the isl29125 interrupt window
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint16 level: the interrupt color going below this level triggers an interrupt
+*
+* Return:
+*  uint8: SENSOR_OK or the SENSOR_ERR_* code of the write, SENSOR_ERR_BUSY and
+*         nothing is changed if the device has a job
+*
+*******************************************************************************/
+
+uint8 set_lower_threshold(ISL29125* device, uint16 level) {
+    uint8 status;
+    
+    if (device->job != JOB_NONE) {
+        return SENSOR_ERR_BUSY;
+    }
+    device->write_buffer[0] = ISL29125_THRESHOLD_LOW_REG;
+    device->write_buffer[1] = level & 0xFF;
+    device->write_buffer[2] = level >> 8;
+    status = isl29125_write(device, device->write_buffer, 3);
+    if (status == SENSOR_OK) {
+        device->threshold_low = level;
+    }
+    return status;
+}
+
+/******************************************************************************
+* Function Name: isl29125_set_threshold_window
+*******************************************************************************
+*
+* Summary:
+*  Put the isl29125 in the threshold window mode.  The INT pin goes low
+*  only when the chosen color stays outside of the window for the chosen
+*  number of conversions, so the MCU can sleep until the light changes 
+*  (e.g. CyPmSleep with the pin interrupt as the wakeup source).
+*  The pin interrupt has to call isl29125_interrupt, the crossed edge is
+*  then given by isl29125_get_threshold_event.  If band is not 0 the window
+*  is moved to band counts above and below each new level, so the sensor
+*  keeps signalling every change larger than band.
+*  Writes both thresholds in one transaction and config register 3 in one
+*  more, conversion interrupts are turned off.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8 color: ISL29125_CONFIG3_G_INT, R_INT or B_INT
+*  uint16 low: lower threshold of the window
+*  uint16 high: upper threshold of the window
+*  uint8 persistence: ISL29125_CONFIG3_INT_1_TIME, 2, 4 or 8 times
+*  uint16 band: half width of the window to re-arm with, or 0 to keep the window
+*
+* Return:
+*  uint8: SENSOR_OK or the SENSOR_ERR_* code of the threshold write, 
+*         SENSOR_ERR_BUSY and nothing is changed if the device has a job
+*
+*******************************************************************************/
+
+uint8 isl29125_set_threshold_window(ISL29125* device, uint8 color, uint16 low, uint16 high, 
+                                    uint8 persistence, uint16 band) {
+    uint8 interrupt_state;
+    uint8 status;
+    
+    if (device->job != JOB_NONE) {
+        return SENSOR_ERR_BUSY;
+    }
+    device->threshold_band = band;
+    fill_threshold_buffer(device->write_buffer, low, high);
+    status = isl29125_write(device, device->write_buffer, ISL29125_NUM_THRESHOLD_REGS + 1);
+    if (status == SENSOR_OK) {
+        device->threshold_low = low;
+        device->threshold_high = high;
+    }
+    
+    interrupt_state = CyEnterCriticalSection();
+    regmap_shadow_write(&device->config, ISL29125_CONFIG_REG_3, color | persistence | 
+                        ISL29125_CONFIG3_DISABLE_INT_ON_CONVERSION);
+    CyExitCriticalSection(interrupt_state);
+    shadow_flush(device);
+    // read the status register to release the INT pin
+    isl29125_read8(device, ISL29125_STATUS_REG);
+    return status;
+}
+
+/******************************************************************************
+* Function Name: isl29125_get_threshold_event
+*******************************************************************************
+*
+* Summary:
+*  Get the last threshold crossing of the isl29125, if there is a new one.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  ISL29125_THRESHOLD_EVENT* event: structure to put the crossed edge and level in
+*
+* Return:
+*  bool: true if a new event was put in event, false if there is no new event
+*
+*******************************************************************************/
+
+bool isl29125_get_threshold_event(ISL29125* device, ISL29125_THRESHOLD_EVENT* event) {
+    uint8 interrupt_state;
+    
+    if (!device->event_ready) {
+        return false;
+    }
+    interrupt_state = CyEnterCriticalSection();
+    *event = device->threshold_event;
+    device->event_ready = false;
+    CyExitCriticalSection(interrupt_state);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: threshold_event
+*******************************************************************************
+*
+* Summary:
+*  Save which edge of the threshold window was crossed and, if a band is 
+*  set, queue a write that moves the window around the new level.  The 
+*  window of the structure only moves in threshold_done, once the device
+*  has it.  If the write can not be queued or fails, the device keeps the
+*  old window and the next crossing of it tries again.
+*  Called from the I2C transaction queue with interrupts disabled.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
+*******************************************************************************/
+
+static void threshold_event(ISL29125* device, ISL29125_RGB* rgb) {
+    ISL29125_THRESHOLD_EVENT* event = &device->threshold_event;
+    uint16 level = color_level(rgb, device->interrupt_color);
+    uint16 middle = device->threshold_low + 
+                    ((device->threshold_high - device->threshold_low) >> 1);
+    uint16 low = 0;
+    uint16 high = 0xFFFF;
+    
+    event->level = level;
+    event->low = device->threshold_low;
+    event->high = device->threshold_high;
+    // with persistence the level can be back in the window when it is read
+    if (level >= middle) {
+        event->edge = ISL29125_EDGE_ABOVE;
+    }
+    else {
+        event->edge = ISL29125_EDGE_BELOW;
+    }
+    device->event_ready = true;
+    
+    if (device->threshold_band == 0) {
+        return;
+    }
+    if ((device->threshold_transaction.state != SENSOR_XFER_IDLE) && 
+            (device->threshold_transaction.state != SENSOR_XFER_DONE)) {
+        return;
+    }
+    if (level > device->threshold_band) {
+        low = level - device->threshold_band;
+    }
+    if (level < 0xFFFF - device->threshold_band) {
+        high = level + device->threshold_band;
+    }
+    fill_threshold_buffer(device->threshold_buffer, low, high);
+    device->threshold_transaction.type = SENSOR_XFER_WRITE;
+    device->threshold_transaction.address = device->address;
+    device->threshold_transaction.buffer = device->threshold_buffer;
+    device->threshold_transaction.num_bytes = ISL29125_NUM_THRESHOLD_REGS + 1;
+    device->threshold_transaction.callback = threshold_done;
+    device->threshold_transaction.context = device;
+    sensor_bus_submit(device->bus, &device->threshold_transaction);
+}
+
+/******************************************************************************
+* Function Name: threshold_done
+*******************************************************************************
+*
+* Summary:
+*  Callback of the write that moves the threshold window, the window of 
+*  the structure follows the device if the write went through
+*
+*******************************************************************************/
+
+static void threshold_done(SENSOR_TRANSACTION* transaction) {
+    ISL29125* device = (ISL29125*) transaction->context;
+    uint8* buffer = device->threshold_buffer;
+    
+    transfer_done(device, transaction->status);
+    if (transaction->status != SENSOR_OK) {
+        return;
+    }
+    device->threshold_low = buffer[1] | (buffer[2] << 8);
+    device->threshold_high = buffer[3] | (buffer[4] << 8);
+}
+
+/******************************************************************************
+* Function Name: fill_threshold_buffer
+*******************************************************************************
+*
+* Summary:
+*  Make the write of both thresholds, starting at the low threshold register
+*
+*******************************************************************************/
+
+static void fill_threshold_buffer(uint8* buffer, uint16 low, uint16 high) {
+    buffer[0] = ISL29125_THRESHOLD_BLOCK_FIRST;
+    buffer[1] = low & 0xFF;
+    buffer[2] = low >> 8;
+    buffer[3] = high & 0xFF;
+    buffer[4] = high >> 8;
+}
+
+/******************************************************************************
+* Function Name: color_level
+*******************************************************************************
+*
+* Return:
+*  uint16: value of the color selected by an ISL29125_CONFIG3_*_INT setting
+*
+*******************************************************************************/
+
+static uint16 color_level(ISL29125_RGB* rgb, uint8 color) {
+    switch (color) {
+        case ISL29125_CONFIG3_R_INT:
+            return rgb->red;
+        case ISL29125_CONFIG3_B_INT:
+            return rgb->blue;
+        default:
+            return rgb->green;
+    }
+}
+
+/******************************************************************************
+* Function Name: isl29125_set_sample_buffer
+*******************************************************************************
+*
+* Summary:
+*  Have every sample read after an isl29125 interrupt put, with a
+*  timestamp, into a sample buffer instead of isl29125_get_sample.  The
+*  main loop can then take them out in batches with sample_buffer_get 
+*  instead of only seeing the last one.  The channels of the samples are
+*  red, green and blue.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  SAMPLE_BUFFER* buffer: buffer to put the samples in, or 0 to stop
+*  uint8 device_id: put in the device field of each sample
+*
+*******************************************************************************/
+
+void isl29125_set_sample_buffer(ISL29125* device, SAMPLE_BUFFER* buffer, uint8 device_id) {
+    device->device_id = device_id;
+    device->samples = buffer;
+}
+
+/******************************************************************************
+* Function Name: sample_read_done
+*******************************************************************************
+*
+* Summary:
+*  Callback of the read started by isl29125_interrupt, saves the sample.
+*  Called from the I2C transaction queue with interrupts disabled.
+*
+*******************************************************************************/
+
+static void sample_read_done(SENSOR_TRANSACTION* transaction) {
+    ISL29125* device = (ISL29125*) transaction->context;
+    uint8 range;
+    uint8 resolution;
+    
+    transfer_done(device, transaction->status);
+    if (transaction->status != SENSOR_OK) {
+        return;
+    }
+    decode_rgb(device, transaction->buffer, &device->sample);
+    if (device->sample.status & ISL29125_STATUS_THRESHOLD_INT) {
+        threshold_event(device, &device->sample);
+    }
+    if (device->range_discard) {
+        device->range_discard--;
+        return;
+    }
+    // the range write is only skipped if the last one is still queued
+    range = device->intensity_range;
+    resolution = device->adc_resolution;
+    if (device->auto_range && !range_queued(device) && 
+            auto_range_step(device, &device->sample, &range, &resolution) &&
+            range_write(device, range, resolution)) {
+        device->range_discard = 1;
+    }
+    if (device->samples) {
+        put_sample(device, &device->sample);
+    }
+    else {
+        if (device->sample_ready) {
+            device->samples_missed++;
+        }
+        device->sample_ready = true;
+    }
+}
+
+/******************************************************************************
+* Function Name: put_sample
+*******************************************************************************
+*
+* Summary:
+*  Put a timestamped copy of a sample in the sample buffer.  Called from
+*  the I2C transaction queue, which is the only producer of the buffer.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*
+*******************************************************************************/
+
+static void put_sample(ISL29125* device, ISL29125_RGB* rgb) {
+    SAMPLE sample;
+    sample.timestamp = timebase_ms();
+    sample.device = device->device_id;
+    sample.status = rgb->status;
+    sample.setting = rgb->intensity_range | rgb->adc_resolution;
+    sample.channel[0] = rgb->red;
+    sample.channel[1] = rgb->green;
+    sample.channel[2] = rgb->blue;
+    sample_buffer_put(device->samples, &sample);
+}
+
+/******************************************************************************
+* Function Name: decode_rgb
+*******************************************************************************
+*
+* Summary:
+*  Fill an ISL29125_RGB structure from a burst read of the status, green,
+*  red and blue registers, and the settings they were measured with.
+*
+*******************************************************************************/
+
+static void decode_rgb(ISL29125* device, uint8* buffer, ISL29125_RGB* rgb) {
+    rgb->status = buffer[SAMPLE_OFFSET(ISL29125_STATUS_REG)];
+    rgb->green = REGMAP_VALUE(ISL29125_GREEN_REG, &buffer[SAMPLE_OFFSET(ISL29125_GREEN_REG)]);
+    rgb->red = REGMAP_VALUE(ISL29125_RED_REG, &buffer[SAMPLE_OFFSET(ISL29125_RED_REG)]);
+    rgb->blue = REGMAP_VALUE(ISL29125_BLUE_REG, &buffer[SAMPLE_OFFSET(ISL29125_BLUE_REG)]);
+    rgb->conversion_done = (0x00 != (rgb->status & ISL29125_STATUS_CONVERSION_DONE));
+    rgb->brownout = (0x00 != (rgb->status & ISL29125_STATUS_BROWNOUT));
+    rgb->intensity_range = device->intensity_range;
+    rgb->adc_resolution = device->adc_resolution;
+}
+
+/*****************************************************************************
+* Function Name: isl29A125_read8
+*******************************************************************************
+*
+* Summary:
+*  Read a byte of data from the specified register.  Uses the sensors.c library
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8 _register: register of isl29125 to read from
+*  uint8 data: value to put into the _register of the isl29125
+*
+* Return:
+*  uint8: value of the register.
+*
+*******************************************************************************/
+
+static uint8 isl29125_read8(ISL29125* device, uint8 _register) {
+    if (isl29125_read(device, device->read_buffer, _register, 1) != SENSOR_OK) {
+        return 0;
+    }
+    return device->read_buffer[0];
+}
+
+/*****************************************************************************
+* Function Name: isl29125_read16
+*******************************************************************************
+*
+* Summary:
+*  Read 2 bytes of data starting from the specified register. Uses the sensors.c library
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8 _register: register of isl29125 to read from
+*
+* Return:
+*  uint16: value of the registers.
+*
+*******************************************************************************/
+
+static uint16 isl29125_read16(ISL29125* device, uint8 _register) {
+    if (isl29125_read(device, device->read_buffer, _register, 2) != SENSOR_OK) {
+        return 0;
+    }
+    return device->read_buffer[0] | (device->read_buffer[1] << 8);
+}
+
+/*****************************************************************************
+* Function Name: isl29125_write
+*******************************************************************************
+*
+* Summary:
+*  Write a buffer to the isl29125 and wait for it, unless the device is 
+*  backing off after a failure or has a job of the *_begin functions,
+*  whose transfers use the same buffers.  Every blocking transfer of the
+*  driver goes through here or isl29125_read.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8* buffer: register address followed by the data
+*  uint8 num_bytes: number of bytes to send, with the register address
+*
+* Return:
+*  uint8: SENSOR_OK or a SENSOR_ERR_* code, SENSOR_ERR_BUSY if the device has a job
+*
+*******************************************************************************/
+
+static uint8 isl29125_write(ISL29125* device, uint8* buffer, uint8 num_bytes) {
+    uint8 status = SENSOR_ERR_BACKOFF;
+    
+    if (device->job != JOB_NONE) {
+        return SENSOR_ERR_BUSY;
+    }
+    if (sensor_backoff_ready(&device->backoff)) {
+        status = regmap_write(&isl29125_regmap, device->bus, device->address, buffer, 
+                              num_bytes);
+    }
+    transfer_done(device, status);
+    return status;
+}
+
+/*****************************************************************************
+* Function Name: isl29125_read
+*******************************************************************************
+*
+* Summary:
+*  Read num_bytes from the isl29125 starting at _register and wait for 
+*  them, unless the device is backing off after a failure or has a job.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8* buffer: where to put the data read
+*  uint8 _register: first register to read
+*  uint8 num_bytes: number of bytes to read
+*
+* Return:
+*  uint8: SENSOR_OK or a SENSOR_ERR_* code, SENSOR_ERR_BUSY if the device has a job
+*
+*******************************************************************************/
+
+static uint8 isl29125_read(ISL29125* device, uint8* buffer, uint8 _register, uint8 num_bytes) {
+    uint8 status = SENSOR_ERR_BACKOFF;
+    
+    if (device->job != JOB_NONE) {
+        return SENSOR_ERR_BUSY;
+    }
+    if (sensor_backoff_ready(&device->backoff)) {
+        status = regmap_read(&isl29125_regmap, device->bus, device->address, buffer, 
+                             _register, num_bytes);
+    }
+    transfer_done(device, status);
+    return status;
+}
+
+/*****************************************************************************
+* Function Name: transfer_done
+*******************************************************************************
+*
+* Summary:
+*  Keep the working flag and backoff of the isl29125 up to date with the
+*  result of a transfer.  After a failure the device could have lost power,
+*  so every configuration register is written again on the next flush.
+*
+* Parameters:
+*  ISL29125* device: isl29125 to use
+*  uint8 status: SENSOR_OK or the SENSOR_ERR_* code of the transfer
+*
+*******************************************************************************/
+
+static void transfer_done(ISL29125* device, uint8 status) {
+    if (status == SENSOR_OK) {
+        if (device->backoff.failures) {
+            device->working = true;
+        }
+    }
+    else if (status != SENSOR_ERR_BACKOFF) {
+        device->working = false;
+        regmap_shadow_invalidate(&device->config);
+    }
+    sensor_backoff_update(&device->backoff, status);
+}
+
+/*****************************************************************************
+* Function Name: queued_done
+*******************************************************************************
+*
+* Summary:
+*  Callback of the reads queued by isl29125_submit_rgb_read
 *
 *******************************************************************************/
 
-static uint16 isl29125_read16(uint8 _register) {
-    return sensor_read16(ISL29125_I2C_ADDRESS, read_buffer, _register);
+static void queued_done(SENSOR_TRANSACTION* transaction) {
+    transfer_done((ISL29125*) transaction->context, transaction->status);
 }
 
 
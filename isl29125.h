@@ -19,17 +19,96 @@
 #if !defined(_ISL29125_H)
 #define _ISL29125_H
     
-#include <project.h>
+#include "platform.h"
 #include "sensor.h"
+#include "sample_buffer.h"
+#include "regmap.h"
 #include "stdbool.h"
 
-    
+/***************************************
+*    ISL29125 Register Map
+***************************************/ 
+
+// name, address, bytes
+#define ISL29125_REGISTERS(X) \
+    X(ISL29125_DEVICE_ID_REG,       0x00, 1) \
+    X(ISL29125_CONFIG_REG_1,        0x01, 1) \
+    X(ISL29125_CONFIG_REG_2,        0x02, 1) \
+    X(ISL29125_CONFIG_REG_3,        0x03, 1) \
+    X(ISL29125_THRESHOLD_LOW_REG,   0x04, 2) \
+    X(ISL29125_THRESHOLD_HIGH_REG,  0x06, 2) \
+    X(ISL29125_STATUS_REG,          0x08, 1) \
+    X(ISL29125_GREEN_REG,           0x09, 2) \
+    X(ISL29125_RED_REG,             0x0B, 2) \
+    X(ISL29125_BLUE_REG,            0x0D, 2)
+
+// name, register, shift, bits
+#define ISL29125_FIELDS(X) \
+    X(ISL29125_MODE,                ISL29125_CONFIG_REG_1, 0, 3) \
+    X(ISL29125_RANGE,               ISL29125_CONFIG_REG_1, 3, 1) \
+    X(ISL29125_RESOLUTION,          ISL29125_CONFIG_REG_1, 4, 1) \
+    X(ISL29125_SYNC,                ISL29125_CONFIG_REG_1, 5, 1) \
+    X(ISL29125_IR_ADJUST,           ISL29125_CONFIG_REG_2, 0, 6) \
+    X(ISL29125_IR_OFFSET,           ISL29125_CONFIG_REG_2, 7, 1) \
+    X(ISL29125_INT_COLOR,           ISL29125_CONFIG_REG_3, 0, 2) \
+    X(ISL29125_INT_PERSIST,         ISL29125_CONFIG_REG_3, 2, 2) \
+    X(ISL29125_INT_ON_CONVERSION,   ISL29125_CONFIG_REG_3, 4, 1) \
+    X(ISL29125_FLAG_INT,            ISL29125_STATUS_REG, 0, 1) \
+    X(ISL29125_FLAG_CONVERSION_DONE, ISL29125_STATUS_REG, 1, 1) \
+    X(ISL29125_FLAG_BROWNOUT,       ISL29125_STATUS_REG, 2, 1) \
+    X(ISL29125_FLAG_CONVERTING,     ISL29125_STATUS_REG, 4, 2)
+
+// Auto-increment ranges used in one transfer: name, first register, bytes
+#define ISL29125_BLOCKS(X) \
+    X(ISL29125_CONFIG_BLOCK,        ISL29125_CONFIG_REG_1, 3) \
+    X(ISL29125_THRESHOLD_BLOCK,     ISL29125_THRESHOLD_LOW_REG, 4) \
+    X(ISL29125_SAMPLE_BLOCK,        ISL29125_STATUS_REG, 7)
+
+REGMAP_CONSTANTS(ISL29125_REGISTERS, ISL29125_FIELDS, ISL29125_BLOCKS)
+
+extern const REGMAP isl29125_regmap;
+
 /***************************************
 *      Structures
 ***************************************/ 
 
+#define ISL29125_NUM_CONFIG_REGS             ISL29125_CONFIG_BLOCK_LENGTH
+#define ISL29125_NUM_THRESHOLD_REGS          ISL29125_THRESHOLD_BLOCK_LENGTH
+// Status through blue data registers, read together in one burst
+#define ISL29125_RGB_READ_LENGTH             ISL29125_SAMPLE_BLOCK_LENGTH
+// Saved for a warm start: address and the configuration registers
+#define ISL29125_WARM_RECORD_SIZE            (1 + ISL29125_CONFIG_BLOCK_LENGTH)
+
+typedef struct {
+    uint16      red;
+    uint16      green;
+    uint16      blue;
+    uint8       status;             // raw value of the status register
+    bool        conversion_done;
+    bool        brownout;
+    uint8       intensity_range;    // settings the counts were measured with
+    uint8       adc_resolution;
+} ISL29125_RGB;
+
+// Counts scaled to the 375 lux range at 16 bits, see isl29125_normalize
+typedef struct {
+    uint32      red;
+    uint32      green;
+    uint32      blue;
+} ISL29125_NORMALIZED_RGB;
+
+typedef struct {
+    uint8       edge;       // ISL29125_EDGE_ABOVE or ISL29125_EDGE_BELOW
+    uint16      level;      // value of the interrupt color when it was read
+    uint16      low;        // window that was crossed
+    uint16      high;
+} ISL29125_THRESHOLD_EVENT;
+
 typedef struct {
     uint8       working;  // Status of the device
+    SENSOR_BUS* bus;
+    uint8       address;
+    SENSOR_BACKOFF backoff; // skips the device for a while after a failed transfer
     uint8       color_mode;
     uint8       intensity_range;
     uint8       adc_resolution;
@@ -37,13 +116,43 @@ typedef struct {
     uint8       ir_offset;
     uint8       ir_setting;
     uint8       interrupt_color; 
-    uint8       config_reg1;
-    uint8       config_reg2;
-    uint8       config_reg3;
+    uint8       conversion_interrupt;
+    uint8       interrupt_persist;
+    uint16      threshold_low;
+    uint16      threshold_high;
+    uint16      threshold_band;     // if not 0, center a window this wide around each new level
+    REGMAP_SHADOW           config;         // shadow of the config registers
+    ISL29125_RGB            sample;         // last sample read after an interrupt
+    volatile bool           sample_ready;
+    uint16                  samples_missed; // samples overwritten before they were read
+    ISL29125_THRESHOLD_EVENT threshold_event;
+    volatile bool           event_ready;
+    SAMPLE_BUFFER*          samples;        // if set, interrupt samples go here
+    uint8                   device_id;      // device field of those samples
+    bool                    auto_range;
+    uint16                  range_precision;    // counts wanted from the brightest color
+    uint8                   range_discard;      // samples left to drop after a switch
+    
+    // I2C communication buffers
+    uint8                   read_buffer[8];
+    uint8                   write_buffer[ISL29125_NUM_THRESHOLD_REGS + 1];
+    // Read started from the INT pin interrupt
+    uint8                   interrupt_buffer[ISL29125_RGB_READ_LENGTH];
+    SENSOR_TRANSACTION      sample_transaction;
+    // Write of a new threshold window from the interrupt callback
+    uint8                   threshold_buffer[ISL29125_NUM_THRESHOLD_REGS + 1];
+    SENSOR_TRANSACTION      threshold_transaction;
+    // Write of a new range and resolution from the interrupt callback
+    uint8                   range_buffer[2];
+    SENSOR_TRANSACTION      range_transaction;
+    // Job moved forward by isl29125_poll
+    uint8                   job;
+    uint8                   job_step;
+    bool                    job_ok;         // false if the last job failed
+    ISL29125_RGB*           job_rgb;        // where a sample job puts the colors
+    SENSOR_TRANSACTION      job_transaction;
 } ISL29125;
 
-ISL29125 isl29125;
-
 /***************************************
 *    ISL29125 Device Constants
 ***************************************/ 
@@ -53,27 +162,6 @@ ISL29125 isl29125;
 #define ISL29125_DEVICE_RESET_CODE           0x46
 #define ISL29125_DEVICE_ID                   0x7D
 
-/***************************************
-*    ISL29125 Register Assignment
-***************************************/ 
-    
-#define ISL29125_DEVICE_ID_REG               0x00
-#define ISL29125_CONFIG_REG_1                0x01
-#define ISL29125_CONFIG_REG_2                0x02
-#define ISL29125_CONFIG_REG_3                0x03
-#define ISL29125_THRESHOLD_REG_LL            0x04
-#define ISL29125_THRESHOLD_REG_LH            0x05
-#define ISL29125_THRESHOLD_REG_HL            0x06
-#define ISL29125_THRESHOLD_REG_HH            0x07
-#define ISL29125_STATUS_REG                  0x08 
-#define ISL29125_GREEN_REG_L                 0x09 
-#define ISL29125_GREEN_REG_H                 0x0A
-#define ISL29125_RED_REG_L                   0x0B
-#define ISL29125_RED_REG_H                   0x0C
-#define ISL29125_BLUE_REG_L                  0x0D
-#define ISL29125_BLUE_REG_H                  0x0E  
- 
-    
 /***************************************
 *       Configuration settings
 ***************************************/ 
@@ -81,73 +169,123 @@ ISL29125 isl29125;
 // Configuration base settings
 #define ISL29125_CONFIG_DEFAULT              0x00
     
+// Define to read back the configuration registers after every write
+//#define ISL29125_VERIFY_CONFIG
+    
 // CONFIGURATION 1 REGISTER OPTIONS
 // Pick color mode
-#define ISL29125_CONFIG1_POWERDOWN           0x00
-#define ISL29125_CONFIG1_GREEN_MODE          0x01
-#define ISL29125_CONFIG1_RED_MODE            0x02
-#define ISL29125_CONFIG1_BLUE_MODE           0x03
-#define ISL29125_CONFIG1_STANDBY             0x04
-#define ISL29125_CONFIG1_RGB_MODE            0x05
-#define ISL29125_CONFIG1_RG_MODE             0x06
-#define ISL29125_CONFIG1_GB_MODE             0x07
+#define ISL29125_CONFIG1_POWERDOWN           REGMAP_ENCODE(ISL29125_MODE, 0)
+#define ISL29125_CONFIG1_GREEN_MODE          REGMAP_ENCODE(ISL29125_MODE, 1)
+#define ISL29125_CONFIG1_RED_MODE            REGMAP_ENCODE(ISL29125_MODE, 2)
+#define ISL29125_CONFIG1_BLUE_MODE           REGMAP_ENCODE(ISL29125_MODE, 3)
+#define ISL29125_CONFIG1_STANDBY             REGMAP_ENCODE(ISL29125_MODE, 4)
+#define ISL29125_CONFIG1_RGB_MODE            REGMAP_ENCODE(ISL29125_MODE, 5)
+#define ISL29125_CONFIG1_RG_MODE             REGMAP_ENCODE(ISL29125_MODE, 6)
+#define ISL29125_CONFIG1_GB_MODE             REGMAP_ENCODE(ISL29125_MODE, 7)
 // Light intensity range
-#define ISL29125_CONFIG1_375LUX              0x00
-#define ISL29125_CONFIG1_10KLUX              0x08
+#define ISL29125_CONFIG1_375LUX              REGMAP_ENCODE(ISL29125_RANGE, 0)
+#define ISL29125_CONFIG1_10KLUX              REGMAP_ENCODE(ISL29125_RANGE, 1)
 // ADC accuracy
-#define ISL29125_CONFIG1_ADC_16BIT           0x00
-#define ISL29125_CONFIG1_ADC_12BIT           0x10
+#define ISL29125_CONFIG1_ADC_16BIT           REGMAP_ENCODE(ISL29125_RESOLUTION, 0)
+#define ISL29125_CONFIG1_ADC_12BIT           REGMAP_ENCODE(ISL29125_RESOLUTION, 1)
+// Largest counts at each ADC resolution
+#define ISL29125_FULL_SCALE_16BIT            65535
+#define ISL29125_FULL_SCALE_12BIT            4095
+// Conversion time of one color, with a margin for the internal oscillator
+#define ISL29125_CONVERSION_16BIT_MS         110
+#define ISL29125_CONVERSION_12BIT_MS         8
+// Ratio of the 10k lux range to the 375 lux range
+#define ISL29125_RANGE_RATIO_NUM             80
+#define ISL29125_RANGE_RATIO_DEN             3
 // interrupt pin setting
-#define ISL29125_CONFIG1_NO_SYNC             0x00
-#define ISL29125_CONFIG1_SYNC_TO_INT         0x20
+#define ISL29125_CONFIG1_NO_SYNC             REGMAP_ENCODE(ISL29125_SYNC, 0)
+#define ISL29125_CONFIG1_SYNC_TO_INT         REGMAP_ENCODE(ISL29125_SYNC, 1)
     
 // CONFIGURATION 2 REGISTER OPTIONS
 // Range for IR filter
-#define ISL29125_CONFIG2_IR_OFFSET_OFF       0x00  
-#define ISL29125_CONFIG2_IR_OFFSET_ON        0x80   
+#define ISL29125_CONFIG2_IR_OFFSET_OFF       REGMAP_ENCODE(ISL29125_IR_OFFSET, 0)  
+#define ISL29125_CONFIG2_IR_OFFSET_ON        REGMAP_ENCODE(ISL29125_IR_OFFSET, 1)   
 // Sets amount of IR filtering, can use these presets or any value between 0x00 and 0x3F
 // Consult datasheet for detailed IR filtering calibration
-#define ISL29125_CONFIG2_IR_ADJUST_LOW       0x00
-#define ISL29125_CONFIG2_IR_ADJUST_MID       0x20
-#define ISL29125_CONFIG2_IR_ADJUST_HIGH      0x3F
+#define ISL29125_CONFIG2_IR_ADJUST_LOW       REGMAP_ENCODE(ISL29125_IR_ADJUST, 0x00)
+#define ISL29125_CONFIG2_IR_ADJUST_MID       REGMAP_ENCODE(ISL29125_IR_ADJUST, 0x20)
+#define ISL29125_CONFIG2_IR_ADJUST_HIGH      REGMAP_ENCODE(ISL29125_IR_ADJUST, 0x3F)
     
 // CONFIGURATION 3 REGISTER OPTIONS
 // Chose what color fires an interupt
-#define ISL29125_CONFIG3_NO_INT              0x00
-#define ISL29125_CONFIG3_G_INT               0x01
-#define ISL29125_CONFIG3_R_INT               0x02
-#define ISL29125_CONFIG3_B_INT               0x03
+#define ISL29125_CONFIG3_NO_INT              REGMAP_ENCODE(ISL29125_INT_COLOR, 0)
+#define ISL29125_CONFIG3_G_INT               REGMAP_ENCODE(ISL29125_INT_COLOR, 1)
+#define ISL29125_CONFIG3_R_INT               REGMAP_ENCODE(ISL29125_INT_COLOR, 2)
+#define ISL29125_CONFIG3_B_INT               REGMAP_ENCODE(ISL29125_INT_COLOR, 3)
 
 // How many times a sensor sample must hit a threshold before triggering an interrupt
 // More consecutive samples means more times between interrupts, but less triggers from short transients
-#define ISL29125_CONFIG3_INT_1_TIME          0x00
-#define ISL29125_CONFIG3_INT_2_TIME          0x04
-#define ISL29125_CONFIG3_INT_4_TIME          0x08
-#define ISL29125_CONFIG3_INT_8_TIME          0x0C
+#define ISL29125_CONFIG3_INT_1_TIME          REGMAP_ENCODE(ISL29125_INT_PERSIST, 0)
+#define ISL29125_CONFIG3_INT_2_TIME          REGMAP_ENCODE(ISL29125_INT_PERSIST, 1)
+#define ISL29125_CONFIG3_INT_4_TIME          REGMAP_ENCODE(ISL29125_INT_PERSIST, 2)
+#define ISL29125_CONFIG3_INT_8_TIME          REGMAP_ENCODE(ISL29125_INT_PERSIST, 3)
 // Choose to have interrupt pin go low when a conversion is finished
-#define ISL29125_CONFIG3_DISABLE_INT_ON_CONVERSION   0x00
-#define ISL29125_CONFIG3_ENABLE_INT_ON_CONVERSION    0x10
+#define ISL29125_CONFIG3_DISABLE_INT_ON_CONVERSION   REGMAP_ENCODE(ISL29125_INT_ON_CONVERSION, 0)
+#define ISL29125_CONFIG3_ENABLE_INT_ON_CONVERSION    REGMAP_ENCODE(ISL29125_INT_ON_CONVERSION, 1)
+    
+// STATUS REGISTER FLAGS
+#define ISL29125_STATUS_THRESHOLD_INT        ISL29125_FLAG_INT_MASK
+#define ISL29125_STATUS_CONVERSION_DONE      ISL29125_FLAG_CONVERSION_DONE_MASK
+#define ISL29125_STATUS_BROWNOUT             ISL29125_FLAG_BROWNOUT_MASK
+#define ISL29125_STATUS_CONVERTING_MASK      ISL29125_FLAG_CONVERTING_MASK
+    
+// Which side of the threshold window the interrupt color went to
+#define ISL29125_EDGE_NONE                   0x00
+#define ISL29125_EDGE_ABOVE                  0x01
+#define ISL29125_EDGE_BELOW                  0x02
     
     
 /***************************************
 *        Function Prototypes
 ***************************************/     
 
-void isl29125_init(void);    
-void isl29125_start(void);
-void isl29125_sleep(void);
-void isl29125_stop(void);
-uint8 isl29125_read_id(void);
+void isl29125_init(ISL29125* device, SENSOR_BUS* bus, uint8 address);    
+void isl29125_init_begin(ISL29125* device, SENSOR_BUS* bus, uint8 address);
+bool isl29125_reset_begin(ISL29125* device);
+bool isl29125_config_begin(ISL29125* device, uint8 config1, uint8 config2, uint8 config3);
+bool isl29125_sample_begin(ISL29125* device, ISL29125_RGB* rgb);
+uint8 isl29125_poll(ISL29125* device);
+bool isl29125_warm_init(ISL29125* device, SENSOR_BUS* bus, uint8 address, uint8 slot);
+bool isl29125_save_config(ISL29125* device, uint8 slot);
+void isl29125_start(ISL29125* device);
+void isl29125_sleep(ISL29125* device);
+void isl29125_stop(ISL29125* device);
+uint8 isl29125_read_id(ISL29125* device);
+
+uint8 set_upper_threshold(ISL29125* device, uint16 level);
+uint8 set_lower_threshold(ISL29125* device, uint16 level);
+
+void isl29125_set_range(ISL29125* device, uint8 range);
+void set_adc_resolution(ISL29125* device, uint8 resolution);
+uint8 get_adc_resolution(ISL29125* device);
+void isl29125_set_auto_range(ISL29125* device, bool enable, uint16 precision);
+bool isl29125_auto_range(ISL29125* device, ISL29125_RGB* rgb);
+uint16 isl29125_conversion_time_ms(ISL29125* device);
+uint32 isl29125_normalize(uint32 counts, uint8 intensity_range, uint8 adc_resolution);
+void isl29125_normalize_rgb(const ISL29125_RGB* rgb, ISL29125_NORMALIZED_RGB* normalized);
 
-void set_upper_threshold(uint16 level);
-void set_lower_threshold(uint16 level);
+uint16 isl29125_read_red(ISL29125* device);
+uint16 isl29125_read_green(ISL29125* device);
+uint16 isl29125_read_blue(ISL29125* device);
+uint8 isl29125_read_rgb(ISL29125* device, ISL29125_RGB* rgb);
+bool isl29125_submit_rgb_read(ISL29125* device, SENSOR_TRANSACTION* transaction, 
+                              uint8* buffer);
+uint8 isl29125_finish_rgb_read(ISL29125* device, SENSOR_TRANSACTION* transaction, 
+                               ISL29125_RGB* rgb);
 
-void set_adc_resolution(uint8 resolution);
-void get_adc_resolution(uint8 resolution);
+uint8 isl29125_set_conversion_interrupt(ISL29125* device, bool enable);
+void isl29125_interrupt(ISL29125* device);
+bool isl29125_get_sample(ISL29125* device, ISL29125_RGB* rgb);
+void isl29125_set_sample_buffer(ISL29125* device, SAMPLE_BUFFER* buffer, uint8 device_id);
 
-uint16 isl29125_read_red(void);
-uint16 isl29125_read_green(void);
-uint16 isl29125_read_blue(void);
+uint8 isl29125_set_threshold_window(ISL29125* device, uint8 color, uint16 low, uint16 high, 
+                                    uint8 persistence, uint16 band);
+bool isl29125_get_threshold_event(ISL29125* device, ISL29125_THRESHOLD_EVENT* event);
 
 #endif
 /* [] END OF FILE */
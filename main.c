@@ -10,45 +10,147 @@
  * ========================================
 */
 #include "project.h"
-#include "stdio.h"
 
 // local files
 #include "isl29125.h"
 #include "tsl2561.h"
+#include "sample_buffer.h"
+#include "timebase.h"
+#include "filter.h"
+#include "display.h"
+#include "telemetry.h"
+#include "nv_store.h"
+#include "discovery.h"
 
 uint8 count = 0;
-char LCD_str[40];
 
-uint8 red;
-uint8 green;
-uint8 blue;
+SENSOR_BUS* const buses[] = {&sensor_psoc_bus};
+DISCOVERY_TABLE sensors;
+ISL29125* rgb_sensor = 0;
+
+SAMPLE_BUFFER samples;
+SAMPLE batch[SAMPLE_BUFFER_SIZE];
+FILTER rgb_filters[SAMPLE_NUM_CHANNELS];
+uint32 rgb_filtered[SAMPLE_NUM_CHANNELS];
+
+/******************************************************************************
+* Interrupt of the ISL29125_INT pin, set to trigger on the falling edge
+******************************************************************************/
+
+CY_ISR(isl29125_int_isr) {
+    ISL29125_INT_ClearInterrupt();
+    if (rgb_sensor) {
+        isl29125_interrupt(rgb_sensor);
+    }
+}
+
+/******************************************************************************
+* Start the drivers of the devices found, the first isl29125 fills the 
+* sample buffer from its conversion interrupt
+******************************************************************************/
+
+static void start_sensors(void) {
+    DISCOVERY_DEVICE* device;
+    uint8 num_tsl2561 = 0;
+    
+    for (uint8 i = 0; i < sensors.num_devices; i++) {
+        device = &sensors.devices[i];
+        if ((device->type == DISCOVERY_ISL29125) && !rgb_sensor) {
+            rgb_sensor = &device->driver.isl29125;
+            isl29125_warm_init(rgb_sensor, device->bus, device->address, NV_SLOT_ISL29125);
+            isl29125_set_sample_buffer(rgb_sensor, &samples, 0);
+            isl29125_set_conversion_interrupt(rgb_sensor, true);
+            isl29125_save_config(rgb_sensor, NV_SLOT_ISL29125);
+        }
+        else if (device->type == DISCOVERY_ISL29125) {
+            isl29125_init(&device->driver.isl29125, device->bus, device->address);
+        }
+        else if (num_tsl2561 < NV_SLOT_TSL2561_COUNT) {
+            tsl2561_warm_init(&device->driver.tsl2561, device->bus, device->address, 
+                              NV_SLOT_TSL2561 + num_tsl2561);
+            num_tsl2561++;
+        }
+        else {
+            tsl2561_Init(&device->driver.tsl2561, device->bus, device->address);
+        }
+    }
+}
 
 int main(void)
 {
     CyGlobalIntEnable; /* Enable global interrupts. */
 
     LCD_Start();
-    LCD_ClearDisplay();
+    display_start();
     I2C_Start();
-    LCD_Position(0, 0);
-    LCD_PrintString("Sensor");
+    display_print(0, 0, "Sensor");
+    display_update();
     
-    isl29125_init();
+    timebase_start();
+    telemetry_start();
+    sample_buffer_init(&samples);
+    // skip the reset and configuration of sensors that stayed powered
+    nv_store_start();
+    discovery_scan(&sensors, buses, sizeof(buses) / sizeof(buses[0]));
+    start_sensors();
+    if (!rgb_sensor) {
+        display_print(1, 0, "no rgb sensor");
+        display_update();
+    }
+    
+    // drop single sample spikes, then smooth
+    for (uint8 i = 0; i < SAMPLE_NUM_CHANNELS; i++) {
+        filter_init(&rgb_filters[i]);
+        filter_add_median(&rgb_filters[i], 5);
+        filter_add_iir(&rgb_filters[i], 3);
+    }
+
+    isr_ISL29125_StartEx(isl29125_int_isr);
 
     for(;;) {
-        CyDelay(1000);
-        LCD_ClearDisplay();
-        uint8 ID = tsl2561_read_id();
-        LCD_Position(0, 0);
-        sprintf(LCD_str, "id: 0x%02X", ID);
-        LCD_PrintString(LCD_str);
+        // move the I2C queue if the I2C interrupt callback is not used
+        sensor_service();
+        uint16 num_samples = sample_buffer_get(&samples, batch, SAMPLE_BUFFER_SIZE);
+        if (num_samples == 0) {
+            continue;
+        }
+        telemetry_send(batch, num_samples);
+        for (uint16 i = 0; i < num_samples; i++) {
+            for (uint8 j = 0; j < SAMPLE_NUM_CHANNELS; j++) {
+                rgb_filtered[j] = isl29125_normalize(batch[i].channel[j], 
+                    batch[i].setting & ISL29125_CONFIG1_10KLUX, 
+                    batch[i].setting & ISL29125_CONFIG1_ADC_12BIT);
+            }
+            filter_update_channels(rgb_filters, rgb_filtered, SAMPLE_NUM_CHANNELS);
+        }
+        // lux of the last tsl2561 in the table that answered
+        uint32 lux = 0;
+        bool have_lux = false;
+        for (uint8 i = 0; i < sensors.num_devices; i++) {
+            TSL2561_DATA lux_data;
+            if ((sensors.devices[i].type == DISCOVERY_TSL2561) && 
+                    (SENSOR_OK == tsl2561_read_data(&sensors.devices[i].driver.tsl2561, 
+                                                    &lux_data))) {
+                lux = lux_data.lux;
+                have_lux = true;
+            }
+        }
+        display_clear();
+        uint8 column = display_print(0, 0, "lux:");
+        if (have_lux) {
+            display_print_uint(0, column, lux);
+        }
+        else {
+            display_print(0, column, "-");
+        }
         
-        red = isl29125_read_red();
-        green = isl29125_read_green();
-        blue = isl29125_read_blue();
-        LCD_Position(1,0);
-        sprintf(LCD_str, "r:%i,g:%i,b:%i ", red, green, blue);
-        LCD_PrintString(LCD_str); 
+        column = display_print(1, 0, "r:");
+        column = display_print_uint(1, column, rgb_filtered[0]);
+        column = display_print(1, column, ",g:");
+        column = display_print_uint(1, column, rgb_filtered[1]);
+        column = display_print(1, column, ",b:");
+        display_print_uint(1, column, rgb_filtered[2]);
+        display_update();
     }
 }
 
@@ -10,42 +10,61 @@
  * ========================================
 */
 #include "project.h"
-#include "stdio.h"
 
 // local files
 #include "isl29125.h"
+#include "timebase.h"
+#include "display.h"
 
 uint8 count = 0;
-char LCD_str[40];
 
-uint8 red;
-uint8 green;
-uint8 blue;
+ISL29125 rgb_sensor;
+
+ISL29125_RGB rgb;
+
+/******************************************************************************
+* Interrupt of the ISL29125_INT pin, set to trigger on the falling edge
+******************************************************************************/
+
+CY_ISR(isl29125_int_isr) {
+    ISL29125_INT_ClearInterrupt();
+    isl29125_interrupt(&rgb_sensor);
+}
 
 int main(void)
 {
     CyGlobalIntEnable; /* Enable global interrupts. */
 
     LCD_Start();
-    LCD_ClearDisplay();
+    display_start();
     I2C_Start();
-    LCD_Position(0, 0);
-    LCD_PrintString("Sensor");
+    display_print(0, 0, "Sensor");
+    display_update();
+    
+    // the I2C timeouts count on the timebase
+    timebase_start();
+    isl29125_init(&rgb_sensor, 0, ISL29125_I2C_ADDRESS);
+    isl29125_set_conversion_interrupt(&rgb_sensor, true);
+    isr_ISL29125_StartEx(isl29125_int_isr);
 
     for(;;) {
-        CyDelay(1000);
-        LCD_ClearDisplay();
-        uint8 ID = isl29125_read_id();
-        LCD_Position(0, 0);
-        sprintf(LCD_str, "id: 0x%02X", ID);
-        LCD_PrintString(LCD_str);
+        // move the I2C queue if the I2C interrupt callback is not used
+        sensor_service();
+        if (!isl29125_get_sample(&rgb_sensor, &rgb)) {
+            continue;
+        }
+        uint8 ID = isl29125_read_id(&rgb_sensor);
+        display_clear();
+        uint8 column = display_print(0, 0, "id: 0x");
+        display_print_hex(0, column, ID, 2);
         
-        red = isl29125_read_red();
-        green = isl29125_read_green();
-        blue = isl29125_read_blue();
-        LCD_Position(1,0);
-        sprintf(LCD_str, "r:%i,g:%i,b:%i ", red, green, blue);
-        LCD_PrintString(LCD_str); 
+        column = display_print(1, 0, "r:");
+        column = display_print_uint(1, column, rgb.red);
+        column = display_print(1, column, ",g:");
+        column = display_print_uint(1, column, rgb.green);
+        column = display_print(1, column, ",b:");
+        display_print_uint(1, column, rgb.blue);
+        display_update();
     }
 }
 
@@ -0,0 +1,93 @@
+/* ========================================
+ *
+ * Copyright YOUR COMPANY, THE YEAR
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF your company.
+ *
+ * ========================================
+*/
+#include "project.h"
+
+// local files
+#include "isl29125.h"
+#include "tsl2561.h"
+#include "sample_buffer.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "display.h"
+#include "telemetry.h"
+
+// sample periods, the sensors and the MCU sleep in between
+#define RGB_PERIOD_MS       1000
+#define LUX_PERIOD_MS       2000
+
+#define RGB_DEVICE_ID       0
+#define LUX_DEVICE_ID       1
+
+ISL29125 rgb_sensor;
+TSL2561 lux_sensor;
+
+SAMPLE_BUFFER samples;
+SAMPLE batch[SAMPLE_BUFFER_SIZE];
+SCHEDULER scheduler;
+
+int main(void)
+{
+    CyGlobalIntEnable; /* Enable global interrupts. */
+
+    LCD_Start();
+    display_start();
+    I2C_Start();
+    display_print(0, 0, "Sensor");
+    display_update();
+    
+    timebase_start();
+    telemetry_start();
+    sample_buffer_init(&samples);
+    isl29125_init(&rgb_sensor, 0, ISL29125_I2C_ADDRESS);
+    tsl2561_Init(&lux_sensor, 0, I2C_ADDRESS_FLOAT);
+    // a 12 bit conversion keeps the isl29125 awake for 24 ms instead of 330 ms
+    set_adc_resolution(&rgb_sensor, ISL29125_CONFIG1_ADC_12BIT);
+    tsl2561_set_timing(&lux_sensor, TSL2561_INTEGRATION_101MS, TSL2561_GAIN_1X);
+    
+    scheduler_init(&scheduler, &samples);
+    scheduler_add(&scheduler, &scheduler_isl29125_ops, &rgb_sensor, RGB_DEVICE_ID, 
+                  RGB_PERIOD_MS, SCHEDULER_IDLE_POWERDOWN);
+    scheduler_add(&scheduler, &scheduler_tsl2561_ops, &lux_sensor, LUX_DEVICE_ID, 
+                  LUX_PERIOD_MS, SCHEDULER_IDLE_POWERDOWN);
+
+    for(;;) {
+        uint32 sleep_ms = scheduler_run(&scheduler);
+        uint16 num_samples = sample_buffer_get(&samples, batch, SAMPLE_BUFFER_SIZE);
+        if (num_samples != 0) {
+            telemetry_send(batch, num_samples);
+            // the rgb sensor on the top row, the lux sensor on the bottom row
+            for (uint16 i = 0; i < num_samples; i++) {
+                SAMPLE* sample = &batch[i];
+                if (sample->device == LUX_DEVICE_ID) {
+                    display_print(1, 0, "                ");
+                    uint8 column = display_print(1, 0, "lux:");
+                    display_print_uint(1, column, sample->channel[2]);
+                    continue;
+                }
+                display_print(0, 0, "                ");
+                uint8 column = display_print(0, 0, "r:");
+                column = display_print_uint(0, column, sample->channel[0]);
+                column = display_print(0, column, ",g:");
+                column = display_print_uint(0, column, sample->channel[1]);
+                column = display_print(0, column, ",b:");
+                display_print_uint(0, column, sample->channel[2]);
+            }
+            display_update();
+        }
+        // the UART DMA stops in sleep, let the frame finish first
+        if (!telemetry_busy()) {
+            scheduler_sleep(sleep_ms);
+        }
+    }
+}
+
+/* [] END OF FILE */
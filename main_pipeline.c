@@ -0,0 +1,88 @@
+/* ========================================
+ *
+ * Copyright YOUR COMPANY, THE YEAR
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF your company.
+ *
+ * ========================================
+*/
+#include "project.h"
+
+// local files
+#include "isl29125.h"
+#include "tsl2561.h"
+#include "sample_buffer.h"
+#include "discovery.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "display.h"
+#include "telemetry.h"
+
+SENSOR_BUS* const buses[] = {&sensor_psoc_bus};
+DISCOVERY_TABLE sensors;
+
+SAMPLE_BUFFER samples;
+SAMPLE batch[SAMPLE_BUFFER_SIZE];
+PIPELINE pipeline;
+uint32 num_samples_sent = 0;
+
+int main(void)
+{
+    CyGlobalIntEnable; /* Enable global interrupts. */
+
+    LCD_Start();
+    display_start();
+    I2C_Start();
+    display_print(0, 0, "Sensor");
+    display_update();
+
+    timebase_start();
+    telemetry_start();
+    sample_buffer_init(&samples);
+    pipeline_init(&pipeline, &samples);
+
+    // every sensor found converts all the time, the device id of its
+    // samples is its place in the table
+    discovery_scan(&sensors, buses, sizeof(buses) / sizeof(buses[0]));
+    for (uint8 i = 0; i < sensors.num_devices; i++) {
+        DISCOVERY_DEVICE* device = &sensors.devices[i];
+        if (device->type == DISCOVERY_ISL29125) {
+            isl29125_init(&device->driver.isl29125, device->bus, device->address);
+            set_adc_resolution(&device->driver.isl29125, ISL29125_CONFIG1_ADC_12BIT);
+            pipeline_add(&pipeline, &pipeline_isl29125_ops, &device->driver.isl29125, i);
+        }
+        else {
+            tsl2561_Init(&device->driver.tsl2561, device->bus, device->address);
+            tsl2561_set_timing(&device->driver.tsl2561, TSL2561_INTEGRATION_101MS,
+                               TSL2561_GAIN_1X);
+            pipeline_add(&pipeline, &pipeline_tsl2561_ops, &device->driver.tsl2561, i);
+        }
+    }
+    display_clear();
+    uint8 column = display_print(0, 0, "sensors:");
+    display_print_uint(0, column, sensors.num_devices);
+    display_update();
+    pipeline_start(&pipeline);
+
+    for(;;) {
+        uint32 sleep_ms = pipeline_run(&pipeline);
+        uint16 num_samples = sample_buffer_get(&samples, batch, SAMPLE_BUFFER_SIZE);
+        if (num_samples != 0) {
+            telemetry_send(batch, num_samples);
+            num_samples_sent += num_samples;
+            column = display_print(1, 0, "samples:");
+            display_print_uint(1, column, num_samples_sent);
+            display_update();
+        }
+        // the UART DMA stops in sleep, let the frame finish first
+        if (!telemetry_busy()) {
+            scheduler_sleep(sleep_ms);
+        }
+    }
+}
+
+/* [] END OF FILE */
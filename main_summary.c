@@ -0,0 +1,130 @@
+/* ========================================
+ *
+ * Copyright YOUR COMPANY, THE YEAR
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF your company.
+ *
+ * ========================================
+*/
+#include "project.h"
+
+// local files
+#include "isl29125.h"
+#include "tsl2561.h"
+#include "sample_buffer.h"
+#include "discovery.h"
+#include "pipeline.h"
+#include "summary.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "display.h"
+#include "telemetry.h"
+
+// Window lengths of the summaries, each a multiple of the last
+#define SUMMARY_SECOND_MS           1000
+#define SUMMARY_MINUTE_MS           60000
+#define SUMMARY_HOUR_MS             3600000
+
+SENSOR_BUS* const buses[] = {&sensor_psoc_bus};
+DISCOVERY_TABLE sensors;
+
+SAMPLE_BUFFER samples;
+SAMPLE batch[SAMPLE_BUFFER_SIZE];
+PIPELINE pipeline;
+SUMMARY summaries[DISCOVERY_MAX_DEVICES];
+uint32 num_records_sent = 0;
+
+// Records waiting for a free telemetry buffer, windows of all the sensors
+// can close at the same time and there are only two frame buffers
+#define OUTBOX_SIZE                 (DISCOVERY_MAX_DEVICES * SUMMARY_MAX_LEVELS)
+SUMMARY_RECORD outbox[OUTBOX_SIZE + SUMMARY_MAX_LEVELS];
+uint16 num_outbox = 0;
+
+void send_outbox(void) {
+    uint16 sent = telemetry_send_summaries(outbox, num_outbox);
+    num_outbox -= sent;
+    for (uint16 i = 0; i < num_outbox; i++) {
+        outbox[i] = outbox[sent + i];
+    }
+    num_records_sent += sent;
+}
+
+// drop the records that do not fit, the outbox only fills up if the UART stops
+void make_room(void) {
+    if (num_outbox > OUTBOX_SIZE) {
+        num_outbox = OUTBOX_SIZE;
+    }
+}
+
+int main(void)
+{
+    CyGlobalIntEnable; /* Enable global interrupts. */
+
+    LCD_Start();
+    display_start();
+    I2C_Start();
+    display_print(0, 0, "Sensor");
+    display_update();
+
+    timebase_start();
+    telemetry_start();
+    sample_buffer_init(&samples);
+    pipeline_init(&pipeline, &samples);
+
+    // every sensor found converts all the time and only the summaries of
+    // its samples are sent, the device id is its place in the table
+    discovery_scan(&sensors, buses, sizeof(buses) / sizeof(buses[0]));
+    for (uint8 i = 0; i < sensors.num_devices; i++) {
+        DISCOVERY_DEVICE* device = &sensors.devices[i];
+        if (device->type == DISCOVERY_ISL29125) {
+            isl29125_init(&device->driver.isl29125, device->bus, device->address);
+            set_adc_resolution(&device->driver.isl29125, ISL29125_CONFIG1_ADC_12BIT);
+            pipeline_add(&pipeline, &pipeline_isl29125_ops, &device->driver.isl29125, i);
+        }
+        else {
+            tsl2561_Init(&device->driver.tsl2561, device->bus, device->address);
+            tsl2561_set_timing(&device->driver.tsl2561, TSL2561_INTEGRATION_101MS,
+                               TSL2561_GAIN_1X);
+            pipeline_add(&pipeline, &pipeline_tsl2561_ops, &device->driver.tsl2561, i);
+        }
+        summary_init(&summaries[i], i);
+        summary_add_level(&summaries[i], SUMMARY_SECOND_MS);
+        summary_add_level(&summaries[i], SUMMARY_MINUTE_MS);
+        summary_add_level(&summaries[i], SUMMARY_HOUR_MS);
+    }
+    display_clear();
+    uint8 column = display_print(0, 0, "sensors:");
+    display_print_uint(0, column, sensors.num_devices);
+    display_update();
+    pipeline_start(&pipeline);
+
+    for(;;) {
+        uint32 sleep_ms = pipeline_run(&pipeline);
+        uint16 num_samples = sample_buffer_get(&samples, batch, SAMPLE_BUFFER_SIZE);
+        for (uint16 i = 0; i < num_samples; i++) {
+            num_outbox += summary_update(&summaries[batch[i].device], &batch[i], 
+                                         &outbox[num_outbox]);
+            make_room();
+        }
+        // close the windows of sensors that stopped giving samples
+        for (uint8 i = 0; i < sensors.num_devices; i++) {
+            num_outbox += summary_tick(&summaries[i], timebase_ms(), &outbox[num_outbox]);
+            make_room();
+        }
+        if (num_outbox != 0) {
+            send_outbox();
+            column = display_print(1, 0, "windows:");
+            display_print_uint(1, column, num_records_sent);
+            display_update();
+        }
+        // the UART DMA stops in sleep, let the frame finish first
+        if (!telemetry_busy()) {
+            scheduler_sleep(sleep_ms);
+        }
+    }
+}
+
+/* [] END OF FILE */
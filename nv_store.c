@@ -0,0 +1,206 @@
+/*******************************************************************************
+ * File Name: nv_store.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the nonvolatile records.  On the
+ *  PSoC the records are rows of the EEPROM component with the name 
+ *  EEPROM, host builds keep them in memory for the life of the process.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "nv_store.h"
+
+// CRC-8 polynomial x^8 + x^2 + x + 1
+#define CHECK_POLYNOMIAL            0x07
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static uint8 check_byte(const uint8* row, uint8 num_bytes);
+static uint8 row_read(uint8 slot, uint8 index);
+static bool row_write(uint8 slot, const uint8* row);
+
+#if defined(SENSOR_HOST_BUILD)
+static uint8 nv_memory[NV_STORE_NUM_SLOTS][NV_STORE_ROW_SIZE];
+#endif
+
+/******************************************************************************
+* Function Name: nv_store_start
+*******************************************************************************
+*
+* Summary:
+*  Power up the EEPROM so records can be written
+*
+*******************************************************************************/
+
+void nv_store_start(void) {
+#if !defined(SENSOR_HOST_BUILD)
+    EEPROM_Start();
+#endif
+}
+
+/******************************************************************************
+* Function Name: nv_store_read
+*******************************************************************************
+*
+* Summary:
+*  Get the data of a record, if the slot holds a valid record of this 
+*  length
+*
+* Parameters:
+*  uint8 slot: record to read, 0 to NV_STORE_NUM_SLOTS - 1
+*  uint8* data: where to put the data
+*  uint8 num_bytes: length of the data, up to NV_STORE_MAX_DATA
+*
+* Return:
+*  bool: true if the record was valid and data was filled
+*
+*******************************************************************************/
+
+bool nv_store_read(uint8 slot, uint8* data, uint8 num_bytes) {
+    uint8 row[NV_STORE_ROW_SIZE];
+    uint8 length = NV_STORE_HEADER_SIZE + num_bytes;
+    uint8 i;
+    
+    if ((slot >= NV_STORE_NUM_SLOTS) || (num_bytes > NV_STORE_MAX_DATA)) {
+        return false;
+    }
+    for (i = 0; i <= length; i++) {
+        row[i] = row_read(slot, i);
+    }
+    if ((row[0] != NV_STORE_SIGNATURE) || (row[1] != NV_STORE_VERSION) || 
+            (row[2] != num_bytes) || (row[length] != check_byte(row, length))) {
+        return false;
+    }
+    for (i = 0; i < num_bytes; i++) {
+        data[i] = row[NV_STORE_HEADER_SIZE + i];
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: nv_store_write
+*******************************************************************************
+*
+* Summary:
+*  Save data as the record of a slot.  The row is only written if it does
+*  not already hold the same record, to spare the EEPROM.  Takes a few 
+*  milliseconds on the PSoC while the row is programmed.
+*
+* Parameters:
+*  uint8 slot: record to write, 0 to NV_STORE_NUM_SLOTS - 1
+*  const uint8* data: data to save
+*  uint8 num_bytes: length of the data, up to NV_STORE_MAX_DATA
+*
+* Return:
+*  bool: true if the slot holds the record
+*
+*******************************************************************************/
+
+bool nv_store_write(uint8 slot, const uint8* data, uint8 num_bytes) {
+    uint8 row[NV_STORE_ROW_SIZE] = {0};
+    uint8 length = NV_STORE_HEADER_SIZE + num_bytes;
+    uint8 i;
+    
+    if ((slot >= NV_STORE_NUM_SLOTS) || (num_bytes > NV_STORE_MAX_DATA)) {
+        return false;
+    }
+    row[0] = NV_STORE_SIGNATURE;
+    row[1] = NV_STORE_VERSION;
+    row[2] = num_bytes;
+    for (i = 0; i < num_bytes; i++) {
+        row[NV_STORE_HEADER_SIZE + i] = data[i];
+    }
+    row[length] = check_byte(row, length);
+    
+    for (i = 0; i < NV_STORE_ROW_SIZE; i++) {
+        if (row[i] != row_read(slot, i)) {
+            return row_write(slot, row);
+        }
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: nv_store_erase
+*******************************************************************************
+*
+* Summary:
+*  Make the record of a slot invalid, e.g. to force a cold start
+*
+* Parameters:
+*  uint8 slot: record to erase
+*
+*******************************************************************************/
+
+void nv_store_erase(uint8 slot) {
+    uint8 row[NV_STORE_ROW_SIZE] = {0};
+    
+    if (slot < NV_STORE_NUM_SLOTS) {
+        row_write(slot, row);
+    }
+}
+
+/******************************************************************************
+* Function Name: check_byte
+*******************************************************************************
+*
+* Return:
+*  uint8: CRC-8 of the first num_bytes of a row
+*
+*******************************************************************************/
+
+static uint8 check_byte(const uint8* row, uint8 num_bytes) {
+    uint8 crc = 0xFF;
+    uint8 i;
+    uint8 bit;
+    
+    for (i = 0; i < num_bytes; i++) {
+        crc ^= row[i];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8) ((crc << 1) ^ CHECK_POLYNOMIAL) : (uint8) (crc << 1);
+        }
+    }
+    return crc;
+}
+
+#if defined(SENSOR_HOST_BUILD)
+
+static uint8 row_read(uint8 slot, uint8 index) {
+    return nv_memory[slot][index];
+}
+
+static bool row_write(uint8 slot, const uint8* row) {
+    uint8 i;
+    for (i = 0; i < NV_STORE_ROW_SIZE; i++) {
+        nv_memory[slot][i] = row[i];
+    }
+    return true;
+}
+
+#else
+
+// the EEPROM is mapped in memory, reading needs no component call
+static uint8 row_read(uint8 slot, uint8 index) {
+    return CY_GET_REG8(CYDEV_EE_BASE + (uint32) slot * CYDEV_EEPROM_ROW_SIZE + index);
+}
+
+static bool row_write(uint8 slot, const uint8* row) {
+    return (CYRET_SUCCESS == EEPROM_Write(row, slot));
+}
+
+#endif
+
+/* [] END OF FILE */
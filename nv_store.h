@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * File Name: nv_store.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides small records kept in nonvolatile memory over a 
+ *  restart, one per EEPROM row.  Each record has a signature and a check 
+ *  byte so an erased or half written row is never taken as valid.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_NV_STORE_H)
+#define _NV_STORE_H
+    
+#include "platform.h"
+#include "stdbool.h"
+    
+/***************************************
+*      Store constants
+***************************************/ 
+
+// One record per EEPROM row of the PSoC 5LP
+#define NV_STORE_ROW_SIZE           16
+#define NV_STORE_NUM_SLOTS          8
+    
+// Record layout: signature, version, length, data, check byte
+#define NV_STORE_SIGNATURE          0x5E
+#define NV_STORE_VERSION            0x01
+#define NV_STORE_HEADER_SIZE        3
+#define NV_STORE_MAX_DATA           (NV_STORE_ROW_SIZE - NV_STORE_HEADER_SIZE - 1)
+    
+// Slots used by the drivers' warm start, a tsl2561 at each of its 3 
+// addresses can have its own, NV_SLOT_TSL2561 + n
+#define NV_SLOT_ISL29125            0
+#define NV_SLOT_TSL2561             1
+#define NV_SLOT_TSL2561_COUNT       3
+  
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void nv_store_start(void);
+bool nv_store_read(uint8 slot, uint8* data, uint8 num_bytes);
+bool nv_store_write(uint8 slot, const uint8* data, uint8 num_bytes);
+void nv_store_erase(uint8 slot);
+
+#endif
+
+/* [] END OF FILE */
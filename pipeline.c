@@ -0,0 +1,362 @@
+/*******************************************************************************
+ * File Name: pipeline.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the conversion pipeline.  All
+ *  the sensors are started together and keep converting, so their
+ *  integration times overlap instead of adding up.  Each sensor's next
+ *  result is expected one conversion time, from its current settings,
+ *  after the last one.  The reads of the results that are ready are
+ *  queued earliest first and the pipeline returns without waiting for
+ *  them, so the transfers of one sensor go on the bus while the others
+ *  are still integrating.  With enough sensors the sample rate is set by
+ *  the bus, not by the sum of the conversion times.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "pipeline.h"
+#include "timebase.h"
+
+// Time difference that is negative when a is before b, safe across the wrap
+#define TIME_BEFORE(a, b)           ((int32) ((a) - (b)) < 0)
+
+/***************************************
+*      Static Function Prototypes
+***************************************/
+
+static void finish_reads(PIPELINE* pipeline, uint32 now);
+static void submit_reads(PIPELINE* pipeline, uint32 now);
+static void next_result(PIPELINE_SENSOR* sensor, uint32 now);
+
+static void isl29125_start_converting(void* device);
+static uint16 isl29125_conversion_ms(void* device);
+static SENSOR_BUS* isl29125_bus(void* device);
+static bool isl29125_submit(void* device, SENSOR_TRANSACTION* transaction, uint8* buffer);
+static bool isl29125_finish(void* device, SENSOR_TRANSACTION* transaction, SAMPLE* sample);
+
+static void tsl2561_start_converting(void* device);
+static uint16 tsl2561_conversion_ms(void* device);
+static SENSOR_BUS* tsl2561_bus(void* device);
+static bool tsl2561_submit(void* device, SENSOR_TRANSACTION* transaction, uint8* buffer);
+static bool tsl2561_finish(void* device, SENSOR_TRANSACTION* transaction, SAMPLE* sample);
+
+const PIPELINE_SENSOR_OPS pipeline_isl29125_ops = {
+    isl29125_start_converting,
+    isl29125_conversion_ms,
+    isl29125_bus,
+    isl29125_submit,
+    isl29125_finish
+};
+
+const PIPELINE_SENSOR_OPS pipeline_tsl2561_ops = {
+    tsl2561_start_converting,
+    tsl2561_conversion_ms,
+    tsl2561_bus,
+    tsl2561_submit,
+    tsl2561_finish
+};
+
+/******************************************************************************
+* Function Name: pipeline_init
+*******************************************************************************
+*
+* Summary:
+*  Make a pipeline with no sensors
+*
+* Parameters:
+*  PIPELINE* pipeline: pipeline to set up
+*  SAMPLE_BUFFER* samples: buffer to put the samples of every sensor in
+*
+*******************************************************************************/
+
+void pipeline_init(PIPELINE* pipeline, SAMPLE_BUFFER* samples) {
+    pipeline->num_sensors = 0;
+    pipeline->samples = samples;
+    pipeline->missed = 0;
+}
+
+/******************************************************************************
+* Function Name: pipeline_add
+*******************************************************************************
+*
+* Summary:
+*  Add a sensor to the pipeline.  The sensor has to be initialized and
+*  should not use its conversion interrupt.
+*
+* Parameters:
+*  PIPELINE* pipeline: pipeline to add to
+*  const PIPELINE_SENSOR_OPS* ops: pipeline_isl29125_ops or pipeline_tsl2561_ops
+*  void* device: ISL29125* or TSL2561* of the sensor
+*  uint8 device_id: put in the device field of its samples
+*
+* Return:
+*  bool: true if the sensor was added, false if there is no room
+*
+*******************************************************************************/
+
+bool pipeline_add(PIPELINE* pipeline, const PIPELINE_SENSOR_OPS* ops, void* device,
+                  uint8 device_id) {
+    PIPELINE_SENSOR* sensor;
+    SENSOR_TRANSACTION empty_transaction = {0};
+
+    if (pipeline->num_sensors >= PIPELINE_MAX_SENSORS) {
+        return false;
+    }
+    sensor = &pipeline->sensors[pipeline->num_sensors];
+    sensor->ops = ops;
+    sensor->device = device;
+    sensor->device_id = device_id;
+    sensor->state = PIPELINE_CONVERTING;
+    sensor->ready_ms = timebase_ms();
+    sensor->transaction = empty_transaction;
+    pipeline->num_sensors++;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: pipeline_start
+*******************************************************************************
+*
+* Summary:
+*  Start the conversions of every sensor, one after the other with no
+*  wait in between, and work out when each first result is ready
+*
+* Parameters:
+*  PIPELINE* pipeline: pipeline to start
+*
+*******************************************************************************/
+
+void pipeline_start(PIPELINE* pipeline) {
+    PIPELINE_SENSOR* sensor;
+    uint8 i;
+
+    for (i = 0; i < pipeline->num_sensors; i++) {
+        sensor = &pipeline->sensors[i];
+        sensor->ops->start(sensor->device);
+        sensor->state = PIPELINE_CONVERTING;
+        sensor->ready_ms = timebase_ms() + sensor->ops->conversion_ms(sensor->device);
+    }
+}
+
+/******************************************************************************
+* Function Name: pipeline_run
+*******************************************************************************
+*
+* Summary:
+*  Move the buses of the sensors forward, put the results of the reads
+*  that are done in the sample buffer and queue the reads of the results
+*  that are ready.  Never waits on a bus.  Call in the main loop.
+*
+* Parameters:
+*  PIPELINE* pipeline: pipeline to run
+*
+* Return:
+*  uint32: milliseconds until the next result is ready, 0 while reads
+*          are still on a bus
+*
+*******************************************************************************/
+
+uint32 pipeline_run(PIPELINE* pipeline) {
+    PIPELINE_SENSOR* sensor;
+    uint32 now = timebase_ms();
+    uint32 next = now + 0x7FFFFFFF;
+    uint8 i;
+
+    for (i = 0; i < pipeline->num_sensors; i++) {
+        sensor = &pipeline->sensors[i];
+        sensor_bus_service(sensor->ops->bus(sensor->device));
+    }
+    finish_reads(pipeline, now);
+    submit_reads(pipeline, now);
+
+    for (i = 0; i < pipeline->num_sensors; i++) {
+        sensor = &pipeline->sensors[i];
+        if (sensor->state == PIPELINE_READING) {
+            return 0;
+        }
+        if (TIME_BEFORE(sensor->ready_ms, next)) {
+            next = sensor->ready_ms;
+        }
+    }
+    if (TIME_BEFORE(next, now)) {
+        return 0;
+    }
+    return next - now;
+}
+
+/******************************************************************************
+* Function Name: finish_reads
+*******************************************************************************
+*
+* Summary:
+*  Put the results of the reads that are done in the sample buffer, and
+*  set when the next result of their sensors is ready
+*
+*******************************************************************************/
+
+static void finish_reads(PIPELINE* pipeline, uint32 now) {
+    PIPELINE_SENSOR* sensor;
+    SAMPLE sample;
+    uint8 i;
+
+    for (i = 0; i < pipeline->num_sensors; i++) {
+        sensor = &pipeline->sensors[i];
+        if ((sensor->state != PIPELINE_READING) ||
+                (sensor->transaction.state != SENSOR_XFER_DONE)) {
+            continue;
+        }
+        if (sensor->ops->finish_read(sensor->device, &sensor->transaction, &sample)) {
+            sample.timestamp = sensor->ready_ms;
+            sample.device = sensor->device_id;
+            sample_buffer_put(pipeline->samples, &sample);
+        }
+        else {
+            pipeline->missed++;
+        }
+        next_result(sensor, now);
+    }
+}
+
+/******************************************************************************
+* Function Name: submit_reads
+*******************************************************************************
+*
+* Summary:
+*  Queue the reads of the results that are ready, the one that has been
+*  ready longest first, so each bus reads its sensors in the order their
+*  results came in.  A read that can not be queued, e.g. of a sensor that
+*  is backing off, is counted as missed and its sensor waits for its
+*  next result.
+*
+*******************************************************************************/
+
+static void submit_reads(PIPELINE* pipeline, uint32 now) {
+    PIPELINE_SENSOR* sensor;
+    PIPELINE_SENSOR* earliest;
+    uint8 i;
+
+    for (;;) {
+        earliest = 0;
+        for (i = 0; i < pipeline->num_sensors; i++) {
+            sensor = &pipeline->sensors[i];
+            if ((sensor->state == PIPELINE_CONVERTING) &&
+                    !TIME_BEFORE(now, sensor->ready_ms) &&
+                    (!earliest || TIME_BEFORE(sensor->ready_ms, earliest->ready_ms))) {
+                earliest = sensor;
+            }
+        }
+        if (!earliest) {
+            return;
+        }
+        if (earliest->ops->submit_read(earliest->device, &earliest->transaction,
+                                       earliest->buffer)) {
+            earliest->state = PIPELINE_READING;
+        }
+        else {
+            pipeline->missed++;
+            next_result(earliest, now);
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: next_result
+*******************************************************************************
+*
+* Summary:
+*  Set when the next result of a sensor is ready, one conversion time with
+*  its current settings after the last one.  If the pipeline fell behind
+*  by more than that the newest result is read as soon as possible.
+*
+*******************************************************************************/
+
+static void next_result(PIPELINE_SENSOR* sensor, uint32 now) {
+    sensor->state = PIPELINE_CONVERTING;
+    sensor->ready_ms += sensor->ops->conversion_ms(sensor->device);
+    if (TIME_BEFORE(sensor->ready_ms, now)) {
+        sensor->ready_ms = now;
+    }
+}
+
+/***************************************
+*      ISL29125 operations
+***************************************/
+
+static void isl29125_start_converting(void* device) {
+    isl29125_start((ISL29125*) device);
+}
+
+static uint16 isl29125_conversion_ms(void* device) {
+    return isl29125_conversion_time_ms((ISL29125*) device);
+}
+
+static SENSOR_BUS* isl29125_bus(void* device) {
+    return ((ISL29125*) device)->bus;
+}
+
+static bool isl29125_submit(void* device, SENSOR_TRANSACTION* transaction, uint8* buffer) {
+    return isl29125_submit_rgb_read((ISL29125*) device, transaction, buffer);
+}
+
+static bool isl29125_finish(void* device, SENSOR_TRANSACTION* transaction, SAMPLE* sample) {
+    ISL29125_RGB rgb;
+
+    if (SENSOR_OK != isl29125_finish_rgb_read((ISL29125*) device, transaction, &rgb)) {
+        return false;
+    }
+    sample->status = rgb.status;
+    sample->setting = rgb.intensity_range | rgb.adc_resolution;
+    sample->channel[0] = rgb.red;
+    sample->channel[1] = rgb.green;
+    sample->channel[2] = rgb.blue;
+    return true;
+}
+
+/***************************************
+*      TSL2561 operations
+***************************************/
+
+static void tsl2561_start_converting(void* device) {
+    tsl2561_Start((TSL2561*) device);
+}
+
+static uint16 tsl2561_conversion_ms(void* device) {
+    return tsl2561_conversion_time_ms((TSL2561*) device);
+}
+
+static SENSOR_BUS* tsl2561_bus(void* device) {
+    return ((TSL2561*) device)->bus;
+}
+
+static bool tsl2561_submit(void* device, SENSOR_TRANSACTION* transaction, uint8* buffer) {
+    return tsl2561_submit_data_read((TSL2561*) device, transaction, buffer);
+}
+
+// channels are channel 0, channel 1 and the lux, which stops at 0xFFFF
+static bool tsl2561_finish(void* device, SENSOR_TRANSACTION* transaction, SAMPLE* sample) {
+    TSL2561* tsl2561 = (TSL2561*) device;
+    TSL2561_DATA data;
+
+    if (SENSOR_OK != tsl2561_finish_data_read(tsl2561, transaction, &data)) {
+        return false;
+    }
+    sample->status = 0;
+    sample->setting = tsl2561->integration_time | tsl2561->_gain;
+    sample->channel[0] = data.channel0;
+    sample->channel[1] = data.channel1;
+    sample->channel[2] = (data.lux > 0xFFFF) ? 0xFFFF : data.lux;
+    return true;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * File Name: pipeline.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the conversion pipeline, that keeps many sensors
+ *  converting at the same time and reads each one when its result is
+ *  ready, without waiting on the bus.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_PIPELINE_H)
+#define _PIPELINE_H
+
+#include "platform.h"
+#include "stdbool.h"
+#include "sensor.h"
+#include "sample_buffer.h"
+#include "isl29125.h"
+#include "tsl2561.h"
+
+/***************************************
+*      Pipeline constants
+***************************************/
+
+#define PIPELINE_MAX_SENSORS        8
+// Largest read of a result, the isl29125 status and color registers
+#define PIPELINE_READ_SIZE          ISL29125_RGB_READ_LENGTH
+
+// Sensor states
+#define PIPELINE_CONVERTING         0   // result ready at ready_ms
+#define PIPELINE_READING            1   // read of the result queued
+
+/***************************************
+*      Structures
+***************************************/
+
+// How the pipeline drives one kind of sensor.  start begins continuous
+// conversions, submit_read queues the read of a result without waiting
+// and returns false if it could not, finish_read puts the result of the
+// done read in a sample and returns false if the read failed.
+typedef struct {
+    void (*start)(void* device);
+    uint16 (*conversion_ms)(void* device);
+    SENSOR_BUS* (*bus)(void* device);
+    bool (*submit_read)(void* device, SENSOR_TRANSACTION* transaction, uint8* buffer);
+    bool (*finish_read)(void* device, SENSOR_TRANSACTION* transaction, SAMPLE* sample);
+} PIPELINE_SENSOR_OPS;
+
+typedef struct {
+    const PIPELINE_SENSOR_OPS*  ops;
+    void*               device;
+    uint8               device_id;      // device field of its samples
+    uint8               state;
+    uint32              ready_ms;       // when the conversion in progress is done
+    SENSOR_TRANSACTION  transaction;
+    uint8               buffer[PIPELINE_READ_SIZE];
+} PIPELINE_SENSOR;
+
+typedef struct {
+    PIPELINE_SENSOR     sensors[PIPELINE_MAX_SENSORS];
+    uint8               num_sensors;
+    SAMPLE_BUFFER*      samples;
+    uint32              missed;     // results whose read failed or was not queued
+} PIPELINE;
+
+extern const PIPELINE_SENSOR_OPS pipeline_isl29125_ops;
+extern const PIPELINE_SENSOR_OPS pipeline_tsl2561_ops;
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void pipeline_init(PIPELINE* pipeline, SAMPLE_BUFFER* samples);
+bool pipeline_add(PIPELINE* pipeline, const PIPELINE_SENSOR_OPS* ops, void* device,
+                  uint8 device_id);
+void pipeline_start(PIPELINE* pipeline);
+uint32 pipeline_run(PIPELINE* pipeline);
+
+#endif
+
+/* [] END OF FILE */
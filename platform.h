@@ -0,0 +1,53 @@
+/*******************************************************************************
+ * File Name: platform.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file selects the PSoC project header, or the types and functions 
+ *  the drivers need when SENSOR_HOST_BUILD is defined to build them on a PC.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_PLATFORM_H)
+#define _PLATFORM_H
+    
+#if defined(SENSOR_HOST_BUILD)
+    
+#include <stdint.h>
+    
+typedef uint8_t     uint8;
+typedef uint16_t    uint16;
+typedef uint32_t    uint32;
+typedef uint64_t    uint64;
+typedef int8_t      int8;
+typedef int16_t     int16;
+typedef int32_t     int32;
+typedef int64_t     int64;
+
+// The host backends have no interrupts, each bus is used by one thread
+#define CyEnterCriticalSection()        (0u)
+#define CyExitCriticalSection(state)    ((void)(state))
+#define SENSOR_IN_INTERRUPT()           (0)
+    
+#else
+    
+#include <project.h>
+
+// The IPSR holds the exception number of the running handler, 0 in thread mode
+#define SENSOR_IN_INTERRUPT()           (__get_IPSR() != 0u)
+    
+#endif
+
+#endif
+
+/* [] END OF FILE */
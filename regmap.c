@@ -0,0 +1,322 @@
+/*******************************************************************************
+ * File Name: regmap.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the register map engine shared by
+ *  the sensor drivers: register access with the command bits of the
+ *  device, decoding of multi-byte registers and the shadow of the
+ *  writable registers.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "regmap.h"
+
+#define SHADOW_ALL_DIRTY(shadow)    ((uint8) ((1 << (shadow)->length) - 1))
+
+/******************************************************************************
+* Function Name: regmap_width
+*******************************************************************************
+*
+* Parameters:
+*  const REGMAP* map: register map of the device
+*  uint8 _register: address of the register
+*
+* Return:
+*  uint8: bytes of the register, or 0 if the map does not have it
+*
+*******************************************************************************/
+
+uint8 regmap_width(const REGMAP* map, uint8 _register) {
+    uint8 i;
+    for (i = 0; i < map->num_registers; i++) {
+        if (map->registers[i].address == _register) {
+            return map->registers[i].width;
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: regmap_value
+*******************************************************************************
+*
+* Summary:
+*  Put together the value of a register from the bytes read from it,
+*  low byte first.  The width is looked up in the register table, use
+*  REGMAP_VALUE for a register known when the code is compiled.
+*
+* Parameters:
+*  const REGMAP* map: register map of the device
+*  uint8 _register: address of the register
+*  const uint8* buffer: bytes read starting at the register
+*
+* Return:
+*  uint32: value of the register
+*
+*******************************************************************************/
+
+uint32 regmap_value(const REGMAP* map, uint8 _register, const uint8* buffer) {
+    uint8 width = regmap_width(map, _register);
+    uint32 value = 0;
+
+    while (width) {
+        width--;
+        value = (value << 8) | buffer[width];
+    }
+    return value;
+}
+
+/******************************************************************************
+* Function Name: regmap_write
+*******************************************************************************
+*
+* Summary:
+*  Write registers of a device and wait for it to finish.  The command
+*  bits of the device are added to the register address in buffer[0].
+*
+* Parameters:
+*  const REGMAP* map: register map of the device
+*  SENSOR_BUS* bus: bus the device is on
+*  uint8 address: I2C address of the device
+*  uint8* buffer: register address followed by the data
+*  uint8 num_bytes: number of bytes to send, with the register address
+*
+* Return:
+*  uint8: SENSOR_OK or a SENSOR_ERR_* code
+*
+*******************************************************************************/
+
+uint8 regmap_write(const REGMAP* map, SENSOR_BUS* bus, uint8 address, uint8* buffer,
+                   uint8 num_bytes) {
+    buffer[0] |= map->command;
+    return sensor_bus_write_n(bus, address, buffer, num_bytes);
+}
+
+/******************************************************************************
+* Function Name: regmap_read
+*******************************************************************************
+*
+* Summary:
+*  Read registers of a device, starting at _register, and wait for them
+*
+* Parameters:
+*  const REGMAP* map: register map of the device
+*  SENSOR_BUS* bus: bus the device is on
+*  uint8 address: I2C address of the device
+*  uint8* buffer: where to put the data read
+*  uint8 _register: first register to read
+*  uint8 num_bytes: number of bytes to read
+*
+* Return:
+*  uint8: SENSOR_OK or a SENSOR_ERR_* code
+*
+*******************************************************************************/
+
+uint8 regmap_read(const REGMAP* map, SENSOR_BUS* bus, uint8 address, uint8* buffer,
+                  uint8 _register, uint8 num_bytes) {
+    return sensor_bus_read_n(bus, address, buffer, map->command | _register, num_bytes);
+}
+
+/******************************************************************************
+* Function Name: regmap_shadow_init
+*******************************************************************************
+*
+* Summary:
+*  Set up the shadow of a block of registers that hold their reset value
+*
+* Parameters:
+*  REGMAP_SHADOW* shadow: shadow to set up
+*  uint8 first: address of the first register of the block
+*  uint8 length: number of registers, up to REGMAP_SHADOW_SIZE
+*  uint8 reset_value: value of the registers after a reset
+*
+*******************************************************************************/
+
+void regmap_shadow_init(REGMAP_SHADOW* shadow, uint8 first, uint8 length, uint8 reset_value) {
+    uint8 i;
+
+    shadow->first = first;
+    shadow->length = length;
+    for (i = 0; i < length; i++) {
+        shadow->value[i] = reset_value;
+        shadow->device[i] = reset_value;
+    }
+    shadow->dirty = 0x00;
+}
+
+/******************************************************************************
+* Function Name: regmap_shadow_invalidate
+*******************************************************************************
+*
+* Summary:
+*  Forget what the device holds, so every register is written on the next
+*  flush.  Used when the device could have lost power or missed a write.
+*
+*******************************************************************************/
+
+void regmap_shadow_invalidate(REGMAP_SHADOW* shadow) {
+    shadow->dirty = SHADOW_ALL_DIRTY(shadow);
+}
+
+/******************************************************************************
+* Function Name: regmap_shadow_write
+*******************************************************************************
+*
+* Summary:
+*  Put a value in the shadow of a register and mark the register dirty if
+*  it differs from what the device holds.  Nothing is sent to the device.
+*
+* Parameters:
+*  REGMAP_SHADOW* shadow: shadow of the block the register is in
+*  uint8 _register: address of the register
+*  uint8 value: value the register should hold
+*
+*******************************************************************************/
+
+void regmap_shadow_write(REGMAP_SHADOW* shadow, uint8 _register, uint8 value) {
+    uint8 index = _register - shadow->first;
+    shadow->value[index] = value;
+    if (value != shadow->device[index]) {
+        shadow->dirty |= (1 << index);
+    }
+}
+
+/******************************************************************************
+* Function Name: regmap_shadow_update
+*******************************************************************************
+*
+* Summary:
+*  Change only the bits of mask in the shadow of a register, e.g. one
+*  field with its _MASK and REGMAP_ENCODE value
+*
+* Parameters:
+*  REGMAP_SHADOW* shadow: shadow of the block the register is in
+*  uint8 _register: address of the register
+*  uint8 mask: bits to change
+*  uint8 bits: new value of those bits
+*
+*******************************************************************************/
+
+void regmap_shadow_update(REGMAP_SHADOW* shadow, uint8 _register, uint8 mask, uint8 bits) {
+    uint8 value = shadow->value[_register - shadow->first];
+    regmap_shadow_write(shadow, _register, (value & ~mask) | (bits & mask));
+}
+
+/******************************************************************************
+* Function Name: regmap_shadow_read
+*******************************************************************************
+*
+* Return:
+*  uint8: value the register should hold
+*
+*******************************************************************************/
+
+uint8 regmap_shadow_read(REGMAP_SHADOW* shadow, uint8 _register) {
+    return shadow->value[_register - shadow->first];
+}
+
+/******************************************************************************
+* Function Name: regmap_shadow_sync
+*******************************************************************************
+*
+* Summary:
+*  Record a value written to a register outside of a flush, e.g. by a
+*  transaction queued from an interrupt
+*
+* Parameters:
+*  REGMAP_SHADOW* shadow: shadow of the block the register is in
+*  uint8 _register: address of the register
+*  uint8 value: value the device now holds
+*
+*******************************************************************************/
+
+void regmap_shadow_sync(REGMAP_SHADOW* shadow, uint8 _register, uint8 value) {
+    uint8 index = _register - shadow->first;
+    shadow->value[index] = value;
+    shadow->device[index] = value;
+    shadow->dirty &= ~(1 << index);
+}
+
+/******************************************************************************
+* Function Name: regmap_shadow_flush_buffer
+*******************************************************************************
+*
+* Summary:
+*  Fill a buffer with the write of the dirty registers.  The range from
+*  the first to the last dirty register goes in one auto-increment write,
+*  so a flush costs at most one I2C transaction.  The registers are
+*  recorded as written, call regmap_shadow_invalidate if the write fails.
+*
+* Parameters:
+*  REGMAP_SHADOW* shadow: shadow to flush
+*  uint8* buffer: room for the register address and REGMAP_SHADOW_SIZE bytes
+*
+* Return:
+*  uint8: bytes to write with the register address, 0 if nothing is dirty
+*
+*******************************************************************************/
+
+uint8 regmap_shadow_flush_buffer(REGMAP_SHADOW* shadow, uint8* buffer) {
+    uint8 first = 0;
+    uint8 last = shadow->length - 1;
+    uint8 i;
+
+    if (shadow->dirty == 0x00) {
+        return 0;
+    }
+    while (0x00 == (shadow->dirty & (1 << first))) {
+        first++;
+    }
+    while (0x00 == (shadow->dirty & (1 << last))) {
+        last--;
+    }
+    buffer[0] = shadow->first + first;
+    for (i = first; i <= last; i++) {
+        buffer[1 + i - first] = shadow->value[i];
+        shadow->device[i] = shadow->value[i];
+    }
+    shadow->dirty = 0x00;
+    return 2 + last - first;
+}
+
+/******************************************************************************
+* Function Name: regmap_shadow_verify
+*******************************************************************************
+*
+* Summary:
+*  Record the values read back from the device and mark the registers
+*  that do not hold their shadow value dirty
+*
+* Parameters:
+*  REGMAP_SHADOW* shadow: shadow of the block read
+*  uint8 _register: first register read
+*  const uint8* buffer: bytes read
+*  uint8 num_bytes: number of registers read
+*
+*******************************************************************************/
+
+void regmap_shadow_verify(REGMAP_SHADOW* shadow, uint8 _register, const uint8* buffer,
+                          uint8 num_bytes) {
+    uint8 index = _register - shadow->first;
+    uint8 i;
+
+    for (i = 0; i < num_bytes; i++, index++) {
+        shadow->device[index] = buffer[i];
+        if (shadow->device[index] != shadow->value[index]) {
+            shadow->dirty |= (1 << index);
+        }
+    }
+}
+
+/* [] END OF FILE */
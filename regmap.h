@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * File Name: regmap.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the register map engine shared by the sensor drivers.
+ *
+ *  A device describes its registers, bit fields and auto-increment blocks
+ *  in X-macro lists in its header:
+ *
+ *    #define DEV_REGISTERS(X)  X(DEV_CONFIG_REG, 0x01, 1)  (name, address, bytes)
+ *    #define DEV_FIELDS(X)     X(DEV_MODE, DEV_CONFIG_REG, 0, 3)  (name, register, shift, bits)
+ *    #define DEV_BLOCKS(X)     X(DEV_CONFIG_BLOCK, DEV_CONFIG_REG, 3)  (name, first, bytes)
+ *
+ *  and makes its constants with REGMAP_CONSTANTS(DEV_REGISTERS, DEV_FIELDS,
+ *  DEV_BLOCKS).  A field gives name_REG, name_SHIFT and name_MASK, a block
+ *  name_FIRST and name_LENGTH.  REGMAP_ENCODE and REGMAP_DECODE use them,
+ *  so a misspelt field does not compile and a constant setting folds into
+ *  an immediate byte.  The driver makes its REGMAP from the same register
+ *  list with REGMAP_REGISTER_TABLE.
+ *
+ *  The engine keeps a shadow of a block of writable registers, so only the
+ *  registers that changed are written, in one auto-increment transfer.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_REGMAP_H)
+#define _REGMAP_H
+
+#include "platform.h"
+#include "sensor.h"
+#include "stdbool.h"
+
+/***************************************
+*      Register map constants
+***************************************/
+
+// Most registers one shadow can hold
+#define REGMAP_SHADOW_SIZE          4
+
+/***************************************
+*      Generators
+***************************************/
+
+#define REGMAP_REGISTER_CONSTANT(name, address, width) \
+    name = (address), name##_WIDTH = (width),
+#define REGMAP_FIELD_CONSTANT(name, _register, shift, bits) \
+    name##_REG = (_register), name##_SHIFT = (shift), \
+    name##_MASK = (((1 << (bits)) - 1) << (shift)),
+#define REGMAP_BLOCK_CONSTANT(name, first, length) \
+    name##_FIRST = (first), name##_LENGTH = (length),
+#define REGMAP_REGISTER_ENTRY(name, address, width) \
+    {(address), (width)},
+
+// Make the constants of a device from its lists
+#define REGMAP_CONSTANTS(REGISTERS, FIELDS, BLOCKS) \
+    enum { REGISTERS(REGMAP_REGISTER_CONSTANT) }; \
+    enum { FIELDS(REGMAP_FIELD_CONSTANT) }; \
+    enum { BLOCKS(REGMAP_BLOCK_CONSTANT) };
+
+// Initializer of the register table of a REGMAP
+#define REGMAP_REGISTER_TABLE(REGISTERS) \
+    { REGISTERS(REGMAP_REGISTER_ENTRY) }
+
+// Field value put in its place in the register, and taken back out
+#define REGMAP_ENCODE(field, value)         ((uint8) (((value) << field##_SHIFT) & field##_MASK))
+#define REGMAP_DECODE(field, reg_value)     ((uint8) (((reg_value) & field##_MASK) >> field##_SHIFT))
+// Value of a register from the bytes read from it, low byte first, like
+// regmap_value but with the width of the register known when it is
+// compiled, so there is no search of the register table.  buffer is used
+// more than once.
+#define REGMAP_VALUE(_register, buffer) \
+    ((uint32) (buffer)[0] | \
+     ((_register##_WIDTH > 1) ? ((uint32) (buffer)[1] << 8) : 0) | \
+     ((_register##_WIDTH > 2) ? ((uint32) (buffer)[2] << 16) : 0) | \
+     ((_register##_WIDTH > 3) ? ((uint32) (buffer)[3] << 24) : 0))
+// Register value with one field replaced
+#define REGMAP_UPDATE(field, reg_value, value) \
+    ((uint8) (((reg_value) & ~field##_MASK) | REGMAP_ENCODE(field, value)))
+// Change one field in a shadow, bits is already in place, e.g. from REGMAP_ENCODE
+#define REGMAP_SHADOW_FIELD(shadow, field, bits) \
+    regmap_shadow_update((shadow), field##_REG, field##_MASK, (bits))
+
+/***************************************
+*      Structures
+***************************************/
+
+typedef struct {
+    uint8       address;
+    uint8       width;      // bytes, multi-byte registers are little endian
+} REGMAP_REGISTER;
+
+typedef struct {
+    const REGMAP_REGISTER*  registers;
+    uint8                   num_registers;
+    uint8                   command;    // bits set in every register address sent
+} REGMAP;
+
+// Shadow of a block of consecutive byte registers
+typedef struct {
+    uint8       first;      // address of the first register
+    uint8       length;
+    uint8       value[REGMAP_SHADOW_SIZE];      // what the registers should hold
+    uint8       device[REGMAP_SHADOW_SIZE];     // what the device holds
+    uint8       dirty;      // bit n set when value[n] differs from device[n]
+} REGMAP_SHADOW;
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8 regmap_width(const REGMAP* map, uint8 _register);
+uint32 regmap_value(const REGMAP* map, uint8 _register, const uint8* buffer);
+uint8 regmap_write(const REGMAP* map, SENSOR_BUS* bus, uint8 address, uint8* buffer,
+                   uint8 num_bytes);
+uint8 regmap_read(const REGMAP* map, SENSOR_BUS* bus, uint8 address, uint8* buffer,
+                  uint8 _register, uint8 num_bytes);
+
+void regmap_shadow_init(REGMAP_SHADOW* shadow, uint8 first, uint8 length, uint8 reset_value);
+void regmap_shadow_invalidate(REGMAP_SHADOW* shadow);
+void regmap_shadow_write(REGMAP_SHADOW* shadow, uint8 _register, uint8 value);
+void regmap_shadow_update(REGMAP_SHADOW* shadow, uint8 _register, uint8 mask, uint8 bits);
+uint8 regmap_shadow_read(REGMAP_SHADOW* shadow, uint8 _register);
+void regmap_shadow_sync(REGMAP_SHADOW* shadow, uint8 _register, uint8 value);
+uint8 regmap_shadow_flush_buffer(REGMAP_SHADOW* shadow, uint8* buffer);
+void regmap_shadow_verify(REGMAP_SHADOW* shadow, uint8 _register, const uint8* buffer,
+                          uint8 num_bytes);
+
+#endif
+
+/* [] END OF FILE */
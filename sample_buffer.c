@@ -0,0 +1,132 @@
+/*******************************************************************************
+ * File Name: sample_buffer.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides a lock-free single producer, single consumer ring 
+ *  buffer of timestamped sensor samples.  The producer is an interrupt or
+ *  transfer callback, the consumer is the main loop.
+ *
+*******************************************************************************
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "sample_buffer.h"
+
+#define BUFFER_MASK                 (SAMPLE_BUFFER_SIZE - 1)
+
+/******************************************************************************
+* Function Name: sample_buffer_init
+*******************************************************************************
+*
+* Summary:
+*  Empty the buffer and clear the overrun count.  Call before the producer
+*  is started.
+*
+*******************************************************************************/
+
+void sample_buffer_init(SAMPLE_BUFFER* buffer) {
+    buffer->head = 0;
+    buffer->tail = 0;
+    buffer->overruns = 0;
+}
+
+/******************************************************************************
+* Function Name: sample_buffer_put
+*******************************************************************************
+*
+* Summary:
+*  Copy a sample into the buffer.  Only the producer may call this.  If
+*  the buffer is full the sample is dropped and counted as an overrun.
+*
+* Parameters:
+*  SAMPLE_BUFFER* buffer: buffer to put the sample in
+*  const SAMPLE* sample: sample to copy
+*
+* Return:
+*  bool: true if the sample was put in, false if it was dropped
+*
+*******************************************************************************/
+
+bool sample_buffer_put(SAMPLE_BUFFER* buffer, const SAMPLE* sample) {
+    uint16 head = buffer->head;
+    
+    if ((uint16)(head - buffer->tail) >= SAMPLE_BUFFER_SIZE) {
+        buffer->overruns++;
+        return false;
+    }
+    buffer->records[head & BUFFER_MASK] = *sample;
+    SAMPLE_BUFFER_BARRIER();
+    buffer->head = head + 1;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: sample_buffer_get
+*******************************************************************************
+*
+* Summary:
+*  Copy out up to max_samples of the oldest samples.  Only the consumer
+*  may call this.
+*
+* Parameters:
+*  SAMPLE_BUFFER* buffer: buffer to take the samples from
+*  SAMPLE* samples: array to copy the samples into
+*  uint16 max_samples: length of samples
+*
+* Return:
+*  uint16: number of samples copied
+*
+*******************************************************************************/
+
+uint16 sample_buffer_get(SAMPLE_BUFFER* buffer, SAMPLE* samples, uint16 max_samples) {
+    uint16 tail = buffer->tail;
+    uint16 available = buffer->head - tail;
+    uint16 i;
+    
+    if (available > max_samples) {
+        available = max_samples;
+    }
+    SAMPLE_BUFFER_BARRIER();
+    for (i = 0; i < available; i++) {
+        samples[i] = buffer->records[(tail + i) & BUFFER_MASK];
+    }
+    SAMPLE_BUFFER_BARRIER();
+    buffer->tail = tail + available;
+    return available;
+}
+
+/******************************************************************************
+* Function Name: sample_buffer_count
+*******************************************************************************
+*
+* Return:
+*  uint16: number of samples waiting in the buffer
+*
+*******************************************************************************/
+
+uint16 sample_buffer_count(SAMPLE_BUFFER* buffer) {
+    return buffer->head - buffer->tail;
+}
+
+/******************************************************************************
+* Function Name: sample_buffer_overruns
+*******************************************************************************
+*
+* Return:
+*  uint32: number of samples dropped because the buffer was full
+*
+*******************************************************************************/
+
+uint32 sample_buffer_overruns(SAMPLE_BUFFER* buffer) {
+    return buffer->overruns;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * File Name: sample_buffer.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the ring buffer that passes timestamped sensor samples
+ *  from interrupts to the main loop.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_SAMPLE_BUFFER_H)
+#define _SAMPLE_BUFFER_H
+    
+#include "platform.h"
+#include "stdbool.h"
+    
+/***************************************
+*      Buffer constants
+***************************************/ 
+
+// Number of samples the buffer holds, must be a power of 2
+#define SAMPLE_BUFFER_SIZE          32
+#define SAMPLE_NUM_CHANNELS         3
+    
+// Makes the record writes visible before the index write, and the other
+// way around for the reader
+#define SAMPLE_BUFFER_BARRIER()     __sync_synchronize()
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+typedef struct {
+    uint32      timestamp;                      // timebase_ms() when the sample was read
+    uint8       device;                         // id of the device that made the sample
+    uint8       status;                         // status register of the device
+    uint8       setting;                        // device settings the channels were measured at
+    uint16      channel[SAMPLE_NUM_CHANNELS];   // e.g. red, green, blue
+} SAMPLE;
+
+// Single producer, single consumer.  head is only written by the producer
+// and tail only by the consumer, so neither side has to disable interrupts.
+typedef struct {
+    SAMPLE              records[SAMPLE_BUFFER_SIZE];
+    volatile uint16     head;       // count of samples put in
+    volatile uint16     tail;       // count of samples taken out
+    volatile uint32     overruns;   // samples dropped because the buffer was full
+} SAMPLE_BUFFER;
+  
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void sample_buffer_init(SAMPLE_BUFFER* buffer);
+bool sample_buffer_put(SAMPLE_BUFFER* buffer, const SAMPLE* sample);
+uint16 sample_buffer_get(SAMPLE_BUFFER* buffer, SAMPLE* samples, uint16 max_samples);
+uint16 sample_buffer_count(SAMPLE_BUFFER* buffer);
+uint32 sample_buffer_overruns(SAMPLE_BUFFER* buffer);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,333 @@
+/*******************************************************************************
+ * File Name: scheduler.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the duty cycled acquisition 
+ *  scheduler.  Each sensor has a plan with its sample period: it is powered
+ *  up one conversion time before the sample is due, read as soon as the 
+ *  conversion is done and put back in standby or powerdown.  Between 
+ *  samples the MCU sleeps until the next plan needs it.  With a 1 s period 
+ *  and a 12 bit isl29125 the sensor is on for about 2% of the time 
+ *  instead of all of it.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "scheduler.h"
+#include "timebase.h"
+
+#if defined(SENSOR_HOST_BUILD)
+#include <time.h>
+#endif
+
+// Time difference that is negative when a is before b, safe across the wrap
+#define TIME_BEFORE(a, b)           ((int32) ((a) - (b)) < 0)
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static void isl29125_power_up(void* device);
+static uint16 isl29125_conversion_ms(void* device);
+static bool isl29125_read_sample(void* device, SAMPLE* sample);
+static void isl29125_power_down(void* device, uint8 idle_mode);
+
+static void tsl2561_power_up(void* device);
+static uint16 tsl2561_conversion_ms(void* device);
+static bool tsl2561_read_sample(void* device, SAMPLE* sample);
+static void tsl2561_power_down(void* device, uint8 idle_mode);
+
+const SCHEDULER_SENSOR_OPS scheduler_isl29125_ops = {
+    isl29125_power_up,
+    isl29125_conversion_ms,
+    isl29125_read_sample,
+    isl29125_power_down
+};
+
+const SCHEDULER_SENSOR_OPS scheduler_tsl2561_ops = {
+    tsl2561_power_up,
+    tsl2561_conversion_ms,
+    tsl2561_read_sample,
+    tsl2561_power_down
+};
+
+#if !defined(SENSOR_HOST_BUILD)
+// Wakeup intervals of the central timewheel, longest first
+typedef struct {
+    uint16      milliseconds;
+    uint8       setting;
+} SLEEP_INTERVAL;
+
+static const SLEEP_INTERVAL sleep_intervals[] = {
+    {4096, PM_SLEEP_TIME_CTW_4096MS},
+    {2048, PM_SLEEP_TIME_CTW_2048MS},
+    {1024, PM_SLEEP_TIME_CTW_1024MS},
+    {512, PM_SLEEP_TIME_CTW_512MS},
+    {256, PM_SLEEP_TIME_CTW_256MS},
+    {128, PM_SLEEP_TIME_CTW_128MS},
+    {64, PM_SLEEP_TIME_CTW_64MS},
+    {32, PM_SLEEP_TIME_CTW_32MS},
+    {16, PM_SLEEP_TIME_CTW_16MS},
+    {8, PM_SLEEP_TIME_CTW_8MS},
+    {4, PM_SLEEP_TIME_CTW_4MS},
+    {2, PM_SLEEP_TIME_CTW_2MS}
+};
+
+#define NUM_SLEEP_INTERVALS         (sizeof(sleep_intervals) / sizeof(sleep_intervals[0]))
+#endif
+
+
+/******************************************************************************
+* Function Name: scheduler_init
+*******************************************************************************
+*
+* Summary:
+*  Make a scheduler with no plans
+*
+* Parameters:
+*  SCHEDULER* scheduler: scheduler to set up
+*  SAMPLE_BUFFER* samples: buffer to put the samples of every plan in
+*
+*******************************************************************************/
+
+void scheduler_init(SCHEDULER* scheduler, SAMPLE_BUFFER* samples) {
+    scheduler->num_plans = 0;
+    scheduler->samples = samples;
+    scheduler->missed = 0;
+}
+
+/******************************************************************************
+* Function Name: scheduler_add
+*******************************************************************************
+*
+* Summary:
+*  Add the sampling plan of a sensor.  The sensor is put in its idle mode
+*  now and its first sample is taken as soon as possible.  The sensor 
+*  has to be initialized and should not use its conversion interrupt.
+*
+* Parameters:
+*  SCHEDULER* scheduler: scheduler to add to
+*  const SCHEDULER_SENSOR_OPS* ops: scheduler_isl29125_ops or scheduler_tsl2561_ops
+*  void* device: ISL29125* or TSL2561* of the sensor
+*  uint8 device_id: put in the device field of its samples
+*  uint32 period_ms: time between samples, longer than the conversion time
+*  uint8 idle_mode: SCHEDULER_IDLE_STANDBY or SCHEDULER_IDLE_POWERDOWN
+*
+* Return:
+*  bool: true if the plan was added, false if there is no room
+*
+*******************************************************************************/
+
+bool scheduler_add(SCHEDULER* scheduler, const SCHEDULER_SENSOR_OPS* ops, void* device, 
+                   uint8 device_id, uint32 period_ms, uint8 idle_mode) {
+    SCHEDULER_PLAN* plan;
+    
+    if (scheduler->num_plans >= SCHEDULER_MAX_PLANS) {
+        return false;
+    }
+    plan = &scheduler->plans[scheduler->num_plans];
+    plan->ops = ops;
+    plan->device = device;
+    plan->device_id = device_id;
+    plan->period_ms = period_ms;
+    plan->idle_mode = idle_mode;
+    plan->state = SCHEDULER_WAITING;
+    plan->start_ms = timebase_ms();
+    plan->ready_ms = plan->start_ms;
+    ops->power_down(device, idle_mode);
+    scheduler->num_plans++;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: scheduler_run
+*******************************************************************************
+*
+* Summary:
+*  Power up the sensors whose sample is due and read the ones whose 
+*  conversion is done.  Call in the main loop, then sleep for the time 
+*  returned, e.g. with scheduler_sleep.
+*
+* Parameters:
+*  SCHEDULER* scheduler: scheduler to run
+*
+* Return:
+*  uint32: milliseconds until a plan needs the scheduler again
+*
+*******************************************************************************/
+
+uint32 scheduler_run(SCHEDULER* scheduler) {
+    SCHEDULER_PLAN* plan;
+    SAMPLE sample;
+    uint32 now = timebase_ms();
+    uint32 next = now + 0x7FFFFFFF;
+    uint8 i;
+    
+    for (i = 0; i < scheduler->num_plans; i++) {
+        plan = &scheduler->plans[i];
+        
+        if ((plan->state == SCHEDULER_WAITING) && !TIME_BEFORE(now, plan->start_ms)) {
+            plan->ops->power_up(plan->device);
+            plan->ready_ms = now + plan->ops->conversion_ms(plan->device);
+            plan->state = SCHEDULER_CONVERTING;
+        }
+        if ((plan->state == SCHEDULER_CONVERTING) && !TIME_BEFORE(now, plan->ready_ms)) {
+            if (plan->ops->read(plan->device, &sample)) {
+                sample.timestamp = now;
+                sample.device = plan->device_id;
+                sample_buffer_put(scheduler->samples, &sample);
+            }
+            else {
+                scheduler->missed++;
+            }
+            plan->ops->power_down(plan->device, plan->idle_mode);
+            plan->state = SCHEDULER_WAITING;
+            // keep the period, unless the scheduler fell a whole period behind
+            plan->start_ms += plan->period_ms;
+            if (TIME_BEFORE(plan->start_ms, now)) {
+                plan->start_ms = now;
+            }
+        }
+        
+        if (plan->state == SCHEDULER_WAITING) {
+            if (TIME_BEFORE(plan->start_ms, next)) {
+                next = plan->start_ms;
+            }
+        }
+        else if (TIME_BEFORE(plan->ready_ms, next)) {
+            next = plan->ready_ms;
+        }
+    }
+    if (TIME_BEFORE(next, now)) {
+        return 0;
+    }
+    return next - now;
+}
+
+/******************************************************************************
+* Function Name: scheduler_sleep
+*******************************************************************************
+*
+* Summary:
+*  Put the MCU in its sleep mode for at most sleep_ms, woken by the central
+*  timewheel.  SysTick stops while asleep, so the time slept is added to the
+*  timebase after.  The longest timewheel interval that fits is used, the 
+*  rest is left for the next call.  Below 2 ms the CPU only waits for the 
+*  next interrupt.  Other wakeup sources would make the timebase run ahead, 
+*  so only the timewheel is enabled.
+*
+* Parameters:
+*  uint32 sleep_ms: time until the scheduler has work
+*
+*******************************************************************************/
+
+#if defined(SENSOR_HOST_BUILD)
+
+void scheduler_sleep(uint32 sleep_ms) {
+    struct timespec wait;
+    wait.tv_sec = sleep_ms / 1000;
+    wait.tv_nsec = (long) (sleep_ms % 1000) * 1000000;
+    nanosleep(&wait, 0);
+}
+
+#else
+
+void scheduler_sleep(uint32 sleep_ms) {
+    uint8 i;
+    
+    if (sleep_ms < sleep_intervals[NUM_SLEEP_INTERVALS - 1].milliseconds) {
+        if (sleep_ms != 0) {
+            CY_PM_WFI;
+        }
+        return;
+    }
+    for (i = 0; sleep_intervals[i].milliseconds > sleep_ms; i++) {
+    }
+    CyPmSaveClocks();
+    CyPmSleep(sleep_intervals[i].setting, PM_SLEEP_SRC_CTW);
+    CyPmRestoreClocks();
+    timebase_advance(sleep_intervals[i].milliseconds);
+}
+
+#endif
+
+/***************************************
+*      ISL29125 operations
+***************************************/  
+
+static void isl29125_power_up(void* device) {
+    isl29125_start((ISL29125*) device);
+}
+
+static uint16 isl29125_conversion_ms(void* device) {
+    return isl29125_conversion_time_ms((ISL29125*) device);
+}
+
+static bool isl29125_read_sample(void* device, SAMPLE* sample) {
+    ISL29125_RGB rgb;
+    
+    if (SENSOR_OK != isl29125_read_rgb((ISL29125*) device, &rgb)) {
+        return false;
+    }
+    sample->status = rgb.status;
+    sample->setting = rgb.intensity_range | rgb.adc_resolution;
+    sample->channel[0] = rgb.red;
+    sample->channel[1] = rgb.green;
+    sample->channel[2] = rgb.blue;
+    return true;
+}
+
+static void isl29125_power_down(void* device, uint8 idle_mode) {
+    if (idle_mode == SCHEDULER_IDLE_POWERDOWN) {
+        isl29125_stop((ISL29125*) device);
+    }
+    else {
+        isl29125_sleep((ISL29125*) device);
+    }
+}
+
+/***************************************
+*      TSL2561 operations
+***************************************/  
+
+static void tsl2561_power_up(void* device) {
+    tsl2561_Start((TSL2561*) device);
+}
+
+static uint16 tsl2561_conversion_ms(void* device) {
+    return tsl2561_conversion_time_ms((TSL2561*) device);
+}
+
+// channels are channel 0, channel 1 and the lux, which stops at 0xFFFF
+static bool tsl2561_read_sample(void* device, SAMPLE* sample) {
+    TSL2561* tsl2561 = (TSL2561*) device;
+    TSL2561_DATA data;
+    
+    if (SENSOR_OK != tsl2561_read_data(tsl2561, &data)) {
+        return false;
+    }
+    sample->status = 0;
+    sample->setting = tsl2561->integration_time | tsl2561->_gain;
+    sample->channel[0] = data.channel0;
+    sample->channel[1] = data.channel1;
+    sample->channel[2] = (data.lux > 0xFFFF) ? 0xFFFF : data.lux;
+    return true;
+}
+
+// the tsl2561 only has on and off
+static void tsl2561_power_down(void* device, uint8 idle_mode) {
+    (void) idle_mode;
+    tsl2561_Stop((TSL2561*) device);
+}
+
+/* [] END OF FILE */
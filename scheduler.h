@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * File Name: scheduler.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the duty cycled acquisition scheduler, that powers
+ *  each sensor up just long enough for one conversion per sample period.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_SCHEDULER_H)
+#define _SCHEDULER_H
+    
+#include "platform.h"
+#include "stdbool.h"
+#include "sample_buffer.h"
+#include "isl29125.h"
+#include "tsl2561.h"
+    
+/***************************************
+*      Scheduler constants
+***************************************/ 
+
+#define SCHEDULER_MAX_PLANS         4
+    
+// What a sensor does between samples
+#define SCHEDULER_IDLE_STANDBY      0
+#define SCHEDULER_IDLE_POWERDOWN    1
+    
+// Plan states
+#define SCHEDULER_WAITING           0   // sensor idle until start_ms
+#define SCHEDULER_CONVERTING        1   // sensor on until ready_ms
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+// How the scheduler drives one kind of sensor.  power_up starts a
+// conversion, read puts the result in a sample and returns false if the
+// read failed, power_down puts the sensor in its idle mode.
+typedef struct {
+    void (*power_up)(void* device);
+    uint16 (*conversion_ms)(void* device);
+    bool (*read)(void* device, SAMPLE* sample);
+    void (*power_down)(void* device, uint8 idle_mode);
+} SCHEDULER_SENSOR_OPS;
+
+// Sampling plan of one sensor
+typedef struct {
+    const SCHEDULER_SENSOR_OPS* ops;
+    void*       device;
+    uint8       device_id;      // device field of its samples
+    uint32      period_ms;
+    uint8       idle_mode;      // SCHEDULER_IDLE_STANDBY or SCHEDULER_IDLE_POWERDOWN
+    uint8       state;
+    uint32      start_ms;       // when to power up for the next sample
+    uint32      ready_ms;       // when the conversion is done
+} SCHEDULER_PLAN;
+
+typedef struct {
+    SCHEDULER_PLAN  plans[SCHEDULER_MAX_PLANS];
+    uint8           num_plans;
+    SAMPLE_BUFFER*  samples;
+    uint32          missed;     // samples whose read failed
+} SCHEDULER;
+
+extern const SCHEDULER_SENSOR_OPS scheduler_isl29125_ops;
+extern const SCHEDULER_SENSOR_OPS scheduler_tsl2561_ops;
+  
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void scheduler_init(SCHEDULER* scheduler, SAMPLE_BUFFER* samples);
+bool scheduler_add(SCHEDULER* scheduler, const SCHEDULER_SENSOR_OPS* ops, void* device, 
+                   uint8 device_id, uint32 period_ms, uint8 idle_mode);
+uint32 scheduler_run(SCHEDULER* scheduler);
+void scheduler_sleep(uint32 sleep_ms);
+
+#endif
+
+/* [] END OF FILE */
@@ -4,7 +4,12 @@
  *
  * Description:
  *  This file provides higher level I2C functions.
- *  A I2C master component with the name I2C is required
+ *
+ *  Transfers are put in the queue of a bus and moved forward by 
+ *  sensor_bus_service(), which hands them to the operations of the bus
+ *  backend.  On the PSoC the default bus is sensor_psoc_bus, which needs
+ *  a I2C master component with the name I2C.  Host builds have to set
+ *  the bus with sensor_set_bus before using the read and write functions.
  *
 *******************************************************************************
  * Copyright by Kyle Lopin, Naresuan University, 2017
@@ -18,37 +23,52 @@
 */
 
 #include "sensor.h"
+#include "timebase.h"
+#include "sensor_stats.h"
+
+/***************************************
+*      Default bus
+***************************************/  
+
+#if defined(SENSOR_HOST_BUILD)
+static SENSOR_BUS* default_bus = 0;
+#else
+static SENSOR_BUS* default_bus = &sensor_psoc_bus;
+#endif
+
+#define QUEUE_MASK                  (SENSOR_QUEUE_SIZE - 1)
+#define QUEUE_DEPTH(bus)            ((uint8)((bus)->queue_tail - (bus)->queue_head))
+#define IS_UNANSWERED_PROBE(transaction) \
+    (((transaction)->type == SENSOR_XFER_WRITE) && ((transaction)->num_bytes == 0) && \
+     ((transaction)->status == SENSOR_ERR_NAK))
 
 /***************************************
 *      Static Function Prototypes
 ***************************************/  
 
-static void sensor_read(uint8 address, uint8* buffer, uint8 _register, uint8 num_bytes);
-static void sensor_write(uint8 address, uint8* buffer, uint8 num_bytes);
+static uint8 sensor_read(uint8 address, uint8* buffer, uint8 _register, uint8 num_bytes);
+static uint8 sensor_write(uint8 address, uint8* buffer, uint8 num_bytes);
+static uint8 sensor_transfer(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
 
-void sensor_write8(uint8 address, uint8* buffer) {   
-    sensor_write(address, buffer, 2);
+static void service_queue(SENSOR_BUS* bus);
+static bool retry_transaction(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static bool check_timeout(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static void finish_transaction(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+
+uint8 sensor_write8(uint8 address, uint8* buffer) {   
+    return sensor_write(address, buffer, 2);
 }
 
-void sensor_write16(uint8 address, uint8* buffer) {   
-    sensor_write(address, buffer, 3);
+uint8 sensor_write16(uint8 address, uint8* buffer) {   
+    return sensor_write(address, buffer, 3);
 }
 
-void sensor_write_n(uint8 address, uint8* buffer, uint8 num_bytes) {   
-    sensor_write(address, buffer, num_bytes);
+uint8 sensor_write_n(uint8 address, uint8* buffer, uint8 num_bytes) {   
+    return sensor_write(address, buffer, num_bytes);
 }
 
-void sensor_write(uint8 address, uint8* buffer, uint8 num_bytes) {   
-    uint8 status = 0;
-    do {
-        status = I2C_MasterWriteBuf(address, buffer, num_bytes, I2C_MODE_COMPLETE_XFER);
-        for(;;) {
-            if (0x00 != (I2C_MasterStatus() & I2C_MSTAT_WR_CMPLT)) {
-                break;
-            }
-        }
-    }
-    while(status != I2C_MSTR_NO_ERROR);
+static uint8 sensor_write(uint8 address, uint8* buffer, uint8 num_bytes) {   
+    return sensor_bus_write_n(default_bus, address, buffer, num_bytes);
 }
 
 
@@ -63,33 +83,538 @@ uint16 sensor_read16(uint8 address, uint8* buffer, uint8 _register) {
     return buffer[0] | (buffer[1] << 8);
 }
 
-void sensor_read_n(uint8 address, uint8* buffer, uint8 _register, uint8 num_bytes) {
-    sensor_read(address, buffer, _register, num_bytes);
+uint8 sensor_read_n(uint8 address, uint8* buffer, uint8 _register, uint8 num_bytes) {
+    return sensor_read(address, buffer, _register, num_bytes);
 }
 
-static void sensor_read(uint8 address, uint8* buffer, uint8 _register, uint8 num_bytes) {
-    uint8 temp;
-    do {
-        temp = I2C_MasterWriteBuf(address, &_register, 1, I2C_MODE_NO_STOP);
-        for(;;) {
-            if (0x00 != (I2C_MasterStatus() & I2C_MSTAT_WR_CMPLT)) {
-                break;
-            }
+static uint8 sensor_read(uint8 address, uint8* buffer, uint8 _register, uint8 num_bytes) {
+    return sensor_bus_read_n(default_bus, address, buffer, _register, num_bytes);
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_write_n
+*******************************************************************************
+*
+* Summary:
+*  Write num_bytes of buffer to a device on a bus and wait for it to finish.
+*  The first byte of the buffer is the register to write to.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus the device is on
+*  uint8 address: I2C address of the device
+*  uint8* buffer: register address followed by the data
+*  uint8 num_bytes: number of bytes to send, with the register address
+*
+* Return:
+*  uint8: SENSOR_OK or the SENSOR_ERR_* code of the last try
+*
+*******************************************************************************/
+
+uint8 sensor_bus_write_n(SENSOR_BUS* bus, uint8 address, uint8* buffer, uint8 num_bytes) {
+    SENSOR_TRANSACTION transaction = {0};
+    transaction.type = SENSOR_XFER_WRITE;
+    transaction.address = address;
+    transaction.buffer = buffer;
+    transaction.num_bytes = num_bytes;
+    return sensor_transfer(bus, &transaction);
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_read_n
+*******************************************************************************
+*
+* Summary:
+*  Read num_bytes from a device on a bus, starting at _register, and wait
+*  for it to finish.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus the device is on
+*  uint8 address: I2C address of the device
+*  uint8* buffer: where to put the data read
+*  uint8 _register: first register to read
+*  uint8 num_bytes: number of bytes to read
+*
+* Return:
+*  uint8: SENSOR_OK or the SENSOR_ERR_* code of the last try
+*
+*******************************************************************************/
+
+uint8 sensor_bus_read_n(SENSOR_BUS* bus, uint8 address, uint8* buffer, uint8 _register, 
+                        uint8 num_bytes) {
+    SENSOR_TRANSACTION transaction = {0};
+    transaction.type = SENSOR_XFER_READ;
+    transaction.address = address;
+    transaction._register = _register;
+    transaction.buffer = buffer;
+    transaction.num_bytes = num_bytes;
+    return sensor_transfer(bus, &transaction);
+}
+
+/******************************************************************************
+* Function Name: sensor_probe_init
+*******************************************************************************
+*
+* Summary:
+*  Set up a transaction that only sends an address, to find out if a 
+*  device answers at it.  A device that is not there costs one address
+*  byte, the NAK is not tried again.  Submit it with sensor_bus_submit to
+*  probe several buses at the same time.
+*
+* Parameters:
+*  SENSOR_TRANSACTION* transaction: transaction to set up
+*  uint8 address: I2C address to probe
+*
+*******************************************************************************/
+
+void sensor_probe_init(SENSOR_TRANSACTION* transaction, uint8 address) {
+    SENSOR_TRANSACTION empty_transaction = {0};
+    *transaction = empty_transaction;
+    transaction->type = SENSOR_XFER_WRITE;
+    transaction->address = address;
+    transaction->num_bytes = 0;
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_probe
+*******************************************************************************
+*
+* Summary:
+*  Probe an address on a bus and wait for the answer
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to probe
+*  uint8 address: I2C address to probe
+*
+* Return:
+*  uint8: SENSOR_OK if a device answered, SENSOR_ERR_NAK if none did
+*
+*******************************************************************************/
+
+uint8 sensor_bus_probe(SENSOR_BUS* bus, uint8 address) {
+    SENSOR_TRANSACTION transaction;
+    sensor_probe_init(&transaction, address);
+    return sensor_transfer(bus, &transaction);
+}
+
+/******************************************************************************
+* Function Name: sensor_transfer
+*******************************************************************************
+*
+* Summary:
+*  Put a transaction in the queue of a bus and wait for it to finish.  
+*  Used by the blocking read and write functions.  Every transaction 
+*  ahead of it and the transaction itself are bounded by the timeout and
+*  retries of the bus, so this always returns, even with a stuck bus.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to use
+*  SENSOR_TRANSACTION* transaction: transfer to perform
+*
+* Return:
+*  uint8: SENSOR_OK or the SENSOR_ERR_* code of the transaction
+*
+*******************************************************************************/
+
+static uint8 sensor_transfer(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    while (!sensor_bus_submit(bus, transaction)) {
+        sensor_bus_service(bus);
+        SENSOR_STATS_SPIN();
+    }
+    while (transaction->state != SENSOR_XFER_DONE) {
+        sensor_bus_service(bus);
+        bus->stats.wait_polls++;
+        SENSOR_STATS_SPIN();
+    }
+    return transaction->status;
+}
+
+/******************************************************************************
+* Function Name: sensor_set_bus
+*******************************************************************************
+*
+* Summary:
+*  Choose the bus used by the sensor_read* and sensor_write* functions and
+*  by sensor_submit and sensor_service.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus set up with sensor_bus_init
+*
+*******************************************************************************/
+
+void sensor_set_bus(SENSOR_BUS* bus) {
+    default_bus = bus;
+}
+
+SENSOR_BUS* sensor_get_bus(void) {
+    return default_bus;
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_init
+*******************************************************************************
+*
+* Summary:
+*  Set up a bus with an empty transaction queue.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to set up
+*  const SENSOR_BUS_OPS* ops: operations of the bus backend
+*  void* context: state of the backend, passed back through bus->context
+*
+*******************************************************************************/
+
+void sensor_bus_init(SENSOR_BUS* bus, const SENSOR_BUS_OPS* ops, void* context) {
+    SENSOR_QUEUE_STATS empty_stats = {0};
+    bus->ops = ops;
+    bus->context = context;
+    bus->timeout_ms = SENSOR_DEFAULT_TIMEOUT_MS;
+    bus->max_retries = SENSOR_DEFAULT_RETRIES;
+    bus->queue_head = 0;
+    bus->queue_tail = 0;
+    bus->recovering = false;
+    bus->servicing = 0;
+    bus->stats = empty_stats;
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_set_timeout
+*******************************************************************************
+*
+* Summary:
+*  Set how long a transaction on a bus may take and how many times it is
+*  tried again.  A blocking call waits at most about 
+*  (1 + max_retries) * timeout_ms for each transaction queued.  Needs the
+*  timebase to be running.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to set
+*  uint16 timeout_ms: time from the front of the queue to finished
+*  uint8 max_retries: tries after the first one, after an error or timeout
+*
+*******************************************************************************/
+
+void sensor_bus_set_timeout(SENSOR_BUS* bus, uint16 timeout_ms, uint8 max_retries) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    bus->timeout_ms = timeout_ms;
+    bus->max_retries = max_retries;
+    CyExitCriticalSection(interrupt_state);
+}
+
+bool sensor_submit(SENSOR_TRANSACTION* transaction) {
+    return sensor_bus_submit(default_bus, transaction);
+}
+
+void sensor_service(void) {
+    sensor_bus_service(default_bus);
+}
+
+bool sensor_busy(void) {
+    return sensor_bus_busy(default_bus);
+}
+
+void sensor_get_queue_stats(SENSOR_QUEUE_STATS* stats) {
+    sensor_bus_get_queue_stats(default_bus, stats);
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_submit
+*******************************************************************************
+*
+* Summary:
+*  Add a transaction to the end of the queue of a bus without waiting for
+*  it.  The transaction and its buffer must stay valid until its state is 
+*  SENSOR_XFER_DONE or its callback has been called.  Can be called from 
+*  an interrupt or from a transaction callback.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to use
+*  SENSOR_TRANSACTION* transaction: transfer to perform
+*
+* Return:
+*  bool: true if the transaction was queued, false if the queue is full
+*
+*******************************************************************************/
+
+bool sensor_bus_submit(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    if (QUEUE_DEPTH(bus) >= SENSOR_QUEUE_SIZE) {
+        CyExitCriticalSection(interrupt_state);
+        return false;
+    }
+    transaction->state = SENSOR_XFER_QUEUED;
+    transaction->status = SENSOR_OK;
+    transaction->retries = 0;
+    if (QUEUE_DEPTH(bus) == 0) {
+        bus->active_since = timebase_ms();
+    }
+    bus->queue[bus->queue_tail & QUEUE_MASK] = transaction;
+    bus->queue_tail++;
+    
+    bus->stats.submitted++;
+    SENSOR_STATS_TRANSACTION(transaction->num_bytes);
+    bus->stats.depth = QUEUE_DEPTH(bus);
+    if (bus->stats.depth > bus->stats.max_depth) {
+        bus->stats.max_depth = bus->stats.depth;
+    }
+    CyExitCriticalSection(interrupt_state);
+    
+    // start the bus if it was idle
+    sensor_bus_service(bus);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_service
+*******************************************************************************
+*
+* Summary:
+*  Move the transaction queue of a bus forward.  Start the first queued 
+*  transaction, or check if the active one has finished and start the 
+*  next one.  Only waits on the bus to recover it, so it is safe to call 
+*  from the bus interrupt and from the main loop.  A transaction that fails 
+*  is started again up to the retry count of the bus, one that does not 
+*  finish in time has its bus recovered first.  The recovery can wait, so
+*  it is only run by a call from the main loop with interrupts enabled 
+*  that is not inside a callback of the queue.  Other calls leave the bus
+*  alone until such a call has recovered it.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to service
+*
+*******************************************************************************/
+
+void sensor_bus_service(SENSOR_BUS* bus) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    bool may_recover = (interrupt_state == 0u) && (bus->servicing == 0) && 
+                       !SENSOR_IN_INTERRUPT();
+    
+    if (bus->recovering && !may_recover) {
+        CyExitCriticalSection(interrupt_state);
+        return;
+    }
+    bus->servicing++;
+    for (;;) {
+        service_queue(bus);
+        if (!bus->recovering || !may_recover) {
+            break;
         }
+        CyExitCriticalSection(interrupt_state);
+        bus->ops->recover(bus);
+        interrupt_state = CyEnterCriticalSection();
+        bus->recovering = false;
     }
-    while (temp != I2C_MSTR_NO_ERROR);
-    I2C_MasterClearWriteBuf();
+    bus->servicing--;
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: service_queue
+*******************************************************************************
+*
+* Summary:
+*  Move the transaction queue forward until it waits on the bus, or until
+*  a timeout needs the bus recovered.  Called with interrupts disabled.
+*
+*******************************************************************************/
 
-    do {
-        temp = I2C_MasterReadBuf(address, buffer, num_bytes, I2C_MODE_REPEAT_START);
-        for(;;) {
-            if (0x00 != (I2C_MasterStatus() & I2C_MSTAT_RD_CMPLT)) {
+static void service_queue(SENSOR_BUS* bus) {
+    SENSOR_TRANSACTION* active;
+    
+    while (!bus->recovering && (bus->queue_head != bus->queue_tail)) {
+        active = bus->queue[bus->queue_head & QUEUE_MASK];
+        
+        if (active->state == SENSOR_XFER_QUEUED) {
+            if (!bus->ops->start(bus, active)) {
+                if (check_timeout(bus, active)) {
+                    continue;
+                }
                 break;
             }
         }
+        if (!bus->ops->poll(bus, active)) {
+            if (check_timeout(bus, active)) {
+                continue;
+            }
+            break;
+        }
+        if ((active->status != SENSOR_OK) && retry_transaction(bus, active)) {
+            continue;
+        }
+        finish_transaction(bus, active);
+    }
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_busy
+*******************************************************************************
+*
+* Return:
+*  bool: true if there are transactions queued or in progress on the bus
+*
+*******************************************************************************/
+
+bool sensor_bus_busy(SENSOR_BUS* bus) {
+    return (bus->queue_head != bus->queue_tail);
+}
+
+/******************************************************************************
+* Function Name: sensor_bus_get_queue_stats
+*******************************************************************************
+*
+* Summary:
+*  Copy the transaction queue statistics of a bus
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to get the statistics of
+*  SENSOR_QUEUE_STATS* stats: structure to copy the statistics into
+*
+*******************************************************************************/
+
+void sensor_bus_get_queue_stats(SENSOR_BUS* bus, SENSOR_QUEUE_STATS* stats) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    *stats = bus->stats;
+    stats->depth = QUEUE_DEPTH(bus);
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: sensor_backoff_ready
+*******************************************************************************
+*
+* Summary:
+*  Check if a device can be used, or if it is still backing off after a
+*  failure.  Drivers skip the bus while this is false.
+*
+* Parameters:
+*  SENSOR_BACKOFF* backoff: backoff state of the device
+*
+* Return:
+*  bool: true if the device can be tried
+*
+*******************************************************************************/
+
+bool sensor_backoff_ready(SENSOR_BACKOFF* backoff) {
+    if (backoff->failures == 0) {
+        return true;
+    }
+    return ((int32) (timebase_ms() - backoff->retry_at) >= 0);
+}
+
+/******************************************************************************
+* Function Name: sensor_backoff_update
+*******************************************************************************
+*
+* Summary:
+*  Record the result of a transfer with a device.  A failure puts off the
+*  next try by SENSOR_BACKOFF_MIN_MS, doubled for every failure in a row 
+*  up to SENSOR_BACKOFF_MAX_SHIFT times.  A success clears the backoff.
+*
+* Parameters:
+*  SENSOR_BACKOFF* backoff: backoff state of the device
+*  uint8 status: SENSOR_OK or the SENSOR_ERR_* code of the transfer
+*
+*******************************************************************************/
+
+void sensor_backoff_update(SENSOR_BACKOFF* backoff, uint8 status) {
+    uint8 shift;
+    uint8 interrupt_state = CyEnterCriticalSection();
+    
+    if (status == SENSOR_OK) {
+        backoff->failures = 0;
+    }
+    else if (status != SENSOR_ERR_BACKOFF) {
+        if (backoff->failures < 0xFF) {
+            backoff->failures++;
+        }
+        shift = backoff->failures - 1;
+        if (shift > SENSOR_BACKOFF_MAX_SHIFT) {
+            shift = SENSOR_BACKOFF_MAX_SHIFT;
+        }
+        backoff->retry_at = timebase_ms() + ((uint32) SENSOR_BACKOFF_MIN_MS << shift);
+    }
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: retry_transaction
+*******************************************************************************
+*
+* Summary:
+*  Put a failed transaction back to be started again, if it has retries
+*  left.  A probe that was not answered is finished, the NAK is its 
+*  answer.  Called with interrupts disabled.
+*
+* Return:
+*  bool: true if the transaction will be tried again
+*
+*******************************************************************************/
+
+static bool retry_transaction(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    if ((transaction->retries >= bus->max_retries) || IS_UNANSWERED_PROBE(transaction)) {
+        bus->stats.errors++;
+        return false;
+    }
+    if (transaction->status == SENSOR_ERR_NAK) {
+        SENSOR_STATS_NAK_RETRY();
+    }
+    transaction->retries++;
+    transaction->state = SENSOR_XFER_QUEUED;
+    transaction->status = SENSOR_OK;
+    bus->active_since = timebase_ms();
+    bus->stats.retries++;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: check_timeout
+*******************************************************************************
+*
+* Summary:
+*  If the active transaction has been at the front of the queue longer 
+*  than the bus timeout, retry the transaction or finish it with 
+*  SENSOR_ERR_TIMEOUT, and have the bus recovered before the next start.
+*  Called with interrupts disabled.
+*
+* Return:
+*  bool: true if the transaction timed out
+*
+*******************************************************************************/
+
+static bool check_timeout(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    if ((uint32) (timebase_ms() - bus->active_since) < bus->timeout_ms) {
+        return false;
+    }
+    bus->stats.timeouts++;
+    if (bus->ops->recover) {
+        // done by the next call of sensor_bus_service that may wait
+        bus->recovering = true;
+        bus->stats.recoveries++;
+    }
+    transaction->status = SENSOR_ERR_TIMEOUT;
+    if (!retry_transaction(bus, transaction)) {
+        finish_transaction(bus, transaction);
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: finish_transaction
+*******************************************************************************
+*
+* Summary:
+*  Remove the active transaction from the queue and call its callback.
+*  Called with interrupts disabled.
+*
+*******************************************************************************/
+
+static void finish_transaction(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    bus->queue_head++;
+    bus->active_since = timebase_ms();
+    bus->stats.completed++;
+    transaction->state = SENSOR_XFER_DONE;
+    if (transaction->callback) {
+        transaction->callback(transaction);
     }
-    while (temp != I2C_MSTR_NO_ERROR);
-    I2C_MasterClearReadBuf();
 }
 
 /* [] END OF FILE */
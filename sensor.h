@@ -21,20 +21,158 @@
 #if !defined(_SENSOR_H)
 #define _SENSOR_H
     
-#include <project.h>
+#include "platform.h"
 #include "stdbool.h"
     
+/***************************************
+*      Transaction queue constants
+***************************************/ 
+
+// Number of transactions that can wait for a bus, must be a power of 2
+#define SENSOR_QUEUE_SIZE           8
+    
+// Transaction types
+#define SENSOR_XFER_WRITE           0
+#define SENSOR_XFER_READ            1
+    
+// Transaction states
+#define SENSOR_XFER_IDLE            0
+#define SENSOR_XFER_QUEUED          1
+#define SENSOR_XFER_WRITING         2
+#define SENSOR_XFER_READING         3
+#define SENSOR_XFER_DONE            4
+    
+// Transaction status, the same for every bus backend
+#define SENSOR_OK                   0x00
+#define SENSOR_ERR_NAK              0x01    // device did not answer its address
+#define SENSOR_ERR_BUS              0x02    // any other transfer error
+#define SENSOR_ERR_TIMEOUT          0x03    // not finished before the bus timeout
+#define SENSOR_ERR_BACKOFF          0x04    // not tried, the device is backing off
+#define SENSOR_ERR_BUSY             0x05    // not tried, the device has a job running
+    
+// What the poll function of a driver's job returns
+#define SENSOR_JOB_IDLE             0       // no job, or its end was returned already
+#define SENSOR_JOB_BUSY             1
+#define SENSOR_JOB_DONE             2       // the job just finished
+    
+// Time a transaction may take from reaching the front of the queue, and 
+// times it is tried again after an error or a timeout
+#define SENSOR_DEFAULT_TIMEOUT_MS   10
+#define SENSOR_DEFAULT_RETRIES      2
+    
+// Wait before trying a failing device again, doubled after every failure
+#define SENSOR_BACKOFF_MIN_MS       50
+#define SENSOR_BACKOFF_MAX_SHIFT    7
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+typedef struct sensor_transaction SENSOR_TRANSACTION;
+typedef struct sensor_bus SENSOR_BUS;
+typedef void (*sensor_callback)(SENSOR_TRANSACTION* transaction);
+
+// Descriptor of one I2C transfer.  A write sends num_bytes of buffer (the
+// register address is buffer[0]), a read sends _register and then reads
+// num_bytes into buffer after a repeated start.  A write of 0 bytes is a
+// probe, only the address is sent and a NAK is not tried again.
+struct sensor_transaction {
+    uint8           type;
+    uint8           address;
+    uint8           _register;
+    uint8           num_bytes;
+    uint8*          buffer;
+    volatile uint8  state;
+    uint8           status;     // SENSOR_OK or a SENSOR_ERR_* code
+    uint8           retries;    // times the transaction was restarted
+    sensor_callback callback;   // called from the engine when done, can be NULL
+    void*           context;    // free for the owner of the transaction
+};
+
+// Operations a bus backend provides to the transaction engine.  start
+// begins a queued transaction and returns false if the bus is not ready,
+// poll returns true when the started transaction has finished and its 
+// status is set.  Neither may wait on the bus.  recover, which can be
+// NULL, abandons the active transfer after a timeout and frees the bus.
+// It is only called from the main loop with interrupts enabled, never from
+// an interrupt or a callback of the queue, and may wait.
+typedef struct {
+    bool (*start)(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+    bool (*poll)(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+    void (*recover)(SENSOR_BUS* bus);
+} SENSOR_BUS_OPS;
+
+typedef struct {
+    uint32      submitted;
+    uint32      completed;
+    uint32      wait_polls;     // engine polls spent inside blocking calls
+    uint32      errors;         // transactions that finished with an error
+    uint32      retries;
+    uint32      timeouts;
+    uint32      recoveries;
+    uint8       depth;
+    uint8       max_depth;
+} SENSOR_QUEUE_STATS;
+
+struct sensor_bus {
+    const SENSOR_BUS_OPS*   ops;
+    void*                   context;    // state of the backend
+    uint16                  timeout_ms;
+    uint8                   max_retries;
+    SENSOR_TRANSACTION*     queue[SENSOR_QUEUE_SIZE];
+    volatile uint8          queue_head; // index of the active transaction
+    volatile uint8          queue_tail; // index of the next free slot
+    volatile bool           recovering; // ops->recover is due or running, the queue waits
+    volatile uint8          servicing;  // sensor_bus_service calls running, nested by callbacks
+    uint32                  active_since;   // timebase_ms() when the active one reached the front
+    SENSOR_QUEUE_STATS      stats;
+};
+
+// Kept by each driver to stop trying a missing or failing device on 
+// every call.  After a failure the device is skipped for a wait that
+// doubles with each failure in a row.
+typedef struct {
+    uint8       failures;       // failed transfers in a row
+    uint32      retry_at;       // timebase_ms() when the device can be tried again
+} SENSOR_BACKOFF;
+
+#if !defined(SENSOR_HOST_BUILD)
+// I2C master component of the PSoC, the default bus on the target
+extern SENSOR_BUS sensor_psoc_bus;
+#endif
   
 /***************************************
 *        Function Prototypes
 ***************************************/   
 
-void sensor_write8(uint8 address, uint8* buffer);
-void sensor_write16(uint8 address, uint8* buffer);
-void sensor_write_n(uint8 address, uint8* buffer, uint8 num_bytes);
+uint8 sensor_write8(uint8 address, uint8* buffer);
+uint8 sensor_write16(uint8 address, uint8* buffer);
+uint8 sensor_write_n(uint8 address, uint8* buffer, uint8 num_bytes);
 uint8 sensor_read8(uint8 address, uint8* buffer, uint8 _register);  
 uint16 sensor_read16(uint8 address, uint8* buffer, uint8 _register);
-void sensor_read_n(uint8 address, uint8* buffer, uint8 _register, uint8 num_bytes);
+uint8 sensor_read_n(uint8 address, uint8* buffer, uint8 _register, uint8 num_bytes);
+
+bool sensor_submit(SENSOR_TRANSACTION* transaction);
+void sensor_service(void);
+bool sensor_busy(void);
+void sensor_get_queue_stats(SENSOR_QUEUE_STATS* stats);
+
+void sensor_set_bus(SENSOR_BUS* bus);
+SENSOR_BUS* sensor_get_bus(void);
+void sensor_bus_init(SENSOR_BUS* bus, const SENSOR_BUS_OPS* ops, void* context);
+void sensor_bus_set_timeout(SENSOR_BUS* bus, uint16 timeout_ms, uint8 max_retries);
+uint8 sensor_bus_write_n(SENSOR_BUS* bus, uint8 address, uint8* buffer, uint8 num_bytes);
+uint8 sensor_bus_read_n(SENSOR_BUS* bus, uint8 address, uint8* buffer, uint8 _register, 
+                        uint8 num_bytes);
+void sensor_probe_init(SENSOR_TRANSACTION* transaction, uint8 address);
+uint8 sensor_bus_probe(SENSOR_BUS* bus, uint8 address);
+bool sensor_bus_submit(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+void sensor_bus_service(SENSOR_BUS* bus);
+bool sensor_bus_busy(SENSOR_BUS* bus);
+void sensor_bus_get_queue_stats(SENSOR_BUS* bus, SENSOR_QUEUE_STATS* stats);
+
+bool sensor_backoff_ready(SENSOR_BACKOFF* backoff);
+void sensor_backoff_update(SENSOR_BACKOFF* backoff, uint8 status);
 
 #endif
 
@@ -0,0 +1,147 @@
+/*******************************************************************************
+ * File Name: sensor_bus_count.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides a bus backend that passes every transfer to another
+ *  bus and counts the transactions, bytes and modeled bus time.  Reset the
+ *  counts before a driver call and get them after it to see what the 
+ *  call costs on the bus, e.g. with the simulated bus as the inner bus.
+ *
+*******************************************************************************
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "sensor_bus_count.h"
+
+// Bit times of the parts of a transfer, a byte is 8 bits and the ack
+#define START_BITS                  1
+#define STOP_BITS                   1
+#define BYTE_BITS                   9
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static bool count_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static bool count_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static void count_recover(SENSOR_BUS* bus);
+static void count_transaction(SENSOR_COUNTER* counter, SENSOR_TRANSACTION* transaction);
+
+static const SENSOR_BUS_OPS count_ops = {
+    count_start,
+    count_poll,
+    count_recover
+};
+
+/******************************************************************************
+* Function Name: sensor_count_init
+*******************************************************************************
+*
+* Summary:
+*  Set up a bus that counts the transfers it passes to another bus.  Only
+*  the backend of the inner bus is used, not its queue.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to set up
+*  SENSOR_COUNTER* counter: state of the counting backend
+*  SENSOR_BUS* inner: bus that does the transfers
+*  uint32 clock_hz: I2C clock rate used to model the bus time
+*
+*******************************************************************************/
+
+void sensor_count_init(SENSOR_BUS* bus, SENSOR_COUNTER* counter, SENSOR_BUS* inner, 
+                       uint32 clock_hz) {
+    counter->inner = inner;
+    counter->clock_hz = clock_hz;
+    sensor_count_reset(counter);
+    sensor_bus_init(bus, &count_ops, counter);
+}
+
+void sensor_count_reset(SENSOR_COUNTER* counter) {
+    SENSOR_COUNTS empty_counts = {0};
+    counter->counts = empty_counts;
+}
+
+/******************************************************************************
+* Function Name: sensor_count_get
+*******************************************************************************
+*
+* Summary:
+*  Copy the counts made since the last reset, with the bus time worked out
+*  from the bit count.
+*
+*******************************************************************************/
+
+void sensor_count_get(SENSOR_COUNTER* counter, SENSOR_COUNTS* counts) {
+    *counts = counter->counts;
+    // split so the multiply does not overflow 32 bits
+    counts->bus_time_us = (counts->bits / counter->clock_hz) * 1000000 + 
+        ((counts->bits % counter->clock_hz) * 1000) / (counter->clock_hz / 1000);
+}
+
+static bool count_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    SENSOR_BUS* inner = ((SENSOR_COUNTER*) bus->context)->inner;
+    return inner->ops->start(inner, transaction);
+}
+
+static bool count_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    SENSOR_COUNTER* counter = (SENSOR_COUNTER*) bus->context;
+    if (!counter->inner->ops->poll(counter->inner, transaction)) {
+        return false;
+    }
+    count_transaction(counter, transaction);
+    return true;
+}
+
+static void count_recover(SENSOR_BUS* bus) {
+    SENSOR_BUS* inner = ((SENSOR_COUNTER*) bus->context)->inner;
+    if (inner->ops->recover) {
+        inner->ops->recover(inner);
+    }
+}
+
+/******************************************************************************
+* Function Name: count_transaction
+*******************************************************************************
+*
+* Summary:
+*  Add a finished transaction to the counts.  A write is the address and
+*  the buffer, a read is the address and register, a repeated start, the
+*  address again and the data.  A transfer that was not acknowledged is 
+*  counted as only its address byte.
+*
+*******************************************************************************/
+
+static void count_transaction(SENSOR_COUNTER* counter, SENSOR_TRANSACTION* transaction) {
+    uint32 bytes;
+    uint32 bits;
+    
+    if (transaction->status == SENSOR_ERR_NAK) {
+        bytes = 1;
+        bits = START_BITS + BYTE_BITS + STOP_BITS;
+    }
+    else if (transaction->type == SENSOR_XFER_WRITE) {
+        bytes = 1 + transaction->num_bytes;
+        bits = START_BITS + bytes * BYTE_BITS + STOP_BITS;
+    }
+    else {
+        bytes = 3 + transaction->num_bytes;
+        bits = 2 * START_BITS + bytes * BYTE_BITS + STOP_BITS;
+    }
+    counter->counts.transactions++;
+    if (transaction->status != SENSOR_OK) {
+        counter->counts.errors++;
+    }
+    counter->counts.bytes += bytes;
+    counter->counts.bits += bits;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,62 @@
+/*******************************************************************************
+ * File Name: sensor_bus_count.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the counting bus backend, used to measure how much
+ *  bus traffic each driver function makes.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_SENSOR_BUS_COUNT_H)
+#define _SENSOR_BUS_COUNT_H
+    
+#include "sensor.h"
+    
+/***************************************
+*      Counting constants
+***************************************/ 
+
+#define SENSOR_COUNT_STANDARD_HZ    100000
+#define SENSOR_COUNT_FAST_HZ        400000
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+typedef struct {
+    uint32      transactions;
+    uint32      errors;         // transactions that did not end with SENSOR_OK
+    uint32      bytes;          // bytes on the wire, address bytes included
+    uint32      bits;           // bit times on the wire, with start, stop and ack bits
+    uint32      bus_time_us;    // bits at the modeled clock rate
+} SENSOR_COUNTS;
+
+typedef struct {
+    SENSOR_BUS*     inner;      // bus that does the transfers
+    uint32          clock_hz;   // modeled I2C clock rate
+    SENSOR_COUNTS   counts;
+} SENSOR_COUNTER;
+  
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void sensor_count_init(SENSOR_BUS* bus, SENSOR_COUNTER* counter, SENSOR_BUS* inner, 
+                       uint32 clock_hz);
+void sensor_count_reset(SENSOR_COUNTER* counter);
+void sensor_count_get(SENSOR_COUNTER* counter, SENSOR_COUNTS* counts);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,349 @@
+/*******************************************************************************
+ * File Name: sensor_bus_linux.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the bus backend for the Linux i2c-dev interface.
+ *  Build it with SENSOR_HOST_BUILD defined on Linux.  Every transfer is
+ *  an I2C_RDWR ioctl, so a read sends its register and reads the data
+ *  after a repeated start in one system call.
+ *
+ *  The ioctl blocks until the transfer is done, so a started transaction
+ *  is held until a service of the bus finds no new transaction queued
+ *  since the last one.  Then the held transaction and the ones queued
+ *  behind it are sent as the messages of one I2C_RDWR.  The transactions
+ *  queued by one pass of the main loop, like the reads of the pipeline,
+ *  cost one system call.  If a batch fails, e.g. one device does not
+ *  answer, each transaction of it is sent again on its own to get its
+ *  own status, so a write ahead of the failure can reach its device twice.
+ *  Probes are never batched, their NAK is expected.  A transaction the
+ *  engine tries again is sent on its own while the ones sent behind it
+ *  still wait for their results, so they are not sent again.
+ *
+*******************************************************************************
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "sensor_bus_linux.h"
+
+// A read is the write of its register and the read of the data
+#define MAX_MESSAGES                (2 * SENSOR_LINUX_MAX_BATCH)
+#define IS_PROBE(transaction)       (((transaction)->type == SENSOR_XFER_WRITE) && \
+                                     ((transaction)->num_bytes == 0))
+
+/***************************************
+*      Static Function Prototypes
+***************************************/
+
+static bool linux_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static bool linux_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static void linux_transfer(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev);
+static uint8 linux_send(SENSOR_LINUX* i2c_dev, SENSOR_TRANSACTION** batch, uint8 num);
+static bool linux_results_waiting(SENSOR_LINUX* i2c_dev);
+static uint8 linux_status(int error);
+static int linux_ioctl(void* context, int fd, unsigned long request, void* arg);
+
+// the kernel times out and recovers the adapter inside the ioctl
+static const SENSOR_BUS_OPS linux_ops = {
+    linux_start,
+    linux_poll,
+    0
+};
+
+/******************************************************************************
+* Function Name: sensor_linux_open
+*******************************************************************************
+*
+* Summary:
+*  Open /dev/i2c-<adapter> and set up a bus that uses it.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to set up
+*  SENSOR_LINUX* i2c_dev: state of the backend
+*  uint8 adapter: number of the I2C adapter
+*
+* Return:
+*  bool: true if the adapter was opened, false with errno set if not
+*
+*******************************************************************************/
+
+bool sensor_linux_open(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev, uint8 adapter) {
+    char path[20];
+    int fd;
+
+    snprintf(path, sizeof(path), "/dev/i2c-%u", adapter);
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return false;
+    }
+    sensor_linux_init(bus, i2c_dev, fd, 0, 0);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: sensor_linux_init
+*******************************************************************************
+*
+* Summary:
+*  Set up a bus on an i2c-dev file that is already open, or on a fake
+*  adapter.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to set up
+*  SENSOR_LINUX* i2c_dev: state of the backend
+*  int fd: open i2c-dev file
+*  sensor_linux_ioctl ioctl: called instead of ioctl(2), or 0 for ioctl(2)
+*  void* ioctl_context: passed to the ioctl function
+*
+*******************************************************************************/
+
+void sensor_linux_init(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev, int fd,
+                       sensor_linux_ioctl ioctl, void* ioctl_context) {
+    i2c_dev->fd = fd;
+    i2c_dev->ioctl = ioctl ? ioctl : linux_ioctl;
+    i2c_dev->ioctl_context = ioctl_context;
+    i2c_dev->max_batch = SENSOR_LINUX_MAX_BATCH;
+    i2c_dev->active = 0;
+    i2c_dev->held = false;
+    i2c_dev->num_results = 0;
+    i2c_dev->ioctls = 0;
+    i2c_dev->batched = 0;
+    sensor_bus_init(bus, &linux_ops, i2c_dev);
+}
+
+void sensor_linux_close(SENSOR_LINUX* i2c_dev) {
+    close(i2c_dev->fd);
+    i2c_dev->fd = -1;
+}
+
+/******************************************************************************
+* Function Name: linux_start
+*******************************************************************************
+*
+* Summary:
+*  Start a transaction.  One that was already sent in the batch of the
+*  transaction ahead of it just gets its status, the others are held to
+*  be sent by linux_poll.
+*
+* Return:
+*  bool: always true
+*
+*******************************************************************************/
+
+static bool linux_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    SENSOR_LINUX* i2c_dev = bus->context;
+    uint8 i;
+
+    transaction->state = SENSOR_XFER_WRITING;
+    for (i = 0; i < i2c_dev->num_results; i++) {
+        if (i2c_dev->results[i].transaction == transaction) {
+            transaction->status = i2c_dev->results[i].status;
+            i2c_dev->results[i].transaction = 0;
+            return true;
+        }
+    }
+    i2c_dev->active = transaction;
+    i2c_dev->held = false;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: linux_poll
+*******************************************************************************
+*
+* Summary:
+*  Hold the active transaction while more transactions are being queued
+*  behind it, then send them all.
+*
+* Return:
+*  bool: true if the transaction has finished
+*
+*******************************************************************************/
+
+static bool linux_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    SENSOR_LINUX* i2c_dev = bus->context;
+
+    if (i2c_dev->active != transaction) {
+        return true;  // finished in the batch ahead of it
+    }
+    if (!i2c_dev->held || (bus->queue_tail != i2c_dev->held_tail)) {
+        i2c_dev->held = true;
+        i2c_dev->held_tail = bus->queue_tail;
+        return false;
+    }
+    linux_transfer(bus, i2c_dev);
+    i2c_dev->active = 0;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: linux_transfer
+*******************************************************************************
+*
+* Summary:
+*  Send the active transaction with the ones queued behind it, up to the
+*  first probe.  The status of the active one is set, the others are kept
+*  in the results until the engine starts them.  A retry of the active 
+*  one is sent alone if the ones behind it are still in the results.
+*
+*******************************************************************************/
+
+static void linux_transfer(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev) {
+    SENSOR_TRANSACTION* batch[SENSOR_LINUX_MAX_BATCH];
+    SENSOR_TRANSACTION* transaction;
+    SENSOR_LINUX_RESULT* result;
+    uint8 depth = bus->queue_tail - bus->queue_head;
+    uint8 num = 1;
+    uint8 batch_status;
+    uint8 status;
+    uint8 i;
+
+    batch[0] = i2c_dev->active;
+    if (!IS_PROBE(batch[0]) && !linux_results_waiting(i2c_dev)) {
+        for (i = 1; (i < depth) && (num < i2c_dev->max_batch); i++) {
+            transaction = bus->queue[(uint8) (bus->queue_head + i) & (SENSOR_QUEUE_SIZE - 1)];
+            if (IS_PROBE(transaction)) {
+                break;
+            }
+            batch[num++] = transaction;
+        }
+    }
+    batch_status = linux_send(i2c_dev, batch, num);
+    if (num == 1) {
+        batch[0]->status = batch_status;
+        return;
+    }
+    if (batch_status == SENSOR_OK) {
+        i2c_dev->batched += num - 1;
+    }
+    i2c_dev->num_results = 0;
+    for (i = 0; i < num; i++) {
+        status = batch_status;
+        // a failed batch does not tell which transaction failed
+        if (batch_status != SENSOR_OK) {
+            status = linux_send(i2c_dev, &batch[i], 1);
+        }
+        if (i == 0) {
+            batch[0]->status = status;
+            continue;
+        }
+        result = &i2c_dev->results[i2c_dev->num_results++];
+        result->transaction = batch[i];
+        result->status = status;
+    }
+}
+
+/******************************************************************************
+* Function Name: linux_results_waiting
+*******************************************************************************
+*
+* Return:
+*  bool: true if a transaction sent in an earlier batch has not been 
+*        started by the engine yet
+*
+*******************************************************************************/
+
+static bool linux_results_waiting(SENSOR_LINUX* i2c_dev) {
+    uint8 i;
+
+    for (i = 0; i < i2c_dev->num_results; i++) {
+        if (i2c_dev->results[i].transaction) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function Name: linux_send
+*******************************************************************************
+*
+* Summary:
+*  Send transactions as the messages of one I2C_RDWR, with a repeated
+*  start between the messages and one stop at the end.  An adapter that
+*  refuses more than one transaction is not sent batches again.
+*
+* Return:
+*  uint8: SENSOR_OK or the SENSOR_ERR_* code of the ioctl
+*
+*******************************************************************************/
+
+static uint8 linux_send(SENSOR_LINUX* i2c_dev, SENSOR_TRANSACTION** batch, uint8 num) {
+    struct i2c_msg messages[MAX_MESSAGES];
+    struct i2c_rdwr_ioctl_data data;
+    SENSOR_TRANSACTION* transaction;
+    uint8 num_messages = 0;
+    uint8 i;
+
+    for (i = 0; i < num; i++) {
+        transaction = batch[i];
+        messages[num_messages].addr = transaction->address;
+        messages[num_messages].flags = 0;
+        if (transaction->type == SENSOR_XFER_WRITE) {
+            messages[num_messages].len = transaction->num_bytes;
+            messages[num_messages].buf = transaction->buffer;
+            num_messages++;
+            continue;
+        }
+        messages[num_messages].len = 1;
+        messages[num_messages].buf = &transaction->_register;
+        num_messages++;
+        messages[num_messages].addr = transaction->address;
+        messages[num_messages].flags = I2C_M_RD;
+        messages[num_messages].len = transaction->num_bytes;
+        messages[num_messages].buf = transaction->buffer;
+        num_messages++;
+    }
+    data.msgs = messages;
+    data.nmsgs = num_messages;
+    i2c_dev->ioctls++;
+    if (i2c_dev->ioctl(i2c_dev->ioctl_context, i2c_dev->fd, I2C_RDWR, &data) >= 0) {
+        return SENSOR_OK;
+    }
+    if ((num > 1) && ((errno == EINVAL) || (errno == EOPNOTSUPP))) {
+        i2c_dev->max_batch = 1;
+    }
+    return linux_status(errno);
+}
+
+/******************************************************************************
+* Function Name: linux_status
+*******************************************************************************
+*
+* Summary:
+*  Convert the errno of a failed I2C_RDWR to a status.  Adapter drivers
+*  report a missing acknowledge with ENXIO or EREMOTEIO.
+*
+*******************************************************************************/
+
+static uint8 linux_status(int error) {
+    if ((error == ENXIO) || (error == EREMOTEIO)) {
+        return SENSOR_ERR_NAK;
+    }
+    if (error == ETIMEDOUT) {
+        return SENSOR_ERR_TIMEOUT;
+    }
+    return SENSOR_ERR_BUS;
+}
+
+static int linux_ioctl(void* context, int fd, unsigned long request, void* arg) {
+    (void) context;
+    return ioctl(fd, request, arg);
+}
+
+/* [] END OF FILE */
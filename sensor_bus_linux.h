@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * File Name: sensor_bus_linux.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the bus backend for the Linux i2c-dev interface, to
+ *  run the drivers on a single board computer from userspace.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_SENSOR_BUS_LINUX_H)
+#define _SENSOR_BUS_LINUX_H
+
+#include "sensor.h"
+
+/***************************************
+*      Linux bus constants
+***************************************/
+
+// Most transactions sent in one I2C_RDWR ioctl, a read is two messages
+#define SENSOR_LINUX_MAX_BATCH      SENSOR_QUEUE_SIZE
+
+/***************************************
+*      Structures
+***************************************/
+
+// Call made for every ioctl of the backend, with the same return and errno
+// as ioctl(2).  Replaced to run the backend against a fake adapter.
+typedef int (*sensor_linux_ioctl)(void* context, int fd, unsigned long request, void* arg);
+
+// A transaction that was sent in the batch of the one ahead of it, and
+// its status, kept until the engine gets to it
+typedef struct {
+    SENSOR_TRANSACTION* transaction;
+    uint8               status;
+} SENSOR_LINUX_RESULT;
+
+typedef struct {
+    int                 fd;
+    sensor_linux_ioctl  ioctl;
+    void*               ioctl_context;
+    uint8               max_batch;  // set to 1 if the adapter refuses batches
+    SENSOR_TRANSACTION* active;     // started and held for a batch
+    bool                held;       // active was held by a poll already
+    uint8               held_tail;  // queue_tail of the bus the last time it was held
+    SENSOR_LINUX_RESULT results[SENSOR_LINUX_MAX_BATCH];
+    uint8               num_results;
+    uint32              ioctls;     // I2C_RDWR calls made
+    uint32              batched;    // transactions sent in the batch of another one
+} SENSOR_LINUX;
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+bool sensor_linux_open(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev, uint8 adapter);
+void sensor_linux_init(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev, int fd,
+                       sensor_linux_ioctl ioctl, void* ioctl_context);
+void sensor_linux_close(SENSOR_LINUX* i2c_dev);
+
+#endif
+
+/* [] END OF FILE */
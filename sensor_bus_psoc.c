@@ -0,0 +1,246 @@
+/*******************************************************************************
+ * File Name: sensor_bus_psoc.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the bus backend for the PSoC I2C master component.
+ *  A I2C master component with the name I2C is required.
+ *
+ *  To have the I2C interrupt move the transaction queue, add
+ *  #define I2C_ISR_EXIT_CALLBACK to cyapicallbacks.h, otherwise the queue
+ *  is moved by the main loop and by the blocking functions.
+ *
+*******************************************************************************
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "sensor.h"
+
+/***************************************
+*      Bus recovery constants
+***************************************/  
+
+// A slave can be holding SDA low for the rest of a byte and its ACK bit
+#define RECOVERY_CLOCKS             9
+// Half of a 100 kHz clock period
+#define RECOVERY_HALF_PERIOD_US     5
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static bool psoc_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static bool psoc_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static void psoc_recover(SENSOR_BUS* bus);
+static void pins_to_firmware(bool firmware);
+static uint8 psoc_status(uint8 master_status);
+
+static const SENSOR_BUS_OPS psoc_ops = {
+    psoc_start,
+    psoc_poll,
+    psoc_recover
+};
+
+SENSOR_BUS sensor_psoc_bus = {
+    .ops = &psoc_ops,
+    .timeout_ms = SENSOR_DEFAULT_TIMEOUT_MS,
+    .max_retries = SENSOR_DEFAULT_RETRIES
+};
+
+/******************************************************************************
+* Function Name: psoc_start
+*******************************************************************************
+*
+* Summary:
+*  Start the first phase of a transaction.  A write sends the whole buffer,
+*  a read sends the register address without a stop.
+*
+* Return:
+*  bool: true if started, false if the I2C master was not ready
+*
+*******************************************************************************/
+
+static bool psoc_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    uint8 error;
+    (void) bus;
+    
+    I2C_MasterClearStatus();
+    I2C_MasterClearWriteBuf();
+    if (transaction->type == SENSOR_XFER_WRITE) {
+        error = I2C_MasterWriteBuf(transaction->address, transaction->buffer, 
+                                   transaction->num_bytes, I2C_MODE_COMPLETE_XFER);
+    }
+    else {
+        error = I2C_MasterWriteBuf(transaction->address, &transaction->_register, 
+                                   1, I2C_MODE_NO_STOP);
+    }
+    if (error != I2C_MSTR_NO_ERROR) {
+        return false;
+    }
+    transaction->state = SENSOR_XFER_WRITING;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: psoc_poll
+*******************************************************************************
+*
+* Summary:
+*  Check if the active transfer phase has finished.  After the register
+*  address of a read, start the read with a repeated start.
+*
+* Return:
+*  bool: true if the transaction has finished
+*
+*******************************************************************************/
+
+static bool psoc_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    uint8 status = I2C_MasterStatus();
+    (void) bus;
+    
+    if (transaction->state == SENSOR_XFER_WRITING) {
+        if (0x00 == (status & I2C_MSTAT_WR_CMPLT)) {
+            return false;
+        }
+        I2C_MasterClearStatus();
+        I2C_MasterClearWriteBuf();
+        transaction->status = psoc_status(status);
+        if ((transaction->type == SENSOR_XFER_WRITE) || (transaction->status != SENSOR_OK)) {
+            return true;
+        }
+        I2C_MasterClearReadBuf();
+        if (I2C_MSTR_NO_ERROR == I2C_MasterReadBuf(transaction->address, transaction->buffer, 
+                transaction->num_bytes, I2C_MODE_REPEAT_START)) {
+            transaction->state = SENSOR_XFER_READING;
+        }
+        else {
+            // bus was not ready, send the register again
+            transaction->state = SENSOR_XFER_QUEUED;
+        }
+        return false;
+    }
+    // SENSOR_XFER_READING
+    if (0x00 == (status & I2C_MSTAT_RD_CMPLT)) {
+        return false;
+    }
+    I2C_MasterClearStatus();
+    I2C_MasterClearReadBuf();
+    transaction->status = psoc_status(status);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: psoc_recover
+*******************************************************************************
+*
+* Summary:
+*  Free a stuck bus after a timeout.  Stop the I2C master, take the I2C_scl
+*  and I2C_sda pins over from it and drive them directly: clock SCL until 
+*  the slave that is holding SDA low lets go, at most 9 times, then make a
+*  stop condition, give the pins back and start the master again.  Takes 
+*  about 100 us, the engine calls it with interrupts enabled.
+*
+*******************************************************************************/
+
+static void psoc_recover(SENSOR_BUS* bus) {
+    uint8 i;
+    (void) bus;
+    
+    I2C_Stop();
+    // released lines, so the pins do not pull low when they switch over
+    I2C_scl_Write(1);
+    I2C_sda_Write(1);
+    pins_to_firmware(true);
+    for (i = 0; (i < RECOVERY_CLOCKS) && (0 == I2C_sda_Read()); i++) {
+        I2C_scl_Write(0);
+        CyDelayUs(RECOVERY_HALF_PERIOD_US);
+        I2C_scl_Write(1);
+        CyDelayUs(RECOVERY_HALF_PERIOD_US);
+    }
+    // stop condition, SDA going high while SCL is high
+    I2C_scl_Write(0);
+    CyDelayUs(RECOVERY_HALF_PERIOD_US);
+    I2C_sda_Write(0);
+    CyDelayUs(RECOVERY_HALF_PERIOD_US);
+    I2C_scl_Write(1);
+    CyDelayUs(RECOVERY_HALF_PERIOD_US);
+    I2C_sda_Write(1);
+    CyDelayUs(RECOVERY_HALF_PERIOD_US);
+    
+    pins_to_firmware(false);
+    I2C_Start();
+}
+
+/******************************************************************************
+* Function Name: pins_to_firmware
+*******************************************************************************
+*
+* Summary:
+*  Switch the I2C_scl and I2C_sda pins between the I2C block and their data
+*  registers.  While the bypass bit of a pin is set the pad follows the 
+*  block and writes to the data register do not reach it.  The bypass 
+*  registers are shared with the other pins of the ports.
+*
+* Parameters:
+*  bool firmware: true to drive the pins with I2C_scl_Write and 
+*                 I2C_sda_Write, false to give them back to the I2C block
+*
+*******************************************************************************/
+
+static void pins_to_firmware(bool firmware) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    if (firmware) {
+        CY_SET_REG8(I2C_scl__BYP, CY_GET_REG8(I2C_scl__BYP) & ~I2C_scl__MASK);
+        CY_SET_REG8(I2C_sda__BYP, CY_GET_REG8(I2C_sda__BYP) & ~I2C_sda__MASK);
+    }
+    else {
+        CY_SET_REG8(I2C_scl__BYP, CY_GET_REG8(I2C_scl__BYP) | I2C_scl__MASK);
+        CY_SET_REG8(I2C_sda__BYP, CY_GET_REG8(I2C_sda__BYP) | I2C_sda__MASK);
+    }
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: psoc_status
+*******************************************************************************
+*
+* Return:
+*  uint8: SENSOR_OK or SENSOR_ERR_* code for an I2C_MasterStatus value
+*
+*******************************************************************************/
+
+static uint8 psoc_status(uint8 master_status) {
+    if (master_status & I2C_MSTAT_ERR_ADDR_NAK) {
+        return SENSOR_ERR_NAK;
+    }
+    if (master_status & I2C_MSTAT_ERR_XFER) {
+        return SENSOR_ERR_BUS;
+    }
+    return SENSOR_OK;
+}
+
+/******************************************************************************
+* Function Name: I2C_ISR_ExitCallback
+*******************************************************************************
+*
+* Summary:
+*  Called by the I2C component at the end of its interrupt when 
+*  I2C_ISR_EXIT_CALLBACK is defined in cyapicallbacks.h.  Moves the 
+*  transaction queue forward as soon as a transfer phase finishes.
+*
+*******************************************************************************/
+
+#if defined(I2C_ISR_EXIT_CALLBACK)
+void I2C_ISR_ExitCallback(void) {
+    sensor_bus_service(&sensor_psoc_bus);
+}
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,414 @@
+/*******************************************************************************
+ * File Name: sensor_bus_sim.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides a simulated I2C bus backend so the drivers can run 
+ *  off-target.  Each device on the bus is a register level model of an 
+ *  isl29125 or tsl2561.  Transfers finish as soon as they are started, a
+ *  conversion is made from the set light level at the start of every 
+ *  transfer to a device.
+ *
+*******************************************************************************
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "sensor_bus_sim.h"
+#include "isl29125.h"
+#include "tsl2561.h"
+
+// TSL2561 command byte
+#define SIM_TSL2561_CMD             0x80
+#define SIM_TSL2561_CLEAR           0x40
+#define SIM_TSL2561_ADDRESS_MASK    0x0F
+#define SIM_TSL2561_POWER_ON        0x03
+#define SIM_TSL2561_GAIN_16X        0x10
+#define SIM_TSL2561_INTEG_MASK      0x03
+#define SIM_TSL2561_PART_ID         0x50
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static bool sim_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static bool sim_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static SENSOR_SIM_DEVICE* sim_find(SENSOR_SIM* sim, uint8 address);
+static SENSOR_SIM_DEVICE* sim_add(SENSOR_SIM* sim, uint8 model, uint8 address);
+
+static void isl29125_model_reset(SENSOR_SIM_DEVICE* device);
+static void isl29125_model_convert(SENSOR_SIM_DEVICE* device);
+static void isl29125_model_write(SENSOR_SIM_DEVICE* device, uint8* buffer, uint8 num_bytes);
+static void isl29125_model_read(SENSOR_SIM_DEVICE* device, uint8* buffer, uint8 num_bytes);
+
+static void tsl2561_model_convert(SENSOR_SIM_DEVICE* device);
+static void tsl2561_model_write(SENSOR_SIM_DEVICE* device, uint8* buffer, uint8 num_bytes);
+static void tsl2561_model_read(SENSOR_SIM_DEVICE* device, uint8* buffer, uint8 num_bytes);
+
+// transfers never get stuck, so there is nothing to recover
+static const SENSOR_BUS_OPS sim_ops = {
+    sim_start,
+    sim_poll,
+    0
+};
+
+/******************************************************************************
+* Function Name: sensor_sim_init
+*******************************************************************************
+*
+* Summary:
+*  Set up a bus that uses the simulation, with no devices on it.
+*
+* Parameters:
+*  SENSOR_BUS* bus: bus to set up
+*  SENSOR_SIM* sim: state of the simulated devices
+*
+*******************************************************************************/
+
+void sensor_sim_init(SENSOR_BUS* bus, SENSOR_SIM* sim) {
+    sim->num_devices = 0;
+    sensor_bus_init(bus, &sim_ops, sim);
+}
+
+/******************************************************************************
+* Function Name: sensor_sim_add_isl29125
+*******************************************************************************
+*
+* Summary:
+*  Put a simulated isl29125 on the bus, in its power on state.
+*
+* Return:
+*  SENSOR_SIM_DEVICE*: the device, or 0 if the simulation is full
+*
+*******************************************************************************/
+
+SENSOR_SIM_DEVICE* sensor_sim_add_isl29125(SENSOR_SIM* sim, uint8 address) {
+    SENSOR_SIM_DEVICE* device = sim_add(sim, SENSOR_SIM_ISL29125, address);
+    if (device) {
+        isl29125_model_reset(device);
+    }
+    return device;
+}
+
+/******************************************************************************
+* Function Name: sensor_sim_add_tsl2561
+*******************************************************************************
+*
+* Summary:
+*  Put a simulated tsl2561 on the bus, powered down.
+*
+* Return:
+*  SENSOR_SIM_DEVICE*: the device, or 0 if the simulation is full
+*
+*******************************************************************************/
+
+SENSOR_SIM_DEVICE* sensor_sim_add_tsl2561(SENSOR_SIM* sim, uint8 address) {
+    SENSOR_SIM_DEVICE* device = sim_add(sim, SENSOR_SIM_TSL2561, address);
+    if (device) {
+        device->registers[TSL2561_REG_ID] = SIM_TSL2561_PART_ID;
+    }
+    return device;
+}
+
+/******************************************************************************
+* Function Name: sensor_sim_set_light
+*******************************************************************************
+*
+* Summary:
+*  Set the light a simulated device sees, used from the next transfer on.
+*
+* Parameters:
+*  SENSOR_SIM_DEVICE* device: device to set
+*  uint16 light0, light1, light2: isl29125 red, green and blue counts at 
+*       375 lux and 16 bits, or tsl2561 channel 0 and 1 counts at 402 ms
+*       and 16x gain (light2 is not used)
+*
+*******************************************************************************/
+
+void sensor_sim_set_light(SENSOR_SIM_DEVICE* device, uint16 light0, uint16 light1, 
+                          uint16 light2) {
+    device->light[0] = light0;
+    device->light[1] = light1;
+    device->light[2] = light2;
+}
+
+/******************************************************************************
+* Function Name: sim_start
+*******************************************************************************
+*
+* Summary:
+*  Do the whole transfer with the simulated device at the address.
+*
+*******************************************************************************/
+
+static bool sim_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    SENSOR_SIM_DEVICE* device = sim_find((SENSOR_SIM*) bus->context, transaction->address);
+    
+    transaction->state = SENSOR_XFER_WRITING;
+    if (!device) {
+        transaction->status = SENSOR_ERR_NAK;
+        return true;
+    }
+    transaction->status = SENSOR_OK;
+    if (device->model == SENSOR_SIM_ISL29125) {
+        isl29125_model_convert(device);
+        if (transaction->type == SENSOR_XFER_WRITE) {
+            isl29125_model_write(device, transaction->buffer, transaction->num_bytes);
+        }
+        else {
+            isl29125_model_write(device, &transaction->_register, 1);
+            isl29125_model_read(device, transaction->buffer, transaction->num_bytes);
+        }
+    }
+    else {
+        tsl2561_model_convert(device);
+        if (transaction->type == SENSOR_XFER_WRITE) {
+            tsl2561_model_write(device, transaction->buffer, transaction->num_bytes);
+        }
+        else {
+            tsl2561_model_write(device, &transaction->_register, 1);
+            tsl2561_model_read(device, transaction->buffer, transaction->num_bytes);
+        }
+    }
+    return true;
+}
+
+static bool sim_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    (void) bus;
+    (void) transaction;
+    return true;
+}
+
+static SENSOR_SIM_DEVICE* sim_find(SENSOR_SIM* sim, uint8 address) {
+    uint8 i;
+    for (i = 0; i < sim->num_devices; i++) {
+        if ((sim->devices[i].address == address) && sim->devices[i].present) {
+            return &sim->devices[i];
+        }
+    }
+    return 0;
+}
+
+static SENSOR_SIM_DEVICE* sim_add(SENSOR_SIM* sim, uint8 model, uint8 address) {
+    SENSOR_SIM_DEVICE* device;
+    uint8 i;
+    
+    if (sim->num_devices >= SENSOR_SIM_MAX_DEVICES) {
+        return 0;
+    }
+    device = &sim->devices[sim->num_devices++];
+    device->model = model;
+    device->address = address;
+    device->present = true;
+    device->pointer = 0;
+    device->interrupt = false;
+    for (i = 0; i < SENSOR_SIM_NUM_REGISTERS; i++) {
+        device->registers[i] = 0x00;
+    }
+    sensor_sim_set_light(device, 0, 0, 0);
+    return device;
+}
+
+/******************************************************************************
+* ISL29125 model
+******************************************************************************/
+
+static void isl29125_model_reset(SENSOR_SIM_DEVICE* device) {
+    uint8 i;
+    for (i = 0; i < SENSOR_SIM_NUM_REGISTERS; i++) {
+        device->registers[i] = 0x00;
+    }
+    device->registers[ISL29125_DEVICE_ID_REG] = ISL29125_DEVICE_ID;
+    device->registers[ISL29125_THRESHOLD_HIGH_REG] = 0xFF;
+    device->registers[ISL29125_THRESHOLD_HIGH_REG + 1] = 0xFF;
+    device->interrupt = false;
+}
+
+/******************************************************************************
+* Function Name: isl29125_model_convert
+*******************************************************************************
+*
+* Summary:
+*  Make a conversion of the colors enabled by the mode, at the set range 
+*  and resolution, and set the status and INT pin like the device does.
+*
+*******************************************************************************/
+
+static void isl29125_model_convert(SENSOR_SIM_DEVICE* device) {
+    // data register of each color: red, green, blue
+    static const uint8 data_registers[3] = {
+        ISL29125_RED_REG, ISL29125_GREEN_REG, ISL29125_BLUE_REG
+    };
+    // colors converted in each mode, bit 0 red, bit 1 green, bit 2 blue
+    static const uint8 mode_colors[8] = {0x00, 0x02, 0x01, 0x04, 0x00, 0x07, 0x03, 0x06};
+    uint8* registers = device->registers;
+    uint8 config1 = registers[ISL29125_CONFIG_REG_1];
+    uint8 colors = mode_colors[config1 & 0x07];
+    uint32 value;
+    uint16 level;
+    uint16 low;
+    uint16 high;
+    uint8 i;
+    
+    if (colors == 0x00) {
+        return;
+    }
+    for (i = 0; i < 3; i++) {
+        if (0x00 == (colors & (1 << i))) {
+            continue;
+        }
+        value = device->light[i];
+        if (config1 & ISL29125_CONFIG1_10KLUX) {
+            value = value * 3 / 80;
+        }
+        if (config1 & ISL29125_CONFIG1_ADC_12BIT) {
+            value >>= 4;
+        }
+        registers[data_registers[i]] = value & 0xFF;
+        registers[data_registers[i] + 1] = value >> 8;
+    }
+    registers[ISL29125_STATUS_REG] |= ISL29125_STATUS_CONVERSION_DONE;
+    
+    switch (registers[ISL29125_CONFIG_REG_3] & ISL29125_INT_COLOR_MASK) {
+        case ISL29125_CONFIG3_G_INT:
+            level = REGMAP_VALUE(ISL29125_GREEN_REG, &registers[ISL29125_GREEN_REG]);
+            break;
+        case ISL29125_CONFIG3_R_INT:
+            level = REGMAP_VALUE(ISL29125_RED_REG, &registers[ISL29125_RED_REG]);
+            break;
+        case ISL29125_CONFIG3_B_INT:
+            level = REGMAP_VALUE(ISL29125_BLUE_REG, &registers[ISL29125_BLUE_REG]);
+            break;
+        default:
+            level = 0;
+            break;
+    }
+    low = REGMAP_VALUE(ISL29125_THRESHOLD_LOW_REG, &registers[ISL29125_THRESHOLD_LOW_REG]);
+    high = REGMAP_VALUE(ISL29125_THRESHOLD_HIGH_REG, &registers[ISL29125_THRESHOLD_HIGH_REG]);
+    if ((registers[ISL29125_CONFIG_REG_3] & ISL29125_INT_COLOR_MASK) && ((level < low) || (level > high))) {
+        registers[ISL29125_STATUS_REG] |= ISL29125_STATUS_THRESHOLD_INT;
+    }
+    if ((registers[ISL29125_STATUS_REG] & ISL29125_STATUS_THRESHOLD_INT) ||
+            (registers[ISL29125_CONFIG_REG_3] & ISL29125_CONFIG3_ENABLE_INT_ON_CONVERSION)) {
+        device->interrupt = true;
+    }
+}
+
+static void isl29125_model_write(SENSOR_SIM_DEVICE* device, uint8* buffer, uint8 num_bytes) {
+    uint8 i;
+    uint8 _register;
+    
+    if (num_bytes == 0) {
+        return;
+    }
+    device->pointer = buffer[0];
+    for (i = 1; i < num_bytes; i++) {
+        _register = device->pointer++;
+        if ((_register == ISL29125_DEVICE_ID_REG) && (buffer[i] == ISL29125_DEVICE_RESET_CODE)) {
+            isl29125_model_reset(device);
+        }
+        else if ((_register >= ISL29125_CONFIG_REG_1) && (_register <= ISL29125_THRESHOLD_HIGH_REG + 1)) {
+            device->registers[_register] = buffer[i];
+        }
+        else if (_register == ISL29125_STATUS_REG) {
+            // only the interrupt and brownout flags can be written, to clear them
+            device->registers[_register] &= (buffer[i] | ~(ISL29125_STATUS_THRESHOLD_INT | 
+                                                           ISL29125_STATUS_BROWNOUT));
+        }
+    }
+}
+
+static void isl29125_model_read(SENSOR_SIM_DEVICE* device, uint8* buffer, uint8 num_bytes) {
+    uint8 i;
+    for (i = 0; i < num_bytes; i++) {
+        if (device->pointer < SENSOR_SIM_NUM_REGISTERS) {
+            buffer[i] = device->registers[device->pointer];
+        }
+        else {
+            buffer[i] = 0x00;
+        }
+        if (device->pointer == ISL29125_STATUS_REG) {
+            // reading the status releases the INT pin
+            device->registers[ISL29125_STATUS_REG] &= ~ISL29125_STATUS_THRESHOLD_INT;
+            device->interrupt = false;
+        }
+        device->pointer++;
+    }
+}
+
+/******************************************************************************
+* TSL2561 model
+******************************************************************************/
+
+/******************************************************************************
+* Function Name: tsl2561_model_convert
+*******************************************************************************
+*
+* Summary:
+*  Make an integration at the set gain and time if the device is powered,
+*  clipped at the maximum count of the integration time.
+*
+*******************************************************************************/
+
+static void tsl2561_model_convert(SENSOR_SIM_DEVICE* device) {
+    // 13.7 ms and 101 ms integrations scale the 402 ms counts by 11/322 and 81/322
+    static const uint16 integ_scale[4] = {11, 81, 322, 322};
+    static const uint16 integ_max[4] = {5047, 37177, 65535, 65535};
+    uint8* registers = device->registers;
+    uint8 integ = registers[TSL2561_REG_TIMING] & SIM_TSL2561_INTEG_MASK;
+    uint32 value;
+    uint8 i;
+    
+    for (i = 0; i < 2; i++) {
+        value = 0;
+        if ((registers[TSL2561_REG_CONTROL] & SIM_TSL2561_POWER_ON) == SIM_TSL2561_POWER_ON) {
+            value = (uint32) device->light[i] * integ_scale[integ] / 322;
+            if (0x00 == (registers[TSL2561_REG_TIMING] & SIM_TSL2561_GAIN_16X)) {
+                value >>= 4;
+            }
+            if (value > integ_max[integ]) {
+                value = integ_max[integ];
+            }
+        }
+        registers[TSL2561_REG_DATA0 + 2 * i] = value & 0xFF;
+        registers[TSL2561_REG_DATA0 + 1 + 2 * i] = value >> 8;
+    }
+}
+
+static void tsl2561_model_write(SENSOR_SIM_DEVICE* device, uint8* buffer, uint8 num_bytes) {
+    uint8 i;
+    uint8 _register;
+    
+    if ((num_bytes == 0) || (0x00 == (buffer[0] & SIM_TSL2561_CMD))) {
+        return;  // bytes without the command bit are ignored
+    }
+    device->pointer = buffer[0] & SIM_TSL2561_ADDRESS_MASK;
+    if (buffer[0] & SIM_TSL2561_CLEAR) {
+        device->interrupt = false;
+    }
+    for (i = 1; i < num_bytes; i++) {
+        _register = device->pointer++;
+        if (_register == TSL2561_REG_CONTROL) {
+            device->registers[_register] = buffer[i] & SIM_TSL2561_POWER_ON;
+        }
+        else if (_register <= TSL2561_REG_INTERRUPT) {
+            device->registers[_register] = buffer[i];
+        }
+    }
+}
+
+static void tsl2561_model_read(SENSOR_SIM_DEVICE* device, uint8* buffer, uint8 num_bytes) {
+    uint8 i;
+    for (i = 0; i < num_bytes; i++) {
+        buffer[i] = device->registers[device->pointer & SIM_TSL2561_ADDRESS_MASK];
+        device->pointer++;
+    }
+}
+
+/* [] END OF FILE */
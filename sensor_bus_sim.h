@@ -0,0 +1,71 @@
+/*******************************************************************************
+ * File Name: sensor_bus_sim.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the simulated I2C bus with register level models of
+ *  the isl29125 and tsl2561 light sensors.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_SENSOR_BUS_SIM_H)
+#define _SENSOR_BUS_SIM_H
+    
+#include "sensor.h"
+    
+/***************************************
+*      Simulation constants
+***************************************/ 
+
+#define SENSOR_SIM_MAX_DEVICES      8
+#define SENSOR_SIM_NUM_REGISTERS    16
+    
+// Device models
+#define SENSOR_SIM_ISL29125         1
+#define SENSOR_SIM_TSL2561          2
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+typedef struct {
+    uint8       model;
+    uint8       address;
+    bool        present;        // set false to simulate an unplugged device
+    uint8       pointer;        // register address pointer of the device
+    uint8       registers[SENSOR_SIM_NUM_REGISTERS];
+    // Light the device sees, in counts at its most sensitive setting:
+    // isl29125 red, green, blue at 375 lux and 16 bits,
+    // tsl2561 channel 0 and 1 at 402 ms and 16x gain
+    uint16      light[3];
+    bool        interrupt;      // INT pin is low
+} SENSOR_SIM_DEVICE;
+
+typedef struct {
+    SENSOR_SIM_DEVICE   devices[SENSOR_SIM_MAX_DEVICES];
+    uint8               num_devices;
+} SENSOR_SIM;
+  
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void sensor_sim_init(SENSOR_BUS* bus, SENSOR_SIM* sim);
+SENSOR_SIM_DEVICE* sensor_sim_add_isl29125(SENSOR_SIM* sim, uint8 address);
+SENSOR_SIM_DEVICE* sensor_sim_add_tsl2561(SENSOR_SIM* sim, uint8 address);
+void sensor_sim_set_light(SENSOR_SIM_DEVICE* device, uint16 light0, uint16 light1, 
+                          uint16 light2);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,312 @@
+/*******************************************************************************
+ * File Name: sensor_stats.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the instrumentation of the I2C
+ *  transaction engine and the sensor drivers.  The API timings are in
+ *  CPU cycles from the DWT cycle counter of the Cortex-M3, or from the
+ *  SysTick timer on a Cortex-M0 that has no DWT.  Host builds count
+ *  nanoseconds instead.  Only built with SENSOR_STATS_ENABLED defined.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "sensor_stats.h"
+
+#if defined(SENSOR_STATS_ENABLED)
+
+#include "timebase.h"
+
+#if defined(SENSOR_HOST_BUILD)
+#include <time.h>
+#elif !defined(CY_PSOC4)
+// Cortex-M3 debug registers that run the cycle counter
+#define DEMCR_REG                   ((reg32 *) 0xE000EDFCu)
+#define DEMCR_TRCENA                0x01000000u
+#define DWT_CTRL_REG                ((reg32 *) 0xE0001000u)
+#define DWT_CTRL_CYCCNTENA          0x00000001u
+#define DWT_CYCCNT_REG              ((reg32 *) 0xE0001004u)
+#endif
+
+// Longest line of the dump, an API line with 4 numbers of 10 digits
+#define DUMP_LINE_LENGTH            80
+
+SENSOR_STATS sensor_stats_counters;
+
+static const char* const api_names[SENSOR_NUM_APIS] = {
+    "isl29125_init",
+    "isl29125_read_id",
+    "isl29125_read_red",
+    "isl29125_read_green",
+    "isl29125_read_blue",
+    "isl29125_read_rgb",
+    "tsl2561_Init",
+    "tsl2561_read_id",
+    "tsl2561_set_timing",
+    "tsl2561_read_data"
+};
+
+/***************************************
+*      Static Function Prototypes
+***************************************/
+
+static char* append_text(char* line, const char* text);
+static char* append_uint(char* line, uint32 value);
+
+/******************************************************************************
+* Function Name: sensor_stats_start
+*******************************************************************************
+*
+* Summary:
+*  Start the cycle counter and clear the statistics.  On the Cortex-M0 the
+*  timebase has to be started too, its SysTick is the cycle counter.
+*
+*******************************************************************************/
+
+void sensor_stats_start(void) {
+#if !defined(SENSOR_HOST_BUILD) && !defined(CY_PSOC4)
+    CY_SET_REG32(DEMCR_REG, CY_GET_REG32(DEMCR_REG) | DEMCR_TRCENA);
+    CY_SET_REG32(DWT_CYCCNT_REG, 0);
+    CY_SET_REG32(DWT_CTRL_REG, CY_GET_REG32(DWT_CTRL_REG) | DWT_CTRL_CYCCNTENA);
+#endif
+    sensor_stats_reset();
+}
+
+/******************************************************************************
+* Function Name: sensor_stats_reset
+*******************************************************************************
+*
+* Summary:
+*  Clear all the counters and timings
+*
+*******************************************************************************/
+
+void sensor_stats_reset(void) {
+    SENSOR_STATS empty_stats = {0};
+    uint8 i;
+    uint8 interrupt_state = CyEnterCriticalSection();
+
+    sensor_stats_counters = empty_stats;
+    for (i = 0; i < SENSOR_NUM_APIS; i++) {
+        sensor_stats_counters.api[i].min_cycles = 0xFFFFFFFF;
+    }
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: sensor_stats_cycles
+*******************************************************************************
+*
+* Summary:
+*  Read the free running cycle counter.  Only differences of the counter
+*  are meaningful, they are right across its wrap.
+*
+* Return:
+*  uint32: current count of the cycle counter
+*
+*******************************************************************************/
+
+#if defined(SENSOR_HOST_BUILD)
+
+uint32 sensor_stats_cycles(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32) (now.tv_sec * 1000000000 + now.tv_nsec);
+}
+
+#elif defined(CY_PSOC4)
+
+// SysTick counts down from its reload value once every millisecond
+uint32 sensor_stats_cycles(void) {
+    uint32 period = CySysTickGetReload() + 1;
+    uint32 milliseconds;
+    uint32 count;
+
+    do {
+        milliseconds = timebase_ms();
+        count = CySysTickGetValue();
+    } while (milliseconds != timebase_ms());
+    return milliseconds * period + (period - 1 - count);
+}
+
+#else
+
+uint32 sensor_stats_cycles(void) {
+    return CY_GET_REG32(DWT_CYCCNT_REG);
+}
+
+#endif
+
+/******************************************************************************
+* Function Name: sensor_stats_transaction
+*******************************************************************************
+*
+* Summary:
+*  Count a transaction submitted to a bus.  Called by the transaction engine
+*  through SENSOR_STATS_TRANSACTION with interrupts disabled.
+*
+* Parameters:
+*  uint8 num_bytes: data bytes of the transaction
+*
+*******************************************************************************/
+
+void sensor_stats_transaction(uint8 num_bytes) {
+    sensor_stats_counters.transactions++;
+    sensor_stats_counters.bytes += num_bytes;
+}
+
+/******************************************************************************
+* Function Name: sensor_stats_record
+*******************************************************************************
+*
+* Summary:
+*  Add the time of one call of an API.  Called through SENSOR_STATS_END.
+*
+* Parameters:
+*  uint8 api: SENSOR_API_* number of the API
+*  uint32 start_cycles: sensor_stats_cycles() when the API was entered
+*
+*******************************************************************************/
+
+void sensor_stats_record(uint8 api, uint32 start_cycles) {
+    SENSOR_API_STATS* stats = &sensor_stats_counters.api[api];
+    uint32 cycles = sensor_stats_cycles() - start_cycles;
+    uint8 interrupt_state = CyEnterCriticalSection();
+
+    stats->calls++;
+    if (cycles < stats->min_cycles) {
+        stats->min_cycles = cycles;
+    }
+    if (cycles > stats->max_cycles) {
+        stats->max_cycles = cycles;
+    }
+    if (stats->total_cycles + cycles < stats->total_cycles) {
+        stats->total_cycles >>= 1;
+        stats->timed_calls >>= 1;
+    }
+    stats->total_cycles += cycles;
+    stats->timed_calls++;
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: sensor_stats_get
+*******************************************************************************
+*
+* Summary:
+*  Copy a snapshot of the statistics
+*
+* Parameters:
+*  SENSOR_STATS* stats: structure to copy the statistics into
+*
+*******************************************************************************/
+
+void sensor_stats_get(SENSOR_STATS* stats) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    *stats = sensor_stats_counters;
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: sensor_stats_dump
+*******************************************************************************
+*
+* Summary:
+*  Print the statistics as text, one line per counter and per API that
+*  has been called.  An API line has its calls and the minimum, average
+*  and maximum cycles of one call.
+*
+* Parameters:
+*  sensor_stats_print print: function that prints one line, e.g. to a UART
+*
+*******************************************************************************/
+
+void sensor_stats_dump(sensor_stats_print print) {
+    SENSOR_STATS stats;
+    SENSOR_API_STATS* api;
+    char line[DUMP_LINE_LENGTH];
+    char* end;
+    uint8 i;
+
+    sensor_stats_get(&stats);
+    end = append_uint(append_text(line, "transactions "), stats.transactions);
+    end = append_uint(append_text(end, " bytes "), stats.bytes);
+    print(line);
+    end = append_uint(append_text(line, "nak retries "), stats.nak_retries);
+    end = append_uint(append_text(end, " spins "), stats.spins);
+    print(line);
+
+    for (i = 0; i < SENSOR_NUM_APIS; i++) {
+        api = &stats.api[i];
+        if (api->calls == 0) {
+            continue;
+        }
+        end = append_text(line, api_names[i]);
+        end = append_uint(append_text(end, " n "), api->calls);
+        end = append_uint(append_text(end, " min "), api->min_cycles);
+        end = append_uint(append_text(end, " avg "), api->total_cycles / api->timed_calls);
+        end = append_uint(append_text(end, " max "), api->max_cycles);
+        print(line);
+    }
+}
+
+/******************************************************************************
+* Function Name: append_text
+*******************************************************************************
+*
+* Summary:
+*  Copy text to the end of a line being built
+*
+* Return:
+*  char*: the terminating 0 of the line
+*
+*******************************************************************************/
+
+static char* append_text(char* line, const char* text) {
+    while (*text) {
+        *line++ = *text++;
+    }
+    *line = 0;
+    return line;
+}
+
+/******************************************************************************
+* Function Name: append_uint
+*******************************************************************************
+*
+* Summary:
+*  Write a number in decimal to the end of a line being built
+*
+* Return:
+*  char*: the terminating 0 of the line
+*
+*******************************************************************************/
+
+static char* append_uint(char* line, uint32 value) {
+    char digits[10];
+    uint8 num_digits = 0;
+
+    do {
+        digits[num_digits++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    while (num_digits) {
+        *line++ = digits[--num_digits];
+    }
+    *line = 0;
+    return line;
+}
+
+#endif
+
+/* [] END OF FILE */
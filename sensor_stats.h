@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * File Name: sensor_stats.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the instrumentation of the I2C transaction engine
+ *  and the sensor drivers.  It counts transactions, bytes, NAK retries
+ *  and the spins of the blocking calls, and times the driver APIs in
+ *  CPU cycles.  Everything is compiled in only when SENSOR_STATS_ENABLED
+ *  is defined, otherwise the macros are empty and cost nothing.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_SENSOR_STATS_H)
+#define _SENSOR_STATS_H
+
+#include "platform.h"
+
+/***************************************
+*      Timed APIs
+***************************************/
+
+#define SENSOR_API_ISL29125_INIT        0
+#define SENSOR_API_ISL29125_READ_ID     1
+#define SENSOR_API_ISL29125_READ_RED    2
+#define SENSOR_API_ISL29125_READ_GREEN  3
+#define SENSOR_API_ISL29125_READ_BLUE   4
+#define SENSOR_API_ISL29125_READ_RGB    5
+#define SENSOR_API_TSL2561_INIT         6
+#define SENSOR_API_TSL2561_READ_ID      7
+#define SENSOR_API_TSL2561_SET_TIMING   8
+#define SENSOR_API_TSL2561_READ_DATA    9
+#define SENSOR_NUM_APIS                 10
+
+/***************************************
+*      Structures
+***************************************/
+
+// Cycles spent in one API.  total_cycles and timed_calls are halved
+// together before total_cycles would wrap, so their ratio stays the average
+typedef struct {
+    uint32      calls;
+    uint32      min_cycles;
+    uint32      max_cycles;
+    uint32      total_cycles;
+    uint32      timed_calls;    // calls counted in total_cycles
+} SENSOR_API_STATS;
+
+typedef struct {
+    uint32              transactions;   // submitted to any bus
+    uint32              bytes;          // data bytes of the transactions
+    uint32              nak_retries;    // transactions started again after a NAK
+    uint32              spins;          // loops of blocking calls waiting on a bus
+    SENSOR_API_STATS    api[SENSOR_NUM_APIS];
+} SENSOR_STATS;
+
+// Prints one line of the dump, without the line ending
+typedef void (*sensor_stats_print)(const char* line);
+
+/***************************************
+*      Instrumentation macros
+***************************************/
+
+#if defined(SENSOR_STATS_ENABLED)
+
+#define SENSOR_STATS_TRANSACTION(num_bytes)     sensor_stats_transaction(num_bytes)
+#define SENSOR_STATS_NAK_RETRY()                (sensor_stats_counters.nak_retries++)
+#define SENSOR_STATS_SPIN()                     (sensor_stats_counters.spins++)
+// Put SENSOR_STATS_BEGIN at the start of an API and SENSOR_STATS_END before it returns
+#define SENSOR_STATS_BEGIN(api)                 uint32 sensor_stats_start_ = sensor_stats_cycles()
+#define SENSOR_STATS_END(api)                   sensor_stats_record(api, sensor_stats_start_)
+
+extern SENSOR_STATS sensor_stats_counters;
+
+#else
+
+#define SENSOR_STATS_TRANSACTION(num_bytes)     ((void) 0)
+#define SENSOR_STATS_NAK_RETRY()                ((void) 0)
+#define SENSOR_STATS_SPIN()                     ((void) 0)
+#define SENSOR_STATS_BEGIN(api)
+#define SENSOR_STATS_END(api)                   ((void) 0)
+
+#endif
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+#if defined(SENSOR_STATS_ENABLED)
+
+void sensor_stats_start(void);
+void sensor_stats_reset(void);
+uint32 sensor_stats_cycles(void);
+void sensor_stats_transaction(uint8 num_bytes);
+void sensor_stats_record(uint8 api, uint32 start_cycles);
+void sensor_stats_get(SENSOR_STATS* stats);
+void sensor_stats_dump(sensor_stats_print print);
+
+#endif
+
+#endif
+
+/* [] END OF FILE */
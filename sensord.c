@@ -0,0 +1,406 @@
+/*******************************************************************************
+ * File Name: sensord.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the acquisition daemon for Linux gateways.  Build
+ *  it with SENSOR_HOST_BUILD defined, with the drivers, the discovery,
+ *  the pipeline, the Linux and simulated bus backends and the shared
+ *  memory ring, and link it with -pthread (and -lrt on old C libraries).
+ *
+ *  The sensors on each bus are found at startup, then every bus gets its
+ *  own thread that runs a conversion pipeline of its sensors.  The
+ *  samples of all the buses are put in one shared memory ring that any
+ *  number of local processes map read-only.  The throughput and the
+ *  drops of each bus are printed at a set interval.
+ *
+ *  sensord [-n name] [-c capacity] [-i seconds] [-s buses] [adapter ...]
+ *      runs the daemon on /dev/i2c-<adapter> for each adapter given, and
+ *      on a number of simulated buses of one isl29125 and three tsl2561
+ *  sensord -w [-n name]
+ *      prints the samples of a running daemon, as an example reader
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sensor_bus_linux.h"
+#include "sensor_bus_sim.h"
+#include "discovery.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "shm_ring.h"
+#include "timebase.h"
+
+#define MAX_BUSES                   8
+#define DEFAULT_INTERVAL_S          10
+// Longest sleep of a bus thread, so a stop is seen quickly
+#define MAX_SLEEP_MS                10
+#define READER_SLEEP_US             10000
+
+#define NUM_SIM_TSL2561             3
+
+// Counts of a bus, written by its thread and read by the main thread
+typedef struct {
+    uint32      samples;    // put in the ring
+    uint32      missed;     // results whose read failed or was not queued
+    uint32      dropped;    // samples the thread did not take out in time
+    uint32      errors;     // failed transactions
+} BUS_STATS;
+
+typedef struct {
+    uint8           number;     // bus field of its records
+    int             adapter;    // i2c-dev adapter, or -1 if simulated
+    SENSOR_BUS      bus;
+    SENSOR_LINUX    i2c_dev;
+    SENSOR_SIM      sim;
+    DISCOVERY_TABLE sensors;
+    PIPELINE        pipeline;
+    SAMPLE_BUFFER   samples;
+    BUS_STATS       stats;
+    pthread_t       thread;
+} BUS;
+
+static BUS buses[MAX_BUSES];
+static uint8 num_buses = 0;
+static SHM_RING ring;
+// bus threads take turns to put records in the ring, its readers never lock
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t running = 1;
+
+/***************************************
+*      Static Function Prototypes
+***************************************/
+
+static bool add_linux_bus(int adapter);
+static bool add_sim_bus(void);
+static void* acquire(void* context);
+static void start_sensors(BUS* bus);
+static void publish(BUS* bus);
+static void print_stats(uint32 interval_s);
+static int watch(const char* name);
+static void stop(int signal_number);
+
+int main(int argc, char* argv[]) {
+    const char* name = SHM_RING_DEFAULT_NAME;
+    uint32 capacity = SHM_RING_DEFAULT_CAPACITY;
+    uint32 interval_s = DEFAULT_INTERVAL_S;
+    int num_sim_buses = 0;
+    bool watching = false;
+    SENSOR_BUS* bus;
+    int option;
+    uint8 i;
+
+    while ((option = getopt(argc, argv, "n:c:i:s:w")) != -1) {
+        switch (option) {
+            case 'n': name = optarg; break;
+            case 'c': capacity = strtoul(optarg, 0, 0); break;
+            case 'i': interval_s = strtoul(optarg, 0, 0); break;
+            case 's': num_sim_buses = atoi(optarg); break;
+            case 'w': watching = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-n name] [-c capacity] [-i seconds] "
+                        "[-s buses] [adapter ...]\n       %s -w [-n name]\n", argv[0], argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    if (watching) {
+        return watch(name);
+    }
+    for (; optind < argc; optind++) {
+        if (!add_linux_bus(atoi(argv[optind]))) {
+            return EXIT_FAILURE;
+        }
+    }
+    while (num_sim_buses-- > 0) {
+        if (!add_sim_bus()) {
+            return EXIT_FAILURE;
+        }
+    }
+    if ((num_buses == 0) || (interval_s == 0)) {
+        fprintf(stderr, "%s: no buses to read\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!shm_ring_create(&ring, name, capacity)) {
+        perror("shm_ring_create");
+        return EXIT_FAILURE;
+    }
+
+    // the discovery is not reentrant, find the sensors before the threads start
+    for (i = 0; i < num_buses; i++) {
+        bus = &buses[i].bus;
+        discovery_scan(&buses[i].sensors, &bus, 1);
+        printf("bus %u: %u sensors\n", i, buses[i].sensors.num_devices);
+    }
+    for (i = 0; i < num_buses; i++) {
+        pthread_create(&buses[i].thread, 0, acquire, &buses[i]);
+    }
+    while (running) {
+        sleep(interval_s);
+        print_stats(interval_s);
+    }
+    for (i = 0; i < num_buses; i++) {
+        pthread_join(buses[i].thread, 0);
+        if (buses[i].adapter >= 0) {
+            sensor_linux_close(&buses[i].i2c_dev);
+        }
+    }
+    shm_ring_close(&ring);
+    shm_ring_unlink(name);
+    return EXIT_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: add_linux_bus
+*******************************************************************************
+*
+* Summary:
+*  Add a bus on /dev/i2c-<adapter>
+*
+* Return:
+*  bool: false if there are too many buses or the adapter did not open
+*
+*******************************************************************************/
+
+static bool add_linux_bus(int adapter) {
+    BUS* bus = &buses[num_buses];
+
+    if (num_buses >= MAX_BUSES) {
+        fprintf(stderr, "more than %u buses\n", MAX_BUSES);
+        return false;
+    }
+    if (!sensor_linux_open(&bus->bus, &bus->i2c_dev, adapter)) {
+        fprintf(stderr, "/dev/i2c-%d: ", adapter);
+        perror(0);
+        return false;
+    }
+    bus->number = num_buses++;
+    bus->adapter = adapter;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: add_sim_bus
+*******************************************************************************
+*
+* Summary:
+*  Add a simulated bus of one isl29125 and three tsl2561, each bus with
+*  a different light
+*
+* Return:
+*  bool: false if there are too many buses
+*
+*******************************************************************************/
+
+static bool add_sim_bus(void) {
+    static const uint8 tsl2561_addresses[NUM_SIM_TSL2561] = {
+        I2C_ADDRESS_GROUND, I2C_ADDRESS_FLOAT, I2C_ADDRESS_VDD
+    };
+    BUS* bus = &buses[num_buses];
+    uint16 light = 1000 * (num_buses + 1);
+    SENSOR_SIM_DEVICE* device;
+    uint8 i;
+
+    if (num_buses >= MAX_BUSES) {
+        fprintf(stderr, "more than %u buses\n", MAX_BUSES);
+        return false;
+    }
+    sensor_sim_init(&bus->bus, &bus->sim);
+    device = sensor_sim_add_isl29125(&bus->sim, ISL29125_I2C_ADDRESS);
+    sensor_sim_set_light(device, light, light / 2, light / 4);
+    for (i = 0; i < NUM_SIM_TSL2561; i++) {
+        device = sensor_sim_add_tsl2561(&bus->sim, tsl2561_addresses[i]);
+        sensor_sim_set_light(device, light, light / 4, 0);
+    }
+    bus->number = num_buses++;
+    bus->adapter = -1;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: acquire
+*******************************************************************************
+*
+* Summary:
+*  Thread of one bus.  Start its sensors and run their pipeline until the
+*  daemon is stopped, putting the samples in the ring as they come.
+*
+*******************************************************************************/
+
+static void* acquire(void* context) {
+    BUS* bus = context;
+    uint32 sleep_ms;
+
+    start_sensors(bus);
+    pipeline_start(&bus->pipeline);
+    while (running) {
+        sleep_ms = pipeline_run(&bus->pipeline);
+        publish(bus);
+        __atomic_store_n(&bus->stats.missed, bus->pipeline.missed, __ATOMIC_RELAXED);
+        __atomic_store_n(&bus->stats.dropped, sample_buffer_overruns(&bus->samples),
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&bus->stats.errors, bus->bus.stats.errors, __ATOMIC_RELAXED);
+        if (sleep_ms != 0) {
+            scheduler_sleep((sleep_ms > MAX_SLEEP_MS) ? MAX_SLEEP_MS : sleep_ms);
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: start_sensors
+*******************************************************************************
+*
+* Summary:
+*  Start the drivers of the sensors found on a bus and add them to its
+*  pipeline, with the settings of main_pipeline.c.  The device id of their
+*  samples is their place in the table of the bus.
+*
+*******************************************************************************/
+
+static void start_sensors(BUS* bus) {
+    DISCOVERY_DEVICE* device;
+    uint8 i;
+
+    sample_buffer_init(&bus->samples);
+    pipeline_init(&bus->pipeline, &bus->samples);
+    for (i = 0; i < bus->sensors.num_devices; i++) {
+        device = &bus->sensors.devices[i];
+        if (device->type == DISCOVERY_ISL29125) {
+            isl29125_init(&device->driver.isl29125, device->bus, device->address);
+            set_adc_resolution(&device->driver.isl29125, ISL29125_CONFIG1_ADC_12BIT);
+            pipeline_add(&bus->pipeline, &pipeline_isl29125_ops, &device->driver.isl29125, i);
+        }
+        else {
+            tsl2561_Init(&device->driver.tsl2561, device->bus, device->address);
+            tsl2561_set_timing(&device->driver.tsl2561, TSL2561_INTEGRATION_101MS,
+                               TSL2561_GAIN_1X);
+            pipeline_add(&bus->pipeline, &pipeline_tsl2561_ops, &device->driver.tsl2561, i);
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: publish
+*******************************************************************************
+*
+* Summary:
+*  Put the samples of a bus in the ring, with the bus, type and address
+*  of the sensor they came from
+*
+*******************************************************************************/
+
+static void publish(BUS* bus) {
+    SAMPLE batch[SAMPLE_BUFFER_SIZE];
+    SHM_RING_RECORD record;
+    DISCOVERY_DEVICE* device;
+    uint16 num_samples = sample_buffer_get(&bus->samples, batch, SAMPLE_BUFFER_SIZE);
+    uint16 i;
+
+    if (num_samples == 0) {
+        return;
+    }
+    record.bus = bus->number;
+    record.reserved = 0;
+    pthread_mutex_lock(&ring_lock);
+    for (i = 0; i < num_samples; i++) {
+        device = &bus->sensors.devices[batch[i].device];
+        record.type = device->type;
+        record.address = device->address;
+        record.sample = batch[i];
+        shm_ring_put(&ring, &record);
+    }
+    pthread_mutex_unlock(&ring_lock);
+    __atomic_add_fetch(&bus->stats.samples, num_samples, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+* Function Name: print_stats
+*******************************************************************************
+*
+* Summary:
+*  Print the sample rate of each bus over the last interval, and its
+*  counts of missed results, dropped samples and failed transactions
+*
+*******************************************************************************/
+
+static void print_stats(uint32 interval_s) {
+    static uint32 last_samples[MAX_BUSES];
+    BUS_STATS stats;
+    uint8 i;
+
+    for (i = 0; i < num_buses; i++) {
+        stats.samples = __atomic_load_n(&buses[i].stats.samples, __ATOMIC_RELAXED);
+        stats.missed = __atomic_load_n(&buses[i].stats.missed, __ATOMIC_RELAXED);
+        stats.dropped = __atomic_load_n(&buses[i].stats.dropped, __ATOMIC_RELAXED);
+        stats.errors = __atomic_load_n(&buses[i].stats.errors, __ATOMIC_RELAXED);
+        printf("bus %u: %.1f samples/s, %u samples, %u missed, %u dropped, %u errors\n",
+               i, (double) (stats.samples - last_samples[i]) / interval_s, stats.samples,
+               stats.missed, stats.dropped, stats.errors);
+        last_samples[i] = stats.samples;
+    }
+    fflush(stdout);
+}
+
+/******************************************************************************
+* Function Name: watch
+*******************************************************************************
+*
+* Summary:
+*  Print the records of a running daemon as they come, read in place in
+*  the shared memory, until stopped
+*
+*******************************************************************************/
+
+static int watch(const char* name) {
+    SHM_RING reader_ring;
+    SHM_RING_READER reader;
+    const SHM_RING_RECORD* record;
+    char line[80];
+
+    if (!shm_ring_attach(&reader_ring, name)) {
+        fprintf(stderr, "%s: no ring\n", name);
+        return EXIT_FAILURE;
+    }
+    shm_ring_reader_init(&reader, &reader_ring);
+    while (running) {
+        record = shm_ring_peek(&reader);
+        if (!record) {
+            usleep(READER_SLEEP_US);
+            continue;
+        }
+        snprintf(line, sizeof(line), "%10u bus %u type %u address 0x%02X: %5u %5u %5u",
+                 record->sample.timestamp, record->bus, record->type, record->address,
+                 record->sample.channel[0], record->sample.channel[1],
+                 record->sample.channel[2]);
+        if (shm_ring_release(&reader)) {
+            puts(line);
+        }
+    }
+    fprintf(stderr, "%u records lost\n", reader.lost);
+    shm_ring_close(&reader_ring);
+    return EXIT_SUCCESS;
+}
+
+static void stop(int signal_number) {
+    (void) signal_number;
+    running = 0;
+}
+
+/* [] END OF FILE */
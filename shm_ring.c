@@ -0,0 +1,325 @@
+/*******************************************************************************
+ * File Name: shm_ring.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the shared memory ring of
+ *  samples.  Build it with SENSOR_HOST_BUILD defined on Linux.
+ *
+ *  One process writes the ring, any number of processes map it read-only
+ *  and read it without locks and without a system call.  Each slot has a
+ *  sequence count like a seqlock: the writer makes it odd, writes the
+ *  record and makes it even again, the readers check it is the same even
+ *  number before and after they use the record.  The writer never waits
+ *  for a reader.  A reader that falls a whole ring behind skips to the
+ *  oldest record left and counts the ones it missed.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm_ring.h"
+
+#define SEQUENCE_WRITING(position)  (2 * (position) + 1)
+#define SEQUENCE_WRITTEN(position)  (2 * (position) + 2)
+#define RING_SIZE(capacity)         (sizeof(SHM_RING_HEADER) + (capacity) * sizeof(SHM_RING_SLOT))
+
+/***************************************
+*      Static Function Prototypes
+***************************************/
+
+static bool ring_map(SHM_RING* ring, int fd, size_t size, int protection);
+static SHM_RING_SLOT* find_next(SHM_RING_READER* reader);
+
+/******************************************************************************
+* Function Name: shm_ring_create
+*******************************************************************************
+*
+* Summary:
+*  Make a new, empty ring in POSIX shared memory, replacing a ring of the
+*  same name.  Readers that attach to it see it once the magic is set.
+*
+* Parameters:
+*  SHM_RING* ring: mapping of the ring for the writer
+*  const char* name: shared memory name, e.g. SHM_RING_DEFAULT_NAME
+*  uint32 capacity: number of records, a power of 2
+*
+* Return:
+*  bool: true if the ring was made, false with errno set if not
+*
+*******************************************************************************/
+
+bool shm_ring_create(SHM_RING* ring, const char* name, uint32 capacity) {
+    size_t size = RING_SIZE(capacity);
+    int fd;
+    bool mapped;
+
+    if ((capacity == 0) || (capacity & (capacity - 1))) {
+        return false;
+    }
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    mapped = (ftruncate(fd, size) == 0) && ring_map(ring, fd, size, PROT_READ | PROT_WRITE);
+    close(fd);
+    if (!mapped) {
+        shm_unlink(name);
+        return false;
+    }
+    // ftruncate filled it with zeros, no slot holds a record yet
+    ring->header->version = SHM_RING_VERSION;
+    ring->header->slot_size = sizeof(SHM_RING_SLOT);
+    ring->header->capacity = capacity;
+    ring->header->head = 0;
+    ring->mask = capacity - 1;
+    __atomic_store_n(&ring->header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: shm_ring_attach
+*******************************************************************************
+*
+* Summary:
+*  Map a ring made by another process, read-only
+*
+* Parameters:
+*  SHM_RING* ring: mapping of the ring for a reader
+*  const char* name: shared memory name the ring was made with
+*
+* Return:
+*  bool: true if the ring was mapped, false if it does not exist, is not
+*        ready yet or was made by another version
+*
+*******************************************************************************/
+
+bool shm_ring_attach(SHM_RING* ring, const char* name) {
+    struct stat status;
+    SHM_RING_HEADER* header;
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd < 0) {
+        return false;
+    }
+    if ((fstat(fd, &status) != 0) || (status.st_size < (off_t) sizeof(SHM_RING_HEADER)) ||
+            !ring_map(ring, fd, status.st_size, PROT_READ)) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+    header = ring->header;
+    if ((__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC) ||
+            (header->version != SHM_RING_VERSION) ||
+            (header->slot_size != sizeof(SHM_RING_SLOT)) ||
+            (RING_SIZE((size_t) header->capacity) > ring->size)) {
+        shm_ring_close(ring);
+        return false;
+    }
+    ring->mask = header->capacity - 1;
+    return true;
+}
+
+void shm_ring_close(SHM_RING* ring) {
+    munmap(ring->header, ring->size);
+    ring->header = 0;
+    ring->slots = 0;
+}
+
+void shm_ring_unlink(const char* name) {
+    shm_unlink(name);
+}
+
+/******************************************************************************
+* Function Name: shm_ring_put
+*******************************************************************************
+*
+* Summary:
+*  Put a record in the ring, over the oldest one.  Only one thread may
+*  put records at a time.
+*
+* Parameters:
+*  SHM_RING* ring: ring made with shm_ring_create
+*  const SHM_RING_RECORD* record: record to put in
+*
+*******************************************************************************/
+
+void shm_ring_put(SHM_RING* ring, const SHM_RING_RECORD* record) {
+    uint32 position = ring->header->head;
+    SHM_RING_SLOT* slot = &ring->slots[position & ring->mask];
+
+    __atomic_store_n(&slot->sequence, SEQUENCE_WRITING(position), __ATOMIC_RELAXED);
+    // readers see the odd sequence before any of the new record
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->record = *record;
+    __atomic_store_n(&slot->sequence, SEQUENCE_WRITTEN(position), __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->header->head, position + 1, __ATOMIC_RELEASE);
+}
+
+// Count of records put in the ring since it was made
+uint32 shm_ring_head(const SHM_RING* ring) {
+    return __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE);
+}
+
+/******************************************************************************
+* Function Name: shm_ring_reader_init
+*******************************************************************************
+*
+* Summary:
+*  Set up a reader that gets the records put in after now
+*
+*******************************************************************************/
+
+void shm_ring_reader_init(SHM_RING_READER* reader, const SHM_RING* ring) {
+    reader->ring = ring;
+    reader->next = shm_ring_head(ring);
+    reader->lost = 0;
+}
+
+/******************************************************************************
+* Function Name: shm_ring_get
+*******************************************************************************
+*
+* Summary:
+*  Copy the next record of a reader out of the ring
+*
+* Parameters:
+*  SHM_RING_READER* reader: reader to use
+*  SHM_RING_RECORD* record: where to copy the record
+*
+* Return:
+*  bool: true if a record was copied, false if there are no new records
+*
+*******************************************************************************/
+
+bool shm_ring_get(SHM_RING_READER* reader, SHM_RING_RECORD* record) {
+    SHM_RING_SLOT* slot;
+
+    while ((slot = find_next(reader)) != 0) {
+        *record = slot->record;
+        if (shm_ring_release(reader)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function Name: shm_ring_peek
+*******************************************************************************
+*
+* Summary:
+*  Get the next record of a reader where it is in the shared memory,
+*  without copying it.  The writer can write over it at any time, so
+*  whatever was taken from the record is only good if shm_ring_release
+*  then returns true.
+*
+* Return:
+*  const SHM_RING_RECORD*: the record, or 0 if there are no new records
+*
+*******************************************************************************/
+
+const SHM_RING_RECORD* shm_ring_peek(SHM_RING_READER* reader) {
+    SHM_RING_SLOT* slot = find_next(reader);
+    return slot ? &slot->record : 0;
+}
+
+/******************************************************************************
+* Function Name: shm_ring_release
+*******************************************************************************
+*
+* Summary:
+*  Finish with the record from shm_ring_peek and move the reader on
+*
+* Return:
+*  bool: true if the record was not written over while it was used,
+*        false if it was, and it is counted as lost
+*
+*******************************************************************************/
+
+bool shm_ring_release(SHM_RING_READER* reader) {
+    const SHM_RING* ring = reader->ring;
+    SHM_RING_SLOT* slot = &ring->slots[reader->next & ring->mask];
+    bool valid;
+
+    // the record was used before the sequence is checked again
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    valid = (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) ==
+             SEQUENCE_WRITTEN(reader->next));
+    if (!valid) {
+        reader->lost++;
+    }
+    reader->next++;
+    return valid;
+}
+
+/******************************************************************************
+* Function Name: find_next
+*******************************************************************************
+*
+* Summary:
+*  Find the slot of the next record of a reader that is still in the
+*  ring.  A reader more than a ring behind skips to the oldest record, a
+*  slot the writer has started to write over is skipped.
+*
+* Return:
+*  SHM_RING_SLOT*: the slot, or 0 if there are no new records
+*
+*******************************************************************************/
+
+static SHM_RING_SLOT* find_next(SHM_RING_READER* reader) {
+    const SHM_RING* ring = reader->ring;
+    uint32 capacity = ring->mask + 1;
+    uint32 head = shm_ring_head(ring);
+    SHM_RING_SLOT* slot;
+
+    for (; reader->next != head; reader->next++, reader->lost++) {
+        if ((uint32) (head - reader->next) > capacity) {
+            reader->lost += head - reader->next - capacity;
+            reader->next = head - capacity;
+        }
+        slot = &ring->slots[reader->next & ring->mask];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) ==
+                SEQUENCE_WRITTEN(reader->next)) {
+            return slot;
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: ring_map
+*******************************************************************************
+*
+* Summary:
+*  Map the shared memory of a ring
+*
+*******************************************************************************/
+
+static bool ring_map(SHM_RING* ring, int fd, size_t size, int protection) {
+    void* memory = mmap(0, size, protection, MAP_SHARED, fd, 0);
+
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    ring->header = memory;
+    ring->slots = (SHM_RING_SLOT*) (ring->header + 1);
+    ring->size = size;
+    return true;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * File Name: shm_ring.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the shared memory ring of samples, written by the
+ *  acquisition daemon and read by any number of local processes.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_SHM_RING_H)
+#define _SHM_RING_H
+
+#include <stddef.h>
+#include "platform.h"
+#include "stdbool.h"
+#include "sample_buffer.h"
+
+/***************************************
+*      Ring constants
+***************************************/
+
+#define SHM_RING_MAGIC              0x53524E47  // "SRNG"
+#define SHM_RING_VERSION            1
+#define SHM_RING_DEFAULT_NAME       "/sensord"
+// Number of records the ring holds by default, must be a power of 2
+#define SHM_RING_DEFAULT_CAPACITY   4096
+
+/***************************************
+*      Structures
+***************************************/
+
+// A sample and where it came from.  The timestamp of the sample is the
+// CLOCK_MONOTONIC time in ms, cut to 32 bits, so readers can compare it
+// to their own clock.
+typedef struct {
+    uint8       bus;        // number of the bus in the daemon
+    uint8       type;       // DISCOVERY_ISL29125 or DISCOVERY_TSL2561
+    uint8       address;
+    uint8       reserved;
+    SAMPLE      sample;
+} SHM_RING_RECORD;
+
+// sequence is odd while the record is written, then even.  For the record
+// at position p of the ring it is 2p + 2, so a reader can tell it from
+// the records before and after it in the same slot.
+typedef struct {
+    volatile uint32     sequence;
+    SHM_RING_RECORD     record;
+} SHM_RING_SLOT;
+
+// Start of the shared memory, the slots follow it
+typedef struct {
+    uint32              magic;
+    uint16              version;
+    uint16              slot_size;
+    uint32              capacity;
+    volatile uint32     head;       // count of records put in
+} SHM_RING_HEADER;
+
+// Mapping of a ring, read-write for the writer, read-only for the readers
+typedef struct {
+    SHM_RING_HEADER*    header;
+    SHM_RING_SLOT*      slots;
+    uint32              mask;
+    size_t              size;
+} SHM_RING;
+
+// Position of one reader.  Each reader keeps its own, the ring does not
+// know its readers, so a slow reader never holds up the writer: records
+// it did not get to in time are counted in lost.
+typedef struct {
+    const SHM_RING*     ring;
+    uint32              next;       // position of the next record to read
+    uint32              lost;
+} SHM_RING_READER;
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+bool shm_ring_create(SHM_RING* ring, const char* name, uint32 capacity);
+bool shm_ring_attach(SHM_RING* ring, const char* name);
+void shm_ring_close(SHM_RING* ring);
+void shm_ring_unlink(const char* name);
+void shm_ring_put(SHM_RING* ring, const SHM_RING_RECORD* record);
+uint32 shm_ring_head(const SHM_RING* ring);
+
+void shm_ring_reader_init(SHM_RING_READER* reader, const SHM_RING* ring);
+bool shm_ring_get(SHM_RING_READER* reader, SHM_RING_RECORD* record);
+const SHM_RING_RECORD* shm_ring_peek(SHM_RING_READER* reader);
+bool shm_ring_release(SHM_RING_READER* reader);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,385 @@
+/*******************************************************************************
+ * File Name: summary.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the windowed statistics of the
+ *  sensor channels.  Each sample updates the min, max, mean and M2 of the
+ *  open window of the shortest length in fixed point.  When a window ends
+ *  its record is made and its statistics are merged into the open window
+ *  of the next length with the parallel form of Welford's method, so a
+ *  one hour window costs one merge per minute, not one update per sample.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "summary.h"
+
+#define FRACTION_HALF               (1 << (SUMMARY_FRACTION - 1))
+#define MAX_VARIANCE                0xFFFFFFFF
+
+/***************************************
+*      Static Function Prototypes
+***************************************/
+
+static void start_windows(SUMMARY* summary, uint32 start, uint8 setting);
+static uint8 close_windows(SUMMARY* summary, uint32 now, SUMMARY_RECORD* records);
+static bool close_level(SUMMARY* summary, uint8 index, SUMMARY_RECORD* record);
+static void add_value(SUMMARY_CHANNEL* channel, uint32 count, uint16 value);
+static void merge_channel(SUMMARY_CHANNEL* into, uint32 into_count,
+                          const SUMMARY_CHANNEL* from, uint32 from_count);
+static int32 divide_rounded(int32 value, uint32 divisor);
+
+
+/******************************************************************************
+* Function Name: summary_init
+*******************************************************************************
+*
+* Summary:
+*  Make a summary with no window lengths.  Add the lengths shortest first.
+*
+* Parameters:
+*  SUMMARY* summary: summary to set up
+*  uint8 device: device field of its records
+*
+*******************************************************************************/
+
+void summary_init(SUMMARY* summary, uint8 device) {
+    summary->num_levels = 0;
+    summary->device = device;
+    summary->started = false;
+}
+
+/******************************************************************************
+* Function Name: summary_add_level
+*******************************************************************************
+*
+* Summary:
+*  Add a window length, that is a whole number of the last length added.
+*  Counts of up to 2^22 samples per window keep the merges in 64 bits.
+*
+* Parameters:
+*  SUMMARY* summary: summary to add to
+*  uint32 window_ms: length of the windows, in ms, below 2^31
+*
+* Return:
+*  bool: true if the length was added, false if the summary has
+*        SUMMARY_MAX_LEVELS lengths or the length is not a multiple of
+*        the last one
+*
+*******************************************************************************/
+
+bool summary_add_level(SUMMARY* summary, uint32 window_ms) {
+    SUMMARY_LEVEL* level;
+    uint32 last_ms;
+
+    if ((summary->num_levels >= SUMMARY_MAX_LEVELS) || (window_ms == 0) ||
+            (window_ms & 0x80000000)) {
+        return false;
+    }
+    if (summary->num_levels != 0) {
+        last_ms = summary->levels[summary->num_levels - 1].window_ms;
+        if ((window_ms <= last_ms) || (window_ms % last_ms != 0)) {
+            return false;
+        }
+    }
+    level = &summary->levels[summary->num_levels++];
+    level->window_ms = window_ms;
+    level->count = 0;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: summary_update
+*******************************************************************************
+*
+* Summary:
+*  Add a sample to the summary.  The windows that ended before it are
+*  closed first.  A sample measured at other settings than the open
+*  windows closes them all early, so the values of different settings
+*  are never mixed.
+*
+* Parameters:
+*  SUMMARY* summary: summary of the device the sample is from
+*  const SAMPLE* sample: new sample, later than the ones before it
+*  SUMMARY_RECORD* records: SUMMARY_MAX_LEVELS records to put the closed
+*                           windows in
+*
+* Return:
+*  uint8: number of records made, shortest windows first
+*
+*******************************************************************************/
+
+uint8 summary_update(SUMMARY* summary, const SAMPLE* sample, SUMMARY_RECORD* records) {
+    SUMMARY_LEVEL* level = &summary->levels[0];
+    uint8 num_records = 0;
+    uint8 i;
+
+    if (summary->num_levels == 0) {
+        return 0;
+    }
+    if (summary->started && (sample->setting != summary->setting)) {
+        num_records = summary_flush(summary, records);
+    }
+    if (summary->started) {
+        num_records = close_windows(summary, sample->timestamp, records);
+    }
+    else {
+        start_windows(summary, sample->timestamp, sample->setting);
+    }
+    level->count++;
+    for (i = 0; i < SAMPLE_NUM_CHANNELS; i++) {
+        add_value(&level->channels[i], level->count, sample->channel[i]);
+    }
+    return num_records;
+}
+
+/******************************************************************************
+* Function Name: summary_tick
+*******************************************************************************
+*
+* Summary:
+*  Close the windows that ended by now, so their records are made on
+*  time when the device stops giving samples.  Call it at least once
+*  every shortest window.
+*
+* Parameters:
+*  SUMMARY* summary: summary to use
+*  uint32 now: timebase_ms() now
+*  SUMMARY_RECORD* records: SUMMARY_MAX_LEVELS records to put the closed
+*                           windows in
+*
+* Return:
+*  uint8: number of records made, shortest windows first
+*
+*******************************************************************************/
+
+uint8 summary_tick(SUMMARY* summary, uint32 now, SUMMARY_RECORD* records) {
+    if (!summary->started) {
+        return 0;
+    }
+    return close_windows(summary, now, records);
+}
+
+/******************************************************************************
+* Function Name: summary_flush
+*******************************************************************************
+*
+* Summary:
+*  Close every open window now, even the ones that have not ended, e.g.
+*  before the settings of the device are changed.  The next sample starts
+*  new windows.
+*
+* Parameters:
+*  SUMMARY* summary: summary to use
+*  SUMMARY_RECORD* records: SUMMARY_MAX_LEVELS records to put the closed
+*                           windows in
+*
+* Return:
+*  uint8: number of records made, shortest windows first
+*
+*******************************************************************************/
+
+uint8 summary_flush(SUMMARY* summary, SUMMARY_RECORD* records) {
+    uint8 num_records = 0;
+    uint8 i;
+
+    for (i = 0; i < summary->num_levels; i++) {
+        if (close_level(summary, i, &records[num_records])) {
+            num_records++;
+        }
+    }
+    summary->started = false;
+    return num_records;
+}
+
+/******************************************************************************
+* Function Name: start_windows
+*******************************************************************************
+*
+* Summary:
+*  Open an empty window of every length at the same time
+*
+*******************************************************************************/
+
+static void start_windows(SUMMARY* summary, uint32 start, uint8 setting) {
+    uint8 i;
+
+    for (i = 0; i < summary->num_levels; i++) {
+        summary->levels[i].start = start;
+        summary->levels[i].count = 0;
+    }
+    summary->setting = setting;
+    summary->started = true;
+}
+
+/******************************************************************************
+* Function Name: close_windows
+*******************************************************************************
+*
+* Summary:
+*  Close the windows that ended by now, shortest first so each one is
+*  merged into the next length before that is checked.  A longer window
+*  only ends where a shorter one does.  After a gap with no samples the
+*  windows skip ahead, a window with no samples makes no record.
+*
+*******************************************************************************/
+
+static uint8 close_windows(SUMMARY* summary, uint32 now, SUMMARY_RECORD* records) {
+    SUMMARY_LEVEL* level;
+    uint8 num_records = 0;
+    uint8 i;
+
+    for (i = 0; i < summary->num_levels; i++) {
+        level = &summary->levels[i];
+        if ((int32) (now - level->start) < (int32) level->window_ms) {
+            break;
+        }
+        if (close_level(summary, i, &records[num_records])) {
+            num_records++;
+        }
+        level->start += level->window_ms * ((now - level->start) / level->window_ms);
+    }
+    return num_records;
+}
+
+/******************************************************************************
+* Function Name: close_level
+*******************************************************************************
+*
+* Summary:
+*  Make the record of the open window of a level, merge it into the
+*  window of the next level and empty it
+*
+* Return:
+*  bool: true if a record was made, false if the window had no samples
+*
+*******************************************************************************/
+
+static bool close_level(SUMMARY* summary, uint8 index, SUMMARY_RECORD* record) {
+    SUMMARY_LEVEL* level = &summary->levels[index];
+    SUMMARY_LEVEL* next = &summary->levels[index + 1];
+    SUMMARY_CHANNEL* channel;
+    uint64 variance;
+    uint8 i;
+
+    if (level->count == 0) {
+        return false;
+    }
+    record->start = level->start;
+    record->count = level->count;
+    record->device = summary->device;
+    record->level = index;
+    record->setting = summary->setting;
+    for (i = 0; i < SAMPLE_NUM_CHANNELS; i++) {
+        channel = &level->channels[i];
+        record->min[i] = channel->min;
+        record->max[i] = channel->max;
+        record->mean[i] = channel->mean;
+        variance = 0;
+        if (level->count > 1) {
+            variance = (channel->m2 / (level->count - 1) + FRACTION_HALF) >> SUMMARY_FRACTION;
+        }
+        record->variance[i] = (variance > MAX_VARIANCE) ? MAX_VARIANCE : variance;
+    }
+    if (index + 1 < summary->num_levels) {
+        for (i = 0; i < SAMPLE_NUM_CHANNELS; i++) {
+            merge_channel(&next->channels[i], next->count, &level->channels[i], level->count);
+        }
+        next->count += level->count;
+    }
+    level->count = 0;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: add_value
+*******************************************************************************
+*
+* Summary:
+*  Welford's update of a channel with a new value:
+*  mean += (value - mean) / count, M2 += (value - old mean) * (value - mean).
+*  Both differences have the same sign, so M2 only grows.
+*
+* Parameters:
+*  SUMMARY_CHANNEL* channel: statistics to update
+*  uint32 count: number of values with the new one
+*  uint16 value: new value
+*
+*******************************************************************************/
+
+static void add_value(SUMMARY_CHANNEL* channel, uint32 count, uint16 value) {
+    int32 scaled = (int32) value << SUMMARY_FRACTION;
+    int32 delta;
+
+    if (count == 1) {
+        channel->min = value;
+        channel->max = value;
+        channel->mean = scaled;
+        channel->m2 = 0;
+        return;
+    }
+    if (value < channel->min) {
+        channel->min = value;
+    }
+    if (value > channel->max) {
+        channel->max = value;
+    }
+    delta = scaled - (int32) channel->mean;
+    channel->mean += divide_rounded(delta, count);
+    channel->m2 += ((int64) delta * (scaled - (int32) channel->mean) + FRACTION_HALF)
+                   >> SUMMARY_FRACTION;
+}
+
+/******************************************************************************
+* Function Name: merge_channel
+*******************************************************************************
+*
+* Summary:
+*  Merge the statistics of a window into those of a longer one, Chan's
+*  form of Welford's method:
+*  M2 = M2a + M2b + (mean b - mean a)^2 * count a * count b / count.
+*
+*******************************************************************************/
+
+static void merge_channel(SUMMARY_CHANNEL* into, uint32 into_count,
+                          const SUMMARY_CHANNEL* from, uint32 from_count) {
+    uint32 count = into_count + from_count;
+    int64 delta;
+    uint64 squared;
+
+    if (into_count == 0) {
+        *into = *from;
+        return;
+    }
+    if (from->min < into->min) {
+        into->min = from->min;
+    }
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+    delta = (int64) from->mean - into->mean;
+    squared = (uint64) (delta * delta) >> SUMMARY_FRACTION;
+    into->m2 += from->m2 + squared * into_count / count * from_count;
+    into->mean = ((uint64) into->mean * into_count + (uint64) from->mean * from_count +
+                  count / 2) / count;
+}
+
+// value / divisor, rounded to the nearest, half away from 0
+static int32 divide_rounded(int32 value, uint32 divisor) {
+    if (value < 0) {
+        return -(int32) (((uint32) -value + divisor / 2) / divisor);
+    }
+    return (int32) (((uint32) value + divisor / 2) / divisor);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,100 @@
+/*******************************************************************************
+ * File Name: summary.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the windowed statistics of the sensor channels, that
+ *  reduce the samples of a sensor to one record of the min, max, mean and
+ *  variance of each channel per window, over several window lengths.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_SUMMARY_H)
+#define _SUMMARY_H
+
+#include "platform.h"
+#include "stdbool.h"
+#include "sample_buffer.h"
+
+/***************************************
+*      Summary constants
+***************************************/
+
+// Number of window lengths a summary can have, e.g. 1 s, 1 min and 1 h
+#if !defined(SUMMARY_MAX_LEVELS)
+#define SUMMARY_MAX_LEVELS          3
+#endif
+
+// Fraction bits of the means, and of the running sums of squares
+#define SUMMARY_FRACTION            8
+
+/***************************************
+*      Structures
+***************************************/
+
+// Running statistics of one channel over a window.  The mean and the sum
+// of squared differences from it (M2) are updated with Welford's method,
+// so there is no large sum of squares to lose precision in.
+typedef struct {
+    uint16      min;
+    uint16      max;
+    uint32      mean;       // with SUMMARY_FRACTION bits
+    uint64      m2;         // with SUMMARY_FRACTION bits
+} SUMMARY_CHANNEL;
+
+typedef struct {
+    uint32          window_ms;
+    uint32          start;      // timestamp the open window started at
+    uint32          count;      // samples in the open window
+    SUMMARY_CHANNEL channels[SAMPLE_NUM_CHANNELS];
+} SUMMARY_LEVEL;
+
+// Summary of the samples of one sensor.  Level 0 takes the samples, each
+// window of a level that closes is merged into the window of the next
+// level, so the longer windows cost nothing per sample.  The windows of
+// every level start at the first sample and follow each other, and the
+// window of a level is a whole number of windows of the level below.
+typedef struct {
+    SUMMARY_LEVEL   levels[SUMMARY_MAX_LEVELS];
+    uint8           num_levels;
+    uint8           device;
+    uint8           setting;    // setting of the samples in the open windows
+    bool            started;    // the windows are open
+} SUMMARY;
+
+// What is sent for one window
+typedef struct {
+    uint32      start;          // timestamp of the start of the window
+    uint32      count;          // number of samples
+    uint8       device;
+    uint8       level;          // index of the window length in the summary
+    uint8       setting;        // device settings the channels were measured at
+    uint16      min[SAMPLE_NUM_CHANNELS];
+    uint16      max[SAMPLE_NUM_CHANNELS];
+    uint32      mean[SAMPLE_NUM_CHANNELS];      // with SUMMARY_FRACTION bits
+    uint32      variance[SAMPLE_NUM_CHANNELS];  // sample variance, in counts squared
+} SUMMARY_RECORD;
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void summary_init(SUMMARY* summary, uint8 device);
+bool summary_add_level(SUMMARY* summary, uint32 window_ms);
+uint8 summary_update(SUMMARY* summary, const SAMPLE* sample, SUMMARY_RECORD* records);
+uint8 summary_tick(SUMMARY* summary, uint32 now, SUMMARY_RECORD* records);
+uint8 summary_flush(SUMMARY* summary, SUMMARY_RECORD* records);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,264 @@
+/*******************************************************************************
+ * File Name: telemetry.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code of the telemetry stream.  Frames are
+ *  built in one of 2 buffers and moved to the UART TX FIFO by the DMA_TX
+ *  channel, so the CPU only works once per frame.  While one buffer is 
+ *  being sent the next frame is put in the other and started from the 
+ *  end of frame interrupt.
+ *
+ *  Needs in the schematic: a UART named UART, a DMA named DMA_TX with its
+ *  drq on the UART tx_interrupt (FIFO not full) and its nrq on an 
+ *  interrupt named isr_TELEMETRY.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "telemetry.h"
+
+/***************************************
+*      DMA settings
+***************************************/  
+
+// one byte per request, as the FIFO frees a place
+#define DMA_BYTES_PER_BURST         1
+#define DMA_REQUEST_PER_BURST       1
+
+#define NUM_BUFFERS                 2
+#define NO_BUFFER                   0xFF
+
+// frames it takes to send a number of records
+#define FRAMES_FOR(_records, _per_frame)    (((_records) + (_per_frame) - 1) / (_per_frame))
+
+static uint8 frames[NUM_BUFFERS][TELEMETRY_MAX_FRAME];
+static uint16 frame_length[NUM_BUFFERS];
+static volatile uint8 sending = NO_BUFFER;      // buffer the DMA is sending
+static volatile uint8 pending = NO_BUFFER;      // full buffer waiting for the DMA
+static uint8 sequence = 0;
+static TELEMETRY_STATS stats;
+
+static uint8 dma_channel;
+static uint8 dma_td;
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static uint8 free_buffer(void);
+static void queue_frame(uint8 buffer);
+static void start_dma(uint8 buffer);
+static CY_ISR_PROTO(telemetry_dma_isr);
+
+
+/******************************************************************************
+* Function Name: telemetry_start
+*******************************************************************************
+*
+* Summary:
+*  Start the UART and set up the DMA channel and its interrupt
+*
+*******************************************************************************/
+
+void telemetry_start(void) {
+    UART_Start();
+    dma_channel = DMA_TX_DmaInitialize(DMA_BYTES_PER_BURST, DMA_REQUEST_PER_BURST, 
+                                       HI16(CYDEV_SRAM_BASE), HI16(CYDEV_PERIPH_BASE));
+    dma_td = CyDmaTdAllocate();
+    isr_TELEMETRY_StartEx(telemetry_dma_isr);
+}
+
+/******************************************************************************
+* Function Name: telemetry_send
+*******************************************************************************
+*
+* Summary:
+*  Send samples as frames of up to TELEMETRY_MAX_RECORDS each, without 
+*  waiting for the UART.  When both buffers are busy the samples left are
+*  not sent and every frame they would have filled is counted in 
+*  frames_dropped.  A caller that keeps them can send them again later.
+*
+* Parameters:
+*  const SAMPLE* samples: samples to send
+*  uint16 num_samples: number of samples
+*
+* Return:
+*  uint16: number of samples that were put in frames, the first ones
+*
+*******************************************************************************/
+
+uint16 telemetry_send(const SAMPLE* samples, uint16 num_samples) {
+    uint16 sent = 0;
+    uint8 count;
+    uint8 buffer;
+    
+    while (sent < num_samples) {
+        count = TELEMETRY_MAX_RECORDS;
+        if (num_samples - sent < TELEMETRY_MAX_RECORDS) {
+            count = num_samples - sent;
+        }
+        buffer = free_buffer();
+        if (buffer == NO_BUFFER) {
+            stats.frames_dropped += FRAMES_FOR(num_samples - sent, TELEMETRY_MAX_RECORDS);
+            break;
+        }
+        frame_length[buffer] = telemetry_frame_encode(&samples[sent], count, sequence, 
+                                                      frames[buffer]);
+        sent += count;
+        queue_frame(buffer);
+    }
+    return sent;
+}
+
+/******************************************************************************
+* Function Name: telemetry_send_summaries
+*******************************************************************************
+*
+* Summary:
+*  Send window summaries as frames of up to TELEMETRY_MAX_SUMMARIES each,
+*  the same way as telemetry_send
+*
+* Parameters:
+*  const SUMMARY_RECORD* records: summaries to send
+*  uint16 num_records: number of summaries
+*
+* Return:
+*  uint16: number of summaries that were put in frames, the first ones
+*
+*******************************************************************************/
+
+uint16 telemetry_send_summaries(const SUMMARY_RECORD* records, uint16 num_records) {
+    uint16 sent = 0;
+    uint8 count;
+    uint8 buffer;
+    
+    while (sent < num_records) {
+        count = TELEMETRY_MAX_SUMMARIES;
+        if (num_records - sent < TELEMETRY_MAX_SUMMARIES) {
+            count = num_records - sent;
+        }
+        buffer = free_buffer();
+        if (buffer == NO_BUFFER) {
+            stats.frames_dropped += FRAMES_FOR(num_records - sent, TELEMETRY_MAX_SUMMARIES);
+            break;
+        }
+        frame_length[buffer] = telemetry_summary_encode(&records[sent], count, sequence, 
+                                                        frames[buffer]);
+        sent += count;
+        queue_frame(buffer);
+    }
+    return sent;
+}
+
+/******************************************************************************
+* Function Name: telemetry_busy
+*******************************************************************************
+*
+* Return:
+*  bool: true if a frame is being sent
+*
+*******************************************************************************/
+
+bool telemetry_busy(void) {
+    return (sending != NO_BUFFER);
+}
+
+void telemetry_get_stats(TELEMETRY_STATS* stats_copy) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    *stats_copy = stats;
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: free_buffer
+*******************************************************************************
+*
+* Summary:
+*  Get the frame buffer that is not being sent, if a full buffer is not
+*  already waiting for the DMA
+*
+* Return:
+*  uint8: the buffer, or NO_BUFFER if both are busy
+*
+*******************************************************************************/
+
+static uint8 free_buffer(void) {
+    if (pending != NO_BUFFER) {
+        return NO_BUFFER;
+    }
+    return (sending == 0) ? 1 : 0;
+}
+
+/******************************************************************************
+* Function Name: queue_frame
+*******************************************************************************
+*
+* Summary:
+*  Send the frame just put in a buffer now, or after the one being sent
+*
+*******************************************************************************/
+
+static void queue_frame(uint8 buffer) {
+    uint8 interrupt_state;
+    
+    sequence++;
+    interrupt_state = CyEnterCriticalSection();
+    if (sending == NO_BUFFER) {
+        start_dma(buffer);
+    }
+    else {
+        pending = buffer;
+    }
+    CyExitCriticalSection(interrupt_state);
+}
+
+/******************************************************************************
+* Function Name: start_dma
+*******************************************************************************
+*
+* Summary:
+*  Point the transfer descriptor at a frame buffer and enable the channel.
+*  The descriptor increments the source only, the destination is the 
+*  UART TX FIFO.  Called with interrupts disabled.
+*
+*******************************************************************************/
+
+static void start_dma(uint8 buffer) {
+    sending = buffer;
+    CyDmaTdSetConfiguration(dma_td, frame_length[buffer], CY_DMA_DISABLE_TD, 
+                            DMA_TX__TD_TERMOUT_EN | CY_DMA_TD_INC_SRC_ADR);
+    CyDmaTdSetAddress(dma_td, LO16((uint32) frames[buffer]), LO16((uint32) UART_TXDATA_PTR));
+    CyDmaChSetInitialTd(dma_channel, dma_td);
+    CyDmaChEnable(dma_channel, 1);
+}
+
+/******************************************************************************
+* Function Name: telemetry_dma_isr
+*******************************************************************************
+*
+* Summary:
+*  End of frame interrupt of the DMA, start the pending frame if there is one
+*
+*******************************************************************************/
+
+static CY_ISR(telemetry_dma_isr) {
+    stats.frames_sent++;
+    stats.bytes_sent += frame_length[sending];
+    sending = NO_BUFFER;
+    if (pending != NO_BUFFER) {
+        start_dma(pending);
+        pending = NO_BUFFER;
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,51 @@
+/*******************************************************************************
+ * File Name: telemetry.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the binary telemetry stream of samples, sent on the
+ *  UART by DMA.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_TELEMETRY_H)
+#define _TELEMETRY_H
+    
+#include "platform.h"
+#include "stdbool.h"
+#include "sample_buffer.h"
+#include "telemetry_frame.h"
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+typedef struct {
+    uint32      frames_sent;
+    uint32      frames_dropped;     // not sent because both buffers were busy
+    uint32      bytes_sent;
+} TELEMETRY_STATS;
+  
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void telemetry_start(void);
+uint16 telemetry_send(const SAMPLE* samples, uint16 num_samples);
+uint16 telemetry_send_summaries(const SUMMARY_RECORD* records, uint16 num_records);
+bool telemetry_busy(void);
+void telemetry_get_stats(TELEMETRY_STATS* stats);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,509 @@
+/*******************************************************************************
+ * File Name: telemetry_frame.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the source code to build and check telemetry frames:
+ *  the CRC, the COBS byte stuffing and the packing of sample and window 
+ *  summary records.  It has no hardware calls, so the host decoder is 
+ *  built from the same file with SENSOR_HOST_BUILD defined.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "telemetry_frame.h"
+
+#define CRC_INITIAL                 0xFFFF
+
+// CRC-16/CCITT (polynomial 0x1021) of each value of a nibble, 32 bytes 
+// of table instead of 512 for two lookups per byte
+static const uint16 crc_nibble_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/***************************************
+*      Static Function Prototypes
+***************************************/  
+
+static uint16 close_frame(uint8* payload, uint16 length, uint8* frame);
+static uint16 open_frame(const uint8* frame, uint16 length, uint8* payload);
+static uint8* put_uint16(uint8* buffer, uint16 value);
+static uint8* put_uint32(uint8* buffer, uint32 value);
+static uint16 get_uint16(const uint8* buffer);
+static uint32 get_uint32(const uint8* buffer);
+
+
+/******************************************************************************
+* Function Name: telemetry_crc16
+*******************************************************************************
+*
+* Summary:
+*  Calculate the CRC-16/CCITT-FALSE of a block of bytes, the check value 
+*  of "123456789" is 0x29B1
+*
+* Parameters:
+*  const uint8* data: bytes to check
+*  uint16 length: number of bytes
+*
+* Return:
+*  uint16: CRC of the bytes
+*
+*******************************************************************************/
+
+uint16 telemetry_crc16(const uint8* data, uint16 length) {
+    uint16 crc = CRC_INITIAL;
+    uint16 i;
+    
+    for (i = 0; i < length; i++) {
+        crc = (crc << 4) ^ crc_nibble_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc_nibble_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+/******************************************************************************
+* Function Name: telemetry_cobs_encode
+*******************************************************************************
+*
+* Summary:
+*  Consistent overhead byte stuffing.  Each run of up to 254 non zero bytes
+*  is sent after a code byte of its length plus one, which also stands for 
+*  the 0 that ended the run.  The output has no 0 bytes and is at most 
+*  length / 254 + 1 bytes longer than the input.  The delimiter is not added.
+*
+* Parameters:
+*  const uint8* input: bytes to encode
+*  uint16 length: number of bytes
+*  uint8* output: where to put the encoded bytes, can not be the input
+*
+* Return:
+*  uint16: number of encoded bytes
+*
+*******************************************************************************/
+
+uint16 telemetry_cobs_encode(const uint8* input, uint16 length, uint8* output) {
+    uint16 code_index = 0;
+    uint16 out = 1;
+    uint8 code = 1;
+    uint16 i;
+    
+    for (i = 0; i < length; i++) {
+        if (input[i] == 0) {
+            output[code_index] = code;
+            code_index = out++;
+            code = 1;
+            continue;
+        }
+        output[out++] = input[i];
+        code++;
+        if (code == 0xFF) {
+            output[code_index] = code;
+            code_index = out++;
+            code = 1;
+        }
+    }
+    output[code_index] = code;
+    return out;
+}
+
+/******************************************************************************
+* Function Name: telemetry_cobs_decode
+*******************************************************************************
+*
+* Summary:
+*  Undo telemetry_cobs_encode
+*
+* Parameters:
+*  const uint8* input: encoded bytes, without the delimiter
+*  uint16 length: number of encoded bytes
+*  uint8* output: where to put the decoded bytes, can not be the input
+*
+* Return:
+*  uint16: number of decoded bytes, or 0 if the input is not valid
+*
+*******************************************************************************/
+
+uint16 telemetry_cobs_decode(const uint8* input, uint16 length, uint8* output) {
+    uint16 in = 0;
+    uint16 out = 0;
+    uint8 code;
+    uint8 i;
+    
+    while (in < length) {
+        code = input[in++];
+        if ((code == 0) || (in + code - 1 > length)) {
+            return 0;
+        }
+        for (i = 1; i < code; i++) {
+            if (input[in] == 0) {
+                return 0;
+            }
+            output[out++] = input[in++];
+        }
+        // a full run has no 0 after it, and neither has the last run
+        if ((code != 0xFF) && (in < length)) {
+            output[out++] = 0;
+        }
+    }
+    return out;
+}
+
+/******************************************************************************
+* Function Name: telemetry_frame_encode
+*******************************************************************************
+*
+* Summary:
+*  Pack samples into a frame ready to send, delimiter included
+*
+* Parameters:
+*  const SAMPLE* samples: samples to send
+*  uint8 num_samples: number of samples, 1 to TELEMETRY_MAX_RECORDS
+*  uint8 sequence: frame counter, so the receiver can count lost frames
+*  uint8* frame: TELEMETRY_MAX_FRAME bytes to put the frame in
+*
+* Return:
+*  uint16: number of bytes of the frame, 0 if there are too many samples
+*
+*******************************************************************************/
+
+uint16 telemetry_frame_encode(const SAMPLE* samples, uint8 num_samples, uint8 sequence, 
+                              uint8* frame) {
+    uint8 payload[TELEMETRY_MAX_PAYLOAD];
+    uint8* position = payload;
+    uint8 i;
+    uint8 j;
+    
+    if ((num_samples == 0) || (num_samples > TELEMETRY_MAX_RECORDS)) {
+        return 0;
+    }
+    *position++ = TELEMETRY_TYPE_SAMPLES;
+    *position++ = sequence;
+    *position++ = num_samples;
+    for (i = 0; i < num_samples; i++) {
+        position = put_uint32(position, samples[i].timestamp);
+        *position++ = samples[i].device;
+        *position++ = samples[i].status;
+        *position++ = samples[i].setting;
+        for (j = 0; j < SAMPLE_NUM_CHANNELS; j++) {
+            position = put_uint16(position, samples[i].channel[j]);
+        }
+    }
+    return close_frame(payload, position - payload, frame);
+}
+
+/******************************************************************************
+* Function Name: telemetry_frame_decode
+*******************************************************************************
+*
+* Summary:
+*  Check a received frame and unpack its samples
+*
+* Parameters:
+*  const uint8* frame: encoded frame, without the delimiter
+*  uint16 length: number of bytes of the frame
+*  uint8* sequence: where to put the sequence number of the frame
+*  SAMPLE* samples: TELEMETRY_MAX_RECORDS samples to fill
+*
+* Return:
+*  uint8: number of samples, or 0 if the frame is not valid
+*
+*******************************************************************************/
+
+uint8 telemetry_frame_decode(const uint8* frame, uint16 length, uint8* sequence, 
+                             SAMPLE* samples) {
+    uint8 payload[TELEMETRY_MAX_FRAME];
+    const uint8* position = payload;
+    uint8 num_samples;
+    uint8 i;
+    uint8 j;
+    
+    length = open_frame(frame, length, payload);
+    if (length == 0) {
+        return 0;
+    }
+    num_samples = payload[2];
+    if ((payload[0] != TELEMETRY_TYPE_SAMPLES) || (num_samples == 0) || 
+            (num_samples > TELEMETRY_MAX_RECORDS) || 
+            (length != TELEMETRY_HEADER_SIZE + num_samples * TELEMETRY_RECORD_SIZE)) {
+        return 0;
+    }
+    *sequence = payload[1];
+    position += TELEMETRY_HEADER_SIZE;
+    for (i = 0; i < num_samples; i++) {
+        samples[i].timestamp = get_uint32(position);
+        position += 4;
+        samples[i].device = *position++;
+        samples[i].status = *position++;
+        samples[i].setting = *position++;
+        for (j = 0; j < SAMPLE_NUM_CHANNELS; j++) {
+            samples[i].channel[j] = get_uint16(position);
+            position += 2;
+        }
+    }
+    return num_samples;
+}
+
+/******************************************************************************
+* Function Name: telemetry_summary_encode
+*******************************************************************************
+*
+* Summary:
+*  Pack window summaries into a frame ready to send, delimiter included
+*
+* Parameters:
+*  const SUMMARY_RECORD* records: summaries to send
+*  uint8 num_records: number of summaries, 1 to TELEMETRY_MAX_SUMMARIES
+*  uint8 sequence: frame counter, shared with the sample frames
+*  uint8* frame: TELEMETRY_MAX_FRAME bytes to put the frame in
+*
+* Return:
+*  uint16: number of bytes of the frame, 0 if there are too many summaries
+*
+*******************************************************************************/
+
+uint16 telemetry_summary_encode(const SUMMARY_RECORD* records, uint8 num_records, 
+                                uint8 sequence, uint8* frame) {
+    uint8 payload[TELEMETRY_MAX_PAYLOAD];
+    uint8* position = payload;
+    uint8 i;
+    uint8 j;
+    
+    if ((num_records == 0) || (num_records > TELEMETRY_MAX_SUMMARIES)) {
+        return 0;
+    }
+    *position++ = TELEMETRY_TYPE_SUMMARIES;
+    *position++ = sequence;
+    *position++ = num_records;
+    for (i = 0; i < num_records; i++) {
+        position = put_uint32(position, records[i].start);
+        position = put_uint32(position, records[i].count);
+        *position++ = records[i].device;
+        *position++ = records[i].level;
+        *position++ = records[i].setting;
+        for (j = 0; j < SAMPLE_NUM_CHANNELS; j++) {
+            position = put_uint16(position, records[i].min[j]);
+            position = put_uint16(position, records[i].max[j]);
+            position = put_uint32(position, records[i].mean[j]);
+            position = put_uint32(position, records[i].variance[j]);
+        }
+    }
+    return close_frame(payload, position - payload, frame);
+}
+
+/******************************************************************************
+* Function Name: telemetry_summary_decode
+*******************************************************************************
+*
+* Summary:
+*  Check a received frame and unpack its window summaries
+*
+* Parameters:
+*  const uint8* frame: encoded frame, without the delimiter
+*  uint16 length: number of bytes of the frame
+*  uint8* sequence: where to put the sequence number of the frame
+*  SUMMARY_RECORD* records: TELEMETRY_MAX_SUMMARIES summaries to fill
+*
+* Return:
+*  uint8: number of summaries, or 0 if the frame is not a valid summary
+*         frame
+*
+*******************************************************************************/
+
+uint8 telemetry_summary_decode(const uint8* frame, uint16 length, uint8* sequence, 
+                               SUMMARY_RECORD* records) {
+    uint8 payload[TELEMETRY_MAX_FRAME];
+    const uint8* position = payload;
+    uint8 num_records;
+    uint8 i;
+    uint8 j;
+    
+    length = open_frame(frame, length, payload);
+    if (length == 0) {
+        return 0;
+    }
+    num_records = payload[2];
+    if ((payload[0] != TELEMETRY_TYPE_SUMMARIES) || (num_records == 0) || 
+            (num_records > TELEMETRY_MAX_SUMMARIES) || 
+            (length != TELEMETRY_HEADER_SIZE + num_records * TELEMETRY_SUMMARY_SIZE)) {
+        return 0;
+    }
+    *sequence = payload[1];
+    position += TELEMETRY_HEADER_SIZE;
+    for (i = 0; i < num_records; i++) {
+        records[i].start = get_uint32(position);
+        records[i].count = get_uint32(position + 4);
+        position += 8;
+        records[i].device = *position++;
+        records[i].level = *position++;
+        records[i].setting = *position++;
+        for (j = 0; j < SAMPLE_NUM_CHANNELS; j++) {
+            records[i].min[j] = get_uint16(position);
+            records[i].max[j] = get_uint16(position + 2);
+            records[i].mean[j] = get_uint32(position + 4);
+            records[i].variance[j] = get_uint32(position + 8);
+            position += 12;
+        }
+    }
+    return num_records;
+}
+
+/******************************************************************************
+* Function Name: telemetry_decoder_init
+*******************************************************************************
+*
+* Summary:
+*  Set up a decoder of a telemetry byte stream, it waits for the first
+*  delimiter before it takes a frame
+*
+*******************************************************************************/
+
+void telemetry_decoder_init(TELEMETRY_DECODER* decoder) {
+    decoder->length = 0;
+    decoder->overflow = true;
+    decoder->sequence = 0;
+    decoder->synced = false;
+    decoder->frames = 0;
+    decoder->errors = 0;
+    decoder->lost = 0;
+    decoder->num_summaries = 0;
+}
+
+/******************************************************************************
+* Function Name: telemetry_decoder_put
+*******************************************************************************
+*
+* Summary:
+*  Give the decoder the next byte of the stream.  When the byte ends a
+*  good frame its samples are unpacked.  The summaries of a summary frame
+*  are unpacked in the decoder, see num_summaries.
+*
+* Parameters:
+*  TELEMETRY_DECODER* decoder: decoder to use
+*  uint8 byte: next byte received
+*  SAMPLE* samples: TELEMETRY_MAX_RECORDS samples to fill
+*
+* Return:
+*  uint8: number of samples unpacked, 0 if no frame was finished
+*
+*******************************************************************************/
+
+uint8 telemetry_decoder_put(TELEMETRY_DECODER* decoder, uint8 byte, SAMPLE* samples) {
+    uint8 sequence;
+    uint8 num_samples;
+    
+    decoder->num_summaries = 0;
+    if (byte != TELEMETRY_DELIMITER) {
+        if (decoder->length < TELEMETRY_MAX_FRAME) {
+            decoder->buffer[decoder->length++] = byte;
+        }
+        else {
+            decoder->overflow = true;
+        }
+        return 0;
+    }
+    // the bytes before the first delimiter are the tail of a lost frame
+    if (decoder->overflow || (decoder->length == 0)) {
+        decoder->overflow = false;
+        decoder->length = 0;
+        return 0;
+    }
+    num_samples = telemetry_frame_decode(decoder->buffer, decoder->length, &sequence, 
+                                         samples);
+    if (num_samples == 0) {
+        decoder->num_summaries = telemetry_summary_decode(decoder->buffer, decoder->length, 
+                                                          &sequence, decoder->summaries);
+    }
+    decoder->length = 0;
+    if ((num_samples == 0) && (decoder->num_summaries == 0)) {
+        decoder->errors++;
+        return 0;
+    }
+    if (decoder->synced) {
+        decoder->lost += (uint8) (sequence - decoder->sequence);
+    }
+    decoder->synced = true;
+    decoder->sequence = sequence + 1;
+    decoder->frames++;
+    return num_samples;
+}
+
+/******************************************************************************
+* Function Name: close_frame
+*******************************************************************************
+*
+* Summary:
+*  Add the CRC to a payload, COBS encode it into the frame and end it 
+*  with the delimiter
+*
+* Return:
+*  uint16: number of bytes of the frame
+*
+*******************************************************************************/
+
+static uint16 close_frame(uint8* payload, uint16 length, uint8* frame) {
+    put_uint16(&payload[length], telemetry_crc16(payload, length));
+    length += TELEMETRY_CRC_SIZE;
+    
+    length = telemetry_cobs_encode(payload, length, frame);
+    frame[length++] = TELEMETRY_DELIMITER;
+    return length;
+}
+
+/******************************************************************************
+* Function Name: open_frame
+*******************************************************************************
+*
+* Summary:
+*  Decode a received frame and check its CRC
+*
+* Return:
+*  uint16: number of bytes of the payload without the CRC, 0 if the frame
+*          is not valid
+*
+*******************************************************************************/
+
+static uint16 open_frame(const uint8* frame, uint16 length, uint8* payload) {
+    if (length > TELEMETRY_MAX_FRAME) {
+        return 0;
+    }
+    length = telemetry_cobs_decode(frame, length, payload);
+    if (length < TELEMETRY_HEADER_SIZE + TELEMETRY_CRC_SIZE) {
+        return 0;
+    }
+    length -= TELEMETRY_CRC_SIZE;
+    if (get_uint16(&payload[length]) != telemetry_crc16(payload, length)) {
+        return 0;
+    }
+    return length;
+}
+
+static uint8* put_uint16(uint8* buffer, uint16 value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+    return buffer + 2;
+}
+
+static uint8* put_uint32(uint8* buffer, uint32 value) {
+    buffer = put_uint16(buffer, value & 0xFFFF);
+    return put_uint16(buffer, value >> 16);
+}
+
+static uint16 get_uint16(const uint8* buffer) {
+    return buffer[0] | (buffer[1] << 8);
+}
+
+static uint32 get_uint32(const uint8* buffer) {
+    return get_uint16(buffer) | ((uint32) get_uint16(buffer + 2) << 16);
+}
+
+/* [] END OF FILE */
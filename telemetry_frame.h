@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * File Name: telemetry_frame.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the binary frame format of the telemetry stream, 
+ *  shared by the firmware and the host decoder.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_TELEMETRY_FRAME_H)
+#define _TELEMETRY_FRAME_H
+    
+#include "platform.h"
+#include "stdbool.h"
+#include "sample_buffer.h"
+#include "summary.h"
+    
+/***************************************
+*      Frame layout
+***************************************/ 
+
+// A frame is a header, up to TELEMETRY_MAX_RECORDS sample records and a
+// CRC-16 of both, all little endian.  It is COBS encoded so it has no 0
+// bytes and is ended by a 0, a receiver can start at any 0 in the stream.
+//
+//  header:  type (1), sequence (1), number of records (1)
+//  record:  timestamp (4), device (1), status (1), setting (1), 
+//           channels (2 each, SAMPLE_NUM_CHANNELS of them)
+//  crc:     CRC-16/CCITT-FALSE of the header and records (2)
+//
+// A summary frame has the same header and crc, with summary records:
+//  summary: start (4), count (4), device (1), level (1), setting (1),
+//           then for each channel min (2), max (2), mean (4), variance (4)
+
+#define TELEMETRY_TYPE_SAMPLES      0x01
+#define TELEMETRY_TYPE_SUMMARIES    0x02
+    
+#define TELEMETRY_MAX_RECORDS       8
+#define TELEMETRY_HEADER_SIZE       3
+#define TELEMETRY_RECORD_SIZE       (7 + 2 * SAMPLE_NUM_CHANNELS)
+#define TELEMETRY_SUMMARY_SIZE      (11 + 12 * SAMPLE_NUM_CHANNELS)
+// As many summaries as fit in the frame of TELEMETRY_MAX_RECORDS samples
+#define TELEMETRY_MAX_SUMMARIES     (TELEMETRY_MAX_RECORDS * TELEMETRY_RECORD_SIZE / \
+                                     TELEMETRY_SUMMARY_SIZE)
+#define TELEMETRY_CRC_SIZE          2
+#define TELEMETRY_MAX_PAYLOAD       (TELEMETRY_HEADER_SIZE + \
+                                     TELEMETRY_MAX_RECORDS * TELEMETRY_RECORD_SIZE + \
+                                     TELEMETRY_CRC_SIZE)
+// COBS adds a byte for every 254 and the frame ends with a 0
+#define TELEMETRY_MAX_FRAME         (TELEMETRY_MAX_PAYLOAD + \
+                                     (TELEMETRY_MAX_PAYLOAD / 254) + 2)
+    
+#define TELEMETRY_DELIMITER         0x00
+    
+/***************************************
+*      Structures
+***************************************/ 
+
+// Reassembles frames from the received byte stream
+typedef struct {
+    uint8       buffer[TELEMETRY_MAX_FRAME];
+    uint16      length;
+    bool        overflow;       // too many bytes since the last delimiter
+    uint8       sequence;       // expected sequence number of the next frame
+    bool        synced;         // a frame has been received
+    uint32      frames;         // good frames
+    uint32      errors;         // frames with a bad length, encoding or CRC
+    uint32      lost;           // frames missing from the sequence numbers
+    SUMMARY_RECORD  summaries[TELEMETRY_MAX_SUMMARIES];
+    uint8       num_summaries;  // summaries of the frame just finished
+} TELEMETRY_DECODER;
+  
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+uint16 telemetry_crc16(const uint8* data, uint16 length);
+uint16 telemetry_cobs_encode(const uint8* input, uint16 length, uint8* output);
+uint16 telemetry_cobs_decode(const uint8* input, uint16 length, uint8* output);
+
+uint16 telemetry_frame_encode(const SAMPLE* samples, uint8 num_samples, uint8 sequence, 
+                              uint8* frame);
+uint8 telemetry_frame_decode(const uint8* frame, uint16 length, uint8* sequence, 
+                             SAMPLE* samples);
+uint16 telemetry_summary_encode(const SUMMARY_RECORD* records, uint8 num_records, 
+                                uint8 sequence, uint8* frame);
+uint8 telemetry_summary_decode(const uint8* frame, uint16 length, uint8* sequence, 
+                               SUMMARY_RECORD* records);
+
+void telemetry_decoder_init(TELEMETRY_DECODER* decoder);
+uint8 telemetry_decoder_put(TELEMETRY_DECODER* decoder, uint8 byte, SAMPLE* samples);
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,189 @@
+/*******************************************************************************
+ * File Name: bench_pipeline.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host benchmark of the conversion pipeline with 8 sensors, an isl29125
+ *  and 3 tsl2561 on each of 2 simulated buses.  The samples per second
+ *  of the pipeline are printed for every sensor and together, next to
+ *  the rate the conversion times allow and the rate of reading the
+ *  sensors one at a time: start, wait for the conversion, read, stop.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include "sensor_bus_sim.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "timebase.h"
+
+#define NUM_BUSES                   2
+#define TSL2561_PER_BUS             3
+#define SENSORS_PER_BUS             (1 + TSL2561_PER_BUS)
+#define NUM_SENSORS                 (NUM_BUSES * SENSORS_PER_BUS)
+#define RUN_MS                      2000
+
+// longest the benchmark sleeps, so the samples are taken out in time
+#define MAX_SLEEP_MS                5
+
+static const uint8 tsl2561_addresses[TSL2561_PER_BUS] = {
+    I2C_ADDRESS_GROUND, I2C_ADDRESS_FLOAT, I2C_ADDRESS_VDD
+};
+
+static SENSOR_BUS buses[NUM_BUSES];
+static SENSOR_SIM sims[NUM_BUSES];
+static ISL29125 isl29125s[NUM_BUSES];
+static TSL2561 tsl2561s[NUM_BUSES * TSL2561_PER_BUS];
+static SAMPLE_BUFFER samples;
+static PIPELINE pipeline;
+
+// every sensor set up and stopped, with short conversions
+static void setup_sensors(void) {
+    TSL2561* tsl2561;
+    uint8 bus;
+    uint8 i;
+
+    for (bus = 0; bus < NUM_BUSES; bus++) {
+        sensor_sim_init(&buses[bus], &sims[bus]);
+        sensor_sim_set_light(sensor_sim_add_isl29125(&sims[bus], ISL29125_I2C_ADDRESS),
+                             4000, 3000, 2000);
+        isl29125_init(&isl29125s[bus], &buses[bus], ISL29125_I2C_ADDRESS);
+        set_adc_resolution(&isl29125s[bus], ISL29125_CONFIG1_ADC_12BIT);
+        isl29125_stop(&isl29125s[bus]);
+        for (i = 0; i < TSL2561_PER_BUS; i++) {
+            tsl2561 = &tsl2561s[bus * TSL2561_PER_BUS + i];
+            sensor_sim_set_light(sensor_sim_add_tsl2561(&sims[bus], tsl2561_addresses[i]),
+                                 3000, 1000, 0);
+            tsl2561_Init(tsl2561, &buses[bus], tsl2561_addresses[i]);
+            tsl2561_set_timing(tsl2561, TSL2561_INTEGRATION_13MS, TSL2561_GAIN_1X);
+            tsl2561_Stop(tsl2561);
+        }
+    }
+}
+
+// samples per second the conversion times of the running sensors allow
+static double conversion_rate(void) {
+    double rate = 0;
+    uint8 i;
+
+    for (i = 0; i < NUM_BUSES; i++) {
+        rate += 1000.0 / isl29125_conversion_time_ms(&isl29125s[i]);
+    }
+    for (i = 0; i < NUM_BUSES * TSL2561_PER_BUS; i++) {
+        rate += 1000.0 / tsl2561_conversion_time_ms(&tsl2561s[i]);
+    }
+    return rate;
+}
+
+static uint32 run_pipeline(uint32* counts, double* allowed) {
+    static SAMPLE out[SAMPLE_BUFFER_SIZE];
+    uint32 total = 0;
+    uint32 start;
+    uint32 wait;
+    uint16 count;
+    uint16 i;
+    uint8 bus;
+    uint8 j;
+
+    sample_buffer_init(&samples);
+    pipeline_init(&pipeline, &samples);
+    for (bus = 0; bus < NUM_BUSES; bus++) {
+        pipeline_add(&pipeline, &pipeline_isl29125_ops, &isl29125s[bus],
+                     bus * SENSORS_PER_BUS);
+        for (j = 0; j < TSL2561_PER_BUS; j++) {
+            pipeline_add(&pipeline, &pipeline_tsl2561_ops, &tsl2561s[bus * TSL2561_PER_BUS + j],
+                         bus * SENSORS_PER_BUS + 1 + j);
+        }
+    }
+    start = timebase_ms();
+    pipeline_start(&pipeline);
+    *allowed = conversion_rate();
+    while ((uint32) (timebase_ms() - start) < RUN_MS) {
+        wait = pipeline_run(&pipeline);
+        while ((count = sample_buffer_get(&samples, out, SAMPLE_BUFFER_SIZE)) != 0) {
+            for (i = 0; i < count; i++) {
+                counts[out[i].device]++;
+            }
+            total += count;
+        }
+        if (wait) {
+            scheduler_sleep((wait > MAX_SLEEP_MS) ? MAX_SLEEP_MS : wait);
+        }
+    }
+    for (bus = 0; bus < NUM_BUSES; bus++) {
+        isl29125_stop(&isl29125s[bus]);
+    }
+    for (j = 0; j < NUM_BUSES * TSL2561_PER_BUS; j++) {
+        tsl2561_Stop(&tsl2561s[j]);
+    }
+    return total;
+}
+
+static uint32 run_one_at_a_time(void) {
+    ISL29125_RGB rgb;
+    TSL2561_DATA data;
+    TSL2561* tsl2561;
+    uint32 total = 0;
+    uint32 start = timebase_ms();
+    uint8 bus;
+    uint8 i;
+
+    while ((uint32) (timebase_ms() - start) < RUN_MS) {
+        for (bus = 0; bus < NUM_BUSES; bus++) {
+            isl29125_start(&isl29125s[bus]);
+            scheduler_sleep(isl29125_conversion_time_ms(&isl29125s[bus]));
+            if (isl29125_read_rgb(&isl29125s[bus], &rgb) == SENSOR_OK) {
+                total++;
+            }
+            isl29125_stop(&isl29125s[bus]);
+            for (i = 0; i < TSL2561_PER_BUS; i++) {
+                tsl2561 = &tsl2561s[bus * TSL2561_PER_BUS + i];
+                tsl2561_Start(tsl2561);
+                scheduler_sleep(tsl2561_conversion_time_ms(tsl2561));
+                if (tsl2561_read_data(tsl2561, &data) == SENSOR_OK) {
+                    total++;
+                }
+                tsl2561_Stop(tsl2561);
+            }
+        }
+    }
+    return total;
+}
+
+int main(void) {
+    uint32 counts[NUM_SENSORS] = {0};
+    uint32 pipelined;
+    uint32 one_at_a_time;
+    double allowed;
+    int errors = 0;
+    uint8 i;
+
+    setup_sensors();
+    pipelined = run_pipeline(counts, &allowed);
+    one_at_a_time = run_one_at_a_time();
+
+    printf("pipeline, %u sensors on %u buses for %u ms:\n", NUM_SENSORS, NUM_BUSES, RUN_MS);
+    for (i = 0; i < NUM_SENSORS; i++) {
+        printf("  sensor %u: %.0f samples/s\n", i, counts[i] * 1000.0 / RUN_MS);
+        if (counts[i] == 0) {
+            errors++;
+        }
+    }
+    printf("  together %.0f samples/s, %u results missed, conversions allow %.0f\n",
+           pipelined * 1000.0 / RUN_MS, pipeline.missed, allowed);
+    printf("  one at a time %.0f samples/s: %s\n", one_at_a_time * 1000.0 / RUN_MS,
+           errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,247 @@
+/*******************************************************************************
+ * File Name: bench_queue.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host benchmark of the transaction queue, with an isl29125 and 3 tsl2561
+ *  on a simulated bus that takes as long as a 400 kHz bus would for each
+ *  transfer.  The sensors are read back to back with the blocking reads,
+ *  then with the queued reads while the main loop does other work.  For
+ *  each the reads per second, the deepest the queue got, the engine polls
+ *  spent inside blocking calls and the fraction of the time the CPU was
+ *  free for other work are printed.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include <time.h>
+#include "sensor_bus_sim.h"
+#include "sensor_bus_count.h"
+#include "isl29125.h"
+#include "tsl2561.h"
+
+#define NUM_TSL2561                 3
+#define NUM_SENSORS                 (1 + NUM_TSL2561)
+#define RUN_NS                      1000000000ull
+
+// one piece of the other work of the main loop, short next to a transfer
+#define WORK_NS                     20000ull
+
+// Bus that finishes each transfer of the simulated bus only once the bus
+// time of the counting bus in front of it has passed
+typedef struct {
+    SENSOR_BUS*     inner;
+    SENSOR_COUNTER* counter;
+    uint64          started_ns;     // when the active transfer was started
+    uint64          done_ns;        // when its bus time is over, 0 until known
+} PACED_BUS;
+
+typedef struct {
+    uint32      reads;
+    uint64      elapsed_ns;
+    uint64      idle_ns;            // time given to the other work
+    SENSOR_QUEUE_STATS stats;
+} RUN;
+
+static bool paced_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+static bool paced_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction);
+
+static const SENSOR_BUS_OPS paced_ops = {
+    paced_start,
+    paced_poll,
+    0
+};
+
+static const uint8 tsl2561_addresses[NUM_TSL2561] = {
+    I2C_ADDRESS_GROUND, I2C_ADDRESS_FLOAT, I2C_ADDRESS_VDD
+};
+
+static SENSOR_BUS sim_bus;
+static SENSOR_BUS count_bus;
+static SENSOR_BUS bus;
+static SENSOR_SIM sim;
+static SENSOR_COUNTER counter;
+static PACED_BUS paced;
+static ISL29125 isl29125;
+static TSL2561 tsl2561s[NUM_TSL2561];
+
+static uint64 now_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static uint32 bus_time_us(SENSOR_COUNTER* counter) {
+    SENSOR_COUNTS counts;
+
+    sensor_count_get(counter, &counts);
+    return counts.bus_time_us;
+}
+
+static bool paced_start(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    PACED_BUS* paced = (PACED_BUS*) bus->context;
+
+    paced->started_ns = now_ns();
+    paced->done_ns = 0;
+    return paced->inner->ops->start(paced->inner, transaction);
+}
+
+static bool paced_poll(SENSOR_BUS* bus, SENSOR_TRANSACTION* transaction) {
+    PACED_BUS* paced = (PACED_BUS*) bus->context;
+    uint32 before;
+
+    if (paced->done_ns == 0) {
+        before = bus_time_us(paced->counter);
+        if (!paced->inner->ops->poll(paced->inner, transaction)) {
+            return false;
+        }
+        paced->done_ns = paced->started_ns +
+                         (uint64) (bus_time_us(paced->counter) - before) * 1000;
+    }
+    return now_ns() >= paced->done_ns;
+}
+
+// the other work of the main loop, the time it gets is the idle time of the drivers
+static void other_work(RUN* run) {
+    uint64 start = now_ns();
+
+    while (now_ns() - start < WORK_NS) {
+    }
+    run->idle_ns += now_ns() - start;
+}
+
+static void run_start(RUN* run) {
+    SENSOR_QUEUE_STATS empty_stats = {0};
+    RUN empty_run = {0};
+
+    *run = empty_run;
+    bus.stats = empty_stats;
+}
+
+static void run_blocking(RUN* run) {
+    ISL29125_RGB rgb;
+    TSL2561_DATA data;
+    uint64 start;
+    uint8 i;
+
+    run_start(run);
+    start = now_ns();
+    while (now_ns() - start < RUN_NS) {
+        if (isl29125_read_rgb(&isl29125, &rgb) == SENSOR_OK) {
+            run->reads++;
+        }
+        for (i = 0; i < NUM_TSL2561; i++) {
+            if (tsl2561_read_data(&tsl2561s[i], &data) == SENSOR_OK) {
+                run->reads++;
+            }
+        }
+        other_work(run);
+    }
+    run->elapsed_ns = now_ns() - start;
+    run->stats = bus.stats;
+}
+
+static void run_queued(RUN* run) {
+    static SENSOR_TRANSACTION transactions[NUM_SENSORS];
+    static uint8 buffers[NUM_SENSORS][ISL29125_RGB_READ_LENGTH];
+    SENSOR_TRANSACTION* transaction;
+    ISL29125_RGB rgb;
+    TSL2561_DATA data;
+    uint64 start;
+    uint8 i;
+
+    run_start(run);
+    start = now_ns();
+    while (now_ns() - start < RUN_NS) {
+        // each sensor has one read in the queue, the next is queued when it is done
+        for (i = 0; i < NUM_SENSORS; i++) {
+            transaction = &transactions[i];
+            if (transaction->state == SENSOR_XFER_DONE) {
+                if (((i == 0) ? isl29125_finish_rgb_read(&isl29125, transaction, &rgb) :
+                     tsl2561_finish_data_read(&tsl2561s[i - 1], transaction, &data)) ==
+                        SENSOR_OK) {
+                    run->reads++;
+                }
+                transaction->state = SENSOR_XFER_IDLE;
+            }
+            if (transaction->state == SENSOR_XFER_IDLE) {
+                if (i == 0) {
+                    isl29125_submit_rgb_read(&isl29125, transaction, buffers[i]);
+                }
+                else {
+                    tsl2561_submit_data_read(&tsl2561s[i - 1], transaction, buffers[i]);
+                }
+            }
+        }
+        // on the target the I2C interrupt does this
+        sensor_bus_service(&bus);
+        other_work(run);
+    }
+    run->elapsed_ns = now_ns() - start;
+    run->stats = bus.stats;
+    while (sensor_bus_busy(&bus)) {
+        sensor_bus_service(&bus);
+    }
+}
+
+static double idle_fraction(RUN* run) {
+    return (double) run->idle_ns / run->elapsed_ns;
+}
+
+static void print_run(const char* name, RUN* run) {
+    printf("  %-8s %6.0f reads/s, queue depth max %u, %8u wait polls, cpu idle %3.0f%%\n",
+           name, run->reads * 1e9 / run->elapsed_ns, run->stats.max_depth,
+           run->stats.wait_polls, 100 * idle_fraction(run));
+}
+
+int main(void) {
+    RUN blocking;
+    RUN queued;
+    int errors = 0;
+    uint8 i;
+
+    sensor_sim_init(&sim_bus, &sim);
+    sensor_sim_set_light(sensor_sim_add_isl29125(&sim, ISL29125_I2C_ADDRESS), 4000, 3000, 2000);
+    for (i = 0; i < NUM_TSL2561; i++) {
+        sensor_sim_set_light(sensor_sim_add_tsl2561(&sim, tsl2561_addresses[i]), 3000, 1000, 0);
+    }
+    sensor_count_init(&count_bus, &counter, &sim_bus, SENSOR_COUNT_FAST_HZ);
+    paced.inner = &count_bus;
+    paced.counter = &counter;
+    sensor_bus_init(&bus, &paced_ops, &paced);
+    isl29125_init(&isl29125, &bus, ISL29125_I2C_ADDRESS);
+    for (i = 0; i < NUM_TSL2561; i++) {
+        tsl2561_Init(&tsl2561s[i], &bus, tsl2561_addresses[i]);
+    }
+
+    run_blocking(&blocking);
+    run_queued(&queued);
+
+    printf("queue depth and idle time, %u sensors on a bus at 400 kHz for %llu ms:\n",
+           NUM_SENSORS, RUN_NS / 1000000);
+    print_run("blocking", &blocking);
+    print_run("queued", &queued);
+    if ((blocking.reads == 0) || (queued.reads == 0)) {
+        errors++;
+    }
+    // the queued reads wait for nothing, and the CPU gets the bus time back
+    if ((queued.stats.wait_polls != 0) || (queued.stats.max_depth < 2) ||
+            (idle_fraction(&queued) <= idle_fraction(&blocking))) {
+        errors++;
+    }
+    printf("  queued reads leave the cpu idle: %s\n", errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,122 @@
+/*******************************************************************************
+ * File Name: bench_warm_init.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host benchmark of the cold and warm initialization of the isl29125 and
+ *  tsl2561, on the simulated bus behind the counting bus.  The I2C
+ *  transactions, bytes and bus time at 400 kHz of each start are printed:
+ *  the cold init, a warm init with nothing saved yet, a warm init after a
+ *  restart of the MCU only, and one after the sensors lost power too.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include "sensor_bus_sim.h"
+#include "sensor_bus_count.h"
+#include "isl29125.h"
+#include "tsl2561.h"
+#include "nv_store.h"
+
+#define ISL29125_ADDRESS            0x44
+#define TSL2561_ADDRESS             0x39
+
+// how each start is made
+#define START_COLD                  0
+#define START_FIRST_BOOT            1   // warm init, nothing saved yet
+#define START_RESTART               2   // warm init, the sensor kept its registers
+#define START_POWER_LOST            3   // warm init, the sensor was reset by a power cycle
+#define NUM_STARTS                  4
+
+static const char* start_names[NUM_STARTS] = {
+    "cold init", "warm, first boot", "warm, mcu restart", "warm, power lost"
+};
+
+// a warm start is only expected after a restart with the registers kept
+static const bool start_warm[NUM_STARTS] = {false, false, true, false};
+
+static SENSOR_BUS sim_bus;
+static SENSOR_BUS bus;
+static SENSOR_SIM sim;
+static SENSOR_COUNTER counter;
+static int errors;
+
+static void print_counts(const char* sensor, uint8 start, bool warm) {
+    SENSOR_COUNTS counts;
+
+    sensor_count_get(&counter, &counts);
+    printf("  %-9s %-18s %3u transactions %4u bytes %6u us%s\n", sensor, start_names[start],
+           counts.transactions, counts.bytes, counts.bus_time_us,
+           (warm == start_warm[start]) ? "" : "  FAIL");
+    if (warm != start_warm[start]) {
+        errors++;
+    }
+}
+
+// registers of the sensors after they were powered up again
+static void power_cycle(SENSOR_SIM_DEVICE* isl29125_model, SENSOR_SIM_DEVICE* tsl2561_model) {
+    isl29125_model->registers[ISL29125_CONFIG_REG_1] = 0x00;
+    isl29125_model->registers[ISL29125_CONFIG_REG_2] = 0x00;
+    isl29125_model->registers[ISL29125_CONFIG_REG_3] = 0x00;
+    tsl2561_model->registers[TSL2561_REG_CONTROL] = 0x00;
+}
+
+int main(void) {
+    static ISL29125 isl29125;
+    static TSL2561 tsl2561;
+    SENSOR_SIM_DEVICE* isl29125_model;
+    SENSOR_SIM_DEVICE* tsl2561_model;
+    bool warm;
+    uint8 start;
+
+    sensor_sim_init(&sim_bus, &sim);
+    isl29125_model = sensor_sim_add_isl29125(&sim, ISL29125_ADDRESS);
+    tsl2561_model = sensor_sim_add_tsl2561(&sim, TSL2561_ADDRESS);
+    sensor_count_init(&bus, &counter, &sim_bus, SENSOR_COUNT_FAST_HZ);
+    nv_store_start();
+    nv_store_erase(NV_SLOT_ISL29125);
+    nv_store_erase(NV_SLOT_TSL2561);
+
+    printf("warm init, I2C traffic of each start:\n");
+    for (start = 0; start < NUM_STARTS; start++) {
+        if (start == START_POWER_LOST) {
+            power_cycle(isl29125_model, tsl2561_model);
+        }
+        sensor_count_reset(&counter);
+        if (start == START_COLD) {
+            isl29125_init(&isl29125, &bus, ISL29125_ADDRESS);
+            warm = false;
+        }
+        else {
+            warm = isl29125_warm_init(&isl29125, &bus, ISL29125_ADDRESS, NV_SLOT_ISL29125);
+        }
+        print_counts("isl29125", start, warm);
+
+        sensor_count_reset(&counter);
+        if (start == START_COLD) {
+            tsl2561_Init(&tsl2561, &bus, TSL2561_ADDRESS);
+            warm = false;
+        }
+        else {
+            warm = tsl2561_warm_init(&tsl2561, &bus, TSL2561_ADDRESS, NV_SLOT_TSL2561);
+        }
+        print_counts("tsl2561", start, warm);
+        if (!isl29125.working || !tsl2561.working) {
+            printf("  sensors not working after the %s\n", start_names[start]);
+            errors++;
+        }
+    }
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,279 @@
+/*******************************************************************************
+ * File Name: test_color.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host test of the fixed point color conversion against the same math in
+ *  double precision.  Counts over the whole range of each range and
+ *  resolution setting are converted both ways, and the XYZ, lux, xy
+ *  chromaticity and McCamy color temperature are compared.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include "color.h"
+
+#define NUM_RANDOM                  200000
+
+// Allowed errors.  Each of the 3 matrix products can be floored by up to a
+// count before the counts are scaled to the 375 lux range at 16 bits.
+#define XYZ_ERROR_COUNTS            3.0
+#define XY_ERROR                    0.0005      // chromaticity
+#define CCT_ERROR_KELVIN            15.0        // up to 10000 K
+#define CCT_ERROR_RELATIVE          0.005       // above 10000 K
+
+// color_cct only uses McCamy's fit for |n| up to 2, a little less is checked
+// so the rounding of n does not matter
+#define MCCAMY_N_MAX                1.99
+
+// The planckian locus from 2000 K to 12500 K is above this y
+#define LOCUS_MIN_Y                 0.25
+
+typedef struct {
+    uint8       range;
+    uint8       resolution;
+    uint16      max_count;
+    double      scale;          // normalized counts per count
+} SETTING;
+
+static const SETTING settings[] = {
+    {ISL29125_CONFIG1_375LUX, ISL29125_CONFIG1_ADC_16BIT, 0xFFFF, 1.0},
+    {ISL29125_CONFIG1_375LUX, ISL29125_CONFIG1_ADC_12BIT, 0x0FFF, 16.0},
+    {ISL29125_CONFIG1_10KLUX, ISL29125_CONFIG1_ADC_16BIT, 0xFFFF, 80.0 / 3.0},
+    {ISL29125_CONFIG1_10KLUX, ISL29125_CONFIG1_ADC_12BIT, 0x0FFF, 16.0 * 80.0 / 3.0}
+};
+#define NUM_SETTINGS                (sizeof(settings) / sizeof(settings[0]))
+
+// A bluish, a neutral and a reddish matrix, with negative coefficients like
+// the calibration of a real sensor has
+static const COLOR_CALIBRATION calibrations[] = {
+    {{{27027, 23436, 11829}, {13933, 46871, 4732}, {1265, 7812, 62292}}},
+    {{{98304, -16384, 4096}, {-8192, 81920, -2048}, {1024, -12288, 90112}}},
+    {{{40000, 10000, -3000}, {30000, 30000, 1000}, {-500, 2000, 20000}}}
+};
+#define NUM_CALIBRATIONS            (sizeof(calibrations) / sizeof(calibrations[0]))
+
+typedef struct {
+    double      X;
+    double      Y;
+    double      Z;
+    double      lux;
+    double      x;
+    double      y;
+    double      cct;
+} REFERENCE;
+
+static uint32 random_state = 12345;
+static double max_error[6];
+static uint32 num_checked;
+static uint32 num_cct_checked;
+static int errors;
+
+static uint32 next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static double mccamy_n(double x, double y) {
+    return (x - 0.3320) / (y - 0.1858);
+}
+
+static double mccamy(double x, double y) {
+    double n = mccamy_n(x, y);
+
+    return -449.0 * n * n * n + 3525.0 * n * n - 6823.3 * n + 5520.33;
+}
+
+// what an error of x and y can change n by
+static double n_error(double x, double y, double xy_error) {
+    double n = mccamy_n(x, y);
+
+    return fabs(mccamy_n(x + xy_error, y) - n) + fabs(mccamy_n(x, y - xy_error) - n);
+}
+
+// error of the fixed point temperature, plus what an error of x and y
+// can change the temperature by
+static double cct_allowed(double x, double y, double xy_error) {
+    double cct = mccamy(x, y);
+    double allowed = (cct > 10000.0) ? cct * CCT_ERROR_RELATIVE : CCT_ERROR_KELVIN;
+
+    allowed += fabs(mccamy(x + xy_error, y) - cct) + fabs(mccamy(x, y + xy_error) - cct);
+    return allowed;
+}
+
+static void reference_convert(const COLOR_CALIBRATION* calibration, const ISL29125_RGB* rgb,
+                              double scale, REFERENCE* reference) {
+    double counts[3] = {rgb->red, rgb->green, rgb->blue};
+    double tristimulus[3];
+    double sum;
+    int row;
+    int i;
+
+    for (row = 0; row < 3; row++) {
+        tristimulus[row] = 0;
+        for (i = 0; i < 3; i++) {
+            tristimulus[row] += calibration->matrix[row][i] / 65536.0 * counts[i];
+        }
+        tristimulus[row] = (tristimulus[row] < 0) ? 0 : tristimulus[row] * scale;
+    }
+    reference->X = tristimulus[0];
+    reference->Y = tristimulus[1];
+    reference->Z = tristimulus[2];
+    reference->lux = reference->Y * 375.0 / 65535.0;
+    sum = reference->X + reference->Y + reference->Z;
+    reference->x = (sum > 0) ? reference->X / sum : 0;
+    reference->y = (sum > 0) ? reference->Y / sum : 0;
+    reference->cct = (reference->y > 0.1858) ? mccamy(reference->x, reference->y) : 0;
+}
+
+static void check(const char* name, int index, double value, double expected, double allowed,
+                  const ISL29125_RGB* rgb, const SETTING* setting) {
+    double error = fabs(value - expected);
+
+    if (error / allowed > max_error[index]) {
+        max_error[index] = error / allowed;
+    }
+    if (error > allowed) {
+        if (errors++ < 10) {
+            printf("%s %.4f, float %.4f for %u %u %u range %u resolution %u\n", name, value,
+                   expected, rgb->red, rgb->green, rgb->blue, setting->range,
+                   setting->resolution);
+        }
+    }
+}
+
+static void check_sample(const COLOR_CALIBRATION* calibration, const SETTING* setting,
+                         uint16 red, uint16 green, uint16 blue) {
+    ISL29125_RGB rgb = {0};
+    COLOR_RESULT result;
+    REFERENCE reference;
+    double allowed = XYZ_ERROR_COUNTS * setting->scale + 1.0;
+    double xy_error;
+    double sum;
+
+    rgb.red = red;
+    rgb.green = green;
+    rgb.blue = blue;
+    rgb.intensity_range = setting->range;
+    rgb.adc_resolution = setting->resolution;
+    color_convert(calibration, &rgb, &result);
+    reference_convert(calibration, &rgb, setting->scale, &reference);
+    num_checked++;
+
+    check("X", 0, result.X, reference.X, allowed, &rgb, setting);
+    check("Y", 1, result.Y, reference.Y, allowed, &rgb, setting);
+    check("Z", 2, result.Z, reference.Z, allowed, &rgb, setting);
+    check("lux", 3, result.millilux / 1000.0, reference.lux,
+          allowed * 375.0 / 65535.0 + 0.001 + reference.lux * 0.0002, &rgb, setting);
+
+    // with only a few counts the chromaticity is mostly rounding
+    sum = reference.X + reference.Y + reference.Z;
+    if (sum < 200.0 * allowed) {
+        return;
+    }
+    // and the floors of the matrix products carry into x and y
+    check("x", 4, result.x / 32768.0, reference.x, XY_ERROR + 2.0 * allowed / sum, &rgb,
+          setting);
+    check("y", 4, result.y / 32768.0, reference.y, XY_ERROR + 2.0 * allowed / sum, &rgb,
+          setting);
+
+    // McCamy's fit is only meant for about 2000 K to 12500 K, near the
+    // planckian locus, color_cct gives no temperature far from it.  Near
+    // y = 0.1858 the smallest error of y changes the temperature a lot.
+    xy_error = XY_ERROR + 2.0 * allowed / sum;
+    if ((reference.cct < 2000.0) || (reference.cct > 12500.0) ||
+            (reference.y < LOCUS_MIN_Y) ||
+            (fabs(mccamy_n(reference.x, reference.y)) + n_error(reference.x, reference.y,
+                                                                xy_error) > MCCAMY_N_MAX)) {
+        return;
+    }
+    num_cct_checked++;
+    check("cct", 5, result.cct, reference.cct,
+          cct_allowed(reference.x, reference.y, xy_error), &rgb, setting);
+}
+
+// points on and near the planckian locus, where McCamy's fit is used
+static void check_cct(void) {
+    double x;
+    double y;
+    uint16 cct;
+
+    for (x = 0.25; x <= 0.55; x += 0.001) {
+        for (y = LOCUS_MIN_Y; y <= 0.45; y += 0.001) {
+            double expected = mccamy(x, y);
+
+            cct = color_cct((uint16) lround(x * 32768.0), (uint16) lround(y * 32768.0));
+            if ((expected < 2000.0) || (expected > 12500.0) ||
+                    (fabs(mccamy_n(x, y)) + n_error(x, y, 1.0 / 32768.0) > MCCAMY_N_MAX)) {
+                continue;
+            }
+            // x and y are rounded to Q15
+            if (fabs(cct - expected) > cct_allowed(x, y, 1.0 / 32768.0)) {
+                if (errors++ < 10) {
+                    printf("cct of %.3f %.3f is %u, float %.1f\n", x, y, cct, expected);
+                }
+            }
+        }
+    }
+    // below the McCamy epicenter there is no color temperature
+    if (color_cct(16384, 6000) != COLOR_CCT_INVALID) {
+        printf("cct below y 0.1858 is not invalid\n");
+        errors++;
+    }
+}
+
+int main(void) {
+    static const uint16 edges[] = {0, 1, 2, 15, 255, 4095, 4096, 32768, 65534, 65535};
+    const SETTING* setting;
+    uint32 c;
+    uint32 s;
+    uint32 i;
+    uint32 j;
+    uint32 k;
+    uint32 n;
+
+    for (c = 0; c < NUM_CALIBRATIONS; c++) {
+        for (s = 0; s < NUM_SETTINGS; s++) {
+            setting = &settings[s];
+            for (i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+                for (j = 0; j < sizeof(edges) / sizeof(edges[0]); j++) {
+                    for (k = 0; k < sizeof(edges) / sizeof(edges[0]); k++) {
+                        if ((edges[i] <= setting->max_count) &&
+                                (edges[j] <= setting->max_count) &&
+                                (edges[k] <= setting->max_count)) {
+                            check_sample(&calibrations[c], setting, edges[i], edges[j],
+                                         edges[k]);
+                        }
+                    }
+                }
+            }
+            for (n = 0; n < NUM_RANDOM; n++) {
+                check_sample(&calibrations[c], setting, next_random() % (setting->max_count + 1),
+                             next_random() % (setting->max_count + 1),
+                             next_random() % (setting->max_count + 1));
+            }
+        }
+    }
+    check_cct();
+
+    printf("color: %u samples, %u with a cct, worst error / allowed: XYZ %.2f %.2f %.2f "
+           "lux %.2f xy %.2f cct %.2f: %s\n", num_checked, num_cct_checked, max_error[0],
+           max_error[1], max_error[2], max_error[3], max_error[4], max_error[5],
+           errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
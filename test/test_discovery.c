@@ -0,0 +1,168 @@
+/*******************************************************************************
+ * File Name: test_discovery.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host test of the discovery of the sensors on 2 simulated buses, each
+ *  behind a counting bus.  Every candidate address is probed once per
+ *  bus, and only the addresses that answered get their ID read.  Parts
+ *  with the wrong ID are left out: an isl29125 whose ID is not 0x7D and a
+ *  tsl2561 whose part number is not the T or CS one.  A device at the
+ *  same address on both buses is found once on each, and no device is
+ *  in the table twice.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include "sensor_bus_sim.h"
+#include "sensor_bus_count.h"
+#include "discovery.h"
+#include "timebase.h"
+
+#define NUM_BUSES                   2
+#define NUM_CANDIDATES              4u      // isl29125 and the 3 tsl2561 addresses
+
+// ID register of the tsl2561: part number in the upper nibble, revision below
+#define TSL2561_ID_PARTNO_OTHER     REGMAP_ENCODE(TSL2561_PARTNO, 0x3)
+#define TSL2561_ID_REVISION         0x0A
+
+// What the table should hold, in the order the buses are scanned
+typedef struct {
+    uint8       bus;
+    uint8       type;
+    uint8       address;
+} EXPECTED;
+
+static const EXPECTED expected[] = {
+    {0, DISCOVERY_ISL29125, ISL29125_I2C_ADDRESS},
+    {0, DISCOVERY_TSL2561,  I2C_ADDRESS_GROUND},
+    {0, DISCOVERY_TSL2561,  I2C_ADDRESS_FLOAT},
+    {1, DISCOVERY_TSL2561,  I2C_ADDRESS_FLOAT}
+};
+
+#define NUM_EXPECTED                (sizeof(expected) / sizeof(expected[0]))
+
+static SENSOR_BUS sim_buses[NUM_BUSES];
+static SENSOR_BUS count_buses[NUM_BUSES];
+static SENSOR_SIM sims[NUM_BUSES];
+static SENSOR_COUNTER counters[NUM_BUSES];
+static DISCOVERY_TABLE table;
+static int errors;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        printf("%s\n", what);
+        errors++;
+    }
+}
+
+// bus 0: a good isl29125, a tsl2561 CS and a T, nothing at the VDD address
+// bus 1: an isl29125 with the wrong ID, a tsl2561 of another part, a T of
+//        another revision, and an unplugged one at the VDD address
+static void setup_buses(void) {
+    SENSOR_SIM_DEVICE* device;
+    uint8 i;
+
+    for (i = 0; i < NUM_BUSES; i++) {
+        sensor_sim_init(&sim_buses[i], &sims[i]);
+        sensor_count_init(&count_buses[i], &counters[i], &sim_buses[i], SENSOR_COUNT_FAST_HZ);
+    }
+    sensor_sim_add_isl29125(&sims[0], ISL29125_I2C_ADDRESS);
+    device = sensor_sim_add_tsl2561(&sims[0], I2C_ADDRESS_GROUND);
+    device->registers[TSL2561_REG_ID] = TSL2561_ID_PARTNO_CS;
+    sensor_sim_add_tsl2561(&sims[0], I2C_ADDRESS_FLOAT);
+
+    device = sensor_sim_add_isl29125(&sims[1], ISL29125_I2C_ADDRESS);
+    device->registers[ISL29125_DEVICE_ID_REG] = ISL29125_DEVICE_ID - 1;
+    device = sensor_sim_add_tsl2561(&sims[1], I2C_ADDRESS_GROUND);
+    device->registers[TSL2561_REG_ID] = TSL2561_ID_PARTNO_OTHER;
+    device = sensor_sim_add_tsl2561(&sims[1], I2C_ADDRESS_FLOAT);
+    device->registers[TSL2561_REG_ID] = TSL2561_ID_PARTNO_T | TSL2561_ID_REVISION;
+    device = sensor_sim_add_tsl2561(&sims[1], I2C_ADDRESS_VDD);
+    device->present = false;
+}
+
+static void check_table(void) {
+    DISCOVERY_DEVICE* device;
+    DISCOVERY_DEVICE* other;
+    uint8 i;
+    uint8 j;
+
+    expect(table.num_devices == NUM_EXPECTED, "table: wrong number of devices");
+    for (i = 0; (i < table.num_devices) && (i < NUM_EXPECTED); i++) {
+        device = &table.devices[i];
+        expect((device->bus == &count_buses[expected[i].bus]) &&
+               (device->type == expected[i].type) && (device->address == expected[i].address),
+               "table: wrong device");
+        for (j = 0; j < i; j++) {
+            other = &table.devices[j];
+            expect((other->bus != device->bus) || (other->address != device->address),
+                   "table: device found twice");
+        }
+    }
+    expect((table.devices[2].id & TSL2561_ID_PARTNO_MASK) == TSL2561_ID_PARTNO_T,
+           "table: ID not kept");
+
+    // the same address on the other bus is another device
+    device = discovery_find(&table, DISCOVERY_TSL2561, 2);
+    expect((device != 0) && (device->bus == &count_buses[1]) &&
+           (device->address == I2C_ADDRESS_FLOAT), "find: tsl2561 of bus 1 not third");
+    expect(discovery_find(&table, DISCOVERY_TSL2561, 3) == 0, "find: too many tsl2561");
+    expect(discovery_find(&table, DISCOVERY_ISL29125, 1) == 0, "find: wrong isl29125 found");
+}
+
+// one address byte for each probe, and an ID read only where one answered
+static void check_traffic(void) {
+    static const uint8 answered[NUM_BUSES] = {3, 3};
+    static const uint8 missing[NUM_BUSES] = {1, 1};
+    SENSOR_COUNTS counts;
+    uint8 i;
+
+    expect(table.probes == NUM_BUSES * NUM_CANDIDATES, "traffic: wrong number of probes");
+    for (i = 0; i < NUM_BUSES; i++) {
+        sensor_count_get(&counters[i], &counts);
+        printf("discovery: bus %u, %u transactions, %u failed, %u bytes\n", i,
+               counts.transactions, counts.errors, counts.bytes);
+        expect(counts.transactions == NUM_CANDIDATES + answered[i],
+               "traffic: not one probe per address and one read per answer");
+        expect(counts.errors == missing[i], "traffic: missing device not one failed probe");
+        // the probes are an address byte, the ID reads 2 address bytes,
+        // the register and the ID
+        expect(counts.bytes == NUM_CANDIDATES + 4 * answered[i], "traffic: wrong bytes");
+    }
+}
+
+int main(void) {
+    SENSOR_BUS* buses[NUM_BUSES];
+    uint8 found;
+    uint8 i;
+
+    timebase_start();
+    setup_buses();
+    for (i = 0; i < NUM_BUSES; i++) {
+        buses[i] = &count_buses[i];
+    }
+    found = discovery_scan(&table, buses, NUM_BUSES);
+    expect(found == table.num_devices, "scan: wrong count returned");
+    check_table();
+    check_traffic();
+
+    // a second scan finds the same devices, not twice as many
+    found = discovery_scan(&table, buses, NUM_BUSES);
+    expect(found == NUM_EXPECTED, "rescan: wrong number of devices");
+
+    printf("discovery: probes, wrong ids, duplicates: %s\n", errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
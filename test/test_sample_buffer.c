@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * File Name: test_sample_buffer.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host stress test of the sample ring buffer.  A producer thread stands in
+ *  for the interrupt and a consumer thread for the main loop, on separate
+ *  cores when there are more than one.  Every sample carries its sequence number, so the consumer checks
+ *  that none is torn, repeated or out of order, and that the samples
+ *  received and the overruns add up to the samples put in.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "sample_buffer.h"
+
+#define NUM_SAMPLES                 1000000
+#define BLOCK_SIZE                  4096
+
+// The consumer takes batches of these sizes in turn, 1 to more than the buffer
+static const uint16 batch_sizes[] = {1, 3, 7, SAMPLE_BUFFER_SIZE, SAMPLE_BUFFER_SIZE + 5};
+#define NUM_BATCH_SIZES             (sizeof(batch_sizes) / sizeof(batch_sizes[0]))
+
+static SAMPLE_BUFFER buffer;
+static volatile bool producer_done;
+static uint32 dropped;
+
+static void make_sample(SAMPLE* sample, uint32 sequence) {
+    sample->timestamp = sequence;
+    sample->device = sequence & 0xFF;
+    sample->status = ~sequence & 0xFF;
+    sample->setting = (sequence >> 8) & 0xFF;
+    sample->channel[0] = sequence & 0xFFFF;
+    sample->channel[1] = sequence >> 16;
+    sample->channel[2] = (sequence * 40503u) & 0xFFFF;
+}
+
+static bool check_sample(const SAMPLE* sample) {
+    SAMPLE expected;
+
+    make_sample(&expected, sample->timestamp);
+    return (sample->device == expected.device) && (sample->status == expected.status) &&
+           (sample->setting == expected.setting) &&
+           (sample->channel[0] == expected.channel[0]) &&
+           (sample->channel[1] == expected.channel[1]) &&
+           (sample->channel[2] == expected.channel[2]);
+}
+
+// the interrupt, puts in every sample once and counts the ones that did not fit
+static void* producer(void* argument) {
+    SAMPLE sample;
+    uint32 sequence;
+
+    (void) argument;
+    for (sequence = 0; sequence < NUM_SAMPLES; sequence++) {
+        make_sample(&sample, sequence);
+        // every other block waits for room, so the buffer is full at times
+        // and samples are dropped, and is drained at other times
+        if (sequence & BLOCK_SIZE) {
+            while (sample_buffer_count(&buffer) == SAMPLE_BUFFER_SIZE) {
+                sched_yield();
+            }
+        }
+        if (!sample_buffer_put(&buffer, &sample)) {
+            dropped++;
+        }
+    }
+    producer_done = true;
+    return NULL;
+}
+
+int main(void) {
+    SAMPLE samples[SAMPLE_BUFFER_SIZE + 5];
+    pthread_t thread;
+    uint32 received = 0;
+    uint32 batches = 0;
+    int64 last = -1;
+    int errors = 0;
+    uint16 count;
+    uint16 i;
+
+    sample_buffer_init(&buffer);
+    pthread_create(&thread, NULL, producer, NULL);
+    for (;;) {
+        bool done = producer_done;
+
+        count = sample_buffer_get(&buffer, samples, batch_sizes[batches % NUM_BATCH_SIZES]);
+        batches++;
+        for (i = 0; i < count; i++) {
+            if (!check_sample(&samples[i])) {
+                if (errors++ < 10) {
+                    printf("torn sample %u\n", samples[i].timestamp);
+                }
+            }
+            if ((int64) samples[i].timestamp <= last) {
+                if (errors++ < 10) {
+                    printf("sample %u after %ld\n", samples[i].timestamp, (long) last);
+                }
+            }
+            last = samples[i].timestamp;
+        }
+        received += count;
+        if (count == 0) {
+            // the producer had finished before this batch, so nothing is left
+            if (done) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+
+    if (received + sample_buffer_overruns(&buffer) != NUM_SAMPLES) {
+        printf("received %u + overruns %u != put %u\n", received,
+               sample_buffer_overruns(&buffer), NUM_SAMPLES);
+        errors++;
+    }
+    if (sample_buffer_overruns(&buffer) != dropped) {
+        printf("overruns %u, producer saw %u dropped\n", sample_buffer_overruns(&buffer),
+               dropped);
+        errors++;
+    }
+    if (sample_buffer_count(&buffer) != 0) {
+        printf("%u samples left\n", sample_buffer_count(&buffer));
+        errors++;
+    }
+    printf("sample_buffer: %u put, %u received in %u batches, %u overruns: %s\n",
+           NUM_SAMPLES, received, batches, sample_buffer_overruns(&buffer),
+           errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
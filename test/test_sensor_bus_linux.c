@@ -0,0 +1,265 @@
+/*******************************************************************************
+ * File Name: test_sensor_bus_linux.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host test of the i2c-dev bus backend against a fake adapter that takes
+ *  the I2C_RDWR ioctl in userspace.  The fake logs every message that
+ *  reaches the wire and stops a transfer at a device that does not answer,
+ *  like an adapter driver does.  Covers a batch of reads in one ioctl, a
+ *  NAK in the middle of a batch, an adapter that refuses batches, and a
+ *  transaction tried again by the engine while the ones batched behind it
+ *  still wait for their results.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "sensor_bus_linux.h"
+
+#define NUM_ADDRESSES               128
+#define MAX_WIRE                    256
+#define MAX_SERVICES                100
+
+// devices on the fake adapter
+#define ANSWERS                     0
+#define MISSING                     -1      // never acknowledges its address
+
+typedef struct {
+    int         naks[NUM_ADDRESSES];    // MISSING, or NAKs left before answering
+    bool        refuse_batches;         // EINVAL for more than one transaction
+    uint8       wire[MAX_WIRE];         // address of each message that was sent
+    uint16      num_wire;
+} FAKE_ADAPTER;
+
+static int errors;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        printf("%s\n", what);
+        errors++;
+    }
+}
+
+// the register write and data read of a read, sent together
+static bool is_read_pair(struct i2c_rdwr_ioctl_data* data, uint32 i) {
+    return (i + 1 < data->nmsgs) && !(data->msgs[i].flags & I2C_M_RD) &&
+           (data->msgs[i + 1].flags & I2C_M_RD) &&
+           (data->msgs[i + 1].addr == data->msgs[i].addr);
+}
+
+static int fake_ioctl(void* context, int fd, unsigned long request, void* arg) {
+    FAKE_ADAPTER* adapter = context;
+    struct i2c_rdwr_ioctl_data* data = arg;
+    struct i2c_msg* message;
+    uint32 i;
+    uint16 j;
+
+    (void) fd;
+    if (request != I2C_RDWR) {
+        errno = ENOTTY;
+        return -1;
+    }
+    if (adapter->refuse_batches && (data->nmsgs > (is_read_pair(data, 0) ? 2u : 1u))) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (i = 0; i < data->nmsgs; i++) {
+        message = &data->msgs[i];
+        if (adapter->naks[message->addr] == MISSING) {
+            errno = ENXIO;
+            return -1;
+        }
+        if (adapter->naks[message->addr] > 0) {
+            adapter->naks[message->addr]--;
+            errno = ENXIO;
+            return -1;
+        }
+        adapter->wire[adapter->num_wire++] = message->addr;
+        // a read gets its address plus the register and the byte index
+        if (message->flags & I2C_M_RD) {
+            for (j = 0; j < message->len; j++) {
+                message->buf[j] = message->addr + data->msgs[i - 1].buf[0] + j;
+            }
+        }
+    }
+    return data->nmsgs;
+}
+
+static void fake_reset(FAKE_ADAPTER* adapter) {
+    memset(adapter, 0, sizeof(*adapter));
+}
+
+// messages that went on the wire to a device
+static uint16 wire_count(FAKE_ADAPTER* adapter, uint8 address) {
+    uint16 count = 0;
+    uint16 i;
+
+    for (i = 0; i < adapter->num_wire; i++) {
+        if (adapter->wire[i] == address) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void read_init(SENSOR_TRANSACTION* transaction, uint8 address, uint8* buffer) {
+    memset(transaction, 0, sizeof(*transaction));
+    transaction->type = SENSOR_XFER_READ;
+    transaction->address = address;
+    transaction->_register = 0x10;
+    transaction->num_bytes = 2;
+    transaction->buffer = buffer;
+}
+
+static void write_init(SENSOR_TRANSACTION* transaction, uint8 address, uint8* buffer) {
+    memset(transaction, 0, sizeof(*transaction));
+    transaction->type = SENSOR_XFER_WRITE;
+    transaction->address = address;
+    transaction->num_bytes = 2;
+    transaction->buffer = buffer;
+}
+
+// queue the transactions like one pass of the main loop, then service
+// the bus until they are done
+static void run(SENSOR_BUS* bus, SENSOR_TRANSACTION* transactions, uint8 num) {
+    uint8 services;
+    uint8 i;
+
+    for (i = 0; i < num; i++) {
+        sensor_bus_submit(bus, &transactions[i]);
+    }
+    for (services = 0; sensor_bus_busy(bus) && (services < MAX_SERVICES); services++) {
+        sensor_bus_service(bus);
+    }
+    expect(!sensor_bus_busy(bus), "transactions never finished");
+}
+
+static void check_batched_read(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev,
+                               FAKE_ADAPTER* adapter) {
+    SENSOR_TRANSACTION reads[4];
+    uint8 buffers[4][2];
+    uint8 i;
+
+    fake_reset(adapter);
+    sensor_linux_init(bus, i2c_dev, 3, fake_ioctl, adapter);
+    for (i = 0; i < 4; i++) {
+        read_init(&reads[i], 0x20 + i, buffers[i]);
+    }
+    run(bus, reads, 4);
+    expect(i2c_dev->ioctls == 1, "batched read: not one ioctl");
+    expect(i2c_dev->batched == 3, "batched read: not 3 transactions batched");
+    expect(adapter->num_wire == 8, "batched read: not 8 messages");
+    for (i = 0; i < 4; i++) {
+        expect(reads[i].status == SENSOR_OK, "batched read: failed");
+        expect((buffers[i][0] == 0x30 + i) && (buffers[i][1] == 0x31 + i),
+               "batched read: wrong data");
+    }
+}
+
+static void check_nak_in_batch(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev,
+                               FAKE_ADAPTER* adapter) {
+    SENSOR_TRANSACTION writes[3];
+    uint8 buffers[3][2] = {{0x01, 0xA0}, {0x01, 0xB0}, {0x01, 0xC0}};
+    uint8 i;
+
+    fake_reset(adapter);
+    adapter->naks[0x31] = MISSING;
+    sensor_linux_init(bus, i2c_dev, 3, fake_ioctl, adapter);
+    for (i = 0; i < 3; i++) {
+        write_init(&writes[i], 0x30 + i, buffers[i]);
+    }
+    run(bus, writes, 3);
+    expect(writes[0].status == SENSOR_OK, "nak in batch: first write failed");
+    expect(writes[1].status == SENSOR_ERR_NAK, "nak in batch: missing device not NAK");
+    expect(writes[2].status == SENSOR_OK, "nak in batch: last write failed");
+    // the batch, each write on its own, and the 2 retries of the missing one
+    expect(i2c_dev->ioctls == 1 + 3 + SENSOR_DEFAULT_RETRIES,
+           "nak in batch: wrong number of ioctls");
+    // the first write went out in the batch before the NAK and on its own
+    expect(wire_count(adapter, 0x30) == 2, "nak in batch: first write not sent twice");
+    expect(wire_count(adapter, 0x32) == 1, "nak in batch: last write not sent once");
+    expect(i2c_dev->max_batch == SENSOR_LINUX_MAX_BATCH, "nak in batch: batches stopped");
+}
+
+static void check_refused_batch(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev,
+                                FAKE_ADAPTER* adapter) {
+    SENSOR_TRANSACTION reads[3];
+    uint8 buffers[3][2];
+    uint8 i;
+
+    fake_reset(adapter);
+    adapter->refuse_batches = true;
+    sensor_linux_init(bus, i2c_dev, 3, fake_ioctl, adapter);
+    for (i = 0; i < 3; i++) {
+        read_init(&reads[i], 0x40 + i, buffers[i]);
+    }
+    run(bus, reads, 3);
+    expect(i2c_dev->max_batch == 1, "refused batch: max_batch not 1");
+    for (i = 0; i < 3; i++) {
+        expect(reads[i].status == SENSOR_OK, "refused batch: read failed");
+        expect(buffers[i][0] == 0x50 + i, "refused batch: wrong data");
+    }
+    expect(i2c_dev->ioctls == 1 + 3, "refused batch: not each read on its own");
+
+    // no batch is tried again
+    i2c_dev->ioctls = 0;
+    run(bus, reads, 3);
+    expect(i2c_dev->ioctls == 3, "refused batch: batch tried again");
+    expect(i2c_dev->batched == 0, "refused batch: transactions batched");
+}
+
+static void check_retry_behind_batch(SENSOR_BUS* bus, SENSOR_LINUX* i2c_dev,
+                                     FAKE_ADAPTER* adapter) {
+    SENSOR_TRANSACTION writes[3];
+    uint8 buffers[3][2] = {{0x01, 0xA0}, {0x01, 0xB0}, {0x01, 0xC0}};
+    uint8 i;
+
+    fake_reset(adapter);
+    // the first device misses the batch and its own resend, then answers
+    adapter->naks[0x60] = 2;
+    sensor_linux_init(bus, i2c_dev, 3, fake_ioctl, adapter);
+    for (i = 0; i < 3; i++) {
+        write_init(&writes[i], 0x60 + i, buffers[i]);
+    }
+    run(bus, writes, 3);
+    for (i = 0; i < 3; i++) {
+        expect(writes[i].status == SENSOR_OK, "retry: write failed");
+    }
+    expect(writes[0].retries == 1, "retry: first write not tried again");
+    // the writes behind it went out once, in the resends after the batch
+    expect(wire_count(adapter, 0x60) == 1, "retry: first write not sent once");
+    expect(wire_count(adapter, 0x61) == 1, "retry: second write sent again");
+    expect(wire_count(adapter, 0x62) == 1, "retry: third write sent again");
+    expect(i2c_dev->ioctls == 1 + 3 + 1, "retry: wrong number of ioctls");
+}
+
+int main(void) {
+    static FAKE_ADAPTER adapter;
+    static SENSOR_LINUX i2c_dev;
+    static SENSOR_BUS bus;
+
+    check_batched_read(&bus, &i2c_dev, &adapter);
+    check_nak_in_batch(&bus, &i2c_dev, &adapter);
+    check_refused_batch(&bus, &i2c_dev, &adapter);
+    check_retry_behind_batch(&bus, &i2c_dev, &adapter);
+
+    printf("sensor_bus_linux: batch, nak in batch, refused batch, retry: %s\n",
+           errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,203 @@
+/*******************************************************************************
+ * File Name: test_sensor_jobs.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host test of the jobs of the isl29125 and tsl2561 drivers on the
+ *  simulated bus.  A blocking read or setting made while a job of a
+ *  *_begin function is running has to leave that job alone: the owner
+ *  still gets its one SENSOR_JOB_DONE and its job_ok, the blocking reads
+ *  and writes return SENSOR_ERR_BUSY or 0 without a transfer, and a 
+ *  setting is written and used by the next flush.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include "sensor_bus_sim.h"
+#include "isl29125.h"
+#include "tsl2561.h"
+
+#define ISL29125_ADDRESS            0x44
+#define TSL2561_ADDRESS             0x39
+
+// polls a job may take on the simulated bus before it counts as stuck
+#define MAX_POLLS                   1000
+
+static int errors;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        printf("%s\n", what);
+        errors++;
+    }
+}
+
+// poll a job to its end, the number of SENSOR_JOB_DONE returned on the way
+static uint32 isl29125_finish(ISL29125* device) {
+    uint32 done = 0;
+    uint32 polls;
+
+    for (polls = 0; polls < MAX_POLLS; polls++) {
+        switch (isl29125_poll(device)) {
+            case SENSOR_JOB_DONE:
+                done++;
+                break;
+            case SENSOR_JOB_IDLE:
+                return done;
+        }
+    }
+    printf("isl29125 job never finished\n");
+    errors++;
+    return done;
+}
+
+static uint32 tsl2561_finish(TSL2561* device) {
+    uint32 done = 0;
+    uint32 polls;
+
+    for (polls = 0; polls < MAX_POLLS; polls++) {
+        switch (tsl2561_poll(device)) {
+            case SENSOR_JOB_DONE:
+                done++;
+                break;
+            case SENSOR_JOB_IDLE:
+                return done;
+        }
+    }
+    printf("tsl2561 job never finished\n");
+    errors++;
+    return done;
+}
+
+static void check_isl29125(SENSOR_BUS* bus, SENSOR_SIM_DEVICE* model) {
+    ISL29125 device;
+    ISL29125_RGB job_rgb = {0};
+    ISL29125_RGB blocking_rgb = {0};
+    uint8 thresholds[ISL29125_NUM_THRESHOLD_REGS];
+    uint16 threshold_low;
+    uint16 threshold_high;
+    uint8 config3;
+    uint8 i;
+
+    isl29125_init(&device, bus, ISL29125_ADDRESS);
+    expect(device.working, "isl29125 init failed");
+    sensor_sim_set_light(model, 4000, 3000, 2000);
+
+    // the blocking calls come before the owner of a sample job polls it
+    expect(isl29125_sample_begin(&device, &job_rgb), "isl29125 sample not started");
+    expect(isl29125_read_rgb(&device, &blocking_rgb) == SENSOR_ERR_BUSY,
+           "isl29125_read_rgb during a job is not SENSOR_ERR_BUSY");
+    isl29125_set_range(&device, ISL29125_CONFIG1_375LUX);
+    for (i = 0; i < ISL29125_NUM_THRESHOLD_REGS; i++) {
+        thresholds[i] = model->registers[ISL29125_THRESHOLD_LOW_REG + i];
+    }
+    config3 = model->registers[ISL29125_CONFIG_REG_3];
+    threshold_low = device.threshold_low;
+    threshold_high = device.threshold_high;
+    expect((isl29125_read_id(&device) == 0) && (isl29125_read_red(&device) == 0) &&
+           (isl29125_read_green(&device) == 0) && (isl29125_read_blue(&device) == 0),
+           "isl29125 register read during a job is not 0");
+    expect(set_upper_threshold(&device, 1000) == SENSOR_ERR_BUSY,
+           "set_upper_threshold during a job is not SENSOR_ERR_BUSY");
+    expect(set_lower_threshold(&device, 100) == SENSOR_ERR_BUSY,
+           "set_lower_threshold during a job is not SENSOR_ERR_BUSY");
+    expect(isl29125_set_threshold_window(&device, ISL29125_CONFIG3_G_INT, 100, 1000,
+                                         ISL29125_CONFIG3_INT_1_TIME, 0) == SENSOR_ERR_BUSY,
+           "isl29125_set_threshold_window during a job is not SENSOR_ERR_BUSY");
+    expect(isl29125_set_conversion_interrupt(&device, true) == SENSOR_ERR_BUSY,
+           "isl29125_set_conversion_interrupt during a job is not SENSOR_ERR_BUSY");
+    expect(isl29125_finish(&device) == 1, "isl29125 sample job not done exactly once");
+    expect(device.job_ok, "isl29125 sample job failed");
+    expect(job_rgb.green != 0, "isl29125 sample job got no colors");
+    expect(blocking_rgb.green == 0, "isl29125 blocking read changed its rgb");
+    expect((model->registers[ISL29125_CONFIG_REG_1] & ISL29125_RANGE_MASK) ==
+           ISL29125_CONFIG1_10KLUX, "isl29125 range written during the job");
+    expect(job_rgb.intensity_range == ISL29125_CONFIG1_10KLUX,
+           "isl29125 sample job not labeled with the range of the device");
+    expect(device.intensity_range == ISL29125_CONFIG1_10KLUX,
+           "isl29125 range setting changed before it was written");
+    for (i = 0; i < ISL29125_NUM_THRESHOLD_REGS; i++) {
+        expect(model->registers[ISL29125_THRESHOLD_LOW_REG + i] == thresholds[i],
+               "isl29125 thresholds written during the job");
+    }
+    expect((device.threshold_low == threshold_low) && (device.threshold_high == threshold_high),
+           "isl29125 threshold settings changed during the job");
+    expect(model->registers[ISL29125_CONFIG_REG_3] == config3,
+           "isl29125 interrupt setting written during the job");
+
+    // with no job the range still waiting goes out with the next flush
+    isl29125_set_range(&device, ISL29125_CONFIG1_375LUX);
+    expect((model->registers[ISL29125_CONFIG_REG_1] & ISL29125_RANGE_MASK) ==
+           ISL29125_CONFIG1_375LUX, "isl29125 range not written after the job");
+    expect(isl29125_read_rgb(&device, &blocking_rgb) == SENSOR_OK,
+           "isl29125_read_rgb with no job failed");
+    expect(blocking_rgb.green != 0, "isl29125 blocking read got no colors");
+    expect(blocking_rgb.intensity_range == ISL29125_CONFIG1_375LUX,
+           "isl29125 blocking read not labeled with the new range");
+}
+
+static void check_tsl2561(SENSOR_BUS* bus, SENSOR_SIM_DEVICE* model) {
+    TSL2561 device;
+    TSL2561_DATA job_data = {0};
+    TSL2561_DATA blocking_data = {0};
+    uint8 timing = TSL2561_INTEGRATION_13MS | TSL2561_GAIN_16X;
+
+    tsl2561_Init(&device, bus, TSL2561_ADDRESS);
+    expect(device.working, "tsl2561 init failed");
+    sensor_sim_set_light(model, 3000, 1000, 0);
+
+    expect(tsl2561_sample_begin(&device, &job_data), "tsl2561 sample not started");
+    expect(tsl2561_read_data(&device, &blocking_data) == SENSOR_ERR_BUSY,
+           "tsl2561_read_data during a job is not SENSOR_ERR_BUSY");
+    expect(tsl2561_read_id(&device) == 0, "tsl2561_read_id during a job is not 0");
+    tsl2561_set_timing(&device, TSL2561_INTEGRATION_13MS, TSL2561_GAIN_16X);
+    expect(tsl2561_finish(&device) == 1, "tsl2561 sample job not done exactly once");
+    expect(device.job_ok, "tsl2561 sample job failed");
+    expect(job_data.channel0 != 0, "tsl2561 sample job got no counts");
+    expect(blocking_data.channel0 == 0, "tsl2561 blocking read changed its data");
+    expect(model->registers[TSL2561_REG_TIMING] != timing,
+           "tsl2561 timing written during the job");
+    // the lux of the job comes from the timing the device still has
+    expect((device.integration_time == TSL2561_INTEGRATION_402MS) &&
+           (device._gain == TSL2561_GAIN_1X), "tsl2561 timing changed before it was written");
+    expect(job_data.lux == tsl2561_calculate_lux(&device, job_data.channel0, 
+                                                 job_data.channel1),
+           "tsl2561 sample job lux not from the timing of the device");
+
+    tsl2561_Start(&device);
+    expect(model->registers[TSL2561_REG_TIMING] == timing,
+           "tsl2561 timing not written after the job");
+    expect((device.integration_time == TSL2561_INTEGRATION_13MS) &&
+           (device._gain == TSL2561_GAIN_16X), "tsl2561 timing not kept after the job");
+    expect(tsl2561_read_data(&device, &blocking_data) == SENSOR_OK,
+           "tsl2561_read_data with no job failed");
+    expect(blocking_data.channel0 != 0, "tsl2561 blocking read got no counts");
+}
+
+int main(void) {
+    static SENSOR_BUS bus;
+    static SENSOR_SIM sim;
+    SENSOR_SIM_DEVICE* isl29125_model;
+    SENSOR_SIM_DEVICE* tsl2561_model;
+
+    sensor_sim_init(&bus, &sim);
+    isl29125_model = sensor_sim_add_isl29125(&sim, ISL29125_ADDRESS);
+    tsl2561_model = sensor_sim_add_tsl2561(&sim, TSL2561_ADDRESS);
+    check_isl29125(&bus, isl29125_model);
+    check_tsl2561(&bus, tsl2561_model);
+
+    printf("sensor jobs: blocking calls during a job: %s\n", errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
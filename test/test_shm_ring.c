@@ -0,0 +1,367 @@
+/*******************************************************************************
+ * File Name: test_shm_ring.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host test of the shared memory ring.  A writer thread puts numbered
+ *  records in a small ring as fast as it can while readers, with
+ *  shm_ring_get and with shm_ring_peek, some of them slow, take them out.
+ *  Every record a reader gets must be whole and in order, and the records
+ *  it got and lost must add up to the ones put in.  Then a reader that
+ *  falls behind must lose exactly the records written over, and sensord
+ *  on a simulated bus must publish the samples of its 4 sensors.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "shm_ring.h"
+#include "discovery.h"
+#include "timebase.h"
+
+#define CAPACITY                    64
+#define NUM_RECORDS                 1000000u
+#define NUM_READERS                 4
+#define SLOW_SPIN                   200
+
+// the readers
+#define READ_GET                    0
+#define READ_PEEK                   1
+#define READ_SLOW                   2   // added to either, works on each record a while
+
+#define SENSORD_SENSORS             4
+#define SENSORD_RUN_MS              1000
+#define SENSORD_START_MS            2000
+#define READER_SLEEP_US             1000
+
+typedef struct {
+    int         mode;
+    uint32      expected;   // records put in after the reader started
+    uint32      got;
+    uint32      lost;
+    uint32      torn;       // records with parts of 2 writes
+    uint32      out_of_order;
+} READER;
+
+static int errors;
+static char ring_name[32];
+static SHM_RING ring;
+static pthread_barrier_t started;
+static volatile int writing_done;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        printf("%s\n", what);
+        errors++;
+    }
+}
+
+// every field of record number i is made from i, so a torn record shows
+static void fill(SHM_RING_RECORD* record, uint32 i) {
+    record->bus = i & 0x07;
+    record->type = (i >> 3) & 0xFF;
+    record->address = i & 0xFF;
+    record->reserved = 0;
+    record->sample.timestamp = i;
+    record->sample.device = (i >> 8) & 0xFF;
+    record->sample.status = (i >> 16) & 0xFF;
+    record->sample.setting = ~i & 0xFF;
+    record->sample.channel[0] = i & 0xFFFF;
+    record->sample.channel[1] = ~i & 0xFFFF;
+    record->sample.channel[2] = (i * 7) & 0xFFFF;
+}
+
+static bool whole(const SHM_RING_RECORD* record) {
+    SHM_RING_RECORD made;
+
+    fill(&made, record->sample.timestamp);
+    return (record->bus == made.bus) && (record->type == made.type) &&
+           (record->address == made.address) &&
+           (record->sample.device == made.sample.device) &&
+           (record->sample.status == made.sample.status) &&
+           (record->sample.setting == made.sample.setting) &&
+           (record->sample.channel[0] == made.sample.channel[0]) &&
+           (record->sample.channel[1] == made.sample.channel[1]) &&
+           (record->sample.channel[2] == made.sample.channel[2]);
+}
+
+static void spin(void) {
+    volatile int i;
+
+    for (i = 0; i < SLOW_SPIN; i++) {
+    }
+}
+
+static void* write_records(void* argument) {
+    SHM_RING_RECORD record;
+    uint32 i;
+
+    (void) argument;
+    pthread_barrier_wait(&started);
+    for (i = 0; i < NUM_RECORDS; i++) {
+        fill(&record, i);
+        shm_ring_put(&ring, &record);
+    }
+    __atomic_store_n(&writing_done, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void take(READER* reader, const SHM_RING_RECORD* record, bool* have, uint32* last) {
+    reader->got++;
+    if (!whole(record)) {
+        reader->torn++;
+    }
+    if (*have && (record->sample.timestamp <= *last)) {
+        reader->out_of_order++;
+    }
+    *last = record->sample.timestamp;
+    *have = true;
+}
+
+// each reader maps the ring on its own, read-only, like another process
+static void* read_records(void* argument) {
+    READER* reader = argument;
+    SHM_RING mapping;
+    SHM_RING_READER position;
+    SHM_RING_RECORD record;
+    const SHM_RING_RECORD* peeked;
+    bool have = false;
+    uint32 last = 0;
+    bool done;
+    bool any;
+
+    if (!shm_ring_attach(&mapping, ring_name)) {
+        pthread_barrier_wait(&started);
+        return 0;
+    }
+    shm_ring_reader_init(&position, &mapping);
+    reader->expected = NUM_RECORDS - position.next;
+    pthread_barrier_wait(&started);
+    do {
+        done = __atomic_load_n(&writing_done, __ATOMIC_ACQUIRE);
+        any = false;
+        if (reader->mode & READ_PEEK) {
+            while ((peeked = shm_ring_peek(&position)) != 0) {
+                record = *peeked;
+                if (reader->mode & READ_SLOW) {
+                    spin();
+                }
+                if (shm_ring_release(&position)) {
+                    take(reader, &record, &have, &last);
+                    any = true;
+                }
+            }
+        }
+        else {
+            while (shm_ring_get(&position, &record)) {
+                take(reader, &record, &have, &last);
+                any = true;
+                if (reader->mode & READ_SLOW) {
+                    spin();
+                }
+            }
+        }
+    } while (!done || any);
+    reader->lost = position.lost;
+    shm_ring_close(&mapping);
+    return 0;
+}
+
+static void check_concurrent_readers(void) {
+    static const char* names[NUM_READERS] = {"get", "peek", "slow get", "slow peek"};
+    static const int modes[NUM_READERS] = {
+        READ_GET, READ_PEEK, READ_GET | READ_SLOW, READ_PEEK | READ_SLOW
+    };
+    READER readers[NUM_READERS] = {{0}};
+    pthread_t threads[NUM_READERS];
+    pthread_t writer;
+    uint32 total_lost = 0;
+    char what[80];
+    uint8 i;
+
+    if (!shm_ring_create(&ring, ring_name, CAPACITY)) {
+        expect(false, "concurrent: ring not made");
+        return;
+    }
+    pthread_barrier_init(&started, 0, NUM_READERS + 1);
+    writing_done = 0;
+    for (i = 0; i < NUM_READERS; i++) {
+        readers[i].mode = modes[i];
+        pthread_create(&threads[i], 0, read_records, &readers[i]);
+    }
+    pthread_create(&writer, 0, write_records, 0);
+    pthread_join(writer, 0);
+    for (i = 0; i < NUM_READERS; i++) {
+        pthread_join(threads[i], 0);
+        snprintf(what, sizeof(what), "concurrent %s: %u got, %u lost, %u put in",
+                 names[i], readers[i].got, readers[i].lost, readers[i].expected);
+        expect(readers[i].got + readers[i].lost == readers[i].expected, what);
+        snprintf(what, sizeof(what), "concurrent %s: %u torn records", names[i],
+                 readers[i].torn);
+        expect(readers[i].torn == 0, what);
+        snprintf(what, sizeof(what), "concurrent %s: %u records out of order", names[i],
+                 readers[i].out_of_order);
+        expect(readers[i].out_of_order == 0, what);
+        expect(readers[i].got != 0, "concurrent: a reader got nothing");
+        total_lost += readers[i].lost;
+    }
+    // a ring of 64 cannot hold a million records for the slow readers
+    expect(total_lost != 0, "concurrent: no reader fell behind");
+    pthread_barrier_destroy(&started);
+    shm_ring_close(&ring);
+    shm_ring_unlink(ring_name);
+}
+
+// a reader 3 rings behind loses the 2 rings written over, and gets the last
+static void check_exact_lost(void) {
+    SHM_RING_READER get_reader;
+    SHM_RING_READER peek_reader;
+    SHM_RING_RECORD record;
+    const SHM_RING_RECORD* peeked;
+    uint32 got = 0;
+    uint32 i;
+
+    if (!shm_ring_create(&ring, ring_name, CAPACITY)) {
+        expect(false, "lost: ring not made");
+        return;
+    }
+    fill(&record, 0);
+    shm_ring_put(&ring, &record);
+    shm_ring_reader_init(&get_reader, &ring);
+    shm_ring_reader_init(&peek_reader, &ring);
+    for (i = 1; i <= 3 * CAPACITY; i++) {
+        fill(&record, i);
+        shm_ring_put(&ring, &record);
+    }
+    expect(shm_ring_head(&ring) == 3 * CAPACITY + 1, "lost: wrong head");
+
+    expect(shm_ring_get(&get_reader, &record), "lost: nothing to get");
+    expect(record.sample.timestamp == 2 * CAPACITY + 1, "lost: not the oldest record kept");
+    expect(get_reader.lost == 2 * CAPACITY, "lost: not 2 rings lost");
+    for (got = 1; shm_ring_get(&get_reader, &record); got++) {
+        expect(whole(&record) && (record.sample.timestamp == 2 * CAPACITY + 1 + got),
+               "lost: wrong record");
+    }
+    expect(got == CAPACITY, "lost: not a ring got");
+    expect(get_reader.lost == 2 * CAPACITY, "lost: records lost after the skip");
+
+    // a record written over while it is peeked at is lost, not got
+    peeked = shm_ring_peek(&peek_reader);
+    expect((peeked != 0) && (peek_reader.lost == 2 * CAPACITY), "lost: peek did not skip");
+    fill(&record, 3 * CAPACITY + 1);
+    shm_ring_put(&ring, &record);
+    expect(!shm_ring_release(&peek_reader), "lost: written over record released");
+    expect(peek_reader.lost == 2 * CAPACITY + 1, "lost: written over record not counted");
+    for (got = 0; shm_ring_get(&peek_reader, &record); got++) {
+    }
+    expect(got == CAPACITY, "lost: peek reader did not get the rest");
+    expect(peek_reader.lost + got == 3 * CAPACITY + 1, "lost: peek reader counts wrong");
+
+    shm_ring_close(&ring);
+    shm_ring_unlink(ring_name);
+}
+
+static bool attach_when_ready(SHM_RING* mapping) {
+    uint32 start = timebase_ms();
+
+    while (!shm_ring_attach(mapping, ring_name)) {
+        if ((uint32) (timebase_ms() - start) > SENSORD_START_MS) {
+            return false;
+        }
+        usleep(READER_SLEEP_US);
+    }
+    return true;
+}
+
+static uint8 expected_type(uint8 address) {
+    if (address == ISL29125_I2C_ADDRESS) {
+        return DISCOVERY_ISL29125;
+    }
+    if ((address == I2C_ADDRESS_GROUND) || (address == I2C_ADDRESS_FLOAT) ||
+            (address == I2C_ADDRESS_VDD)) {
+        return DISCOVERY_TSL2561;
+    }
+    return 0;
+}
+
+// sensord on one simulated bus, read like any other process would
+static void check_sensord(void) {
+    uint32 counts[SENSORD_SENSORS] = {0};
+    SHM_RING mapping;
+    SHM_RING_READER reader;
+    SHM_RING_RECORD record;
+    uint32 start;
+    int status;
+    pid_t pid;
+    uint8 i;
+
+    pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        execl("./sensord", "sensord", "-n", ring_name, "-s", "1", "-i", "1", (char*) 0);
+        _exit(127);
+    }
+    expect(pid > 0, "sensord: not started");
+    if (pid <= 0) {
+        return;
+    }
+    if (attach_when_ready(&mapping)) {
+        shm_ring_reader_init(&reader, &mapping);
+        start = timebase_ms();
+        while ((uint32) (timebase_ms() - start) < SENSORD_RUN_MS) {
+            while (shm_ring_get(&reader, &record)) {
+                expect(record.bus == 0, "sensord: wrong bus");
+                expect(record.type == expected_type(record.address),
+                       "sensord: wrong type for the address");
+                if (record.sample.device < SENSORD_SENSORS) {
+                    counts[record.sample.device]++;
+                }
+                else {
+                    expect(false, "sensord: wrong device");
+                }
+                expect(record.sample.channel[0] != 0, "sensord: no light");
+            }
+            usleep(READER_SLEEP_US);
+        }
+        expect(reader.lost == 0, "sensord: records lost by a reader that kept up");
+        for (i = 0; i < SENSORD_SENSORS; i++) {
+            expect(counts[i] != 0, "sensord: a sensor published nothing");
+        }
+        shm_ring_close(&mapping);
+    }
+    else {
+        expect(false, "sensord: no ring");
+    }
+    kill(pid, SIGTERM);
+    expect((waitpid(pid, &status, 0) == pid) && WIFEXITED(status) &&
+           (WEXITSTATUS(status) == 0), "sensord: did not stop cleanly");
+    expect(!shm_ring_attach(&mapping, ring_name), "sensord: ring left behind");
+}
+
+int main(void) {
+    snprintf(ring_name, sizeof(ring_name), "/test_shm_ring.%d", (int) getpid());
+    timebase_start();
+
+    check_concurrent_readers();
+    check_exact_lost();
+    check_sensord();
+
+    printf("shm_ring: concurrent readers, exact lost counts, sensord: %s\n",
+           errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
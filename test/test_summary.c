@@ -0,0 +1,327 @@
+/*******************************************************************************
+ * File Name: test_summary.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host test of the windowed statistics.  Two hours of samples at 100 Hz
+ *  go through windows of 1 s, 1 min and 1 h, and every record is checked
+ *  against the same window computed in double precision: the 1 s windows
+ *  test the Welford update of each sample, the longer ones the merges of
+ *  the shorter windows.  Then the windows after a gap, a change of the
+ *  settings and a flush are checked record by record, and summary records
+ *  must come back unchanged from a telemetry frame.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "summary.h"
+#include "telemetry_frame.h"
+
+#define NUM_LEVELS                  3
+#define SAMPLE_PERIOD_MS            10
+#define RUN_MS                      (2 * 3600000u + 5000)
+#define START_MS                    123456
+
+// the means have SUMMARY_FRACTION bits and the variances are rounded to
+// whole counts squared, each update and merge can round once more
+#define MEAN_ALLOWED                0.1
+#define VARIANCE_ALLOWED            1.0
+#define VARIANCE_RELATIVE_ALLOWED   1e-3
+
+// Running statistics of one channel over a window, in double precision
+typedef struct {
+    uint32      count;
+    double      mean;
+    double      m2;
+    uint16      min;
+    uint16      max;
+} REFERENCE;
+
+static const uint32 window_ms[NUM_LEVELS] = {1000, 60000, 3600000};
+
+static int errors;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        printf("%s\n", what);
+        errors++;
+    }
+}
+
+static void reference_add(REFERENCE* reference, uint16 value) {
+    double delta = value - reference->mean;
+
+    if ((reference->count == 0) || (value < reference->min)) {
+        reference->min = value;
+    }
+    if ((reference->count == 0) || (value > reference->max)) {
+        reference->max = value;
+    }
+    reference->count++;
+    reference->mean += delta / reference->count;
+    reference->m2 += delta * (value - reference->mean);
+}
+
+static SAMPLE make_sample(uint32 timestamp, uint8 setting, uint16 value) {
+    SAMPLE sample = {0};
+
+    sample.timestamp = timestamp;
+    sample.device = 5;
+    sample.setting = setting;
+    sample.channel[0] = value;
+    sample.channel[1] = value / 2;
+    sample.channel[2] = value / 4;
+    return sample;
+}
+
+// channel 0 a slow wave with noise, channel 1 a large offset with a
+// little noise, that loses precision in a plain sum of squares, channel 2
+// noise over the whole range
+static SAMPLE noisy_sample(uint32 ms) {
+    SAMPLE sample = {0};
+
+    sample.timestamp = START_MS + ms;
+    sample.device = 5;
+    sample.setting = 3;
+    sample.channel[0] = (uint16) (1000 + 500 * sin(ms / 600000.0) + rand() % 200);
+    sample.channel[1] = (uint16) (60000 + rand() % 5);
+    sample.channel[2] = (uint16) (rand() % 65536);
+    return sample;
+}
+
+static void check_record(const SUMMARY_RECORD* record, REFERENCE* references,
+                         double* worst_mean, double* worst_variance) {
+    REFERENCE* reference;
+    double variance;
+    double error;
+    uint8 i;
+
+    for (i = 0; i < SAMPLE_NUM_CHANNELS; i++) {
+        reference = &references[i];
+        expect(record->count == reference->count, "statistics: wrong count");
+        expect((record->min[i] == reference->min) && (record->max[i] == reference->max),
+               "statistics: wrong min or max");
+        error = fabs(record->mean[i] / (double) (1 << SUMMARY_FRACTION) - reference->mean);
+        if (error > *worst_mean) {
+            *worst_mean = error;
+        }
+        expect(error <= MEAN_ALLOWED, "statistics: mean too far off");
+        variance = (reference->count > 1) ? reference->m2 / (reference->count - 1) : 0;
+        error = fabs(record->variance[i] - variance);
+        if (error / (variance + 1) > *worst_variance) {
+            *worst_variance = error / (variance + 1);
+        }
+        expect(error <= VARIANCE_ALLOWED + VARIANCE_RELATIVE_ALLOWED * variance,
+               "statistics: variance too far off");
+        memset(reference, 0, sizeof(*reference));
+    }
+}
+
+static void check_statistics(void) {
+    static REFERENCE references[NUM_LEVELS][SAMPLE_NUM_CHANNELS];
+    SUMMARY_RECORD records[SUMMARY_MAX_LEVELS];
+    uint32 num_records[NUM_LEVELS] = {0};
+    double worst_mean = 0;
+    double worst_variance = 0;
+    SUMMARY summary;
+    SAMPLE sample;
+    uint32 ms;
+    uint8 count;
+    uint8 level;
+    uint8 i;
+
+    summary_init(&summary, 5);
+    for (level = 0; level < NUM_LEVELS; level++) {
+        expect(summary_add_level(&summary, window_ms[level]), "levels: length not added");
+    }
+    srand(1);
+    for (ms = 0; ms < RUN_MS; ms += SAMPLE_PERIOD_MS) {
+        sample = noisy_sample(ms);
+        count = summary_update(&summary, &sample, records);
+        for (i = 0; i < count; i++) {
+            level = records[i].level;
+            expect((i == 0) || (level > records[i - 1].level), "statistics: records out of order");
+            expect((records[i].device == 5) && (records[i].setting == 3),
+                   "statistics: wrong device or setting");
+            expect(records[i].start == START_MS + num_records[level] * window_ms[level],
+                   "statistics: wrong window start");
+            check_record(&records[i], references[level], &worst_mean, &worst_variance);
+            num_records[level]++;
+        }
+        for (level = 0; level < NUM_LEVELS; level++) {
+            for (i = 0; i < SAMPLE_NUM_CHANNELS; i++) {
+                reference_add(&references[level][i], sample.channel[i]);
+            }
+        }
+    }
+    for (level = 0; level < NUM_LEVELS; level++) {
+        expect(num_records[level] == (RUN_MS - SAMPLE_PERIOD_MS) / window_ms[level],
+               "statistics: wrong number of windows");
+    }
+    printf("summary: %u, %u and %u windows, worst mean error %.3f counts, "
+           "worst relative variance error %.1e\n", num_records[0], num_records[1],
+           num_records[2], worst_mean, worst_variance);
+}
+
+static void check_levels(void) {
+    SUMMARY summary;
+    uint8 i;
+
+    summary_init(&summary, 0);
+    expect(summary_add_level(&summary, 1000), "levels: first length not added");
+    expect(!summary_add_level(&summary, 1500), "levels: length not a multiple added");
+    expect(!summary_add_level(&summary, 1000), "levels: same length added");
+    expect(!summary_add_level(&summary, 0x80000000), "levels: length too long added");
+    for (i = 1; i < SUMMARY_MAX_LEVELS; i++) {
+        expect(summary_add_level(&summary, 1000 << i), "levels: longer length not added");
+    }
+    expect(!summary_add_level(&summary, 1000 << SUMMARY_MAX_LEVELS), "levels: too many added");
+}
+
+static void expect_record(const SUMMARY_RECORD* record, uint8 level, uint32 start,
+                          uint32 count, uint8 setting, const char* what) {
+    expect((record->level == level) && (record->start == start) &&
+           (record->count == count) && (record->setting == setting), what);
+}
+
+// windows of 1 s and 10 s with gaps, a change of the settings and flushes
+static void check_windows(void) {
+    SUMMARY_RECORD records[SUMMARY_MAX_LEVELS];
+    SUMMARY summary;
+    SAMPLE sample;
+    uint32 ms;
+    uint8 count;
+
+    summary_init(&summary, 1);
+    summary_add_level(&summary, 1000);
+    summary_add_level(&summary, 10000);
+    for (ms = 0; ms < 1000; ms += 100) {
+        sample = make_sample(ms, 1, 100 + ms);
+        expect(summary_update(&summary, &sample, records) == 0, "windows: closed too early");
+    }
+
+    // the first windows close after a gap, the next start where the sample falls
+    sample = make_sample(25300, 1, 50);
+    count = summary_update(&summary, &sample, records);
+    expect(count == 2, "gap: not both windows closed");
+    expect_record(&records[0], 0, 0, 10, 1, "gap: wrong 1 s window");
+    expect_record(&records[1], 1, 0, 10, 1, "gap: wrong 10 s window");
+    expect((records[0].min[0] == 100) && (records[0].max[0] == 1000) &&
+           (records[0].mean[0] == 550 << SUMMARY_FRACTION),
+           "gap: wrong statistics of the 1 s window");
+    expect((summary.levels[0].start == 25000) && (summary.levels[1].start == 20000),
+           "gap: windows not skipped ahead");
+
+    // empty windows make no records
+    expect(summary_tick(&summary, 25999, records) == 0, "tick: window closed early");
+    count = summary_tick(&summary, 26000, records);
+    expect(count == 1, "tick: 1 s window not closed");
+    expect_record(&records[0], 0, 25000, 1, 1, "tick: wrong 1 s window");
+    count = summary_tick(&summary, 30000, records);
+    expect(count == 1, "tick: empty window made a record");
+    expect_record(&records[0], 1, 20000, 1, 1, "tick: wrong 10 s window");
+    expect(summary.levels[0].start == 30000, "tick: empty windows not skipped");
+
+    // other settings flush the open windows before the sample is added
+    sample = make_sample(30100, 1, 60);
+    expect(summary_update(&summary, &sample, records) == 0, "settings: closed too early");
+    sample = make_sample(30200, 2, 70);
+    count = summary_update(&summary, &sample, records);
+    expect(count == 2, "settings: open windows not flushed");
+    expect_record(&records[0], 0, 30000, 1, 1, "settings: wrong 1 s window");
+    expect_record(&records[1], 1, 30000, 1, 1, "settings: wrong 10 s window");
+    expect(records[0].min[0] == 60, "settings: sample of the new settings in the old window");
+    expect((summary.setting == 2) && (summary.levels[0].start == 30200) &&
+           (summary.levels[1].start == 30200), "settings: new windows not started");
+
+    count = summary_flush(&summary, records);
+    expect(count == 2, "flush: open windows not closed");
+    expect_record(&records[0], 0, 30200, 1, 2, "flush: wrong 1 s window");
+    expect_record(&records[1], 1, 30200, 1, 2, "flush: wrong 10 s window");
+    expect(summary_flush(&summary, records) == 0, "flush: records of no samples");
+    expect(summary_tick(&summary, 50000, records) == 0, "flush: windows still open");
+}
+
+static bool records_equal(const SUMMARY_RECORD* a, const SUMMARY_RECORD* b) {
+    uint8 i;
+
+    if ((a->start != b->start) || (a->count != b->count) || (a->device != b->device) ||
+            (a->level != b->level) || (a->setting != b->setting)) {
+        return false;
+    }
+    for (i = 0; i < SAMPLE_NUM_CHANNELS; i++) {
+        if ((a->min[i] != b->min[i]) || (a->max[i] != b->max[i]) ||
+                (a->mean[i] != b->mean[i]) || (a->variance[i] != b->variance[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// summaries of extreme values come back unchanged, and not as samples
+static void check_frames(void) {
+    SUMMARY_RECORD records[TELEMETRY_MAX_SUMMARIES];
+    SUMMARY_RECORD decoded[TELEMETRY_MAX_SUMMARIES];
+    SAMPLE samples[TELEMETRY_MAX_RECORDS];
+    uint8 frame[TELEMETRY_MAX_FRAME];
+    uint8 sequence;
+    uint16 length;
+    uint8 i;
+    uint8 j;
+
+    memset(records, 0, sizeof(records));
+    memset(decoded, 0, sizeof(decoded));
+    for (i = 0; i < TELEMETRY_MAX_SUMMARIES; i++) {
+        records[i].start = 0xDEADBEEF + i;
+        records[i].count = 0x00400000 - i;
+        records[i].device = 0xA0 + i;
+        records[i].level = i;
+        records[i].setting = 0x5A;
+        for (j = 0; j < SAMPLE_NUM_CHANNELS; j++) {
+            records[i].min[j] = j;
+            records[i].max[j] = 0xFFFF - j;
+            records[i].mean[j] = 0xFFFF00 + j;
+            records[i].variance[j] = 0xFFFFFFFF - j;
+        }
+    }
+    length = telemetry_summary_encode(records, TELEMETRY_MAX_SUMMARIES, 77, frame);
+    expect((length > 0) && (frame[length - 1] == TELEMETRY_DELIMITER),
+           "frames: not ended by a delimiter");
+    expect(telemetry_summary_decode(frame, length - 1, &sequence, decoded) ==
+           TELEMETRY_MAX_SUMMARIES, "frames: wrong number of summaries");
+    expect(sequence == 77, "frames: wrong sequence");
+    for (i = 0; i < TELEMETRY_MAX_SUMMARIES; i++) {
+        expect(records_equal(&records[i], &decoded[i]), "frames: summary changed");
+    }
+    expect(telemetry_frame_decode(frame, length - 1, &sequence, samples) == 0,
+           "frames: summaries decoded as samples");
+    frame[length / 2] ^= 0x01;
+    expect(telemetry_summary_decode(frame, length - 1, &sequence, decoded) == 0,
+           "frames: corrupted frame decoded");
+}
+
+int main(void) {
+    check_levels();
+    check_statistics();
+    check_windows();
+    check_frames();
+
+    printf("summary: statistics, gaps, settings change, flush, frames: %s\n",
+           errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,218 @@
+/*******************************************************************************
+ * File Name: test_telemetry_pty.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host throughput test of the telemetry framing, with a pseudo-terminal as
+ *  the serial link.  A thread encodes frames of samples and writes them to
+ *  the master side in raw mode, the main thread reads the slave side and
+ *  feeds the bytes to the decoder library.  Some frames are corrupted and
+ *  some left out on the way, the decoder has to count exactly those as
+ *  errors and lost frames and give back every other sample unchanged.
+ *  The rate of the pty is printed next to what UARTs of a few baud rates
+ *  carry with the same frames.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include "telemetry_frame.h"
+
+#define NUM_FRAMES                  50000
+#define CORRUPT_EVERY               997     // frames with a flipped bit
+#define SKIP_EVERY                  1499    // frames never written
+#define WRITE_CHUNK                 4096
+#define READ_TIMEOUT_MS             2000
+
+static int master;
+
+// what the sample with an index holds
+static void make_sample(SAMPLE* sample, uint32 index) {
+    sample->timestamp = index;
+    sample->device = index % 7;
+    sample->status = (index >> 3) & 0xFF;
+    sample->setting = index & 0x18;
+    sample->channel[0] = index & 0xFFFF;
+    sample->channel[1] = (index * 3) & 0xFFFF;
+    // zeros in the middle of the payload for COBS to take out
+    sample->channel[2] = (index & 1) ? 0 : 0xFFFF;
+}
+
+static bool check_sample(const SAMPLE* sample) {
+    SAMPLE expected;
+
+    make_sample(&expected, sample->timestamp);
+    return (sample->device == expected.device) && (sample->status == expected.status) &&
+           (sample->setting == expected.setting) &&
+           (sample->channel[0] == expected.channel[0]) &&
+           (sample->channel[1] == expected.channel[1]) &&
+           (sample->channel[2] == expected.channel[2]);
+}
+
+static void write_all(const uint8* data, size_t length) {
+    ssize_t written;
+
+    while (length > 0) {
+        written = write(master, data, length);
+        if (written < 0) {
+            perror("write");
+            exit(1);
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+// the firmware side, frames go out in large writes like the DMA sends them
+static void* sender(void* argument) {
+    static uint8 chunk[WRITE_CHUNK + TELEMETRY_MAX_FRAME];
+    SAMPLE samples[TELEMETRY_MAX_RECORDS];
+    size_t length = 0;
+    uint32 frame;
+    uint16 i;
+
+    (void) argument;
+    chunk[length++] = TELEMETRY_DELIMITER;
+    for (frame = 0; frame < NUM_FRAMES; frame++) {
+        for (i = 0; i < TELEMETRY_MAX_RECORDS; i++) {
+            make_sample(&samples[i], frame * TELEMETRY_MAX_RECORDS + i);
+        }
+        if ((frame % SKIP_EVERY) == SKIP_EVERY - 1) {
+            continue;
+        }
+        i = telemetry_frame_encode(samples, TELEMETRY_MAX_RECORDS, frame, &chunk[length]);
+        // a flipped bit, that does not make a delimiter and split the frame
+        if ((frame % CORRUPT_EVERY) == CORRUPT_EVERY - 1) {
+            chunk[length + 10] ^= (chunk[length + 10] == 0x04) ? 0x08 : 0x04;
+        }
+        length += i;
+        if (length >= WRITE_CHUNK) {
+            write_all(chunk, length);
+            length = 0;
+        }
+    }
+    write_all(chunk, length);
+    return NULL;
+}
+
+int main(void) {
+    static uint8 bytes[WRITE_CHUNK];
+    TELEMETRY_DECODER decoder;
+    SAMPLE samples[TELEMETRY_MAX_RECORDS];
+    struct termios settings;
+    struct timespec start;
+    struct timespec end;
+    struct pollfd ready;
+    pthread_t thread;
+    uint32 expected_errors = 0;
+    uint32 expected_lost = 0;
+    uint32 received = 0;
+    uint64 total_bytes = 0;
+    int64 last = -1;
+    double seconds;
+    int errors = 0;
+    ssize_t length;
+    ssize_t i;
+    uint8 count;
+    uint8 j;
+    int slave;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+        perror("posix_openpt");
+        return 1;
+    }
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror("open pty");
+        return 1;
+    }
+    // a serial port in raw mode, no echo and no changed bytes
+    tcgetattr(slave, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(slave, TCSANOW, &settings);
+
+    for (i = 0; i < NUM_FRAMES; i++) {
+        if ((i % SKIP_EVERY) == SKIP_EVERY - 1) {
+            expected_lost++;
+        }
+        else if ((i % CORRUPT_EVERY) == CORRUPT_EVERY - 1) {
+            expected_errors++;
+        }
+    }
+    // a corrupted frame is also missing from the sequence of the good ones
+    expected_lost += expected_errors;
+
+    telemetry_decoder_init(&decoder);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&thread, NULL, sender, NULL);
+    ready.fd = slave;
+    ready.events = POLLIN;
+    while (decoder.frames < NUM_FRAMES - expected_lost) {
+        if (poll(&ready, 1, READ_TIMEOUT_MS) <= 0) {
+            printf("nothing received for %d ms\n", READ_TIMEOUT_MS);
+            errors++;
+            break;
+        }
+        length = read(slave, bytes, sizeof(bytes));
+        if (length <= 0) {
+            perror("read");
+            errors++;
+            break;
+        }
+        total_bytes += length;
+        for (i = 0; i < length; i++) {
+            count = telemetry_decoder_put(&decoder, bytes[i], samples);
+            for (j = 0; j < count; j++) {
+                if (!check_sample(&samples[j]) || ((int64) samples[j].timestamp <= last)) {
+                    if (errors++ < 10) {
+                        printf("bad sample %u after %ld\n", samples[j].timestamp, (long) last);
+                    }
+                }
+                last = samples[j].timestamp;
+            }
+            received += count;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_join(thread, NULL);
+    close(slave);
+    close(master);
+
+    if ((decoder.errors != expected_errors) || (decoder.lost != expected_lost) ||
+            (received != (NUM_FRAMES - expected_lost) * TELEMETRY_MAX_RECORDS)) {
+        printf("frames %u errors %u lost %u samples %u, expected errors %u lost %u\n",
+               decoder.frames, decoder.errors, decoder.lost, received, expected_errors,
+               expected_lost);
+        errors++;
+    }
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("telemetry pty: %u samples in %.2f s, %.0f samples/s, %.1f bytes per sample\n",
+           received, seconds, received / seconds, (double) total_bytes / received);
+    printf("  UART at 115200 baud carries %.0f samples/s, 921600 %.0f, 3000000 %.0f\n",
+           11520.0 * received / total_bytes, 92160.0 * received / total_bytes,
+           300000.0 * received / total_bytes);
+    printf("  %u frames, %u errors, %u lost: %s\n", decoder.frames, decoder.errors,
+           decoder.lost, errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,182 @@
+/*******************************************************************************
+ * File Name: test_tsl2561_lux.c
+ * Version 0.50
+ *
+ * Description:
+ *  Host test of the integer lux calculation of the tsl2561 against the
+ *  floating point formulas of the datasheet, for both packages at every
+ *  integration time and gain.  The channel ratios go past the last segment
+ *  of the fit, up to a channel 1 many times channel 0.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include "tsl2561.h"
+
+#define NUM_RANDOM                  500000
+
+// The integer calculation fits the channel0 * ratio^1.4 term of the
+// datasheet with straight lines, that are off by up to a few percent
+#define LUX_ERROR_RELATIVE          0.06
+#define LUX_ERROR_LUX               0.5
+
+typedef struct {
+    uint8       integration_time;
+    uint16      max_count;
+    double      scale;          // channel scale to 402 ms
+} TIMING;
+
+static const TIMING timings[] = {
+    {TSL2561_INTEGRATION_13MS, TSL2561_MAX_COUNT_13MS, 322.0 / 11.0},
+    {TSL2561_INTEGRATION_101MS, TSL2561_MAX_COUNT_101MS, 322.0 / 81.0},
+    {TSL2561_INTEGRATION_402MS, TSL2561_MAX_COUNT_402MS, 1.0}
+};
+#define NUM_TIMINGS                 (sizeof(timings) / sizeof(timings[0]))
+
+static uint32 random_state = 54321;
+static double max_error;
+static uint32 num_checked;
+static int errors;
+
+static uint32 next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+// lux of the datasheet, from the channels at 402 ms and 16x gain
+static double reference_lux(uint8 package, double channel0, double channel1) {
+    double ratio;
+
+    if (channel0 == 0) {
+        return 0;
+    }
+    ratio = channel1 / channel0;
+    if (package == TSL2561_ID_PARTNO_CS) {
+        if (ratio <= 0.52) {
+            return 0.0315 * channel0 - 0.0593 * channel0 * pow(ratio, 1.4);
+        }
+        if (ratio <= 0.65) {
+            return 0.0229 * channel0 - 0.0291 * channel1;
+        }
+        if (ratio <= 0.80) {
+            return 0.0157 * channel0 - 0.0180 * channel1;
+        }
+        if (ratio <= 1.30) {
+            return 0.00338 * channel0 - 0.00260 * channel1;
+        }
+        return 0;
+    }
+    if (ratio <= 0.50) {
+        return 0.0304 * channel0 - 0.062 * channel0 * pow(ratio, 1.4);
+    }
+    if (ratio <= 0.61) {
+        return 0.0224 * channel0 - 0.031 * channel1;
+    }
+    if (ratio <= 0.80) {
+        return 0.0128 * channel0 - 0.0153 * channel1;
+    }
+    if (ratio <= 1.30) {
+        return 0.00146 * channel0 - 0.00112 * channel1;
+    }
+    return 0;
+}
+
+static void check_lux(TSL2561* device, const TIMING* timing, uint16 channel0, uint16 channel1) {
+    double scale = timing->scale;
+    double expected;
+    double allowed;
+    double error;
+    uint32 lux;
+
+    if (device->_gain == TSL2561_GAIN_1X) {
+        scale *= 16.0;
+    }
+    lux = tsl2561_calculate_lux(device, channel0, channel1);
+    num_checked++;
+    if ((channel0 >= timing->max_count) || (channel1 >= timing->max_count)) {
+        if (lux != TSL2561_LUX_SATURATED) {
+            if (errors++ < 10) {
+                printf("lux %u of saturated %u %u\n", lux, channel0, channel1);
+            }
+        }
+        return;
+    }
+    expected = reference_lux(device->package, channel0 * scale, channel1 * scale);
+    if (expected < 0) {
+        expected = 0;
+    }
+    // a count of the scaled channels is a large part of the lux at low light,
+    // and with a lot of infrared the lux is the difference of two large
+    // products, with coefficients rounded to 2^-14
+    allowed = expected * LUX_ERROR_RELATIVE + LUX_ERROR_LUX + 0.07 * scale +
+              (channel0 + channel1) * scale / 32768.0;
+    error = fabs(lux - expected);
+    if (error / allowed > max_error) {
+        max_error = error / allowed;
+    }
+    if (error > allowed) {
+        if (errors++ < 10) {
+            printf("lux %u, float %.2f for %u %u package %x timing %u gain %u\n", lux,
+                   expected, channel0, channel1, device->package,
+                   device->integration_time, device->_gain);
+        }
+    }
+}
+
+int main(void) {
+    static const uint8 packages[] = {TSL2561_ID_PARTNO_T, TSL2561_ID_PARTNO_CS};
+    static const uint8 gains[] = {TSL2561_GAIN_1X, TSL2561_GAIN_16X};
+    // ratios of 0, inside each segment, past the last one and past 0xFFFF
+    static const uint16 edges[] = {0, 1, 2, 3, 10, 100, 200, 1000, 5046, 5047, 37176,
+                                   37177, 65534, 65535};
+    TSL2561 device = {0};
+    const TIMING* timing;
+    uint16 channel0;
+    uint32 p;
+    uint32 g;
+    uint32 t;
+    uint32 i;
+    uint32 j;
+    uint32 n;
+
+    for (p = 0; p < sizeof(packages); p++) {
+        device.package = packages[p];
+        for (g = 0; g < sizeof(gains); g++) {
+            device._gain = gains[g];
+            for (t = 0; t < NUM_TIMINGS; t++) {
+                timing = &timings[t];
+                device.integration_time = timing->integration_time;
+                for (i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+                    for (j = 0; j < sizeof(edges) / sizeof(edges[0]); j++) {
+                        check_lux(&device, timing, edges[i], edges[j]);
+                    }
+                }
+                // channel 1 up to 1.5 times channel 0, most light has less
+                for (n = 0; n < NUM_RANDOM; n++) {
+                    channel0 = next_random() % timing->max_count;
+                    check_lux(&device, timing, channel0,
+                              next_random() % (channel0 + channel0 / 2 + 1));
+                }
+            }
+        }
+    }
+
+    printf("tsl2561 lux: %u readings, worst error / allowed %.2f: %s\n", num_checked,
+           max_error, errors ? "FAIL" : "pass");
+    return errors ? 1 : 0;
+}
+
+/* [] END OF FILE */
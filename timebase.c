@@ -0,0 +1,98 @@
+/*******************************************************************************
+ * File Name: timebase.c
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides a millisecond counter run from the SysTick timer,
+ *  or read from the monotonic clock in host builds.
+ *
+*******************************************************************************
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#include "timebase.h"
+
+#if defined(SENSOR_HOST_BUILD)
+
+#include <time.h>
+
+void timebase_start(void) {
+}
+
+uint32 timebase_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+// the host clock keeps running while the process sleeps
+void timebase_advance(uint32 elapsed) {
+    (void) elapsed;
+}
+
+#else
+
+static volatile uint32 milliseconds = 0;
+
+static void timebase_tick(void);
+
+/******************************************************************************
+* Function Name: timebase_start
+*******************************************************************************
+*
+* Summary:
+*  Start the SysTick timer with a 1 ms period and count its interrupts.
+*
+*******************************************************************************/
+
+void timebase_start(void) {
+    CySysTickStart();
+    CySysTickSetCallback(0, timebase_tick);
+}
+
+/******************************************************************************
+* Function Name: timebase_ms
+*******************************************************************************
+*
+* Return:
+*  uint32: milliseconds since timebase_start, wraps after about 49 days
+*
+*******************************************************************************/
+
+uint32 timebase_ms(void) {
+    return milliseconds;
+}
+
+/******************************************************************************
+* Function Name: timebase_advance
+*******************************************************************************
+*
+* Summary:
+*  Add time that went by without SysTick interrupts, e.g. while the MCU
+*  was in a low power mode that stops the SysTick timer.
+*
+* Parameters:
+*  uint32 elapsed: milliseconds to add
+*
+*******************************************************************************/
+
+void timebase_advance(uint32 elapsed) {
+    uint8 interrupt_state = CyEnterCriticalSection();
+    milliseconds += elapsed;
+    CyExitCriticalSection(interrupt_state);
+}
+
+static void timebase_tick(void) {
+    milliseconds++;
+}
+
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,35 @@
+/*******************************************************************************
+ * File Name: timebase.h
+ * Version 0.50
+ *
+ * Description:
+ *  This file provides the millisecond time used to timestamp sensor samples.
+ *
+********************************************************************************
+ *
+ * Copyright by Kyle Lopin, Naresuan University, 2017
+ * All Rights Reserved
+ * UNPUBLISHED, LICENSED SOFTWARE.
+ *
+ * CONFIDENTIAL AND PROPRIETARY INFORMATION
+ * WHICH IS THE PROPERTY OF Naresuan University.
+ *
+ * ========================================
+*/
+
+#if !defined(_TIMEBASE_H)
+#define _TIMEBASE_H
+    
+#include "platform.h"
+    
+/***************************************
+*        Function Prototypes
+***************************************/   
+
+void timebase_start(void);
+uint32 timebase_ms(void);
+void timebase_advance(uint32 elapsed);
+
+#endif
+
+/* [] END OF FILE */
@@ -1,9 +1,9 @@
 /*******************************************************************************
- * File Name: tsl2591.c
+ * File Name: tsl2561.c
  * Version 0.50
  *
  * Description:
- *  This file provides the source code of APIs for the tsl2591 light sensor.
+ *  This file provides the source code of APIs for the tsl2561 light sensor.
  *  The sensor needs a I2C master component with the name I2C
  *
  *******************************************************************************
@@ -18,24 +18,99 @@
  */
 
 #include "tsl2561.h"
+#include "sensor_stats.h"
+#include "nv_store.h"
 
 /***************************************
-*      I2C communication buffer
+*      Lux calculation constants
 ***************************************/  
 
-uint8 static read_buffer[8];
-uint8 static write_buffer[2];
-#define TSL2561_I2C_ADDRESS         I2C_ADDRESS_FLOAT
+// Fixed point scales of the datasheet's integer lux calculation
+#define LUX_SCALE                   14      // lux is scaled by 2^14
+#define RATIO_SCALE                 9       // channel ratio is scaled by 2^9
+#define CH_SCALE                    10      // channel scaling is by 2^10
+#define CHSCALE_TINT0               0x7517  // 322/11 * 2^CH_SCALE
+#define CHSCALE_TINT1               0x0FE7  // 322/81 * 2^CH_SCALE
+
+#define NUM_LUX_SEGMENTS            8
+
+// Bits of the setup registers a warm start checks
+#define WARM_CONTROL_MASK           TSL2561_POWER_MASK
+#define WARM_TIMING_MASK            (TSL2561_INTEG_MASK | TSL2561_GAIN_MASK)
+
+// Jobs moved forward by tsl2561_poll
+#define JOB_NONE                    0
+#define JOB_INIT                    1
+#define JOB_CONFIG                  2
+#define JOB_SAMPLE                  3
+
+// Steps of the jobs, each one I2C transaction
+#define STEP_READ_ID                0
+#define STEP_FLUSH                  1
+#define STEP_SAMPLE                 2
+#define STEP_FINISHED               3
+
+// Offset of a register in the block read of both channels
+#define DATA_OFFSET(_register)      ((_register) - TSL2561_DATA_BLOCK_FIRST)
+
+// Piecewise linear fit of lux to the channel 1 / channel 0 ratio.  While the
+// ratio is at most k, lux = channel0 * b - channel1 * m.  The last segment
+// gives 0 lux for every ratio above the others, even ones past its k.
+typedef struct {
+    uint16 k;
+    uint16 b;
+    uint16 m;
+} LUX_SEGMENT;
+
+static const LUX_SEGMENT lux_segments_t[NUM_LUX_SEGMENTS] = {
+    {0x0040, 0x01F2, 0x01BE},
+    {0x0080, 0x0214, 0x02D1},
+    {0x00C0, 0x023F, 0x037B},
+    {0x0100, 0x0270, 0x03FE},
+    {0x0138, 0x016F, 0x01FC},
+    {0x019A, 0x00D2, 0x00FB},
+    {0x029A, 0x0018, 0x0012},
+    {0xFFFF, 0x0000, 0x0000}
+};
+
+static const LUX_SEGMENT lux_segments_cs[NUM_LUX_SEGMENTS] = {
+    {0x0043, 0x0204, 0x01AD},
+    {0x0085, 0x0228, 0x02C1},
+    {0x00C8, 0x0253, 0x0363},
+    {0x010A, 0x0282, 0x03DF},
+    {0x014D, 0x0177, 0x01DD},
+    {0x019A, 0x0101, 0x0127},
+    {0x029A, 0x0037, 0x002B},
+    {0xFFFF, 0x0000, 0x0000}
+};
+
+static const REGMAP_REGISTER tsl2561_registers[] = REGMAP_REGISTER_TABLE(TSL2561_REGISTERS);
+
+// every register access needs the command bit
+const REGMAP tsl2561_regmap = {
+    tsl2561_registers,
+    sizeof(tsl2561_registers) / sizeof(tsl2561_registers[0]),
+    TSL2561_COMMAND_BIT
+};
 
 /***************************************
 *      Static Function Prototypes
 ***************************************/  
 
 
-static inline void tsl2561_write8(uint8 _register, uint8 data);
+static uint8 tsl2561_read(TSL2561* device, uint8 _register, uint8 num_bytes);
+static void transfer_done(TSL2561* device, uint8 status);
+static void queued_done(SENSOR_TRANSACTION* transaction);
+static void shadow_flush(TSL2561* device);
+static void tsl2561_setup(TSL2561* device, SENSOR_BUS* bus, uint8 address);
 
-static inline uint8 tsl2561_read8(uint8 _register);
-//static inline uint16 tsl2561_read16(uint8 _register);
+static void job_begin(TSL2561* device, uint8 job, uint8 step);
+static bool job_submit(TSL2561* device);
+static void job_next(TSL2561* device, uint8 status);
+static bool job_wait(TSL2561* device);
+static bool job_run(TSL2561* device, uint8 job, uint8 step);
+
+static inline uint8 tsl2561_read8(TSL2561* device, uint8 _register);
 
 
 /******************************************************************************
@@ -43,47 +118,531 @@ static inline uint8 tsl2561_read8(uint8 _register);
 *******************************************************************************
 *
 * Summary:
-*  Initialize a isl29125 red, green, blue light sensor.  
-*  First check that the device returns the correct ID.  Reset the device
-*  and then configure it to read in the rgb mode, at the high lux setting
-*  and with the ir adjustment set to high.  
-*  Save to the isl29125 structure all the operational settings
+*  Initialize a tsl2561 lux sensor.  
+*  First check that the device returns a tsl2561 part number, then power 
+*  it up with a 402 ms integration time and 1x gain.
+*  Save to the tsl2561 structure all the operational settings.
+*  Waits for the bus, tsl2561_init_begin does the same without waiting.
+*
+* Parameters:
+*  TSL2561* device: structure to save the settings of this tsl2561 in
+*  SENSOR_BUS* bus: bus the tsl2561 is on, or 0 for the default bus
+*  uint8 address: I2C_ADDRESS_GROUND, I2C_ADDRESS_FLOAT or I2C_ADDRESS_VDD,
+*                 set by the ADDR SEL pin
+*
+*******************************************************************************/
+
+void tsl2561_Init(TSL2561* device, SENSOR_BUS* bus, uint8 address) {
+    SENSOR_STATS_BEGIN(SENSOR_API_TSL2561_INIT);
+    tsl2561_init_begin(device, bus, address);
+    job_wait(device);
+    SENSOR_STATS_END(SENSOR_API_TSL2561_INIT);
+}
+
+/******************************************************************************
+* Function Name: tsl2561_init_begin
+*******************************************************************************
+*
+* Summary:
+*  Start the same initialization as tsl2561_Init as a job, moved forward
+*  by tsl2561_poll.  The ID read and the power up each take one call of
+*  tsl2561_poll that finds the bus done.
+*
+* Parameters:
+*  TSL2561* device: structure to save the settings of this tsl2561 in
+*  SENSOR_BUS* bus: bus the tsl2561 is on, or 0 for the default bus
+*  uint8 address: I2C_ADDRESS_GROUND, I2C_ADDRESS_FLOAT or I2C_ADDRESS_VDD
+*
+*******************************************************************************/
+
+void tsl2561_init_begin(TSL2561* device, SENSOR_BUS* bus, uint8 address) {
+    tsl2561_setup(device, bus, address);
+    job_begin(device, JOB_INIT, STEP_READ_ID);
+}
+
+/******************************************************************************
+* Function Name: tsl2561_config_begin
+*******************************************************************************
+*
+* Summary:
+*  Start a job that sets the integration time and gain of the tsl2561,
+*  the same as tsl2561_set_timing
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  uint8 integration_time: TSL2561_INTEGRATION_13MS, 101MS or 402MS
+*  uint8 gain: TSL2561_GAIN_1X or TSL2561_GAIN_16X
 *
-* Global Parameters:
-*  ISL29125 isl29125: structure to save settings of the isl29125
+* Return:
+*  bool: true if started, false if the device already has a job
 *
 *******************************************************************************/
 
-void tsl2561_Init(void) {
-    uint8 id = tsl2561_read8(TSL2561_REG_ID);
-    if (id != 0x0A) {
-        tsl2561.working = false;
+bool tsl2561_config_begin(TSL2561* device, uint8 integration_time, uint8 gain) {
+    if (device->job != JOB_NONE) {
+        return false;
     }
+    REGMAP_SHADOW_FIELD(&device->setup, TSL2561_INTEG, integration_time);
+    REGMAP_SHADOW_FIELD(&device->setup, TSL2561_GAIN, gain);
+    job_begin(device, JOB_CONFIG, STEP_FLUSH);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: tsl2561_sample_begin
+*******************************************************************************
+*
+* Summary:
+*  Start a job that reads both channels and calculates the lux, the same
+*  as tsl2561_read_data.  The device has to be already running.
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  TSL2561_DATA* data: where to put the channels and lux, kept until the 
+*                      job is done
+*
+* Return:
+*  bool: true if started, false if the device already has a job
+*
+*******************************************************************************/
+
+bool tsl2561_sample_begin(TSL2561* device, TSL2561_DATA* data) {
+    if (device->job != JOB_NONE) {
+        return false;
+    }
+    device->job_data = data;
+    job_begin(device, JOB_SAMPLE, STEP_SAMPLE);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: tsl2561_poll
+*******************************************************************************
+*
+* Summary:
+*  Move the job of the tsl2561 forward without waiting on the bus.  Call
+*  it from a loop, with the polls of the other devices, until it returns
+*  SENSOR_JOB_DONE.  Then job_ok tells if the job worked.
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*
+* Return:
+*  uint8: SENSOR_JOB_BUSY while the job runs, SENSOR_JOB_DONE once when 
+*         it finishes, SENSOR_JOB_IDLE after that or with no job
+*
+*******************************************************************************/
+
+uint8 tsl2561_poll(TSL2561* device) {
+    SENSOR_TRANSACTION* transaction = &device->job_transaction;
     
+    if (device->job == JOB_NONE) {
+        return SENSOR_JOB_IDLE;
+    }
+    sensor_bus_service(device->bus);
+    for (;;) {
+        if (device->job_step == STEP_FINISHED) {
+            device->job = JOB_NONE;
+            return SENSOR_JOB_DONE;
+        }
+        if (transaction->state == SENSOR_XFER_IDLE) {
+            if (!job_submit(device)) {
+                return SENSOR_JOB_BUSY;  // the queue is full, try again
+            }
+            continue;
+        }
+        if (transaction->state != SENSOR_XFER_DONE) {
+            return SENSOR_JOB_BUSY;
+        }
+        transaction->state = SENSOR_XFER_IDLE;
+        transfer_done(device, transaction->status);
+        job_next(device, transaction->status);
+    }
+}
+
+/******************************************************************************
+* Function Name: tsl2561_warm_init
+*******************************************************************************
+*
+* Summary:
+*  Initialize a tsl2561 that may have stayed powered over an MCU restart.
+*  The control and timing registers are checked in one block read against
+*  the configuration saved in the nonvolatile slot.  If the device is on
+*  with the saved timing it is used as it is, so the only I2C transaction
+*  is that read.  Otherwise it gets a cold tsl2561_Init and that
+*  configuration is saved.  Call nv_store_start first.
+*
+* Parameters:
+*  TSL2561* device: structure to save the settings of this tsl2561 in
+*  SENSOR_BUS* bus: bus the tsl2561 is on, or 0 for the default bus
+*  uint8 address: I2C_ADDRESS_GROUND, I2C_ADDRESS_FLOAT or I2C_ADDRESS_VDD
+*  uint8 slot: nonvolatile slot of this tsl2561, e.g. NV_SLOT_TSL2561
+*
+* Return:
+*  bool: true if the device kept its configuration, false after a cold init
+*
+*******************************************************************************/
+
+bool tsl2561_warm_init(TSL2561* device, SENSOR_BUS* bus, uint8 address, uint8 slot) {
+    uint8 saved[TSL2561_WARM_RECORD_SIZE];
+    uint8 control;
+    uint8 timing;
     
+    tsl2561_setup(device, bus, address);
+    if (nv_store_read(slot, saved, TSL2561_WARM_RECORD_SIZE) && (saved[0] == address) &&
+            (saved[1] == TSL2561_POWER_ON) &&
+            (SENSOR_OK == tsl2561_read(device, TSL2561_SETUP_BLOCK_FIRST, 
+                                       TSL2561_SETUP_BLOCK_LENGTH))) {
+        control = device->read_buffer[0];
+        timing = device->read_buffer[1];
+        if (((control & WARM_CONTROL_MASK) == saved[1]) && 
+                ((timing & WARM_TIMING_MASK) == saved[2])) {
+            device->package = saved[3];
+            device->integration_time = timing & TSL2561_INTEG_MASK;
+            device->_gain = timing & TSL2561_GAIN_MASK;
+            regmap_shadow_init(&device->setup, TSL2561_SETUP_BLOCK_FIRST, 
+                               TSL2561_SETUP_BLOCK_LENGTH, TSL2561_POWER_OFF);
+            regmap_shadow_sync(&device->setup, TSL2561_REG_CONTROL, saved[1]);
+            regmap_shadow_sync(&device->setup, TSL2561_REG_TIMING, saved[2]);
+            return true;
+        }
+    }
+    tsl2561_Init(device, bus, address);
+    tsl2561_save_config(device, slot);
+    return false;
+}
+
+/******************************************************************************
+* Function Name: tsl2561_save_config
+*******************************************************************************
+*
+* Summary:
+*  Save the timing the tsl2561 runs with, for tsl2561_warm_init after the
+*  next restart.  Call again after tsl2561_set_timing if the new timing 
+*  should be kept, the EEPROM row is only written when the record changes.
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  uint8 slot: nonvolatile slot of this tsl2561
+*
+* Return:
+*  bool: true if saved, false if the device is not working or not configured
+*
+*******************************************************************************/
+
+bool tsl2561_save_config(TSL2561* device, uint8 slot) {
+    uint8 record[TSL2561_WARM_RECORD_SIZE];
     
-    
-    
-    
+    if (!device->working || (device->setup.dirty != 0x00)) {
+        return false;
+    }
+    record[0] = device->address;
+    record[1] = regmap_shadow_read(&device->setup, TSL2561_REG_CONTROL) & WARM_CONTROL_MASK;
+    record[2] = regmap_shadow_read(&device->setup, TSL2561_REG_TIMING) & WARM_TIMING_MASK;
+    record[3] = device->package;
+    return nv_store_write(slot, record, TSL2561_WARM_RECORD_SIZE);
 }
 
+/******************************************************************************
+* Function Name: tsl2561_setup
+*******************************************************************************
+*
+* Summary:
+*  Set up the bus, address and state of the tsl2561 structure, before 
+*  talking to the device
+*
+*******************************************************************************/
+
+static void tsl2561_setup(TSL2561* device, SENSOR_BUS* bus, uint8 address) {
+    device->bus = bus ? bus : sensor_get_bus();
+    device->address = address;
+    device->working = true;
+    device->backoff.failures = 0;
+    device->job = JOB_NONE;
+}
 
+/******************************************************************************
+* Function Name: tsl2561_Start
+*******************************************************************************
+*
+* Summary:
+*  Power up the tsl2561, it starts integrating with its timing settings
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*
+*******************************************************************************/
 
+void tsl2561_Start(TSL2561* device) {
+    REGMAP_SHADOW_FIELD(&device->setup, TSL2561_POWER, TSL2561_POWER_ON);
+    shadow_flush(device);
+}
+
+/******************************************************************************
+* Function Name: tsl2561_Stop
+*******************************************************************************
+*
+* Summary:
+*  Power down the tsl2561, the timing settings are kept
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*
+*******************************************************************************/
+
+void tsl2561_Stop(TSL2561* device) {
+    REGMAP_SHADOW_FIELD(&device->setup, TSL2561_POWER, TSL2561_POWER_OFF);
+    shadow_flush(device);
+}
+
+/******************************************************************************
+* Function Name: tsl2561_set_timing
+*******************************************************************************
+*
+* Summary:
+*  Set the integration time and gain of the tsl2561.  The lux keeps using
+*  the old timing until the new one is written, if the device has a job 
+*  that is on the next flush.
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  uint8 integration_time: TSL2561_INTEGRATION_13MS, 101MS or 402MS
+*  uint8 gain: TSL2561_GAIN_1X or TSL2561_GAIN_16X
+*
+*******************************************************************************/
+
+void tsl2561_set_timing(TSL2561* device, uint8 integration_time, uint8 gain) {
+    SENSOR_STATS_BEGIN(SENSOR_API_TSL2561_SET_TIMING);
+    REGMAP_SHADOW_FIELD(&device->setup, TSL2561_INTEG, integration_time);
+    REGMAP_SHADOW_FIELD(&device->setup, TSL2561_GAIN, gain);
+    shadow_flush(device);
+    SENSOR_STATS_END(SENSOR_API_TSL2561_SET_TIMING);
+}
 
 /******************************************************************************
 * Function Name: tsl2561_read_id
 *******************************************************************************
 *
 * Summary:
-*  Read the ID code of the tsl2561 lux sensor, should be 0x0A???
+*  Read the ID code of the tsl2561 lux sensor, the upper nibble should be 
+*  0x5 for the T, FN and CL packages or 0x1 for the CS package
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*
+* Return:
+*  uint8: byte read from the device's ID register, 0 if the read failed or the 
+*         device has a job
+*
+*******************************************************************************/
+
+uint8 tsl2561_read_id(TSL2561* device) {
+    SENSOR_STATS_BEGIN(SENSOR_API_TSL2561_READ_ID);
+    uint8 id = tsl2561_read8(device, TSL2561_REG_ID); 
+    SENSOR_STATS_END(SENSOR_API_TSL2561_READ_ID);
+    return id;
+}
+
+/******************************************************************************
+* Function Name: tsl2561_read_data
+*******************************************************************************
+*
+* Summary:
+*  Read both channels of the tsl2561 in one 4 byte block read, starting 
+*  at the DATA0 low byte, and calculate the lux.  The device has to be
+*  already running, and not have a job of the *_begin functions.
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  TSL2561_DATA* data: structure to put the channels and lux in
+*
+* Return:
+*  uint8: SENSOR_OK, or the SENSOR_ERR_* code of the read and data is not changed,
+*         SENSOR_ERR_BUSY if the device has a job
+*
+*******************************************************************************/
+
+uint8 tsl2561_read_data(TSL2561* device, TSL2561_DATA* data) {
+    uint8 status = SENSOR_ERR_BUSY;
+    
+    SENSOR_STATS_BEGIN(SENSOR_API_TSL2561_READ_DATA);
+    if (device->job == JOB_NONE) {
+        device->job_data = data;
+        job_run(device, JOB_SAMPLE, STEP_SAMPLE);
+        status = device->job_transaction.status;
+    }
+    SENSOR_STATS_END(SENSOR_API_TSL2561_READ_DATA);
+    return status;
+}
+
+/******************************************************************************
+* Function Name: tsl2561_submit_data_read
+*******************************************************************************
+*
+* Summary:
+*  Queue the same read as tsl2561_read_data without waiting for it, so
+*  transfers with other devices can go on the bus around it.  When the
+*  transaction is done, get the channels with tsl2561_finish_data_read.
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  SENSOR_TRANSACTION* transaction: transaction to use, not in a queue
+*  uint8* buffer: TSL2561_DATA_BLOCK_LENGTH bytes for the registers, kept
+*                 until the transaction is done
+*
+* Return:
+*  bool: true if queued, false if the device is backing off or the queue is full
+*
+*******************************************************************************/
+
+bool tsl2561_submit_data_read(TSL2561* device, SENSOR_TRANSACTION* transaction, 
+                              uint8* buffer) {
+    if (!sensor_backoff_ready(&device->backoff)) {
+        return false;
+    }
+    transaction->type = SENSOR_XFER_READ;
+    transaction->address = device->address;
+    transaction->_register = tsl2561_regmap.command | TSL2561_DATA_BLOCK_FIRST;
+    transaction->buffer = buffer;
+    transaction->num_bytes = TSL2561_DATA_BLOCK_LENGTH;
+    transaction->callback = queued_done;
+    transaction->context = device;
+    return sensor_bus_submit(device->bus, transaction);
+}
+
+/******************************************************************************
+* Function Name: tsl2561_finish_data_read
+*******************************************************************************
+*
+* Summary:
+*  Get the channels and lux of a read queued by tsl2561_submit_data_read
+*  that is done
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  SENSOR_TRANSACTION* transaction: the finished transaction
+*  TSL2561_DATA* data: structure to put the channels and lux in
+*
+* Return:
+*  uint8: SENSOR_OK, or the SENSOR_ERR_* code of the read and data is not changed
+*
+*******************************************************************************/
+
+uint8 tsl2561_finish_data_read(TSL2561* device, SENSOR_TRANSACTION* transaction, 
+                               TSL2561_DATA* data) {
+    uint8* buffer = transaction->buffer;
+    
+    if (transaction->status == SENSOR_OK) {
+        data->channel0 = REGMAP_VALUE(TSL2561_REG_DATA0, &buffer[DATA_OFFSET(TSL2561_REG_DATA0)]);
+        data->channel1 = REGMAP_VALUE(TSL2561_REG_DATA1, &buffer[DATA_OFFSET(TSL2561_REG_DATA1)]);
+        data->lux = tsl2561_calculate_lux(device, data->channel0, data->channel1);
+    }
+    return transaction->status;
+}
+
+/******************************************************************************
+* Function Name: tsl2561_calculate_lux
+*******************************************************************************
+*
+* Summary:
+*  Calculate the lux from the two channels with the integer only 
+*  approximation of the datasheet.  The channels are first scaled to a 
+*  402 ms integration at 16x gain, then the fit for the channel ratio 
+*  of the device package is applied.
+*
+* Parameters:
+*  TSL2561* device: tsl2561 the channels came from, for its timing and package
+*  uint16 channel0: visible and infrared counts
+*  uint16 channel1: infrared counts
+*
+* Return:
+*  uint32: lux, or TSL2561_LUX_SATURATED if a channel is at its maximum
+*
+*******************************************************************************/
+
+uint32 tsl2561_calculate_lux(TSL2561* device, uint16 channel0, uint16 channel1) {
+    const LUX_SEGMENT* segment;
+    const LUX_SEGMENT* last;
+    uint32 channel_scale;
+    uint16 max_count;
+    uint32 scaled0;
+    uint32 scaled1;
+    uint32 ratio = 0;
+    uint32 lux;
+    
+    switch (device->integration_time) {
+        case TSL2561_INTEGRATION_13MS:
+            channel_scale = CHSCALE_TINT0;
+            max_count = TSL2561_MAX_COUNT_13MS;
+            break;
+        case TSL2561_INTEGRATION_101MS:
+            channel_scale = CHSCALE_TINT1;
+            max_count = TSL2561_MAX_COUNT_101MS;
+            break;
+        default:
+            channel_scale = (1 << CH_SCALE);
+            max_count = TSL2561_MAX_COUNT_402MS;
+            break;
+    }
+    if ((channel0 >= max_count) || (channel1 >= max_count)) {
+        return TSL2561_LUX_SATURATED;
+    }
+    if (device->_gain == TSL2561_GAIN_1X) {
+        channel_scale <<= 4;
+    }
+    // below the maximum counts these products fit in 32 bits
+    scaled0 = (channel0 * channel_scale) >> CH_SCALE;
+    scaled1 = (channel1 * channel_scale) >> CH_SCALE;
+    
+    if (scaled0 != 0) {
+        ratio = (((scaled1 << (RATIO_SCALE + 1)) / scaled0) + 1) >> 1;
+    }
+    if (device->package == TSL2561_ID_PARTNO_CS) {
+        segment = lux_segments_cs;
+    }
+    else {
+        segment = lux_segments_t;
+    }
+    for (last = segment + NUM_LUX_SEGMENTS - 1; segment != last; segment++) {
+        if (ratio <= segment->k) {
+            break;
+        }
+    }
+    
+    lux = scaled0 * segment->b;
+    if (lux < scaled1 * segment->m) {
+        return 0;
+    }
+    lux -= scaled1 * segment->m;
+    // round off the fraction bits
+    return (lux + (1 << (LUX_SCALE - 1))) >> LUX_SCALE;
+}
+
+/******************************************************************************
+* Function Name: tsl2561_conversion_time_ms
+*******************************************************************************
+*
+* Summary:
+*  Time from powering up the tsl2561 until both channels hold a conversion
+*  with the integration time it is set to
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
 *
 * Return:
-*  uint8: byte read from the device's ID register
+*  uint16: milliseconds to wait
 *
 *******************************************************************************/
 
-uint8 tsl2561_read_id(void) {
-    return tsl2561_read8(TSL2561_REG_ID); 
+uint16 tsl2561_conversion_time_ms(TSL2561* device) {
+    switch (device->integration_time) {
+        case TSL2561_INTEGRATION_13MS:
+            return TSL2561_CONVERSION_13MS;
+        case TSL2561_INTEGRATION_101MS:
+            return TSL2561_CONVERSION_101MS;
+        default:
+            return TSL2561_CONVERSION_402MS;
+    }
 }
 
 /*****************************************************************************
@@ -94,6 +653,7 @@ uint8 tsl2561_read_id(void) {
 *  Read a byte of data from the specified register.  Uses the sensors.c library
 *
 * Parameters:
+*  TSL2561* device: tsl2561 to use
 *  uint8 _register: register of tsl2591 to read from
 *  uint8 data: value to put into the _register of the tsl2591
 *
@@ -102,25 +662,284 @@ uint8 tsl2561_read_id(void) {
 *
 *******************************************************************************/
 
-static uint8 tsl2561_read8(uint8 _register) {
-    return sensor_read8(TSL2561_I2C_ADDRESS, read_buffer, _register);
+static uint8 tsl2561_read8(TSL2561* device, uint8 _register) {
+    if (tsl2561_read(device, _register, 1) != SENSOR_OK) {
+        return 0;
+    }
+    return device->read_buffer[0];
 }
 
 /*****************************************************************************
-* Function Name: tsl2561_write8
+* Function Name: shadow_flush
 *******************************************************************************
 *
 * Summary:
-*  Write a byte of data to the specified register.  Uses the sensors.c library
+*  Write the control and timing registers that changed, in one transfer,
+*  unless the device is backing off after a failure, and wait for it.
+*  If the device has a job nothing is written, the registers stay dirty
+*  for the next flush.
 *
 * Parameters:
-*  uint8 _register: register of tsl2591 to write to
-*  uint8 data: value to put into the _register of the tsl2591
+*  TSL2561* device: tsl2561 to use
+*
+*******************************************************************************/
+
+static void shadow_flush(TSL2561* device) {
+    job_run(device, JOB_CONFIG, STEP_FLUSH);
+}
+
+/******************************************************************************
+* Function Name: job_begin
+*******************************************************************************
+*
+* Summary:
+*  Set the job of the tsl2561, its first transaction is queued by the 
+*  next tsl2561_poll
+*
+*******************************************************************************/
+
+static void job_begin(TSL2561* device, uint8 job, uint8 step) {
+    device->job = job;
+    device->job_step = step;
+    device->job_ok = true;
+    device->job_transaction.state = SENSOR_XFER_IDLE;
+}
+
+/******************************************************************************
+* Function Name: job_submit
+*******************************************************************************
+*
+* Summary:
+*  Queue the transaction of the step the job is at.  A device that is 
+*  backing off has its job finished with SENSOR_ERR_BACKOFF instead, and 
+*  a flush with nothing dirty finishes the job.
+*
+* Return:
+*  bool: false if the queue of the bus is full
+*
+*******************************************************************************/
+
+static bool job_submit(TSL2561* device) {
+    SENSOR_TRANSACTION* transaction = &device->job_transaction;
+    uint8 num_bytes = 0;
+    
+    if (!sensor_backoff_ready(&device->backoff)) {
+        transaction->status = SENSOR_ERR_BACKOFF;
+        device->job_ok = false;
+        device->job_step = STEP_FINISHED;
+        return true;
+    }
+    if (device->job_step == STEP_FLUSH) {
+        num_bytes = regmap_shadow_flush_buffer(&device->setup, device->write_buffer);
+        if (num_bytes == 0) {
+            device->job_step = STEP_FINISHED;
+            return true;
+        }
+    }
+    transaction->type = SENSOR_XFER_READ;
+    transaction->address = device->address;
+    transaction->buffer = device->read_buffer;
+    transaction->callback = 0;
+    switch (device->job_step) {
+        case STEP_READ_ID:
+            transaction->_register = TSL2561_REG_ID;
+            transaction->num_bytes = 1;
+            break;
+        case STEP_FLUSH:
+            device->write_buffer[0] |= tsl2561_regmap.command;
+            transaction->type = SENSOR_XFER_WRITE;
+            transaction->buffer = device->write_buffer;
+            transaction->num_bytes = num_bytes;
+            break;
+        default:
+            // STEP_SAMPLE
+            transaction->_register = TSL2561_DATA_BLOCK_FIRST;
+            transaction->num_bytes = TSL2561_DATA_BLOCK_LENGTH;
+            break;
+    }
+    transaction->_register |= tsl2561_regmap.command;
+    return sensor_bus_submit(device->bus, transaction);
+}
+
+/******************************************************************************
+* Function Name: job_next
+*******************************************************************************
+*
+* Summary:
+*  Use the result of the transaction of the step the job was at and go to
+*  the next step
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  uint8 status: SENSOR_OK or the SENSOR_ERR_* code of the transaction
+*
+*******************************************************************************/
+
+static void job_next(TSL2561* device, uint8 status) {
+    uint8* buffer = device->read_buffer;
+    TSL2561_DATA* data = device->job_data;
+    uint8 id = buffer[0] & TSL2561_ID_PARTNO_MASK;
+    uint8 timing;
+    
+    switch (device->job_step) {
+        case STEP_READ_ID:
+            if ((status != SENSOR_OK) || 
+                    ((id != TSL2561_ID_PARTNO_T) && (id != TSL2561_ID_PARTNO_CS))) {
+                device->working = false;
+                device->job_ok = false;
+            }
+            device->package = id;
+            // the settings are not known, power up and set the timing in one write
+            regmap_shadow_init(&device->setup, TSL2561_SETUP_BLOCK_FIRST, 
+                               TSL2561_SETUP_BLOCK_LENGTH, TSL2561_POWER_OFF);
+            regmap_shadow_invalidate(&device->setup);
+            device->integration_time = TSL2561_INTEGRATION_402MS;
+            device->_gain = TSL2561_GAIN_1X;
+            regmap_shadow_write(&device->setup, TSL2561_REG_TIMING, 
+                                device->integration_time | device->_gain);
+            REGMAP_SHADOW_FIELD(&device->setup, TSL2561_POWER, TSL2561_POWER_ON);
+            device->job_step = STEP_FLUSH;
+            break;
+        case STEP_FLUSH:
+            if (status != SENSOR_OK) {
+                device->job_ok = false;
+            }
+            else {
+                // the lux of the next samples is calculated with the timing written
+                timing = regmap_shadow_read(&device->setup, TSL2561_REG_TIMING);
+                device->integration_time = timing & TSL2561_INTEG_MASK;
+                device->_gain = timing & TSL2561_GAIN_MASK;
+            }
+            device->job_step = STEP_FINISHED;
+            break;
+        default:
+            // STEP_SAMPLE
+            if (status == SENSOR_OK) {
+                data->channel0 = REGMAP_VALUE(TSL2561_REG_DATA0,
+                                              &buffer[DATA_OFFSET(TSL2561_REG_DATA0)]);
+                data->channel1 = REGMAP_VALUE(TSL2561_REG_DATA1,
+                                              &buffer[DATA_OFFSET(TSL2561_REG_DATA1)]);
+                data->lux = tsl2561_calculate_lux(device, data->channel0, data->channel1);
+            }
+            else {
+                device->job_ok = false;
+            }
+            device->job_step = STEP_FINISHED;
+            break;
+    }
+}
+
+/******************************************************************************
+* Function Name: job_wait
+*******************************************************************************
+*
+* Summary:
+*  Poll the job of the tsl2561 until it is done, for the blocking 
+*  functions of the driver
+*
+* Return:
+*  bool: job_ok of the job
+*
+*******************************************************************************/
+
+static bool job_wait(TSL2561* device) {
+    while (tsl2561_poll(device) == SENSOR_JOB_BUSY) {
+        device->bus->stats.wait_polls++;
+        SENSOR_STATS_SPIN();
+    }
+    return device->job_ok;
+}
+
+/******************************************************************************
+* Function Name: job_run
+*******************************************************************************
+*
+* Summary:
+*  Run a job and wait for it, for the blocking functions of the driver.
+*  Nothing is done if the device already has a job started by a *_begin
+*  function: waiting for it here would take the SENSOR_JOB_DONE its owner
+*  polls for, and change job_ok before the owner reads it.
+*
+* Return:
+*  bool: job_ok of the job, or false if the device already has a job
+*
+*******************************************************************************/
+
+static bool job_run(TSL2561* device, uint8 job, uint8 step) {
+    if (device->job != JOB_NONE) {
+        return false;
+    }
+    job_begin(device, job, step);
+    return job_wait(device);
+}
+
+/*****************************************************************************
+* Function Name: tsl2561_read
+*******************************************************************************
+*
+* Summary:
+*  Read num_bytes into the read buffer starting at _register, with the
+*  command bit set so the register address increments, unless the device
+*  is backing off after a failure or has a job of the *_begin functions,
+*  whose transfers use the same buffer.
+*
+* Parameters:
+*  TSL2561* device: tsl2561 to use
+*  uint8 _register: first register to read
+*  uint8 num_bytes: number of bytes to read
+*
+* Return:
+*  uint8: SENSOR_OK or a SENSOR_ERR_* code, SENSOR_ERR_BUSY if the device has a job
+*
+*******************************************************************************/
+
+static uint8 tsl2561_read(TSL2561* device, uint8 _register, uint8 num_bytes) {
+    uint8 status;
+    
+    if (device->job != JOB_NONE) {
+        return SENSOR_ERR_BUSY;
+    }
+    if (!sensor_backoff_ready(&device->backoff)) {
+        return SENSOR_ERR_BACKOFF;
+    }
+    status = regmap_read(&tsl2561_regmap, device->bus, device->address, device->read_buffer, 
+                         _register, num_bytes);
+    transfer_done(device, status);
+    return status;
+}
+
+/*****************************************************************************
+* Function Name: transfer_done
+*******************************************************************************
+*
+* Summary:
+*  Keep the working flag and backoff of the tsl2561 up to date with the
+*  result of a transfer
+*
+*******************************************************************************/
+
+static void transfer_done(TSL2561* device, uint8 status) {
+    if (status == SENSOR_OK) {
+        if (device->backoff.failures) {
+            device->working = true;
+        }
+    }
+    else {
+        device->working = false;
+        regmap_shadow_invalidate(&device->setup);
+    }
+    sensor_backoff_update(&device->backoff, status);
+}
+
+/*****************************************************************************
+* Function Name: queued_done
+*******************************************************************************
+*
+* Summary:
+*  Callback of the reads queued by tsl2561_submit_data_read
 *
 *******************************************************************************/
 
-static void tsl2561_write8(uint8 _register, uint8 data) {
-    write_buffer[0] = _register;
-    write_buffer[1] = data;
-    sensor_write8(TSL2561_I2C_ADDRESS, write_buffer);
+static void queued_done(SENSOR_TRANSACTION* transaction) {
+    transfer_done((TSL2561*) transaction->context, transaction->status);
 }
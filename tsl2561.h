@@ -19,21 +19,77 @@
 #if !defined(_TSL2561_H)
 #define _TSL2561_H
     
-#include <project.h>
+#include "platform.h"
 #include "sensor.h"
+#include "regmap.h"
+
+/***************************************
+*    TSL2561 Register Map
+***************************************/ 
+
+// name, address, bytes
+#define TSL2561_REGISTERS(X) \
+    X(TSL2561_REG_CONTROL,          0x00, 1) \
+    X(TSL2561_REG_TIMING,           0x01, 1) \
+    X(TSL2561_REG_THRESHOLD_LOW,    0x02, 2) \
+    X(TSL2561_REG_THRESHOLD_HIGH,   0x04, 2) \
+    X(TSL2561_REG_INTERRUPT,        0x06, 1) \
+    X(TSL2561_REG_ID,               0x0A, 1) \
+    X(TSL2561_REG_DATA0,            0x0C, 2) \
+    X(TSL2561_REG_DATA1,            0x0E, 2)
+
+// name, register, shift, bits
+#define TSL2561_FIELDS(X) \
+    X(TSL2561_POWER,                TSL2561_REG_CONTROL, 0, 2) \
+    X(TSL2561_INTEG,                TSL2561_REG_TIMING, 0, 2) \
+    X(TSL2561_MANUAL,               TSL2561_REG_TIMING, 3, 1) \
+    X(TSL2561_GAIN,                 TSL2561_REG_TIMING, 4, 1) \
+    X(TSL2561_PERSIST,              TSL2561_REG_INTERRUPT, 0, 4) \
+    X(TSL2561_INTR,                 TSL2561_REG_INTERRUPT, 4, 2) \
+    X(TSL2561_REVNO,                TSL2561_REG_ID, 0, 4) \
+    X(TSL2561_PARTNO,               TSL2561_REG_ID, 4, 4)
+
+// Auto-increment ranges used in one transfer: name, first register, bytes
+#define TSL2561_BLOCKS(X) \
+    X(TSL2561_SETUP_BLOCK,          TSL2561_REG_CONTROL, 2) \
+    X(TSL2561_THRESHOLD_BLOCK,      TSL2561_REG_THRESHOLD_LOW, 4) \
+    X(TSL2561_DATA_BLOCK,           TSL2561_REG_DATA0, 4)
+
+REGMAP_CONSTANTS(TSL2561_REGISTERS, TSL2561_FIELDS, TSL2561_BLOCKS)
+
+extern const REGMAP tsl2561_regmap;
 
 /***************************************
 *      Structures
 ***************************************/ 
 
+typedef struct {
+    uint16 channel0;    // visible and infrared
+    uint16 channel1;    // infrared only
+    uint32 lux;         // TSL2561_LUX_SATURATED if a channel is at its maximum
+} TSL2561_DATA;
+
 typedef struct {
     uint8 working;
+    SENSOR_BUS* bus;
+    uint8 address;
+    SENSOR_BACKOFF backoff;  // skips the device for a while after a failed transfer
+    uint8 package;      // TSL2561_ID_PARTNO_T or TSL2561_ID_PARTNO_CS
     uint8 integration_time;
     uint8 _gain;
+    REGMAP_SHADOW setup;    // shadow of the control and timing registers
+    // Job moved forward by tsl2561_poll
+    uint8 job;
+    uint8 job_step;
+    bool job_ok;            // false if the last job failed
+    TSL2561_DATA* job_data; // where a sample job puts the channels
+    SENSOR_TRANSACTION job_transaction;
+    
+    // I2C communication buffers
+    uint8 read_buffer[8];
+    uint8 write_buffer[REGMAP_SHADOW_SIZE + 1];
 } TSL2561;
 
-TSL2561 tsl2561;
-
 /***************************************
 *    ISL29125 Device Constants
 ***************************************/ 
@@ -42,33 +98,67 @@ TSL2561 tsl2561;
 #define I2C_ADDRESS_FLOAT           0X39
 #define I2C_ADDRESS_VDD             0X49
 
-#define TSL
-
 /***************************************
-*    ISL29125 Register Assignment
+*       Register settings
 ***************************************/ 
 
-#define TSL2561_REG_CONTROL         0x00
-#define TSL2561_REG_TIMING          0x01
-#define TSL2561_REG_THRESHOLD_LL    0x02
-#define TSL2561_REG_THRESHOLD_LH    0x03
-#define TSL2561_REG_THRESHOLD_HL    0x04
-#define TSL2561_REG_THRESHOLD_HH    0x05
-#define TSL2561_REG_INTERRUPT       0x06
-#define TSL2561_REG_ID              0x0A
-#define TSL2561_REG_DATA0_LOW       0x0C
-#define TSL2561_REG_DATA0_HIGH      0x0D
-#define TSL2561_REG_DATA1_LOW       0x0E
-#define TSL2561_REG_DATA1_HIGH      0x0F
+// COMMAND BYTE, sent before every register access
+#define TSL2561_COMMAND_BIT         0x80
+#define TSL2561_CLEAR_BIT           0x40
+    
+// CONTROL REGISTER OPTIONS
+#define TSL2561_POWER_OFF           REGMAP_ENCODE(TSL2561_POWER, 0)
+#define TSL2561_POWER_ON            REGMAP_ENCODE(TSL2561_POWER, 3)
+    
+// TIMING REGISTER OPTIONS
+#define TSL2561_GAIN_1X             REGMAP_ENCODE(TSL2561_GAIN, 0)
+#define TSL2561_GAIN_16X            REGMAP_ENCODE(TSL2561_GAIN, 1)
+#define TSL2561_INTEGRATION_13MS    REGMAP_ENCODE(TSL2561_INTEG, 0)
+#define TSL2561_INTEGRATION_101MS   REGMAP_ENCODE(TSL2561_INTEG, 1)
+#define TSL2561_INTEGRATION_402MS   REGMAP_ENCODE(TSL2561_INTEG, 2)
+    
+// ID REGISTER, the upper nibble is the part number
+#define TSL2561_ID_PARTNO_MASK      TSL2561_PARTNO_MASK
+#define TSL2561_ID_PARTNO_CS        REGMAP_ENCODE(TSL2561_PARTNO, 0x1)
+#define TSL2561_ID_PARTNO_T         REGMAP_ENCODE(TSL2561_PARTNO, 0x5)    // T, FN and CL packages
+    
+// Maximum counts of each integration time, and lux reported for them
+#define TSL2561_MAX_COUNT_13MS      5047
+#define TSL2561_MAX_COUNT_101MS     37177
+#define TSL2561_MAX_COUNT_402MS     65535
+#define TSL2561_LUX_SATURATED       0xFFFFFFFF
+    
+// Integration times rounded up, with a margin for the internal oscillator
+#define TSL2561_CONVERSION_13MS     15
+#define TSL2561_CONVERSION_101MS    110
+#define TSL2561_CONVERSION_402MS    430
+
+// Saved for a warm start: address, control, timing and package
+#define TSL2561_WARM_RECORD_SIZE    4
 
 /***************************************
 *        Function Prototypes
 ***************************************/     
 
-void tsl2561_Init(void); 
-void tsl2561_Start(void);
+void tsl2561_Init(TSL2561* device, SENSOR_BUS* bus, uint8 address); 
+void tsl2561_init_begin(TSL2561* device, SENSOR_BUS* bus, uint8 address);
+bool tsl2561_config_begin(TSL2561* device, uint8 integration_time, uint8 gain);
+bool tsl2561_sample_begin(TSL2561* device, TSL2561_DATA* data);
+uint8 tsl2561_poll(TSL2561* device);
+bool tsl2561_warm_init(TSL2561* device, SENSOR_BUS* bus, uint8 address, uint8 slot);
+bool tsl2561_save_config(TSL2561* device, uint8 slot);
+void tsl2561_Start(TSL2561* device);
+void tsl2561_Stop(TSL2561* device);
+void tsl2561_set_timing(TSL2561* device, uint8 integration_time, uint8 gain);
 
-uint8 tsl2561_read_id(void);
+uint8 tsl2561_read_id(TSL2561* device);
+uint8 tsl2561_read_data(TSL2561* device, TSL2561_DATA* data);
+bool tsl2561_submit_data_read(TSL2561* device, SENSOR_TRANSACTION* transaction, 
+                              uint8* buffer);
+uint8 tsl2561_finish_data_read(TSL2561* device, SENSOR_TRANSACTION* transaction, 
+                               TSL2561_DATA* data);
+uint32 tsl2561_calculate_lux(TSL2561* device, uint16 channel0, uint16 channel1);
+uint16 tsl2561_conversion_time_ms(TSL2561* device);
 
 
 